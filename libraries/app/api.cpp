@@ -200,6 +200,21 @@ namespace graphene { namespace app {
        return _app.p2p_node()->get_potential_peers();
     }
 
+    std::vector<net::sync_peer_stats> network_node_api::get_sync_peer_stats() const
+    {
+       return _app.p2p_node()->get_sync_peer_stats();
+    }
+
+    vector<index_memory_usage> network_node_api::get_index_memory_usage() const
+    {
+       return _app.chain_database()->get_index_memory_usage();
+    }
+
+    block_production_stats network_node_api::get_block_production_stats() const
+    {
+       return _app.chain_database()->get_block_production_stats();
+    }
+
     fc::variant_object network_node_api::get_advanced_node_parameters() const
     {
        return _app.p2p_node()->get_advanced_node_parameters();
@@ -31,6 +31,7 @@
 
 #include <graphene/egenesis/egenesis.hpp>
 
+#include <graphene/net/blockchain_synopsis.hpp>
 #include <graphene/net/core_messages.hpp>
 #include <graphene/net/exceptions.hpp>
 
@@ -43,6 +44,7 @@
 #include <fc/rpc/websocket_api.hpp>
 #include <fc/network/resolve.hpp>
 #include <fc/crypto/base64.hpp>
+#include <fc/thread/thread.hpp>
 
 #include <boost/filesystem/path.hpp>
 #include <boost/signals2.hpp>
@@ -312,6 +314,8 @@ namespace detail {
 
       ~application_impl()
       {
+         for( auto& thread : _validation_threads )
+            thread->quit();
       }
 
       void set_dbg_init_key( genesis_state_type& genesis, const std::string& init_key )
@@ -387,12 +391,42 @@ namespace detail {
          }
          _chain_db->add_checkpoints( loaded_checkpoints );
 
+         if( _options->count("track-state-hash") && _options->at("track-state-hash").as<bool>() )
+         {
+            flat_map<uint32_t,fc::uint128> state_hash_checkpoints;
+            if( _options->count("state-hash-checkpoint") )
+            {
+               auto cps = _options->at("state-hash-checkpoint").as<vector<string>>();
+               state_hash_checkpoints.reserve( cps.size() );
+               for( auto cp : cps )
+               {
+                  auto item = fc::json::from_string(cp).as<std::pair<uint32_t,fc::uint128> >( 2 );
+                  state_hash_checkpoints[item.first] = item.second;
+               }
+            }
+            _chain_db->add_state_hash_checkpoints( state_hash_checkpoints );
+            _chain_db->enable_state_hash( true );
+         }
+
          if( _options->count("replay-blockchain") )
             _chain_db->wipe( _data_dir / "blockchain", false );
 
          try
          {
-            _chain_db->open( _data_dir / "blockchain", initial_state, GRAPHENE_CURRENT_DB_VERSION );
+            if( _options->count("import-snapshot") )
+            {
+               FC_ASSERT( _options->count("snapshot-trusted-block-id"),
+                          "import-snapshot requires the id of the snapshot block in snapshot-trusted-block-id" );
+               FC_ASSERT( _options->count("snapshot-trusted-state-hash"),
+                          "import-snapshot requires the state hash of the snapshot block in snapshot-trusted-state-hash" );
+               _chain_db->open_from_snapshot( _options->at("import-snapshot").as<boost::filesystem::path>(),
+                                              block_id_type( _options->at("snapshot-trusted-block-id").as<string>() ),
+                                              fc::variant( _options->at("snapshot-trusted-state-hash").as<string>() )
+                                                 .as<fc::uint128>( 1 ),
+                                              _data_dir / "blockchain", initial_state, GRAPHENE_CURRENT_DB_VERSION );
+            }
+            else
+               _chain_db->open( _data_dir / "blockchain", initial_state, GRAPHENE_CURRENT_DB_VERSION );
          }
          catch( const fc::exception& e )
          {
@@ -400,12 +434,38 @@ namespace detail {
             throw;
          }
 
+         if( _options->count("flush-state-interval") )
+            _chain_db->set_flush_interval( _options->at("flush-state-interval").as<uint32_t>() );
+         if( _options->count("block-log-sync-interval-ms") )
+            _chain_db->set_block_log_sync_interval( fc::milliseconds( _options->at("block-log-sync-interval-ms").as<uint32_t>() ) );
+         if( _options->count("block-log-segment-size") )
+            _chain_db->set_block_log_segment_size( _options->at("block-log-segment-size").as<uint32_t>(),
+                                                   _options->at("block-log-compression-threads").as<uint32_t>() );
+         if( _options->count("prune-blocks-window") && _options->at("prune-blocks-window").as<uint32_t>() > 0 )
+         {
+            // blocks are never pruned past the last state saved to disk, see database::set_block_prune_window()
+            FC_ASSERT( _options->at("flush-state-interval").as<uint32_t>() > 0,
+                       "prune-blocks-window requires flush-state-interval, otherwise nothing is ever pruned" );
+            _chain_db->set_block_prune_window( _options->at("prune-blocks-window").as<uint32_t>() );
+         }
+         if( _options->count("memory-usage-log-interval") )
+            _chain_db->set_memory_usage_log_interval( _options->at("memory-usage-log-interval").as<uint32_t>() );
+
+         if( _options->count("export-snapshot") )
+            _chain_db->export_snapshot( _options->at("export-snapshot").as<boost::filesystem::path>() );
+
          if( _options->count("force-validate") )
          {
             ilog( "All transaction signatures will be validated" );
             _force_validate = true;
          }
 
+         const uint32_t validation_threads = _options->count("transaction-validation-threads") ?
+                                             _options->at("transaction-validation-threads").as<uint32_t>() : 0;
+         for( uint32_t i = 0; i < validation_threads; ++i )
+            _validation_threads.push_back( std::make_shared<fc::thread>( "trx_validation_" + fc::to_string( i ) ) );
+         ilog( "Using ${n} threads to validate transactions received from the network", ("n", validation_threads) );
+
          if( _options->count("api-access") ) {
 
             if(fc::exists(_options->at("api-access").as<boost::filesystem::path>()))
@@ -526,6 +586,9 @@ namespace detail {
             }
 
             return result;
+         } catch ( const graphene::chain::unlinkable_block_buffered& e ) {
+            // the block was kept and will be pushed as soon as its predecessor arrives
+            FC_THROW_EXCEPTION(graphene::net::unlinkable_block_buffered, "Block buffered:\n${e}", ("e", e.to_detail_string()));
          } catch ( const graphene::chain::unlinkable_block_exception& e ) {
             // translate to a graphene::net exception
             elog("Error when pushing block:\n${e}", ("e", e.to_detail_string()));
@@ -554,19 +617,52 @@ namespace detail {
             trx_count = 0;
          }
 
+         precheck_transaction( transaction_message.trx );
          _chain_db->push_transaction( transaction_message.trx );
       } FC_CAPTURE_AND_RETHROW( (transaction_message) ) }
 
+      /**
+       * Run the stateless checks of a transaction received from the network, i.e. validate() and the
+       * recovery of the signing keys, on one of the validation threads. Invalid transactions are rejected
+       * here without occupying the chain thread, which keeps processing other messages while waiting.
+       * The recovered keys are cached in the transaction and reused by push_transaction.
+       */
+      void precheck_transaction( const signed_transaction& trx )
+      {
+         if( _validation_threads.empty() )
+            return;
+         const chain_id_type chain_id = _chain_db->get_chain_id();
+         auto& thread = _validation_threads[ _next_validation_thread++ % _validation_threads.size() ];
+         thread->async( [&trx,chain_id]() {
+            trx.validate();
+            trx.get_signature_keys( chain_id );
+         }, "precheck_transaction" ).wait();
+      }
+
       virtual void handle_message(const message& message_to_process) override
       {
          // not a transaction, not a block
          FC_THROW( "Invalid Message Type" );
       }
 
+      /**
+       * Returns the id of a block of the preferred chain, from the cache if it is between the last
+       * irreversible block and the head.  The cache is brought up to date with the head first.
+       */
+      block_id_type get_preferred_chain_block_id(uint32_t block_num)
+      {
+        _synopsis_block_ids.update( std::max( _chain_db->last_non_undoable_block_num(), 1u ),
+                                    _chain_db->head_block_num(), _chain_db->head_block_id(),
+                                    [this]( uint32_t num ) { return _chain_db->get_block_id_for_num( num ); } );
+        if( _synopsis_block_ids.contains(block_num) )
+          return _synopsis_block_ids.at(block_num);
+        return _chain_db->get_block_id_for_num(block_num);
+      }
+
       bool is_included_block(const block_id_type& block_id)
       {
         uint32_t block_num = block_header::num_from_id(block_id);
-        block_id_type block_id_in_preferred_chain = _chain_db->get_block_id_for_num(block_num);
+        block_id_type block_id_in_preferred_chain = get_preferred_chain_block_id(block_num);
         return block_id == block_id_in_preferred_chain;
       }
 
@@ -588,7 +684,6 @@ namespace detail {
          if( _chain_db->head_block_num() == 0 )
             return result;
 
-         result.reserve(limit);
          block_id_type last_known_block_id;
 
          if (blockchain_synopsis.empty() ||
@@ -605,7 +700,9 @@ namespace detail {
            bool found_a_block_in_synopsis = false;
            for (const item_hash_t& block_id_in_synopsis : boost::adaptors::reverse(blockchain_synopsis))
              if (block_id_in_synopsis == block_id_type() ||
-                 (_chain_db->is_known_block(block_id_in_synopsis) && is_included_block(block_id_in_synopsis)))
+                 ((_chain_db->is_known_block(block_id_in_synopsis) ||
+                   block_header::num_from_id(block_id_in_synopsis) < _chain_db->first_available_block_num()) &&
+                  is_included_block(block_id_in_synopsis)))
              {
                last_known_block_id = block_id_in_synopsis;
                found_a_block_in_synopsis = true;
@@ -614,11 +711,7 @@ namespace detail {
            if (!found_a_block_in_synopsis)
              FC_THROW_EXCEPTION(graphene::net::peer_is_on_an_unreachable_fork, "Unable to provide a list of blocks starting at any of the blocks in peer's synopsis");
          }
-         for( uint32_t num = block_header::num_from_id(last_known_block_id);
-              num <= _chain_db->head_block_num() && result.size() < limit;
-              ++num )
-            if( num > 0 )
-               result.push_back(_chain_db->get_block_id_for_num(num));
+         result = _chain_db->get_block_ids_from( block_header::num_from_id(last_known_block_id), limit );
 
          if( !result.empty() && block_header::num_from_id(result.back()) < _chain_db->head_block_num() )
             remaining_item_count = _chain_db->head_block_num() - block_header::num_from_id(result.back());
@@ -634,13 +727,8 @@ namespace detail {
         // ilog("Request for item ${id}", ("id", id));
          if( id.item_type == graphene::net::block_message_type )
          {
-            auto opt_block = _chain_db->fetch_block_by_id(id.item_hash);
-            if( !opt_block )
-               elog("Couldn't find block ${id} -- corresponding ID in our chain is ${id2}",
-                    ("id", id.item_hash)("id2", _chain_db->get_block_id_for_num(block_header::num_from_id(id.item_hash))));
-            FC_ASSERT( opt_block.valid() );
-            // ilog("Serving up block #${num}", ("num", opt_block->block_num()));
-            return block_message(std::move(*opt_block));
+            // ilog("Serving up block #${num}", ("num", block_header::num_from_id(id.item_hash)));
+            return block_message( _chain_db->get_block_by_id( id.item_hash ) );
          }
          return trx_message( _chain_db->get_recent_transaction( id.item_hash ) );
       } FC_CAPTURE_AND_RETHROW( (id) ) }
@@ -816,7 +904,7 @@ namespace detail {
             // if it's <= non_fork_high_block_num, we grab it from the main blockchain;
             // if it's not, we pull it from the fork history
             if (low_block_num <= non_fork_high_block_num)
-              synopsis.push_back(_chain_db->get_block_id_for_num(low_block_num));
+              synopsis.push_back(get_preferred_chain_block_id(low_block_num));
             else
               synopsis.push_back(fork_history[low_block_num - non_fork_high_block_num - 1]);
             low_block_num += (true_high_block_num - low_block_num + 2) / 2;
@@ -898,6 +986,11 @@ namespace detail {
       std::map<string, std::shared_ptr<abstract_plugin>> _available_plugins;
 
       bool _is_finished_syncing = false;
+      /// ids of the reversible blocks of the preferred chain, which blockchain synopses are built from
+      graphene::net::block_id_cache _synopsis_block_ids;
+
+      std::vector< std::shared_ptr<fc::thread> >            _validation_threads;
+      uint32_t                                              _next_validation_thread = 0;
    };
 
 }
@@ -927,6 +1020,29 @@ void application::set_program_options(boost::program_options::options_descriptio
          ("seed-node,s", bpo::value<vector<string>>()->composing(), "P2P nodes to connect to on startup (may specify multiple times)")
          ("seed-nodes", bpo::value<string>()->composing(), "JSON array of P2P nodes to connect to on startup")
          ("checkpoint,c", bpo::value<vector<string>>()->composing(), "Pairs of [BLOCK_NUM,BLOCK_ID] that should be enforced as checkpoints.")
+         ("track-state-hash", bpo::bool_switch()->default_value(false), "Maintain a hash of the chain state and record it after every block")
+         ("state-hash-checkpoint", bpo::value<vector<string>>()->composing(),
+          "Pairs of [BLOCK_NUM,STATE_HASH], a divergence from them is logged (requires track-state-hash)")
+         ("flush-state-interval", bpo::value<uint32_t>()->default_value(0),
+          "Write the object database to disk in the background every N blocks, to shorten the replay after a crash (0 disables)")
+         ("block-log-sync-interval-ms", bpo::value<uint32_t>()->default_value(1000),
+          "Sync stored blocks to disk at most this many milliseconds after they were stored (0 syncs every block)")
+         ("block-log-segment-size", bpo::value<uint32_t>()->default_value(0),
+          "Compress irreversible blocks into segments of this many blocks to save disk space (0 disables)")
+         ("block-log-compression-threads", bpo::value<uint32_t>()->default_value(2),
+          "Number of block log segments compressed in parallel")
+         ("prune-blocks-window", bpo::value<uint32_t>()->default_value(0),
+          "Keep only this many recent blocks and the reversible blocks, 0 keeps the full history. Pruned blocks cannot be served to peers or replayed. "
+          "Requires flush-state-interval: blocks are only pruned up to the last state written to disk")
+         ("memory-usage-log-interval", bpo::value<uint32_t>()->default_value(0),
+          "Log the estimated memory held by the largest object indexes every N blocks (0 disables)")
+         ("export-snapshot", bpo::value<boost::filesystem::path>(),
+          "Write a state snapshot of the last irreversible block to this directory after opening the database")
+         ("import-snapshot", bpo::value<boost::filesystem::path>(),
+          "Start a new node from the state snapshot in this directory instead of replaying from genesis")
+         ("snapshot-trusted-block-id", bpo::value<string>(), "Block id the imported snapshot must be of")
+         ("snapshot-trusted-state-hash", bpo::value<string>(),
+          "State hash the imported snapshot must have, as reported by get_block_state_hash on a trusted node")
          ("rpc-endpoint", bpo::value<string>()->implicit_value("127.0.0.1:8090"), "Endpoint for websocket RPC to listen on")
          ("rpc-tls-endpoint", bpo::value<string>()->implicit_value("127.0.0.1:8089"), "Endpoint for TLS websocket RPC to listen on")
          ("server-pem,p", bpo::value<string>()->implicit_value("server.pem"), "The TLS certificate file for this server")
@@ -935,6 +1051,9 @@ void application::set_program_options(boost::program_options::options_descriptio
          ("dbg-init-key", bpo::value<string>(), "Block signing key to use for init witnesses, overrides genesis file")
          ("api-access", bpo::value<boost::filesystem::path>(), "JSON file specifying API permissions")
          ("plugins", bpo::value<string>(), "Space-separated list of plugins to activate")
+         ("transaction-validation-threads", bpo::value<uint32_t>()->default_value(2),
+          "Number of threads validating and recovering signatures of transactions received from the network before "
+          "they are pushed to the database, 0 to do it on the chain thread")
          ;
    command_line_options.add(configuration_file_options);
    command_line_options.add_options()
@@ -75,6 +75,7 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       // Blocks and transactions
       optional<block_header> get_block_header(uint32_t block_num)const;
       map<uint32_t, optional<block_header>> get_block_header_batch(const vector<uint32_t> block_nums)const;
+      optional<fc::uint128> get_block_state_hash(uint32_t block_num)const;
       optional<signed_block_with_info> get_block(uint32_t block_num)const;
       processed_transaction get_transaction( uint32_t block_num, uint32_t trx_in_block )const;
 
@@ -99,6 +100,9 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       vector<account_uid_type> get_account_references( account_uid_type uid )const;
       vector<optional<account_object>> lookup_account_names(const vector<string>& account_names)const;
       map<string,account_uid_type> lookup_accounts_by_name(const string& lower_bound_name, uint32_t limit)const;
+      vector<pair<string,account_uid_type>> lookup_accounts_by_prefix(const string& prefix, const string& start_after,
+                                                                      uint32_t limit)const;
+      uint64_t count_accounts_by_prefix(const string& prefix)const;
       uint64_t get_account_count()const;
 
       // CSAF
@@ -380,6 +384,16 @@ map<uint32_t, optional<block_header>> database_api_impl::get_block_header_batch(
    return results;
 }
 
+optional<fc::uint128> database_api::get_block_state_hash(uint32_t block_num)const
+{
+   return my->get_block_state_hash( block_num );
+}
+
+optional<fc::uint128> database_api_impl::get_block_state_hash(uint32_t block_num)const
+{
+   return _db.get_block_state_hash( block_num );
+}
+
 optional<signed_block_with_info> database_api::get_block(uint32_t block_num)const
 {
    return my->get_block( block_num );
@@ -854,6 +868,35 @@ map<string,account_uid_type> database_api_impl::lookup_accounts_by_name(const st
    return result;
 }
 
+vector<pair<string,account_uid_type>> database_api::lookup_accounts_by_prefix(const string& prefix, const string& start_after,
+                                                                              uint32_t limit)const
+{
+   return my->lookup_accounts_by_prefix( prefix, start_after, limit );
+}
+
+vector<pair<string,account_uid_type>> database_api_impl::lookup_accounts_by_prefix(const string& prefix,
+                                                                                   const string& start_after,
+                                                                                   uint32_t limit)const
+{
+   FC_ASSERT( limit <= 1001 );
+   const auto& idx = _db.get_index_type<account_index>();
+   const auto& aidx = dynamic_cast<const primary_index<account_index>&>(idx);
+   const auto& names = aidx.get_secondary_index<graphene::chain::account_name_prefix_index>().names;
+   return names.find_prefix( prefix, start_after, limit );
+}
+
+uint64_t database_api::count_accounts_by_prefix(const string& prefix)const
+{
+   return my->count_accounts_by_prefix( prefix );
+}
+
+uint64_t database_api_impl::count_accounts_by_prefix(const string& prefix)const
+{
+   const auto& idx = _db.get_index_type<account_index>();
+   const auto& aidx = dynamic_cast<const primary_index<account_index>&>(idx);
+   return aidx.get_secondary_index<graphene::chain::account_name_prefix_index>().names.count_prefix( prefix );
+}
+
 uint64_t database_api::get_account_count()const
 {
    return my->get_account_count();
@@ -1757,25 +1800,20 @@ vector<proposal_object> database_api::get_proposed_transactions( account_uid_typ
    return my->get_proposed_transactions( uid );
 }
 
-/** TODO: add secondary index that will accelerate this process */
 vector<proposal_object> database_api_impl::get_proposed_transactions( account_uid_type uid )const
 {
-   const auto& idx = _db.get_index_type<proposal_index>();
-   vector<proposal_object> result;
+   const auto& proposal_idx = _db.get_index_type<proposal_index>();
+   const auto& pidx = dynamic_cast<const primary_index<proposal_index>&>(proposal_idx);
+   const auto& proposals_by_account = pidx.get_secondary_index<graphene::chain::required_approval_index>();
 
-   idx.inspect_all_objects( [&](const object& obj){
-           const proposal_object& p = static_cast<const proposal_object&>(obj);
-           if( p.required_secondary_approvals.find( uid ) != p.required_secondary_approvals.end() )
-              result.push_back(p);
-           else if( p.required_active_approvals.find( uid ) != p.required_active_approvals.end() )
-              result.push_back(p);
-           else if ( p.required_owner_approvals.find( uid ) != p.required_owner_approvals.end() )
-              result.push_back(p);
-           else if ( p.available_active_approvals.find( uid ) != p.available_active_approvals.end() )
-              result.push_back(p);
-           else if( p.available_secondary_approvals.find( uid ) != p.available_secondary_approvals.end() )
-              result.push_back(p);
-   });
+   vector<proposal_object> result;
+   auto itr = proposals_by_account._account_to_proposals.find( uid );
+   if( itr != proposals_by_account._account_to_proposals.end() )
+   {
+      result.reserve( itr->second.size() );
+      for( auto proposal_id : itr->second )
+         result.push_back( proposal_id(_db) );
+   }
    return result;
 }
 
@@ -207,7 +207,7 @@ namespace graphene { namespace app {
    };
 
    /**
-    * @brief The network_node_api class allows maintenance of p2p connections.
+    * @brief The network_node_api class allows maintenance of p2p connections and inspection of the node.
     */
    class network_node_api
    {
@@ -248,6 +248,29 @@ namespace graphene { namespace app {
           */
          std::vector<net::potential_peer_record> get_potential_peers() const;
 
+         /**
+          * @brief Return the measured throughput, latency and request window of the peers blocks are
+          *        being synchronized from
+          */
+         std::vector<net::sync_peer_stats> get_sync_peer_stats() const;
+
+         /**
+          * @brief Estimate the memory held by each object index
+          * @return For every index its object count, the size of its objects, the heap memory owned by their
+          * members, the overhead of the container and the memory of its secondary indexes
+          *
+          * This walks every object in the database, so it is slow on a large chain and only offered to node
+          * operators.
+          */
+         vector<index_memory_usage> get_index_memory_usage() const;
+
+         /**
+          * @brief Get the totals of the blocks generated by this node since it started
+          * @return Blocks produced, deadline hits, included and deferred transactions, production times and
+          * the stats of the last generated block
+          */
+         block_production_stats get_block_production_stats() const;
+
       private:
          application& _app;
    };
@@ -392,6 +415,9 @@ FC_API(graphene::app::network_node_api,
        (add_node)
        (get_connected_peers)
        (get_potential_peers)
+       (get_sync_peer_stats)
+       (get_index_memory_usage)
+       (get_block_production_stats)
        (get_advanced_node_parameters)
        (set_advanced_node_parameters)
      )
@@ -166,6 +166,12 @@ class database_api
       */
       map<uint32_t, optional<block_header>> get_block_header_batch(const vector<uint32_t> block_nums)const;
 
+      /**
+       * @brief Retrieve the hash of the chain state after a block was applied
+       * @param block_num Height of the block
+       * @return the state hash, or null if the node does not track it (see track-state-hash) or the block is too old
+       */
+      optional<fc::uint128> get_block_state_hash(uint32_t block_num)const;
 
       /**
        * @brief Retrieve a full, signed block
@@ -306,6 +312,23 @@ class database_api
        */
       map<string,account_uid_type> lookup_accounts_by_name(const string& lower_bound_name, uint32_t limit)const;
 
+      /**
+       * @brief Get names and UIDs of the accounts whose names start with a prefix, e.g. to autocomplete names
+       * @param prefix Prefix of the names to return, matched case-insensitively
+       * @param start_after Return only names after this one; pass the last name of the previous page to get the
+       * next page, or an empty string to get the first page
+       * @param limit Maximum number of results to return -- must not exceed 1001
+       * @return Names and UIDs of the matching accounts, in ascending order of names
+       */
+      vector<pair<string,account_uid_type>> lookup_accounts_by_prefix(const string& prefix, const string& start_after,
+                                                                      uint32_t limit)const;
+
+      /**
+       * @brief Get the number of accounts whose names start with a prefix
+       * @param prefix Prefix of the names to count, matched case-insensitively
+       */
+      uint64_t count_accounts_by_prefix(const string& prefix)const;
+
       //////////////
       // Balances //
       //////////////
@@ -620,6 +643,7 @@ FC_API( graphene::app::database_api,
    // Blocks and transactions
    (get_block_header)
    (get_block_header_batch)
+   (get_block_state_hash)
    (get_block)
    (get_transaction)
    (get_recent_transaction_by_id)
@@ -644,6 +668,8 @@ FC_API( graphene::app::database_api,
    (get_account_references)
    //(lookup_account_names)
    (lookup_accounts_by_name)
+   (lookup_accounts_by_prefix)
+   (count_accounts_by_prefix)
    (get_account_count)
 
    // CSAF
@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+#include <graphene/chain/account_name_trie.hpp>
+#include <graphene/db/memory_usage.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace chain {
+
+account_name_trie::account_name_trie()
+{
+   _nodes.emplace_back();
+}
+
+uint32_t account_name_trie::new_node()
+{
+   if( !_free_nodes.empty() )
+   {
+      const uint32_t index = _free_nodes.back();
+      _free_nodes.pop_back();
+      return index;
+   }
+   FC_ASSERT( _nodes.size() < npos, "too many nodes in account name trie" );
+   _nodes.emplace_back();
+   return _nodes.size() - 1;
+}
+
+void account_name_trie::free_node( uint32_t index )
+{
+   _nodes[index] = node();
+   _free_nodes.push_back( index );
+}
+
+uint32_t account_name_trie::find_child( uint32_t parent, char first )const
+{
+   const vector<uint32_t>& children = _nodes[parent].children;
+   auto itr = std::lower_bound( children.begin(), children.end(), first,
+                                [this]( uint32_t child, char c ) {
+      return uint8_t( _nodes[child].label[0] ) < uint8_t( c );
+   });
+   if( itr == children.end() || _nodes[*itr].label[0] != first )
+      return npos;
+   return *itr;
+}
+
+void account_name_trie::add_child( uint32_t parent, uint32_t child )
+{
+   const uint8_t first = _nodes[child].label[0];
+   vector<uint32_t>& children = _nodes[parent].children;
+   auto itr = std::find_if( children.begin(), children.end(), [this,first]( uint32_t c ) {
+      return uint8_t( _nodes[c].label[0] ) > first;
+   });
+   children.insert( itr, child );
+}
+
+void account_name_trie::merge_with_child( uint32_t index )
+{
+   const uint32_t child = _nodes[index].children.front();
+   node& n = _nodes[index];
+   node& c = _nodes[child];
+   n.label += c.label;
+   n.terminal = c.terminal;
+   n.uid = c.uid;
+   n.children = std::move( c.children );
+   free_node( child );
+}
+
+bool account_name_trie::insert( const string& name, account_uid_type uid )
+{
+   // nodes whose counts go up if the name is new
+   vector<uint32_t> path;
+   uint32_t current = 0;
+   size_t pos = 0;
+   while( true )
+   {
+      path.push_back( current );
+      if( pos == name.size() )
+      {
+         if( _nodes[current].terminal )
+            return false;
+         _nodes[current].terminal = true;
+         _nodes[current].uid = uid;
+         break;
+      }
+
+      uint32_t child = find_child( current, name[pos] );
+      if( child == npos )
+      {
+         const uint32_t leaf = new_node();
+         node& n = _nodes[leaf];
+         n.label.assign( name, pos, string::npos );
+         n.terminal = true;
+         n.uid = uid;
+         n.count = 1;
+         add_child( current, leaf );
+         break;
+      }
+
+      const size_t label_size = _nodes[child].label.size();
+      size_t common = 1;
+      while( common < label_size && pos + common < name.size() && _nodes[child].label[common] == name[pos + common] )
+         ++common;
+      if( common < label_size )
+      {
+         // the name leaves the edge halfway: split it
+         const uint32_t middle = new_node();
+         node& m = _nodes[middle];
+         m.label.assign( _nodes[child].label, 0, common );
+         m.count = _nodes[child].count;
+         m.children.push_back( child );
+         _nodes[child].label.erase( 0, common );
+         vector<uint32_t>& siblings = _nodes[current].children;
+         *std::find( siblings.begin(), siblings.end(), child ) = middle;
+         child = middle;
+      }
+      current = child;
+      pos += common;
+   }
+   for( uint32_t index : path )
+      ++_nodes[index].count;
+   return true;
+}
+
+bool account_name_trie::remove( const string& name )
+{
+   vector<uint32_t> path;
+   uint32_t current = 0;
+   size_t pos = 0;
+   while( pos < name.size() )
+   {
+      path.push_back( current );
+      const uint32_t child = find_child( current, name[pos] );
+      if( child == npos )
+         return false;
+      const string& label = _nodes[child].label;
+      if( name.compare( pos, label.size(), label ) != 0 )
+         return false;
+      pos += label.size();
+      current = child;
+   }
+   if( !_nodes[current].terminal )
+      return false;
+
+   _nodes[current].terminal = false;
+   path.push_back( current );
+   for( uint32_t index : path )
+      --_nodes[index].count;
+
+   // keep the trie compact: no empty leaves, and no non-terminal nodes with a single child
+   if( current == 0 )
+      return true;
+   if( _nodes[current].children.empty() )
+   {
+      const uint32_t parent = path[path.size() - 2];
+      vector<uint32_t>& siblings = _nodes[parent].children;
+      siblings.erase( std::find( siblings.begin(), siblings.end(), current ) );
+      free_node( current );
+      if( parent != 0 && !_nodes[parent].terminal && _nodes[parent].children.size() == 1 )
+         merge_with_child( parent );
+   }
+   else if( _nodes[current].children.size() == 1 )
+      merge_with_child( current );
+   return true;
+}
+
+uint32_t account_name_trie::locate( const string& prefix, string& key )const
+{
+   key.clear();
+   uint32_t current = 0;
+   size_t pos = 0;
+   while( pos < prefix.size() )
+   {
+      const uint32_t child = find_child( current, prefix[pos] );
+      if( child == npos )
+         return npos;
+      const string& label = _nodes[child].label;
+      const size_t n = std::min( label.size(), prefix.size() - pos );
+      if( prefix.compare( pos, n, label, 0, n ) != 0 )
+         return npos;
+      key += label;
+      pos += label.size();
+      current = child;
+   }
+   return current;
+}
+
+optional<account_uid_type> account_name_trie::find( const string& name )const
+{
+   string key;
+   const uint32_t index = locate( name, key );
+   if( index == npos || key.size() != name.size() || !_nodes[index].terminal )
+      return optional<account_uid_type>();
+   return _nodes[index].uid;
+}
+
+uint64_t account_name_trie::size()const
+{
+   return _nodes[0].count;
+}
+
+uint64_t account_name_trie::count_prefix( const string& prefix )const
+{
+   string key;
+   const uint32_t index = locate( fold_case( prefix ), key );
+   return index == npos ? 0 : _nodes[index].count;
+}
+
+void account_name_trie::collect( uint32_t index, string& key, const string* cursor, uint32_t limit,
+                                 vector<pair<string,account_uid_type>>& result )const
+{
+   const node& n = _nodes[index];
+   if( cursor != nullptr )
+   {
+      if( cursor->compare( 0, key.size(), key ) == 0 )
+      {
+         // the names below may or may not come after the cursor, and this one does not
+         for( uint32_t child : n.children )
+         {
+            if( result.size() >= limit )
+               return;
+            const size_t key_size = key.size();
+            key += _nodes[child].label;
+            collect( child, key, cursor, limit, result );
+            key.resize( key_size );
+         }
+         return;
+      }
+      if( key < *cursor )
+         return;
+      // all names at and below this node come after the cursor
+   }
+
+   if( n.terminal )
+      result.emplace_back( key, n.uid );
+   for( uint32_t child : n.children )
+   {
+      if( result.size() >= limit )
+         return;
+      const size_t key_size = key.size();
+      key += _nodes[child].label;
+      collect( child, key, nullptr, limit, result );
+      key.resize( key_size );
+   }
+}
+
+vector<pair<string,account_uid_type>> account_name_trie::find_prefix( const string& prefix, const string& start_after,
+                                                                      uint32_t limit )const
+{
+   vector<pair<string,account_uid_type>> result;
+   if( limit == 0 )
+      return result;
+   string key;
+   const uint32_t index = locate( fold_case( prefix ), key );
+   if( index == npos )
+      return result;
+
+   result.reserve( std::min<uint64_t>( limit, _nodes[index].count ) );
+   const string cursor = fold_case( start_after );
+   collect( index, key, cursor.empty() ? nullptr : &cursor, limit, result );
+   return result;
+}
+
+uint64_t account_name_trie::heap_bytes()const
+{
+   uint64_t result = graphene::db::heap_allocation_size( _nodes.capacity() * sizeof( node ) )
+                     + graphene::db::heap_size_of( _free_nodes );
+   for( const node& n : _nodes )
+      result += graphene::db::heap_size_of( n.label ) + graphene::db::heap_size_of( n.children );
+   return result;
+}
+
+string account_name_trie::fold_case( const string& s )
+{
+   string result( s );
+   for( char& c : result )
+   {
+      if( c >= 'A' && c <= 'Z' )
+         c += 'a' - 'A';
+   }
+   return result;
+}
+
+} } // graphene::chain
@@ -223,6 +223,14 @@ void account_member_index::object_modified(const object& after)
     }
 }
 
+secondary_index_memory_usage account_member_index::memory_usage()const
+{
+   secondary_index_memory_usage result = secondary_index::memory_usage();
+   result.entry_count = account_to_account_memberships.size() + account_to_key_memberships.size();
+   result.heap_bytes = heap_size_of( account_to_account_memberships ) + heap_size_of( account_to_key_memberships );
+   return result;
+}
+
 void account_referrer_index::object_inserted( const object& obj )
 {
 }
@@ -236,4 +244,101 @@ void account_referrer_index::object_modified( const object& after  )
 {
 }
 
+secondary_index_memory_usage account_referrer_index::memory_usage()const
+{
+   secondary_index_memory_usage result = secondary_index::memory_usage();
+   result.entry_count = referred_by.size();
+   result.heap_bytes = heap_size_of( referred_by );
+   return result;
+}
+
+void account_authority_change_index::object_inserted( const object& obj )
+{
+   assert( dynamic_cast<const account_object*>(&obj) ); // for debug only
+   account_changed( static_cast<const account_object&>(obj).uid );
+}
+void account_authority_change_index::object_removed( const object& obj )
+{
+   assert( dynamic_cast<const account_object*>(&obj) ); // for debug only
+   account_changed( static_cast<const account_object&>(obj).uid );
+}
+void account_authority_change_index::about_to_modify( const object& before )
+{
+   assert( dynamic_cast<const account_object*>(&before) ); // for debug only
+   const account_object& a = static_cast<const account_object&>(before);
+   before_owner     = a.owner;
+   before_active    = a.active;
+   before_secondary = a.secondary;
+}
+void account_authority_change_index::object_modified( const object& after  )
+{
+   assert( dynamic_cast<const account_object*>(&after) ); // for debug only
+   const account_object& a = static_cast<const account_object&>(after);
+   if( !( a.owner == before_owner && a.active == before_active && a.secondary == before_secondary ) )
+      account_changed( a.uid );
+}
+void account_authority_change_index::account_changed( account_uid_type uid )
+{
+   auto itr = authority_changes.find( uid );
+   if( itr != authority_changes.end() )
+      ++itr->second;
+}
+uint64_t account_authority_change_index::watch( account_uid_type uid )const
+{
+   return authority_changes.emplace( uid, 0 ).first->second;
+}
+bool account_authority_change_index::unchanged( const flat_map<account_uid_type, uint64_t>& changes )const
+{
+   for( const auto& item : changes )
+   {
+      auto itr = authority_changes.find( item.first );
+      if( itr == authority_changes.end() || itr->second != item.second )
+         return false;
+   }
+   return true;
+}
+secondary_index_memory_usage account_authority_change_index::memory_usage()const
+{
+   secondary_index_memory_usage result = secondary_index::memory_usage();
+   result.entry_count = authority_changes.size();
+   result.heap_bytes = heap_size_of( authority_changes );
+   return result;
+}
+
+void account_name_prefix_index::object_inserted( const object& obj )
+{
+   assert( dynamic_cast<const account_object*>(&obj) ); // for debug only
+   const account_object& a = static_cast<const account_object&>(obj);
+   names.insert( a.name, a.uid );
+}
+void account_name_prefix_index::object_removed( const object& obj )
+{
+   assert( dynamic_cast<const account_object*>(&obj) ); // for debug only
+   const account_object& a = static_cast<const account_object&>(obj);
+   names.remove( a.name );
+}
+void account_name_prefix_index::about_to_modify( const object& before )
+{
+   assert( dynamic_cast<const account_object*>(&before) ); // for debug only
+   const account_object& a = static_cast<const account_object&>(before);
+   before_name = a.name;
+}
+void account_name_prefix_index::object_modified( const object& after  )
+{
+   assert( dynamic_cast<const account_object*>(&after) ); // for debug only
+   const account_object& a = static_cast<const account_object&>(after);
+   if( a.name != before_name )
+   {
+      names.remove( before_name );
+      names.insert( a.name, a.uid );
+   }
+}
+secondary_index_memory_usage account_name_prefix_index::memory_usage()const
+{
+   secondary_index_memory_usage result = secondary_index::memory_usage();
+   result.entry_count = names.size();
+   result.heap_bytes = names.heap_bytes();
+   return result;
+}
+
 } } // graphene::chain
@@ -23,8 +23,22 @@
  */
 #include <graphene/chain/block_database.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
+#include <fc/crypto/city.hpp>
 #include <fc/io/raw.hpp>
 #include <fc/smart_ref_impl.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <cstdio>
+#include <limits>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef GRAPHENE_HAS_ZLIB
+#include <zlib.h>
+#endif
 
 namespace graphene { namespace chain {
 
@@ -34,28 +48,408 @@ struct index_entry
    uint32_t      block_size = 0;
    block_id_type block_id;
 };
+
+/** An update of the index, as written to the journal */
+struct journal_record
+{
+   uint64_t      block_pos = 0;
+   uint32_t      block_size = 0;
+   block_id_type block_id;
+   /// city_hash64 of the packed block, 0 for a removed block
+   uint64_t      block_checksum = 0;
+   /// city_hash64 of the fields above
+   uint64_t      checksum = 0;
+};
+
+/**
+ * Start of a block log segment file, which is laid out as
+ * [uint32_t header size][packed segment_header][uint64_t city_hash64 of the packed header][payload]
+ */
+struct segment_header
+{
+   uint32_t         first_block_num = 0;
+   /// offsets of the blocks in the uncompressed payload, followed by the payload size
+   vector<uint32_t> offsets;
+   /// size of the compressed payload
+   uint64_t         payload_size = 0;
+   uint64_t         payload_checksum = 0;
+};
  }}
 FC_REFLECT( graphene::chain::index_entry, (block_pos)(block_size)(block_id) );
+FC_REFLECT( graphene::chain::journal_record, (block_pos)(block_size)(block_id)(block_checksum)(checksum) );
+FC_REFLECT( graphene::chain::segment_header, (first_block_num)(offsets)(payload_size)(payload_checksum) );
 
 namespace graphene { namespace chain {
 
+namespace {
+
+uint64_t journal_record_checksum( journal_record r )
+{
+   r.checksum = 0;
+   const auto data = fc::raw::pack( r );
+   return fc::city_hash64( data.data(), data.size() );
+}
+
+/// make the data written to the file at @p p durable, the file's stream must have been flushed
+void sync_file( const fc::path& p )
+{
+#ifndef _WIN32
+   int fd = ::open( p.generic_string().c_str(), O_RDONLY );
+   if( fd >= 0 )
+   {
+      ::fsync( fd );
+      ::close( fd );
+   }
+#endif
+}
+
+/// give the space of the blocks in @p entries back to the file system, keeping the offsets of the other blocks
+void release_blocks( const fc::path& blocks_filename, const vector<index_entry>& entries )
+{
+#if defined(__linux__) && defined(FALLOC_FL_PUNCH_HOLE)
+   int fd = ::open( blocks_filename.generic_string().c_str(), O_WRONLY );
+   if( fd < 0 )
+      return;
+   for( const auto& e : entries )
+   {
+      if( ::fallocate( fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, e.block_pos, e.block_size ) != 0 )
+      {
+         wlog( "The file system does not support releasing space of compressed blocks in ${f}", ("f",blocks_filename) );
+         break;
+      }
+   }
+   ::close( fd );
+#endif
+}
+
+fc::path segment_filename( const fc::path& dir, uint32_t first_block_num )
+{
+   char name[32];
+   snprintf( name, sizeof(name), "%010u.seg", first_block_num );
+   return dir / name;
+}
+
+void write_segment( const fc::path& filename, uint32_t first_block_num, const vector< vector<char> >& blocks )
+{
+#ifdef GRAPHENE_HAS_ZLIB
+   segment_header header;
+   header.first_block_num = first_block_num;
+   header.offsets.reserve( blocks.size() + 1 );
+   vector<char> payload;
+   for( const auto& b : blocks )
+   {
+      header.offsets.push_back( payload.size() );
+      payload.insert( payload.end(), b.begin(), b.end() );
+   }
+   FC_ASSERT( payload.size() <= std::numeric_limits<uint32_t>::max(), "block log segment is too large" );
+   header.offsets.push_back( payload.size() );
+
+   uLongf compressed_size = compressBound( payload.size() );
+   vector<char> compressed( compressed_size );
+   FC_ASSERT( compress2( (Bytef*)compressed.data(), &compressed_size, (const Bytef*)payload.data(), payload.size(),
+                         Z_BEST_SPEED ) == Z_OK, "failed to compress block log segment" );
+   compressed.resize( compressed_size );
+   header.payload_size     = compressed.size();
+   header.payload_checksum = fc::city_hash64( compressed.data(), compressed.size() );
+
+   const auto packed_header = fc::raw::pack( header );
+   const uint32_t header_size = packed_header.size();
+   const uint64_t header_checksum = fc::city_hash64( packed_header.data(), packed_header.size() );
+
+   // written under a temporary name, so that a segment file is either complete or absent
+   const fc::path tmp_filename = filename.generic_string() + ".tmp";
+   {
+      std::ofstream out;
+      out.exceptions( std::ios_base::failbit | std::ios_base::badbit );
+      out.open( tmp_filename.generic_string().c_str(), std::ios::binary | std::ios::trunc );
+      out.write( (const char*)&header_size, sizeof(header_size) );
+      out.write( packed_header.data(), packed_header.size() );
+      out.write( (const char*)&header_checksum, sizeof(header_checksum) );
+      out.write( compressed.data(), compressed.size() );
+   }
+   sync_file( tmp_filename );
+   fc::rename( tmp_filename, filename );
+#else
+   FC_THROW( "This build does not support block log segments" );
+#endif
+}
+
+}
+
+bool block_log_segments::is_supported()
+{
+#ifdef GRAPHENE_HAS_ZLIB
+   return true;
+#else
+   return false;
+#endif
+}
+
+void block_log_segments::open( const fc::path& dir )
+{ try {
+   close();
+   _dir = dir;
+   if( !fc::exists( dir ) )
+      return;
+
+   std::map< uint32_t, segment_info > found;
+   for( fc::directory_iterator itr( dir ); itr != fc::directory_iterator(); ++itr )
+   {
+      const fc::path filename = *itr;
+      const std::string extension = filename.extension().generic_string();
+      if( extension == ".tmp" )
+         fc::remove( filename );
+      if( extension != ".seg" )
+         continue;
+      try
+      {
+         uint32_t first_block_num = 0;
+         segment_info info = read_segment_info( filename, first_block_num );
+         found[first_block_num] = std::move( info );
+      }
+      catch( const fc::exception& e )
+      {
+         elog( "Ignoring unreadable block log segment ${f}: ${e}", ("f",filename)("e",e.to_detail_string()) );
+      }
+   }
+
+   for( auto& item : found )
+   {
+      // segments may leave gaps where blocks were pruned before they were compressed
+      if( !_segments.empty() && item.first < _end_block_num )
+      {
+         elog( "Block log segment ${f} overlaps block ${n}, ignoring it and the segments after it",
+               ("f",item.second.filename)("n",_end_block_num - 1) );
+         break;
+      }
+      _end_block_num = item.first + item.second.offsets.size() - 1;
+      _segments.insert( std::move( item ) );
+   }
+   if( !_segments.empty() )
+      ilog( "Opened block log segments holding blocks ${b} to ${e}", ("b",begin_block_num())("e",_end_block_num - 1) );
+} FC_CAPTURE_AND_RETHROW( (dir) ) }
+
+void block_log_segments::close()
+{
+   _segments.clear();
+   _cache.clear();
+   _end_block_num = 1;
+}
+
+uint32_t block_log_segments::begin_block_num()const
+{
+   return _segments.empty() ? _end_block_num : _segments.begin()->first;
+}
+
+bool block_log_segments::contains( uint32_t block_num )const
+{
+   auto itr = _segments.upper_bound( block_num );
+   if( itr == _segments.begin() )
+      return false;
+   --itr;
+   return block_num < itr->first + itr->second.offsets.size() - 1;
+}
+
+block_log_segments::segment_info block_log_segments::read_segment_info( const fc::path& filename, uint32_t& first_block_num )
+{ try {
+   const uint64_t file_size = fc::file_size( filename );
+   std::ifstream in;
+   in.exceptions( std::ios_base::failbit | std::ios_base::badbit );
+   in.open( filename.generic_string().c_str(), std::ios::binary );
+
+   uint32_t header_size = 0;
+   in.read( (char*)&header_size, sizeof(header_size) );
+   FC_ASSERT( sizeof(header_size) + header_size + sizeof(uint64_t) <= file_size, "truncated segment header" );
+   vector<char> packed_header( header_size );
+   in.read( packed_header.data(), packed_header.size() );
+   uint64_t header_checksum = 0;
+   in.read( (char*)&header_checksum, sizeof(header_checksum) );
+   FC_ASSERT( fc::city_hash64( packed_header.data(), packed_header.size() ) == header_checksum, "corrupt segment header" );
+
+   const segment_header header = fc::raw::unpack<segment_header>( packed_header );
+   FC_ASSERT( header.offsets.size() > 1, "empty segment" );
+
+   segment_info info;
+   info.filename         = filename;
+   info.offsets          = header.offsets;
+   info.payload_pos      = sizeof(header_size) + header_size + sizeof(header_checksum);
+   info.payload_size     = header.payload_size;
+   info.payload_checksum = header.payload_checksum;
+   FC_ASSERT( info.payload_pos + info.payload_size == file_size, "truncated segment payload" );
+   first_block_num = header.first_block_num;
+   return info;
+} FC_CAPTURE_AND_RETHROW( (filename) ) }
+
+std::shared_ptr< const vector<char> > block_log_segments::load_payload( uint32_t first_block_num, const segment_info& info )const
+{
+   for( auto itr = _cache.begin(); itr != _cache.end(); ++itr )
+   {
+      if( itr->first == first_block_num )
+      {
+         _cache.splice( _cache.begin(), _cache, itr );
+         return _cache.front().second;
+      }
+   }
+
+#ifdef GRAPHENE_HAS_ZLIB
+   vector<char> compressed( info.payload_size );
+   {
+      std::ifstream in;
+      in.exceptions( std::ios_base::failbit | std::ios_base::badbit );
+      in.open( info.filename.generic_string().c_str(), std::ios::binary );
+      in.seekg( info.payload_pos );
+      in.read( compressed.data(), compressed.size() );
+   }
+   FC_ASSERT( fc::city_hash64( compressed.data(), compressed.size() ) == info.payload_checksum,
+              "corrupt block log segment ${f}", ("f",info.filename) );
+
+   auto payload = std::make_shared< vector<char> >( info.offsets.back() );
+   uLongf payload_size = payload->size();
+   FC_ASSERT( uncompress( (Bytef*)payload->data(), &payload_size, (const Bytef*)compressed.data(), compressed.size() ) == Z_OK
+              && payload_size == payload->size(), "failed to decompress block log segment ${f}", ("f",info.filename) );
+
+   _cache.emplace_front( first_block_num, payload );
+   if( _cache.size() > MAX_CACHED_SEGMENTS )
+      _cache.pop_back();
+   return payload;
+#else
+   FC_THROW( "This build does not support block log segments" );
+#endif
+}
+
+vector<char> block_log_segments::fetch( uint32_t block_num )const
+{ try {
+   FC_ASSERT( contains( block_num ) );
+   auto itr = _segments.upper_bound( block_num );
+   --itr;
+   const segment_info& info = itr->second;
+   const auto payload = load_payload( itr->first, info );
+   const uint32_t i = block_num - itr->first;
+   return vector<char>( payload->begin() + info.offsets[i], payload->begin() + info.offsets[i+1] );
+} FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
+void block_log_segments::write( const fc::path& dir, uint32_t first_block_num,
+                                const vector< vector< vector<char> > >& segments, uint32_t thread_count )
+{ try {
+   if( segments.empty() )
+      return;
+   FC_ASSERT( is_supported(), "This build does not support block log segments" );
+   fc::create_directories( dir );
+
+   vector<uint32_t> first_block_nums;
+   uint32_t next_block_num = first_block_num;
+   for( const auto& segment : segments )
+   {
+      FC_ASSERT( !segment.empty() );
+      first_block_nums.push_back( next_block_num );
+      next_block_num += segment.size();
+   }
+
+   thread_count = std::max( std::min<uint32_t>( thread_count, segments.size() ), 1u );
+   vector< std::shared_ptr<fc::thread> > threads;
+   vector< fc::future<void> > done;
+   for( uint32_t t = 0; t < thread_count; ++t )
+   {
+      threads.push_back( std::make_shared<fc::thread>( "compress_blocks_" + fc::to_string( t ) ) );
+      done.push_back( threads.back()->async( [&dir,t,thread_count,&segments,&first_block_nums](){
+         for( size_t i = t; i < segments.size(); i += thread_count )
+            write_segment( segment_filename( dir, first_block_nums[i] ), first_block_nums[i], segments[i] );
+      } ) );
+   }
+   // wait for every thread before giving up, they refer to the segments
+   optional<fc::exception> error;
+   for( auto& f : done )
+   {
+      try
+      {
+         f.wait();
+      }
+      catch( const fc::exception& e )
+      {
+         if( !error.valid() )
+            error = e;
+      }
+   }
+   FC_ASSERT( !error.valid(), "failed to write block log segments: ${e}", ("e",error->to_detail_string()) );
+   sync_file( dir );
+} FC_CAPTURE_AND_RETHROW( (dir)(first_block_num)(thread_count) ) }
+
+void block_log_segments::add( uint32_t first_block_num, uint32_t segment_count )
+{ try {
+   FC_ASSERT( _segments.empty() || first_block_num >= _end_block_num );
+   uint32_t segment_first_block_num = first_block_num;
+   for( uint32_t i = 0; i < segment_count; ++i )
+   {
+      uint32_t read_first_block_num = 0;
+      segment_info info = read_segment_info( segment_filename( _dir, segment_first_block_num ), read_first_block_num );
+      FC_ASSERT( read_first_block_num == segment_first_block_num );
+      _end_block_num = segment_first_block_num + info.offsets.size() - 1;
+      _segments[segment_first_block_num] = std::move( info );
+      segment_first_block_num = _end_block_num;
+   }
+} FC_CAPTURE_AND_RETHROW( (first_block_num)(segment_count) ) }
+
+void block_log_segments::remove_below( uint32_t block_num )
+{ try {
+   while( !_segments.empty() )
+   {
+      auto itr = _segments.begin();
+      if( itr->first + itr->second.offsets.size() - 1 > block_num )
+         break;
+      for( auto cached = _cache.begin(); cached != _cache.end(); ++cached )
+      {
+         if( cached->first == itr->first )
+         {
+            _cache.erase( cached );
+            break;
+         }
+      }
+      fc::remove( itr->second.filename );
+      _segments.erase( itr );
+   }
+} FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
 void block_database::open( const fc::path& dbdir )
 { try {
    fc::create_directories(dbdir);
    _block_num_to_pos.exceptions(std::ios_base::failbit | std::ios_base::badbit);
    _blocks.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+   _journal.exceptions(std::ios_base::failbit | std::ios_base::badbit);
 
    _index_filename = dbdir / "index";
+   _blocks_filename = dbdir / "blocks";
+   _journal_filename = dbdir / "journal";
    if( !fc::exists( _index_filename ) )
    {
      _block_num_to_pos.open( _index_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
+     _blocks.open( _blocks_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
    }
    else
    {
      _block_num_to_pos.open( _index_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+     _blocks.open( _blocks_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+     replay_journal();
    }
+   checkpoint_journal();
+   _segments.open( dbdir / "segments" );
+
+   // pruned and unwritten entries form a prefix of the index up to the last stored block
+   const optional<index_entry> last_entry = last_index_entry();
+   uint32_t low = 1;
+   uint32_t high = last_entry.valid() ? block_header::num_from_id( last_entry->block_id ) : 1;
+   while( low < high )
+   {
+      const uint32_t mid = low + ( high - low ) / 2;
+      index_entry e;
+      _block_num_to_pos.seekg( sizeof(e) * mid );
+      _block_num_to_pos.read( (char*)&e, sizeof(e) );
+      if( e.block_size == 0 )
+         low = mid + 1;
+      else
+         high = mid;
+   }
+   _first_available_block_num = low;
+   _last_sync = fc::time_point::now();
 } FC_CAPTURE_AND_RETHROW( (dbdir) ) }
 
 bool block_database::is_open()const
@@ -65,16 +459,139 @@ bool block_database::is_open()const
 
 void block_database::close()
 {
+  try
+  {
+     finish_compression( true );
+  }
+  catch( const fc::exception& e )
+  {
+     elog( "Failed to compress the block log: ${e}", ("e",e.to_detail_string()) );
+  }
+  if( _blocks.is_open() )
+  {
+     sync();
+     checkpoint_journal();
+  }
   _blocks.close();
   _block_num_to_pos.close();
+  _journal.close();
+  _segments.close();
 }
 
 void block_database::flush()
 {
   _blocks.flush();
   _block_num_to_pos.flush();
+  _journal.flush();
 }
 
+void block_database::sync()
+{
+   if( !_unsynced )
+      return;
+   _blocks.flush();
+   _journal.flush();
+   // the blocks first, a journal record must not become durable before the block it refers to
+   sync_file( _blocks_filename );
+   sync_file( _journal_filename );
+   _unsynced = false;
+   _last_sync = fc::time_point::now();
+
+   // the journal records of pruned blocks are durable now
+   if( !_unreleased_blocks.empty() )
+   {
+      // the journal still holds the records storing them, whose data the journal replay checks
+      checkpoint_journal();
+      release_blocks( _blocks_filename, _unreleased_blocks );
+      _unreleased_blocks.clear();
+   }
+   if( _unreleased_segments_end > 0 )
+   {
+      _segments.remove_below( _unreleased_segments_end );
+      _unreleased_segments_end = 0;
+   }
+
+   if( _journal_records >= MAX_JOURNAL_RECORDS )
+      checkpoint_journal();
+}
+
+void block_database::checkpoint_journal()
+{
+   _block_num_to_pos.flush();
+   sync_file( _index_filename );
+   if( _journal.is_open() )
+      _journal.close();
+   _journal.open( _journal_filename.generic_string().c_str(), std::fstream::binary | std::fstream::out | std::fstream::trunc );
+   _journal_records = 0;
+}
+
+void block_database::append_journal( const index_entry& e, uint64_t block_checksum )
+{
+   journal_record r;
+   r.block_pos      = e.block_pos;
+   r.block_size     = e.block_size;
+   r.block_id       = e.block_id;
+   r.block_checksum = block_checksum;
+   r.checksum       = journal_record_checksum( r );
+   const auto data = fc::raw::pack( r );
+   _journal.write( data.data(), data.size() );
+   ++_journal_records;
+   _unsynced = true;
+}
+
+/**
+ * Writes the index updates recorded in the journal to the index again, up to the first record which is
+ * incomplete, fails its checksum or refers to block data which did not make it to disk.
+ */
+void block_database::replay_journal()
+{ try {
+   if( !fc::exists( _journal_filename ) )
+      return;
+   const uint64_t journal_size = fc::file_size( _journal_filename );
+   if( journal_size == 0 )
+      return;
+
+   vector<char> journal( journal_size );
+   {
+      std::ifstream in( _journal_filename.generic_string().c_str(), std::ios::binary );
+      in.read( journal.data(), journal.size() );
+      journal.resize( in.gcount() );
+   }
+
+   _blocks.seekg( 0, _blocks.end );
+   const uint64_t blocks_size = _blocks.tellg();
+
+   const size_t record_size = fc::raw::pack_size( journal_record() );
+   uint32_t replayed = 0;
+   for( size_t pos = 0; pos + record_size <= journal.size(); pos += record_size )
+   {
+      journal_record r;
+      fc::datastream<const char*> ds( journal.data() + pos, record_size );
+      fc::raw::unpack( ds, r );
+      if( r.checksum != journal_record_checksum( r ) )
+         break;
+      if( r.block_size > 0 )
+      {
+         if( r.block_pos + r.block_size > blocks_size )
+            break;
+         vector<char> data( r.block_size );
+         _blocks.seekg( r.block_pos );
+         _blocks.read( data.data(), data.size() );
+         if( fc::city_hash64( data.data(), data.size() ) != r.block_checksum )
+            break;
+      }
+
+      index_entry e;
+      e.block_pos  = r.block_pos;
+      e.block_size = r.block_size;
+      e.block_id   = r.block_id;
+      _block_num_to_pos.seekp( sizeof( index_entry ) * block_header::num_from_id( e.block_id ) );
+      _block_num_to_pos.write( (char*)&e, sizeof(e) );
+      ++replayed;
+   }
+   ilog( "Replayed ${n} of ${t} block database journal records", ("n",replayed)("t",journal.size() / record_size) );
+} FC_CAPTURE_AND_RETHROW() }
+
 void block_database::store( const block_id_type& _id, const signed_block& b )
 {
    block_id_type id = _id;
@@ -92,9 +609,24 @@ void block_database::store( const block_id_type& _id, const signed_block& b )
    e.block_size = vec.size();
    e.block_id   = id;
    _blocks.write( vec.data(), vec.size() );
+   append_journal( e, fc::city_hash64( vec.data(), vec.size() ) );
    _block_num_to_pos.write( (char*)&e, sizeof(e) );
+
+   if( fc::time_point::now() - _last_sync >= _sync_interval )
+      sync();
 }
 
+void block_database::store_id( const block_id_type& id )
+{ try {
+   const uint32_t num = block_header::num_from_id( id );
+   index_entry e;
+   e.block_id = id;
+   append_journal( e, 0 );
+   _block_num_to_pos.seekp( sizeof(e) * num );
+   _block_num_to_pos.write( (char*)&e, sizeof(e) );
+   _first_available_block_num = std::max( _first_available_block_num, num + 1 );
+} FC_CAPTURE_AND_RETHROW( (id) ) }
+
 void block_database::remove( const block_id_type& id )
 { try {
    index_entry e;
@@ -109,6 +641,7 @@ void block_database::remove( const block_id_type& id )
    if( e.block_id == id )
    {
       e.block_size = 0;
+      append_journal( e, 0 );
       _block_num_to_pos.seekp( sizeof(e)*block_header::num_from_id(id) );
       _block_num_to_pos.write( (char*)&e, sizeof(e) );
    }
@@ -161,11 +694,7 @@ optional<signed_block> block_database::fetch_optional( const block_id_type& id )
 
       if( e.block_id != id ) return optional<signed_block>();
 
-      vector<char> data( e.block_size );
-      _blocks.seekg( e.block_pos );
-      if (e.block_size)
-         _blocks.read( data.data(), e.block_size );
-      auto result = fc::raw::unpack<signed_block>(data);
+      auto result = fc::raw::unpack<signed_block>( read_block( e ) );
       FC_ASSERT( result.id() == e.block_id );
       return result;
    }
@@ -191,10 +720,7 @@ optional<signed_block> block_database::fetch_by_number( uint32_t block_num )cons
       _block_num_to_pos.seekg( index_pos, _block_num_to_pos.beg );
       _block_num_to_pos.read( (char*)&e, sizeof(e) );
 
-      vector<char> data( e.block_size );
-      _blocks.seekg( e.block_pos );
-      _blocks.read( data.data(), e.block_size );
-      auto result = fc::raw::unpack<signed_block>(data);
+      auto result = fc::raw::unpack<signed_block>( read_block( e ) );
       FC_ASSERT( result.id() == e.block_id );
       return result;
    }
@@ -207,6 +733,131 @@ optional<signed_block> block_database::fetch_by_number( uint32_t block_num )cons
    return optional<signed_block>();
 }
 
+vector<char> block_database::read_block( const index_entry& e )const
+{
+   vector<char> data;
+   if( e.block_size == 0 )
+      return data;
+   if( _segments.contains( block_header::num_from_id( e.block_id ) ) )
+      return _segments.fetch( block_header::num_from_id( e.block_id ) );
+   data.resize( e.block_size );
+   _blocks.seekg( e.block_pos );
+   _blocks.read( data.data(), e.block_size );
+   return data;
+}
+
+void block_database::set_segment_size( uint32_t blocks_per_segment, uint32_t thread_count )
+{
+   FC_ASSERT( blocks_per_segment == 0 || block_log_segments::is_supported(),
+              "This build does not support block log segments" );
+   _segment_size = blocks_per_segment;
+   _compression_threads = std::max( thread_count, 1u );
+}
+
+void block_database::compress_irreversible( uint32_t last_irreversible_block_num )
+{ try {
+   finish_compression( false );
+   if( _segment_size == 0 || _compressing_segments > 0 )
+      return;
+   // pruned blocks are not compressed, the segments skip them
+   const uint32_t first_block_num = std::max( _segments.end_block_num(), _first_available_block_num );
+   if( last_irreversible_block_num < first_block_num )
+      return;
+   const uint32_t count = std::min( ( last_irreversible_block_num - first_block_num + 1 ) / _segment_size,
+                                    _compression_threads );
+   if( count == 0 )
+      return;
+
+   vector<index_entry> entries( count * _segment_size );
+   _block_num_to_pos.seekg( sizeof(index_entry) * first_block_num );
+   _block_num_to_pos.read( (char*)entries.data(), sizeof(index_entry) * entries.size() );
+   for( uint32_t i = 0; i < entries.size(); ++i )
+      FC_ASSERT( entries[i].block_size > 0 && block_header::num_from_id( entries[i].block_id ) == first_block_num + i,
+                 "Irreversible block ${n} is missing in the block database", ("n",first_block_num + i) );
+   // the background thread reads the blocks through its own stream
+   _blocks.flush();
+
+   if( !_compression_thread )
+      _compression_thread = std::make_shared<fc::thread>( "compress_block_log" );
+   _compressing_segments = count;
+   _compressing_entries  = entries;
+   _compression_start    = fc::time_point::now();
+   const fc::path blocks_filename = _blocks_filename;
+   const fc::path dir = _segments.dir();
+   const uint32_t segment_size = _segment_size;
+   const uint32_t thread_count = _compression_threads;
+   _compression_done = _compression_thread->async(
+      [blocks_filename,dir,first_block_num,entries,segment_size,thread_count](){
+         std::ifstream blocks;
+         blocks.exceptions( std::ios_base::failbit | std::ios_base::badbit );
+         blocks.open( blocks_filename.generic_string().c_str(), std::ios::binary );
+         vector< vector< vector<char> > > segments( entries.size() / segment_size );
+         for( size_t i = 0; i < entries.size(); ++i )
+         {
+            auto& segment = segments[i / segment_size];
+            segment.emplace_back( entries[i].block_size );
+            blocks.seekg( entries[i].block_pos );
+            blocks.read( segment.back().data(), segment.back().size() );
+         }
+         block_log_segments::write( dir, first_block_num, segments, thread_count );
+      } );
+} FC_CAPTURE_AND_RETHROW( (last_irreversible_block_num) ) }
+
+void block_database::finish_compression( bool wait )
+{ try {
+   if( _compressing_segments == 0 || ( !wait && !_compression_done.ready() ) )
+      return;
+   const uint32_t count = _compressing_segments;
+   const vector<index_entry> entries = std::move( _compressing_entries );
+   _compressing_segments = 0;
+   _compressing_entries.clear();
+   // a failed task is started again by the next compress_irreversible()
+   _compression_done.wait();
+
+   const uint32_t first_block_num = block_header::num_from_id( entries.front().block_id );
+   _segments.add( first_block_num, count );
+   // the journal replay checks the data of the blocks its records refer to, it must not see them released
+   sync();
+   checkpoint_journal();
+   release_blocks( _blocks_filename, entries );
+   uint64_t uncompressed_size = 0;
+   for( const auto& e : entries )
+      uncompressed_size += e.block_size;
+   ilog( "Compressed blocks ${b} to ${e} (${s} bytes) into ${n} segments in ${t} ms",
+         ("b",first_block_num)("e",first_block_num + entries.size() - 1)("s",uncompressed_size)("n",count)
+         ("t",( fc::time_point::now() - _compression_start ).count() / 1000) );
+} FC_CAPTURE_AND_RETHROW( (wait) ) }
+
+void block_database::prune( uint32_t block_num )
+{ try {
+   block_num = std::min( block_num, _first_available_block_num + MAX_PRUNED_BLOCKS );
+   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
+   block_num = std::min<uint64_t>( block_num, _block_num_to_pos.tellg() / sizeof(index_entry) );
+   // the blocks being compressed in the background are read from the block log until their segments are added
+   if( _compressing_segments > 0 )
+      block_num = std::min( block_num, block_header::num_from_id( _compressing_entries.front().block_id ) );
+   if( block_num <= _first_available_block_num )
+      return;
+
+   for( uint32_t num = _first_available_block_num; num < block_num; ++num )
+   {
+      index_entry e;
+      _block_num_to_pos.seekg( sizeof(e) * num );
+      _block_num_to_pos.read( (char*)&e, sizeof(e) );
+      if( e.block_size == 0 )
+         continue;
+      if( !_segments.contains( num ) )
+         _unreleased_blocks.push_back( e );
+      e.block_size = 0;
+      append_journal( e, 0 );
+      _block_num_to_pos.seekp( sizeof(e) * num );
+      _block_num_to_pos.write( (char*)&e, sizeof(e) );
+   }
+   _first_available_block_num = block_num;
+   // the index must not refer to released space after a crash, the space is released by the next sync
+   _unreleased_segments_end = block_num;
+} FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
 optional<index_entry> block_database::last_index_entry()const {
    try
    {
@@ -230,10 +881,8 @@ optional<index_entry> block_database::last_index_entry()const {
                 && e.block_pos + e.block_size <= blocks_size )
             try
             {
-               vector<char> data( e.block_size );
-               _blocks.seekg( e.block_pos );
-               _blocks.read( data.data(), e.block_size );
-               if( _blocks.gcount() == e.block_size )
+               const vector<char> data = read_block( e );
+               if( data.size() == e.block_size )
                {
                   const signed_block block = fc::raw::unpack<signed_block>(data);
                   if( block.id() == e.block_id )
@@ -272,4 +921,114 @@ optional<block_id_type> block_database::last_id()const
    return optional<block_id_type>();
 }
 
+namespace {
+
+/// verify the index entries [begin, end), each worker uses its own streams
+void verify_block_range( const fc::path& dbdir, uint32_t begin, uint32_t end, uint64_t blocks_size,
+                         block_log_verification& result )
+{
+   std::ifstream index( (dbdir / "index").generic_string().c_str(), std::ios::binary );
+   std::ifstream blocks( (dbdir / "blocks").generic_string().c_str(), std::ios::binary );
+   block_log_segments segments;
+   segments.open( dbdir / "segments" );
+
+   // the block before the range, to check that the first block of the range links to it
+   optional<block_id_type> previous_id;
+   if( begin > 1 )
+   {
+      index_entry e;
+      index.seekg( sizeof(e) * ( begin - 1 ) );
+      index.read( (char*)&e, sizeof(e) );
+      if( e.block_size > 0 )
+         previous_id = e.block_id;
+   }
+
+   index.seekg( sizeof(index_entry) * begin );
+   vector<char> data;
+   for( uint32_t num = begin; num < end; ++num )
+   {
+      index_entry e;
+      index.read( (char*)&e, sizeof(e) );
+      if( e.block_size == 0 )
+      {
+         ++result.empty_entries;
+         previous_id.reset();
+         continue;
+      }
+      ++result.blocks_checked;
+
+      bool valid = false;
+      if( e.block_pos + e.block_size <= blocks_size && block_header::num_from_id( e.block_id ) == num )
+      {
+         try {
+            if( segments.contains( num ) )
+               data = segments.fetch( num );
+            else
+            {
+               data.resize( e.block_size );
+               blocks.seekg( e.block_pos );
+               blocks.read( data.data(), data.size() );
+            }
+            const signed_block block = fc::raw::unpack<signed_block>( data );
+            valid = ( block.id() == e.block_id
+                      && block.transaction_merkle_root == block.calculate_merkle_root() );
+            if( valid && previous_id.valid() && block.previous != *previous_id )
+               result.unlinked_blocks.push_back( num );
+         }
+         catch( const fc::exception& ) {}
+         catch( const std::exception& ) {}
+      }
+      if( !valid )
+      {
+         result.corrupt_blocks.push_back( num );
+         previous_id.reset();
+      }
+      else
+         previous_id = e.block_id;
+   }
+}
+
+}
+
+block_log_verification block_database::verify( const fc::path& dbdir, uint32_t thread_count )
+{ try {
+   FC_ASSERT( fc::exists( dbdir / "index" ) && fc::exists( dbdir / "blocks" ), "no block database in ${d}", ("d",dbdir) );
+   const uint32_t entries = fc::file_size( dbdir / "index" ) / sizeof(index_entry);
+   const uint64_t blocks_size = fc::file_size( dbdir / "blocks" );
+
+   block_log_verification result;
+   result.index_entries = entries;
+   if( entries <= 1 )
+      return result;
+
+   thread_count = std::max( thread_count, 1u );
+   const uint32_t per_thread = ( entries - 1 + thread_count - 1 ) / thread_count;
+   vector<block_log_verification> partial( thread_count );
+   vector< std::shared_ptr<fc::thread> > threads;
+   vector< fc::future<void> > done;
+   for( uint32_t i = 0; i < thread_count; ++i )
+   {
+      const uint32_t begin = 1 + i * per_thread;
+      const uint32_t end = std::min( entries, begin + per_thread );
+      if( begin >= end )
+         break;
+      threads.push_back( std::make_shared<fc::thread>( "verify_blocks_" + fc::to_string( i ) ) );
+      block_log_verification& part = partial[i];
+      done.push_back( threads.back()->async( [&dbdir,begin,end,blocks_size,&part](){
+         verify_block_range( dbdir, begin, end, blocks_size, part );
+      } ) );
+   }
+   for( auto& f : done )
+      f.wait();
+
+   for( const auto& part : partial )
+   {
+      result.blocks_checked += part.blocks_checked;
+      result.empty_entries  += part.empty_entries;
+      result.corrupt_blocks.insert( result.corrupt_blocks.end(), part.corrupt_blocks.begin(), part.corrupt_blocks.end() );
+      result.unlinked_blocks.insert( result.unlinked_blocks.end(), part.unlinked_blocks.begin(), part.unlinked_blocks.end() );
+   }
+   return result;
+} FC_CAPTURE_AND_RETHROW( (dbdir)(thread_count) ) }
+
 } }
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+#include <graphene/chain/content_blob.hpp>
+
+#include <fc/crypto/city.hpp>
+
+namespace graphene { namespace chain {
+
+content_blob::content_blob( const std::string& s )
+{
+   if( !s.empty() )
+      _data = content_blob_store::instance().intern( std::string( s ) );
+}
+
+content_blob::content_blob( std::string&& s )
+{
+   if( !s.empty() )
+      _data = content_blob_store::instance().intern( std::move( s ) );
+}
+
+const std::string& content_blob::empty_string()
+{
+   static const std::string empty;
+   return empty;
+}
+
+content_blob_store& content_blob_store::instance()
+{
+   // Intentionally never destroyed, blobs held by static objects may be released after exit() runs destructors
+   static content_blob_store* store = new content_blob_store();
+   return *store;
+}
+
+std::shared_ptr<const std::string> content_blob_store::intern( std::string&& content )
+{
+   const uint64_t key = fc::city_hash64( content.data(), content.size() );
+
+   // Declared before the lock: if this is the last reference to a colliding blob, it is released after the
+   // lock is dropped, release() locks the mutex again
+   std::shared_ptr<const std::string> existing;
+   std::lock_guard<std::mutex> guard( _mutex );
+   auto itr = _blobs.find( key );
+   if( itr != _blobs.end() )
+   {
+      existing = itr->second.lock();
+      if( existing && *existing == content )
+         return existing;
+      if( existing )
+      {
+         // hash collision, keep the new content out of the store
+         return std::make_shared<const std::string>( std::move( content ) );
+      }
+   }
+
+   const size_t size = content.size();
+   std::shared_ptr<const std::string> blob( new std::string( std::move( content ) ),
+                                            [this,key]( const std::string* p ){ release( key, p ); } );
+   _blobs[key] = blob;
+   _total_bytes += size;
+   return blob;
+}
+
+void content_blob_store::release( uint64_t key, const std::string* content )
+{
+   {
+      std::lock_guard<std::mutex> guard( _mutex );
+      auto itr = _blobs.find( key );
+      // the entry may have been replaced by new content with the same key after this one expired
+      if( itr != _blobs.end() && itr->second.expired() )
+         _blobs.erase( itr );
+      _total_bytes -= content->size();
+   }
+   delete content;
+}
+
+content_blob_store::store_stats content_blob_store::get_stats()const
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   store_stats result;
+   result.blob_count  = _blobs.size();
+   result.total_bytes = _total_bytes;
+   return result;
+}
+
+} } // graphene::chain
@@ -78,6 +78,30 @@ optional<signed_block> database::fetch_block_by_id( const block_id_type& id )con
    return b->data;
 }
 
+signed_block database::get_block_by_id( const block_id_type& id )const
+{
+   optional<signed_block> b = fetch_block_by_id( id );
+   if( !b.valid() )
+   {
+      if( block_header::num_from_id( id ) < first_available_block_num() )
+         FC_THROW_EXCEPTION( fc::key_not_found_exception, "Block ${id} has been pruned", ("id", id) );
+      FC_THROW_EXCEPTION( fc::key_not_found_exception, "Block ${id} not found", ("id", id) );
+   }
+   return *b;
+}
+
+vector<block_id_type> database::get_block_ids_from( uint32_t block_num, uint32_t limit )const
+{
+   vector<block_id_type> result;
+   // a peer needing the pruned blocks following it has to sync from an archive node
+   if( block_num + 1 < first_available_block_num() )
+      return result;
+   for( uint32_t num = block_num; num <= head_block_num() && result.size() < limit; ++num )
+      if( num > 0 )
+         result.push_back( get_block_id_for_num( num ) );
+   return result;
+}
+
 optional<signed_block> database::fetch_block_by_number( uint32_t num )const
 {
    auto results = _fork_db.fetch_block_by_number(num);
@@ -129,6 +153,9 @@ bool database::push_block(const signed_block& new_block, uint32_t skip)
       [&]()
       {
          result = _push_block(new_block);
+         check_background_flush();
+         maintain_block_log();
+         check_memory_usage_log();
       });
    });
    return result;
@@ -143,6 +170,46 @@ bool database::_push_block(const signed_block& new_block)
       // verify that the block signer is in the current set of active witnesses.
 
       shared_ptr<fork_item> new_head = _fork_db.push_block(new_block);
+
+      // Blocks which were waiting in the fork database for new_block have been linked along with it.
+      // If they extend the current chain, apply them in order rather than switching forks.
+      if( new_head->data.previous != head_block_id() && new_head->num > head_block_num() )
+      {
+         vector<item_ptr> extension;
+         for( item_ptr item = new_head; item && item->num > head_block_num(); item = item->prev.lock() )
+            extension.push_back( item );
+         if( !extension.empty() && extension.back()->data.previous == head_block_id() )
+         {
+            ilog( "Pushing ${n} blocks which were waiting for block ${num} ${id}",
+                  ("n",extension.size() - 1)("num",new_block.block_num())("id",new_block.id()) );
+            for( auto ritr = extension.rbegin(); ritr != extension.rend(); ++ritr )
+            {
+               optional<fc::exception> except;
+               try {
+                  auto session = _undo_db.start_undo_session();
+                  apply_block( (*ritr)->data, skip );
+                  _block_id_to_block.store( (*ritr)->id, (*ritr)->data );
+                  session.commit();
+               }
+               catch ( const fc::exception& e ) { except = e; }
+               if( except )
+               {
+                  elog( "Failed to push block ${num} ${id}:\n${e}",
+                        ("num",(*ritr)->num)("id",(*ritr)->id)("e",except->to_detail_string()) );
+                  // the block and the ones built on it are invalid
+                  const bool is_new_block = ( (*ritr)->id == new_block.id() );
+                  for( ; ritr != extension.rend(); ++ritr )
+                     _fork_db.remove( (*ritr)->id );
+                  _fork_db.set_head( _fork_db.fetch_block( head_block_id() ) );
+                  if( is_new_block )
+                     throw *except;
+                  break;
+               }
+            }
+            return false;
+         }
+      }
+
       //If the head block from the longest chain does not build off of the current head, we need to switch forks.
       if( new_head->data.previous != head_block_id() )
       {
@@ -151,11 +218,17 @@ bool database::_push_block(const signed_block& new_block)
          if( new_head->data.block_num() > head_block_num() )
          {
             wlog( "Switching to fork: ${id}", ("id",new_head->data.id()) );
+            const fc::time_point switch_start = fc::time_point::now();
+            uint32_t popped_count = 0;
+            uint32_t restored_count = 0;
             auto branches = _fork_db.fetch_branch_from(new_head->data.id(), head_block_id());
 
             // pop blocks until we hit the forked block
             while( head_block_id() != branches.second.back()->data.previous )
+            {
                pop_block();
+               ++popped_count;
+            }
 
             // push all blocks on the new fork
             for( auto ritr = branches.first.rbegin(); ritr != branches.first.rend(); ++ritr )
@@ -164,7 +237,10 @@ bool database::_push_block(const signed_block& new_block)
                 optional<fc::exception> except;
                 try {
                    undo_database::session session = _undo_db.start_undo_session();
-                   apply_block( (*ritr)->data, skip );
+                   if( apply_popped_block( (*ritr)->data ) )
+                      ++restored_count;
+                   else
+                      apply_block( (*ritr)->data, skip );
                    _block_id_to_block.store( (*ritr)->id, (*ritr)->data );
                    session.commit();
                 }
@@ -185,16 +261,26 @@ bool database::_push_block(const signed_block& new_block)
                       pop_block();
 
                    // restore all blocks from the good fork
+                   uint32_t switched_back_count = 0;
                    for( auto ritr = branches.second.rbegin(); ritr != branches.second.rend(); ++ritr )
                    {
                       auto session = _undo_db.start_undo_session();
-                      apply_block( (*ritr)->data, skip );
-                      _block_id_to_block.store( new_block.id(), (*ritr)->data );
+                      if( apply_popped_block( (*ritr)->data ) )
+                         ++switched_back_count;
+                      else
+                         apply_block( (*ritr)->data, skip );
+                      _block_id_to_block.store( (*ritr)->id, (*ritr)->data );
                       session.commit();
                    }
+                   wlog( "Switched back from bad fork in ${t} ms, restored ${r} of ${n} blocks from redo state",
+                         ("t",(fc::time_point::now() - switch_start).count() / 1000)
+                         ("r",switched_back_count)("n",branches.second.size()) );
                    throw *except;
                 }
             }
+            ilog( "Switched to fork ${id} in ${t} ms: popped ${p} blocks, pushed ${n}, ${r} of them restored from redo state",
+                  ("id",new_head->data.id())("t",(fc::time_point::now() - switch_start).count() / 1000)
+                  ("p",popped_count)("n",branches.first.size())("r",restored_count) );
             return true;
          }
          else return false;
@@ -203,7 +289,8 @@ bool database::_push_block(const signed_block& new_block)
 
    try {
       auto session = _undo_db.start_undo_session();
-      apply_block(new_block, skip);
+      if( !apply_popped_block( new_block ) )
+         apply_block(new_block, skip);
       _block_id_to_block.store(new_block.id(), new_block);
       session.commit();
    } catch ( const fc::exception& e ) {
@@ -248,7 +335,7 @@ processed_transaction database::_push_transaction( const signed_transaction& trx
 
    auto temp_session = _undo_db.start_undo_session();
    auto processed_trx = _apply_transaction( trx );
-   _pending_tx.push_back(processed_trx);
+   _pending_tx.insert(processed_trx);
 
    // notify_changed_objects();
    // The transaction applied successfully. Merge its changes into the pending block session.
@@ -259,6 +346,21 @@ processed_transaction database::_push_transaction( const signed_transaction& trx
    return processed_trx;
 }
 
+void database::_push_pending_transaction( pending_transaction entry )
+{
+   if( !_pending_tx_session.valid() )
+      _pending_tx_session = _undo_db.start_undo_session();
+
+   auto temp_session = _undo_db.start_undo_session();
+   processed_transaction processed_trx = _apply_transaction( entry.trx, entry.id );
+   // the operation results may differ on the new head, the fees and thus the priority don't
+   entry.trx.operation_results = std::move( processed_trx.operation_results );
+   temp_session.merge();
+
+   on_pending_transaction( entry.trx );
+   _pending_tx.insert( std::move( entry ) );
+}
+
 processed_transaction database::validate_transaction( const signed_transaction& trx )
 {
    auto session = _undo_db.start_undo_session();
@@ -297,19 +399,45 @@ signed_block database::generate_block(
    const fc::ecc::private_key& block_signing_private_key,
    uint32_t skip /* = 0 */
    )
+{
+   block_generation_stats stats;
+   return generate_block( when, witness_uid, block_signing_private_key, skip, fc::time_point::maximum(), stats );
+}
+
+signed_block database::generate_block(
+   fc::time_point_sec when,
+   account_uid_type witness_uid,
+   const fc::ecc::private_key& block_signing_private_key,
+   uint32_t skip,
+   const fc::time_point deadline,
+   block_generation_stats& stats
+   )
 { try {
+   const fc::time_point start = fc::time_point::now();
    signed_block result;
    detail::with_skip_flags( *this, skip, [&]()
    {
-      result = _generate_block( when, witness_uid, block_signing_private_key );
+      result = _generate_block( when, witness_uid, block_signing_private_key, deadline, stats );
    } );
+   const fc::microseconds production_time = fc::time_point::now() - start;
+   ++_production_stats.blocks_produced;
+   if( stats.deadline_reached )
+      ++_production_stats.deadline_hits;
+   _production_stats.transactions_included += stats.included;
+   _production_stats.transactions_deferred += stats.deferred;
+   _production_stats.last_production_time = production_time;
+   _production_stats.max_production_time = std::max( _production_stats.max_production_time, production_time );
+   _production_stats.total_production_time += production_time;
+   _production_stats.last_block = stats;
    return result;
-} FC_CAPTURE_AND_RETHROW() }
+} FC_CAPTURE_AND_RETHROW( (deadline) ) }
 
 signed_block database::_generate_block(
    fc::time_point_sec when,
    account_uid_type witness_uid,
-   const fc::ecc::private_key& block_signing_private_key
+   const fc::ecc::private_key& block_signing_private_key,
+   const fc::time_point deadline,
+   block_generation_stats& stats
    )
 {
    try {
@@ -351,35 +479,77 @@ signed_block database::_generate_block(
    update_global_dynamic_data(pending_block);
 
    uint64_t postponed_tx_count = 0;
-   // pop pending state (reset to head block state)
-   for( const processed_transaction& tx : _pending_tx )
-   {
-      size_t new_total_size = total_block_size + fc::raw::pack_size( tx );
+   vector<const pending_transaction*> deferred_txs;
+   stats = block_generation_stats();
+   const fc::time_point start = fc::time_point::now();
 
+   // Apply a pending transaction to the block being generated.  The id and the packed size of the
+   // signed transaction are cached by the pool, so only the operation results need to be measured.
+   auto try_apply_pending = [&]( const pending_transaction& entry )
+   {
       // postpone transaction if it would make block too big
-      if( new_total_size >= maximum_block_size )
+      if( total_block_size + entry.packed_size >= maximum_block_size )
       {
          postponed_tx_count++;
-         continue;
+         return;
       }
 
+      auto temp_session = _undo_db.start_undo_session();
+      processed_transaction ptx = _apply_transaction( entry.trx, entry.id );
+
+      // The results may make the processed transaction bigger than the signed one
+      size_t ptx_size = entry.packed_size + fc::raw::pack_size( ptx.operation_results );
+      if( total_block_size + ptx_size >= maximum_block_size )
+      {
+         postponed_tx_count++;
+         return;
+      }
+      temp_session.merge();
+
+      total_block_size += ptx_size;
+      pending_block.transactions.push_back( std::move( ptx ) );
+   };
+   auto deadline_passed = [&]() -> bool
+   {
+      if( !stats.deadline_reached && fc::time_point::now() >= deadline )
+         stats.deadline_reached = true;
+      return stats.deadline_reached;
+   };
+
+   // pop pending state (reset to head block state), then fill the block greedily by priority
+   for( const pending_transaction& entry : _pending_tx.indices().get<pending_transaction_pool::by_priority>() )
+   {
+      if( deadline_passed() )
+         break;
       try
       {
-         auto temp_session = _undo_db.start_undo_session();
-         processed_transaction ptx = _apply_transaction( tx );
-         temp_session.merge();
-
-         // We have to recompute pack_size(ptx) because it may be different
-         // than pack_size(tx) (i.e. if one or more results increased
-         // their size)
-         total_block_size += fc::raw::pack_size( ptx );
-         pending_block.transactions.push_back( ptx );
+         try_apply_pending( entry );
+      }
+      catch ( const fc::exception& )
+      {
+         // The transaction may depend on one with a lower priority which arrived earlier,
+         // give it another chance after the first pass.
+         deferred_txs.push_back( &entry );
+      }
+   }
+
+   // Retry the deferred transactions in arrival order
+   std::sort( deferred_txs.begin(), deferred_txs.end(),
+              []( const pending_transaction* a, const pending_transaction* b ) { return a->sequence < b->sequence; } );
+   for( const pending_transaction* entry : deferred_txs )
+   {
+      if( deadline_passed() )
+         break;
+      try
+      {
+         try_apply_pending( *entry );
       }
       catch ( const fc::exception& e )
       {
          // Do nothing, transaction will not be re-applied
+         ++stats.failed;
          wlog( "Transaction was not processed while generating block due to ${e}", ("e", e) );
-         wlog( "The transaction was ${t}", ("t", tx) );
+         wlog( "The transaction was ${t}", ("t", entry->trx) );
       }
    }
    if( postponed_tx_count > 0 )
@@ -387,6 +557,15 @@ signed_block database::_generate_block(
       wlog( "Postponed ${n} transactions due to block size limit", ("n", postponed_tx_count) );
    }
 
+   stats.included = pending_block.transactions.size();
+   stats.deferred = _pending_tx.size() - stats.included - stats.failed;
+   stats.elapsed = fc::time_point::now() - start;
+   if( stats.deadline_reached )
+   {
+      wlog( "Block generation deadline reached after ${ms} ms, included ${i} transactions, deferred ${d}",
+            ("ms", stats.elapsed.count() / 1000)("i", stats.included)("d", stats.deferred) );
+   }
+
    _pending_tx_session.reset();
 
    // We have temporarily broken the invariant that
@@ -423,12 +602,76 @@ void database::pop_block()
    GRAPHENE_ASSERT( head_block.valid(), pop_empty_chain, "there are no blocks to pop" );
 
    _fork_db.pop_block();
-   pop_undo();
+   redo_state redo;
+   pop_undo( &redo );
+
+   // keep the changes of the block, switching back to it is then a matter of replaying them
+   for( auto itr = _popped_block_redo.begin(); itr != _popped_block_redo.end(); ++itr )
+   {
+      if( itr->first == head_id )
+      {
+         _popped_block_redo.erase( itr );
+         break;
+      }
+   }
+   _popped_block_redo.emplace_back( head_id, std::move( redo ) );
+   while( _popped_block_redo.size() > GRAPHENE_MAX_REDO_HISTORY )
+      _popped_block_redo.pop_front();
 
    _popped_tx.insert( _popped_tx.begin(), head_block->transactions.begin(), head_block->transactions.end() );
+   _block_state_hashes.erase( _block_state_hashes.upper_bound( head_block_num() ), _block_state_hashes.end() );
 
 } FC_CAPTURE_AND_RETHROW() }
 
+bool database::apply_popped_block( const signed_block& next_block )
+{
+   if( _popped_block_redo.empty() || next_block.previous != head_block_id() )
+      return false;
+
+   const block_id_type block_id = next_block.id();
+   auto itr = _popped_block_redo.begin();
+   while( itr != _popped_block_redo.end() && itr->first != block_id )
+      ++itr;
+   if( itr == _popped_block_redo.end() )
+      return false;
+
+   // the state only depends on the chain of block ids, so the redo state of a block is valid whenever
+   // the head is its predecessor
+   redo_state redo = std::move( itr->second );
+   _popped_block_redo.erase( itr );
+   try {
+      // the caller's session becomes the undo state of the block, so that it can be popped again
+      auto session = _undo_db.start_undo_session();
+      _undo_db.redo( redo );
+      session.merge();
+   }
+   catch( const fc::exception& e )
+   {
+      wlog( "Failed to restore block ${n} ${id} from its redo state, applying it again: ${e}",
+            ("n",next_block.block_num())("id",block_id)("e",e.to_detail_string()) );
+      return false;
+   }
+
+   update_undo_db_size();
+   if( _state_hash_enabled )
+      record_state_hash( next_block.block_num() );
+
+   _applied_ops.clear();
+   _reapplying_block = true;
+   try {
+      applied_block( next_block ); //emit
+   }
+   catch( ... )
+   {
+      _reapplying_block = false;
+      throw;
+   }
+   _reapplying_block = false;
+
+   notify_changed_objects();
+   return true;
+}
+
 void database::clear_pending()
 { try {
    assert( (_pending_tx.size() == 0) || _pending_tx_session.valid() );
@@ -551,6 +794,9 @@ void database::_apply_block( const signed_block& next_block )
       check_invariants();
    }
 
+   if( _state_hash_enabled )
+      record_state_hash( next_block_num );
+
    dlog("before notify applied block");
    // notify observers that the block has been applied
    // TODO catch exceptions thrown by plugins but not the core
@@ -574,6 +820,11 @@ processed_transaction database::apply_transaction(const signed_transaction& trx,
 }
 
 processed_transaction database::_apply_transaction(const signed_transaction& trx)
+{
+   return _apply_transaction( trx, trx.id() );
+}
+
+processed_transaction database::_apply_transaction(const signed_transaction& trx, const transaction_id_type& trx_id)
 { try {
    uint32_t skip = get_node_properties().skip_flags;
 
@@ -582,7 +833,6 @@ processed_transaction database::_apply_transaction(const signed_transaction& trx
 
    auto& trx_idx = get_mutable_index_type<transaction_index>();
    const chain_id_type& chain_id = get_chain_id();
-   auto trx_id = trx.id();
    FC_ASSERT( (skip & skip_transaction_dupe_check) ||
               trx_idx.indices().get<by_trx_id>().find(trx_id) == trx_idx.indices().get<by_trx_id>().end() );
    transaction_evaluation_state eval_state(this);
@@ -704,4 +954,81 @@ bool database::before_last_checkpoint()const
    return (_checkpoints.size() > 0) && (_checkpoints.rbegin()->first >= head_block_num());
 }
 
+void database::enable_state_hash( bool enabled )
+{
+   _state_hash_enabled = enabled;
+   _block_state_hashes.clear();
+   for( db::index* idx : _state_hash_indexes )
+      idx->enable_state_hash( enabled );
+}
+
+fc::uint128 database::get_state_hash()const
+{
+   fc::uint128 result;
+   for( const db::index* idx : _state_hash_indexes )
+      result += idx->state_hash();
+   return result;
+}
+
+fc::uint128 database::compute_state_hash()
+{
+   if( _state_hash_enabled )
+      return get_state_hash();
+   for( db::index* idx : _state_hash_indexes )
+      idx->enable_state_hash( true );
+   const fc::uint128 result = get_state_hash();
+   for( db::index* idx : _state_hash_indexes )
+      idx->enable_state_hash( false );
+   return result;
+}
+
+optional<fc::uint128> database::get_block_state_hash( uint32_t block_num )const
+{
+   auto itr = _block_state_hashes.find( block_num );
+   if( itr == _block_state_hashes.end() )
+      return optional<fc::uint128>();
+   return itr->second;
+}
+
+void database::add_state_hash_checkpoints( const flat_map<uint32_t,fc::uint128>& checkpts )
+{
+   for( const auto& i : checkpts )
+      _state_hash_checkpoints[i.first] = i.second;
+}
+
+bool database::verify_state_hash()const
+{
+   bool result = true;
+   for( const db::index* idx : _state_hash_indexes )
+   {
+      if( !idx->state_hash_enabled() )
+         continue;
+      const fc::uint128 full = idx->hash();
+      if( full != idx->state_hash() )
+      {
+         elog( "State hash of index ${s}.${t} is ${h}, recomputed ${f}",
+               ("s",idx->object_space_id())("t",idx->object_type_id())("h",idx->state_hash())("f",full) );
+         result = false;
+      }
+   }
+   return result;
+}
+
+void database::record_state_hash( uint32_t block_num )
+{
+   const fc::uint128 state_hash = get_state_hash();
+   _block_state_hashes[block_num] = state_hash;
+   while( _block_state_hashes.size() > GRAPHENE_MAX_UNDO_HISTORY )
+      _block_state_hashes.erase( _block_state_hashes.begin() );
+
+   auto itr = _state_hash_checkpoints.find( block_num );
+   if( itr != _state_hash_checkpoints.end() && itr->second != state_hash )
+   {
+      elog( "State diverged at block ${n}: state hash is ${h}, expected ${e}",
+            ("n",block_num)("h",state_hash)("e",itr->second) );
+      for( const db::index* idx : _state_hash_indexes )
+         elog( "   index ${s}.${t}: ${h}", ("s",idx->object_space_id())("t",idx->object_type_id())("h",idx->state_hash()) );
+   }
+}
+
 } }
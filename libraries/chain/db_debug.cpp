@@ -182,6 +182,8 @@ void database::debug_update( const fc::variant_object& update )
 
    // What the last block does has been changed by adding to node_property_object, so we have to re-apply it
    pop_block();
+   // the changes kept for the popped block do not include the update
+   _popped_block_redo.clear();
    push_block( *head_block );
 }
 
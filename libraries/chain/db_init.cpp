@@ -174,6 +174,8 @@ void database::initialize_indexes()
    auto acnt_index = add_index< primary_index<account_index> >();
    acnt_index->add_secondary_index<account_member_index>();
    acnt_index->add_secondary_index<account_referrer_index>();
+   acnt_index->add_secondary_index<account_authority_change_index>();
+   acnt_index->add_secondary_index<account_name_prefix_index>();
 
    add_index< primary_index<platform_index> >();
    add_index< primary_index<post_index> >();
@@ -202,6 +204,8 @@ void database::initialize_indexes()
    add_index< primary_index<simple_index<chain_property_object          > > >();
    add_index< primary_index<simple_index<witness_schedule_object        > > >();
 
+   // Indexes added by plugins from here on are not part of the state hash
+   _state_hash_indexes = get_mutable_indexes();
 }
 
 void database::init_genesis(const genesis_state_type& genesis_state)
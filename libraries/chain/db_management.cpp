@@ -23,14 +23,19 @@
  */
 
 #include <graphene/chain/database.hpp>
+#include <graphene/chain/db_with.hpp>
 
+#include <graphene/chain/block_summary_object.hpp>
 #include <graphene/chain/operation_history_object.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
 
 #include <fc/io/fstream.hpp>
+#include <fc/io/json.hpp>
 
+#include <algorithm>
 #include <fstream>
 #include <functional>
+#include <sstream>
 #include <iostream>
 
 namespace graphene { namespace chain {
@@ -55,6 +60,9 @@ void database::reindex( fc::path data_dir )
       return;
    }
    if( last_block->block_num() <= head_block_num()) return;
+   FC_ASSERT( head_block_num() + 1 >= _block_id_to_block.first_available_block_num(),
+              "Blocks below ${n} have been pruned, replaying from block ${h} needs the full block history",
+              ("n",_block_id_to_block.first_available_block_num())("h",head_block_num() + 1) );
 
    ilog( "reindexing blockchain" );
    auto start = fc::time_point::now();
@@ -76,8 +84,7 @@ void database::reindex( fc::path data_dir )
       if( i == flush_point )
       {
          ilog( "Writing database to disk at block ${i}", ("i",i) );
-         flush();
-         ilog( "Done" );
+         start_background_flush();
       }
       fc::optional< signed_block > block = _block_id_to_block.fetch_by_number(i);
       if( !block.valid() )
@@ -124,6 +131,98 @@ void database::reindex( fc::path data_dir )
    ilog( "Done reindexing, elapsed time: ${t} sec", ("t",double((end-start).count())/1000000.0 ) );
 } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
 
+void database::set_flush_interval( uint32_t blocks )
+{
+   _flush_interval = blocks;
+   _next_flush_block = head_block_num() + blocks;
+}
+
+void database::check_background_flush()
+{
+   finish_background_flush();
+   if( _flushing_head_block_num != 0 && !background_flush_in_progress() )
+   {
+      if( last_background_flush_succeeded() )
+         _flushed_head_block_num = _flushing_head_block_num;
+      _flushing_head_block_num = 0;
+   }
+   if( _flush_interval == 0 || head_block_num() < _next_flush_block )
+      return;
+   // the blocks up to the flushed state must be on disk to replay from it
+   _block_id_to_block.flush();
+   // like close(), save the state as of the last irreversible block: a node restarted from the flush could
+   // not pop reversible blocks, having no undo history for them
+   const uint32_t last_irreversible_block_num = get_dynamic_global_properties().last_irreversible_block_num;
+   auto rewind = [this,last_irreversible_block_num]() {
+      while( head_block_num() > last_irreversible_block_num && _undo_db.size() > 0 )
+         _undo_db.pop_commit();
+   };
+   if( start_background_flush( rewind ) )
+   {
+      ilog( "Flushing object database in the background at block ${n}", ("n",last_irreversible_block_num) );
+      _next_flush_block = head_block_num() + _flush_interval;
+      // the child may stop short of it if the undo history is too short, which leaves a later state
+      if( background_flush_in_progress() )
+         _flushing_head_block_num = last_irreversible_block_num;
+   }
+}
+
+void database::maintain_block_log()
+{
+   const auto& dgp = get_dynamic_global_properties();
+   // independent of each other, a failure of one must not stop the other
+   try
+   {
+      _block_id_to_block.compress_irreversible( dgp.last_irreversible_block_num );
+   }
+   catch( const fc::exception& e )
+   {
+      elog( "Failed to compress the block log: ${e}", ("e",e.to_detail_string()) );
+   }
+   try
+   {
+      if( _block_prune_window > 0 && dgp.head_block_number > _block_prune_window )
+      {
+         // a replay after a crash starts at the head block of the last flushed state
+         const uint32_t prune_point = std::min( { dgp.head_block_number - _block_prune_window + 1,
+                                                  dgp.last_irreversible_block_num, _flushed_head_block_num } );
+         if( prune_point >= _block_id_to_block.first_available_block_num() + GRAPHENE_BLOCK_PRUNE_BATCH )
+            _block_id_to_block.prune( prune_point );
+      }
+   }
+   catch( const fc::exception& e )
+   {
+      elog( "Failed to prune the block log: ${e}", ("e",e.to_detail_string()) );
+   }
+}
+
+void database::check_memory_usage_log()const
+{
+   if( _memory_usage_log_interval == 0 || head_block_num() % _memory_usage_log_interval != 0 )
+      return;
+   vector<db::index_memory_usage> usage = get_index_memory_usage();
+   uint64_t total_bytes = 0;
+   uint64_t total_objects = 0;
+   for( const auto& item : usage )
+   {
+      total_bytes += item.total_bytes();
+      total_objects += item.object_count;
+   }
+   std::sort( usage.begin(), usage.end(), []( const db::index_memory_usage& a, const db::index_memory_usage& b ) {
+      return a.total_bytes() > b.total_bytes();
+   } );
+   std::stringstream largest;
+   for( size_t i = 0; i < usage.size() && i < 5; ++i )
+   {
+      const auto separator = usage[i].name.rfind( "::" );
+      largest << ( i > 0 ? ", " : "" )
+              << ( separator == string::npos ? usage[i].name : usage[i].name.substr( separator + 2 ) ) << " "
+              << usage[i].total_bytes() / 1024 / 1024 << " MiB in " << usage[i].object_count << " objects";
+   }
+   ilog( "Index memory at block ${n}: ${t} MiB in ${o} objects, largest ${l}",
+         ("n",head_block_num())("t",total_bytes / 1024 / 1024)("o",total_objects)("l",largest.str()) );
+}
+
 void database::wipe(const fc::path& data_dir, bool include_blocks)
 {
    ilog("Wiping database", ("include_blocks", include_blocks));
@@ -165,9 +264,14 @@ void database::open(
       if( !find(global_property_id_type()) )
          init_genesis(genesis_loader());
 
+      _flushed_head_block_num = head_block_num();
       fc::optional<block_id_type> last_block = _block_id_to_block.last_id();
       if( last_block.valid() )
       {
+         // a background flush may have saved a block which was given up in a fork switch before a crash
+         FC_ASSERT( head_block_num() == 0 || _block_id_to_block.fetch_block_id( head_block_num() ) == head_block_id(),
+                    "object database head block is not on the stored chain, a replay is required",
+                    ("head_block_num",head_block_num())("head_block_id",head_block_id()) );
          FC_ASSERT( *last_block >= head_block_id(),
                     "last block ID does not match current chain state",
                     ("last_block->id", last_block)("head_block_id",head_block_num()) );
@@ -177,6 +281,136 @@ void database::open(
    FC_CAPTURE_LOG_AND_RETHROW( (data_dir) )
 }
 
+void database::open_from_snapshot(
+   const fc::path& snapshot_dir,
+   const block_id_type& trusted_block_id,
+   const fc::uint128& trusted_state_hash,
+   const fc::path& data_dir,
+   std::function<genesis_state_type()> genesis_loader,
+   const std::string& db_version )
+{ try {
+   FC_ASSERT( !fc::exists( data_dir / "object_database" ) && !fc::exists( data_dir / "database" ),
+              "A snapshot can only be imported into an empty data directory" );
+   const auto header = fc::json::from_file( snapshot_dir / "snapshot.json" )
+                          .as<state_snapshot_header>( GRAPHENE_MAX_NESTED_OBJECTS );
+   FC_ASSERT( header.block_id == trusted_block_id, "The snapshot is of block ${b}, not of the trusted block ${t}",
+              ("b",header.block_id)("t",trusted_block_id) );
+   // the hash in the header is no proof of the state, a tampered state comes with a matching hash
+   FC_ASSERT( header.state_hash == trusted_state_hash,
+              "The snapshot has state hash ${h}, not the trusted state hash ${t}",
+              ("h",header.state_hash)("t",trusted_state_hash) );
+   FC_ASSERT( header.head_block.id() == header.block_id, "The snapshot holds the wrong head block" );
+
+   ilog( "Importing state snapshot of block ${n} ${id}", ("n",header.block_num())("id",header.block_id) );
+   const auto start = fc::time_point::now();
+   for( fc::directory_iterator space( snapshot_dir / "object_database" ); space != fc::directory_iterator(); ++space )
+   {
+      const fc::path space_dir = data_dir / "object_database" / (*space).filename();
+      fc::create_directories( space_dir );
+      for( fc::directory_iterator type( *space ); type != fc::directory_iterator(); ++type )
+         fc::copy( *type, space_dir / (*type).filename() );
+   }
+   {
+      std::ofstream version_file( (data_dir / "db_version").generic_string().c_str(),
+                                  std::ios::out | std::ios::binary | std::ios::trunc );
+      version_file.write( db_version.c_str(), db_version.size() );
+   }
+
+   open( data_dir, genesis_loader, db_version );
+   try
+   {
+      FC_ASSERT( head_block_id() == header.block_id && get_chain_id() == header.chain_id,
+                 "The imported state is not of the snapshot block" );
+      const fc::uint128 state_hash = compute_state_hash();
+      FC_ASSERT( state_hash == trusted_state_hash, "The imported state hash ${h} is not the trusted state hash",
+                 ("h",state_hash) );
+
+      // the ids of recent blocks are needed to sync, they are known from the TaPoS block summaries
+      const uint32_t block_num = header.block_num();
+      for( uint32_t num = block_num > 0xffff ? block_num - 0xffff : 1; num < block_num; ++num )
+      {
+         const block_summary_object* summary = find( block_summary_id_type( num & 0xffff ) );
+         if( summary != nullptr && block_header::num_from_id( summary->block_id ) == num )
+            _block_id_to_block.store_id( summary->block_id );
+      }
+      _block_id_to_block.store( header.block_id, header.head_block );
+      _fork_db.start_block( header.head_block );
+   }
+   catch( const fc::exception& e )
+   {
+      elog( "Rejecting the imported snapshot: ${e}", ("e",e.to_detail_string()) );
+      wipe( data_dir, true );
+      throw;
+   }
+   ilog( "Imported state snapshot in ${t} ms", ("t",( fc::time_point::now() - start ).count() / 1000) );
+} FC_CAPTURE_AND_RETHROW( (snapshot_dir)(trusted_block_id)(trusted_state_hash)(data_dir) ) }
+
+void database::export_snapshot( const fc::path& snapshot_dir )
+{ try {
+   FC_ASSERT( !fc::exists( snapshot_dir / "snapshot.json" ), "${d} already holds a snapshot", ("d",snapshot_dir) );
+   detail::without_pending_transactions( *this, std::move(_pending_tx), [&]()
+   {
+      const uint32_t last_irreversible_block_num = get_dynamic_global_properties().last_irreversible_block_num;
+      FC_ASSERT( last_irreversible_block_num > 0, "There is no irreversible block to export yet" );
+      const auto start = fc::time_point::now();
+
+      // rewind to the last irreversible block, keeping the changes of the reversible blocks
+      vector<redo_state> redo;
+      while( head_block_num() > last_irreversible_block_num )
+      {
+         redo.emplace_back();
+         pop_undo( &redo.back() );
+      }
+
+      optional<fc::exception> error;
+      try
+      {
+         state_snapshot_header header;
+         header.chain_id   = get_chain_id();
+         header.block_id   = head_block_id();
+         header.state_hash = compute_state_hash();
+         optional<signed_block> head_block = fetch_block_by_id( header.block_id );
+         FC_ASSERT( head_block.valid(), "Block ${id} is not available", ("id",header.block_id) );
+         header.head_block = std::move( *head_block );
+
+         export_indexes( snapshot_dir / "object_database" );
+         // written last, a directory without it holds no usable snapshot
+         fc::json::save_to_file( header, snapshot_dir / "snapshot.json", GRAPHENE_MAX_NESTED_OBJECTS );
+         ilog( "Exported state snapshot of block ${n} ${id} with state hash ${h} in ${t} ms",
+               ("n",header.block_num())("id",header.block_id)("h",header.state_hash)
+               ("t",( fc::time_point::now() - start ).count() / 1000) );
+      }
+      catch( const fc::exception& e )
+      {
+         error = e;
+      }
+
+      // restore the reversible blocks, applying them again if a redo state fails
+      for( auto ritr = redo.rbegin(); ritr != redo.rend(); ++ritr )
+      {
+         const uint32_t block_num = head_block_num() + 1;
+         try
+         {
+            auto session = _undo_db.start_undo_session();
+            _undo_db.redo( *ritr );
+            session.commit();
+            continue;
+         }
+         catch( const fc::exception& e )
+         {
+            wlog( "Failed to restore block ${n} from its redo state, applying it again: ${e}",
+                  ("n",block_num)("e",e.to_detail_string()) );
+         }
+         auto session = _undo_db.start_undo_session();
+         apply_block( *fetch_block_by_number( block_num ), get_node_properties().skip_flags );
+         session.commit();
+      }
+
+      if( error.valid() )
+         error->dynamic_rethrow_exception();
+   });
+} FC_CAPTURE_AND_RETHROW( (snapshot_dir) ) }
+
 void database::close(bool rewind)
 {
    // TODO:  Save pending tx's on close()
@@ -208,6 +442,7 @@ void database::close(bool rewind)
    // we have to clear_pending() after we're done popping to get a clean
    // DB state (issue #336).
    clear_pending();
+   _popped_block_redo.clear();
 
    object_database::flush();
    object_database::close();
@@ -5,19 +5,44 @@
 #include <graphene/chain/protocol/transaction.hpp>
 #include <graphene/chain/protocol/types.hpp>
 #include <graphene/chain/committee_member_object.hpp>
+#include <graphene/chain/csaf_object.hpp>
+#include <graphene/chain/operation_history_object.hpp>
+#include <graphene/chain/proposal_object.hpp>
+#include <graphene/chain/transaction_object.hpp>
 #include <graphene/chain/impacted.hpp>
 
+#include <algorithm>
+
 using namespace fc;
 
 namespace graphene { namespace chain {
 
+/**
+ * Collects impacted account uids into a plain vector. Duplicates are kept, the caller
+ * is expected to sort and deduplicate once after all objects have been visited.
+ */
+struct impacted_account_uid_collector
+{
+   vector<account_uid_type>& _uids;
+   impacted_account_uid_collector( vector<account_uid_type>& uids ):_uids(uids) {}
+
+   void insert( account_uid_type uid ) { _uids.push_back( uid ); }
+};
+
 // TODO:  Review all of these, especially no-ops
+template<typename Collector>
 struct get_impacted_account_uid_visitor
 {
-   flat_set<account_uid_type>& _impacted;
-   get_impacted_account_uid_visitor( flat_set<account_uid_type>& impact ):_impacted(impact) {}
+   Collector& _impacted;
+   get_impacted_account_uid_visitor( Collector& impact ):_impacted(impact) {}
    typedef void result_type;
 
+   void add_authority_account_uids( Collector& result, const authority& a )
+   {
+      for( auto& item : a.account_uid_auths )
+         result.insert( item.first.uid );
+   }
+
    // NOTE: don't use a default template operator, since it may cause unintended behavior
 
    void operator()( const account_create_operation& op )
@@ -244,9 +269,12 @@ struct get_impacted_account_uid_visitor
    void operator()( const proposal_create_operation& op )
    {
       _impacted.insert( op.fee_paying_account ); // fee payer
+      flat_set<account_uid_type> required;
       vector<authority> other;
       for( const auto& proposed_op : op.proposed_ops )
-         operation_get_required_uid_authorities( proposed_op.op, _impacted, _impacted, _impacted, other );
+         operation_get_required_uid_authorities( proposed_op.op, required, required, required, other );
+      for( auto uid : required )
+         _impacted.insert( uid );
       for( auto& o : other )
          add_authority_account_uids( _impacted, o );
    }
@@ -274,7 +302,7 @@ struct get_impacted_account_uid_visitor
 
 void operation_get_impacted_account_uids( const operation& op, flat_set<account_uid_type>& result )
 {
-   get_impacted_account_uid_visitor vtor = get_impacted_account_uid_visitor( result );
+   get_impacted_account_uid_visitor< flat_set<account_uid_type> > vtor( result );
    op.visit( vtor );
 }
 
@@ -284,158 +312,331 @@ void transaction_get_impacted_account_uids( const transaction& tx, flat_set<acco
       operation_get_impacted_account_uids( op, result );
 }
 
-void get_relevant_accounts( const object* obj, flat_set<account_uid_type>& accounts )
+static void operation_collect_impacted_account_uids( const operation& op, impacted_account_uid_collector& result )
+{
+   get_impacted_account_uid_visitor< impacted_account_uid_collector > vtor( result );
+   op.visit( vtor );
+}
+
+static void transaction_collect_impacted_account_uids( const transaction& tx, impacted_account_uid_collector& result )
+{
+   for( const auto& op : tx.operations )
+      operation_collect_impacted_account_uids( op, result );
+}
+
+/**
+ * Per-object-type impacted accounts extractor.
+ *
+ * Object types whose changes are relevant to accounts specialize this template and
+ * register themselves in impacted_accounts_registry below. Types without a
+ * specialization don't impact any account.
+ */
+template<typename ObjectType>
+struct impacted_accounts_trait
 {
-   if( obj->id.space() == protocol_ids )
+   static const bool is_specialized = false;
+};
+
+template<> struct impacted_accounts_trait< account_object >
+{
+   static const bool is_specialized = true;
+   static void collect( const account_object& obj, impacted_account_uid_collector& accounts )
    {
-      switch( (object_type)obj->id.type() )
-      {
-        case null_object_type:
-        case base_object_type:
-        case OBJECT_TYPE_COUNT:
-           return;
-        case account_object_type:{
-           accounts.insert( ((account_object*)obj)->uid );
-           break;
-        } case asset_object_type:{
-           const auto& aobj = dynamic_cast<const asset_object*>(obj);
-           assert( aobj != nullptr );
-           accounts.insert( aobj->issuer );
-           break;
-        } case platform_object_type:{
-           const auto& aobj = dynamic_cast<const platform_object*>(obj);
-           assert( aobj != nullptr );
-           accounts.insert( aobj->owner );
-           break;
-        } case post_object_type:{
-           const auto& aobj = dynamic_cast<const post_object*>(obj);
-           assert( aobj != nullptr );
-           accounts.insert( aobj->poster );
-           if( aobj->origin_poster.valid() )
-              accounts.insert( *(aobj->origin_poster) );
-           break;
-        } case committee_member_object_type:{
-           const auto& aobj = dynamic_cast<const committee_member_object*>(obj);
-           assert( aobj != nullptr );
-           accounts.insert( aobj->account );
-           break;
-        } case committee_proposal_object_type:{
-           const auto& aobj = dynamic_cast<const committee_proposal_object*>(obj);
-           assert( aobj != nullptr );
-           accounts.insert( aobj->proposer );
-           break;
-        } case witness_object_type:{
-           const auto& aobj = dynamic_cast<const witness_object*>(obj);
-           assert( aobj != nullptr );
-           accounts.insert( aobj->account );
-           break;
-        } case proposal_object_type:{
-           const auto& aobj = dynamic_cast<const proposal_object*>(obj);
-           assert( aobj != nullptr );
-           transaction_get_impacted_account_uids( aobj->proposed_transaction, accounts );
-           break;
-        } case operation_history_object_type:{
-           const auto& aobj = dynamic_cast<const operation_history_object*>(obj);
-           assert( aobj != nullptr );
-           operation_get_impacted_account_uids( aobj->op, accounts );
-           break;
-        }
-      }
+      accounts.insert( obj.uid );
    }
-   else if( obj->id.space() == implementation_ids )
+};
+
+template<> struct impacted_accounts_trait< asset_object >
+{
+   static const bool is_specialized = true;
+   static void collect( const asset_object& obj, impacted_account_uid_collector& accounts )
    {
-      switch( (impl_object_type)obj->id.type() )
+      accounts.insert( obj.issuer );
+   }
+};
+
+template<> struct impacted_accounts_trait< platform_object >
+{
+   static const bool is_specialized = true;
+   static void collect( const platform_object& obj, impacted_account_uid_collector& accounts )
+   {
+      accounts.insert( obj.owner );
+   }
+};
+
+template<> struct impacted_accounts_trait< post_object >
+{
+   static const bool is_specialized = true;
+   static void collect( const post_object& obj, impacted_account_uid_collector& accounts )
+   {
+      accounts.insert( obj.poster );
+      if( obj.origin_poster.valid() )
+         accounts.insert( *(obj.origin_poster) );
+   }
+};
+
+template<> struct impacted_accounts_trait< committee_member_object >
+{
+   static const bool is_specialized = true;
+   static void collect( const committee_member_object& obj, impacted_account_uid_collector& accounts )
+   {
+      accounts.insert( obj.account );
+   }
+};
+
+template<> struct impacted_accounts_trait< committee_proposal_object >
+{
+   static const bool is_specialized = true;
+   static void collect( const committee_proposal_object& obj, impacted_account_uid_collector& accounts )
+   {
+      accounts.insert( obj.proposer );
+   }
+};
+
+template<> struct impacted_accounts_trait< witness_object >
+{
+   static const bool is_specialized = true;
+   static void collect( const witness_object& obj, impacted_account_uid_collector& accounts )
+   {
+      accounts.insert( obj.account );
+   }
+};
+
+template<> struct impacted_accounts_trait< proposal_object >
+{
+   static const bool is_specialized = true;
+   static void collect( const proposal_object& obj, impacted_account_uid_collector& accounts )
+   {
+      transaction_collect_impacted_account_uids( obj.proposed_transaction, accounts );
+   }
+};
+
+template<> struct impacted_accounts_trait< operation_history_object >
+{
+   static const bool is_specialized = true;
+   static void collect( const operation_history_object& obj, impacted_account_uid_collector& accounts )
+   {
+      operation_collect_impacted_account_uids( obj.op, accounts );
+   }
+};
+
+template<> struct impacted_accounts_trait< account_balance_object >
+{
+   static const bool is_specialized = true;
+   static void collect( const account_balance_object& obj, impacted_account_uid_collector& accounts )
+   {
+      accounts.insert( obj.owner );
+   }
+};
+
+template<> struct impacted_accounts_trait< account_statistics_object >
+{
+   static const bool is_specialized = true;
+   static void collect( const account_statistics_object& obj, impacted_account_uid_collector& accounts )
+   {
+      accounts.insert( obj.owner );
+   }
+};
+
+template<> struct impacted_accounts_trait< csaf_lease_object >
+{
+   static const bool is_specialized = true;
+   static void collect( const csaf_lease_object& obj, impacted_account_uid_collector& accounts )
+   {
+      accounts.insert( obj.from );
+      accounts.insert( obj.to );
+   }
+};
+
+template<> struct impacted_accounts_trait< transaction_object >
+{
+   static const bool is_specialized = true;
+   static void collect( const transaction_object& obj, impacted_account_uid_collector& accounts )
+   {
+      transaction_collect_impacted_account_uids( obj.trx, accounts );
+   }
+};
+
+template<> struct impacted_accounts_trait< voter_object >
+{
+   static const bool is_specialized = true;
+   static void collect( const voter_object& obj, impacted_account_uid_collector& accounts )
+   {
+      accounts.insert( obj.uid );
+      if( obj.proxy_uid != GRAPHENE_PROXY_TO_SELF_ACCOUNT_UID )
+         accounts.insert( obj.proxy_uid );
+   }
+};
+
+template<> struct impacted_accounts_trait< witness_vote_object >
+{
+   static const bool is_specialized = true;
+   static void collect( const witness_vote_object& obj, impacted_account_uid_collector& accounts )
+   {
+      accounts.insert( obj.voter_uid );
+      accounts.insert( obj.witness_uid );
+   }
+};
+
+template<> struct impacted_accounts_trait< platform_vote_object >
+{
+   static const bool is_specialized = true;
+   static void collect( const platform_vote_object& obj, impacted_account_uid_collector& accounts )
+   {
+      accounts.insert( obj.voter_uid );
+      accounts.insert( obj.platform_owner );
+   }
+};
+
+template<> struct impacted_accounts_trait< committee_member_vote_object >
+{
+   static const bool is_specialized = true;
+   static void collect( const committee_member_vote_object& obj, impacted_account_uid_collector& accounts )
+   {
+      accounts.insert( obj.voter_uid );
+      accounts.insert( obj.committee_member_uid );
+   }
+};
+
+template<> struct impacted_accounts_trait< registrar_takeover_object >
+{
+   static const bool is_specialized = true;
+   static void collect( const registrar_takeover_object& obj, impacted_account_uid_collector& accounts )
+   {
+      accounts.insert( obj.original_registrar );
+      accounts.insert( obj.takeover_registrar );
+   }
+};
+
+/**
+ * Maps ( space_id, type_id ) of an object to the extractor of its concrete type, so that
+ * dispatching is a table lookup plus a static_cast instead of a switch and dynamic_cast.
+ */
+class impacted_accounts_registry
+{
+   public:
+      typedef void (*extractor_type)( const object&, impacted_account_uid_collector& );
+
+      impacted_accounts_registry() : _extractors()
       {
-             case IMPL_OBJECT_TYPE_COUNT:
-              break;
-             case impl_global_property_object_type:
-              break;
-             case impl_dynamic_global_property_object_type:
-              break;
-             case impl_asset_dynamic_data_type:
-              break;
-             case impl_account_balance_object_type:{
-              const auto& aobj = dynamic_cast<const account_balance_object*>(obj);
-              assert( aobj != nullptr );
-              accounts.insert( aobj->owner );
-              break;
-           } case impl_account_statistics_object_type:{
-              const auto& aobj = dynamic_cast<const account_statistics_object*>(obj);
-              assert( aobj != nullptr );
-              accounts.insert( aobj->owner );
-              break;
-            } case impl_voter_object_type:{
-               // TODO review
-              break;
-            } case impl_witness_vote_object_type:{
-               // TODO review
-              break;
-            } case impl_platform_vote_object_type:{
-              // TODO review
-              break;
-            } case impl_committee_member_vote_object_type:{
-               // TODO review
-              break;
-            } case impl_registrar_takeover_object_type:{
-               // TODO review
-              break;
-            } case impl_csaf_lease_object_type:{
-               const auto& aobj = dynamic_cast<const csaf_lease_object*>(obj);
-               assert( aobj != nullptr );
-               accounts.insert( aobj->from );
-               accounts.insert( aobj->to );
-               break;
-           } case impl_transaction_object_type:{
-              const auto& aobj = dynamic_cast<const transaction_object*>(obj);
-              assert( aobj != nullptr );
-              transaction_get_impacted_account_uids( aobj->trx, accounts );
-              break;
-           } case impl_block_summary_object_type:
-              break;
-             case impl_account_transaction_history_object_type:
-              break;
-             case impl_chain_property_object_type:
-              break;
-             case impl_witness_schedule_object_type:
-              break;
+         add< account_object               >();
+         add< asset_object                 >();
+         add< platform_object              >();
+         add< post_object                  >();
+         add< committee_member_object      >();
+         add< committee_proposal_object    >();
+         add< witness_object               >();
+         add< proposal_object              >();
+         add< operation_history_object     >();
+         add< account_balance_object       >();
+         add< account_statistics_object    >();
+         add< voter_object                 >();
+         add< witness_vote_object          >();
+         add< platform_vote_object         >();
+         add< committee_member_vote_object >();
+         add< registrar_takeover_object    >();
+         add< csaf_lease_object            >();
+         add< transaction_object           >();
       }
-   }
+
+      static const impacted_accounts_registry& instance()
+      {
+         static const impacted_accounts_registry registry;
+         return registry;
+      }
+
+      void collect( const object& obj, impacted_account_uid_collector& accounts )const
+      {
+         const auto space = obj.id.space();
+         if( space > implementation_ids )
+            return;
+         const auto extract = _extractors[space][obj.id.type()];
+         if( extract != nullptr )
+            extract( obj, accounts );
+      }
+
+   private:
+      template<typename ObjectType>
+      static void extract( const object& obj, impacted_account_uid_collector& accounts )
+      {
+         impacted_accounts_trait<ObjectType>::collect( static_cast<const ObjectType&>( obj ), accounts );
+      }
+
+      template<typename ObjectType>
+      void add()
+      {
+         static_assert( impacted_accounts_trait<ObjectType>::is_specialized,
+                        "impacted_accounts_trait is not specialized for this object type" );
+         static_assert( ObjectType::space_id <= implementation_ids, "unexpected object space" );
+         _extractors[ObjectType::space_id][ObjectType::type_id] = &extract<ObjectType>;
+      }
+
+      extractor_type _extractors[implementation_ids + 1][256];
+};
+
+void get_relevant_accounts( const object* obj, vector<account_uid_type>& accounts )
+{
+   impacted_account_uid_collector collector( accounts );
+   impacted_accounts_registry::instance().collect( *obj, collector );
+}
+
+void get_relevant_accounts( const object* obj, flat_set<account_uid_type>& accounts )
+{
+   vector<account_uid_type> uids;
+   get_relevant_accounts( obj, uids );
+   accounts.insert( uids.begin(), uids.end() );
+}
+
+/// Sorts and deduplicates @p uids once, then builds the flat_set without per-element inserts
+static flat_set<account_uid_type> make_sorted_account_set( vector<account_uid_type>& uids )
+{
+   std::sort( uids.begin(), uids.end() );
+   uids.erase( std::unique( uids.begin(), uids.end() ), uids.end() );
+   return flat_set<account_uid_type>( boost::container::ordered_unique_range, uids.begin(), uids.end() );
 }
 
 void database::notify_changed_objects()
 { try {
    if( _undo_db.enabled() )
    {
+      // Nothing to do if nobody is listening
+      if( new_objects.empty() && changed_objects.empty() && removed_objects.empty() )
+         return;
+
       const auto& head_undo = _undo_db.head();
+      const auto& registry = impacted_accounts_registry::instance();
+      vector<account_uid_type> uids;
 
       // New
       if( !new_objects.empty() )
       {
         vector<object_id_type> new_ids;  new_ids.reserve(head_undo.new_ids.size());
-        flat_set<account_uid_type> new_accounts_impacted;
+        uids.clear();  uids.reserve( head_undo.new_ids.size() * 2 );
+        impacted_account_uid_collector collector( uids );
         for( const auto& item : head_undo.new_ids )
         {
           new_ids.push_back(item);
           auto obj = find_object(item);
           if(obj != nullptr)
-            get_relevant_accounts(obj, new_accounts_impacted);
+            registry.collect( *obj, collector );
         }
 
-        new_objects(new_ids, new_accounts_impacted);
+        new_objects(new_ids, make_sorted_account_set( uids ));
       }
 
       // Changed
       if( !changed_objects.empty() )
       {
         vector<object_id_type> changed_ids;  changed_ids.reserve(head_undo.old_values.size());
-        flat_set<account_uid_type> changed_accounts_impacted;
+        uids.clear();  uids.reserve( head_undo.old_values.size() * 2 );
+        impacted_account_uid_collector collector( uids );
         for( const auto& item : head_undo.old_values )
         {
           changed_ids.push_back(item.first);
-          get_relevant_accounts(item.second.get(), changed_accounts_impacted);
+          registry.collect( *item.second, collector );
         }
 
-        changed_objects(changed_ids, changed_accounts_impacted);
+        changed_objects(changed_ids, make_sorted_account_set( uids ));
       }
 
       // Removed
@@ -443,16 +644,17 @@ void database::notify_changed_objects()
       {
         vector<object_id_type> removed_ids; removed_ids.reserve( head_undo.removed.size() );
         vector<const object*> removed; removed.reserve( head_undo.removed.size() );
-        flat_set<account_uid_type> removed_accounts_impacted;
+        uids.clear();  uids.reserve( head_undo.removed.size() * 2 );
+        impacted_account_uid_collector collector( uids );
         for( const auto& item : head_undo.removed )
         {
           removed_ids.emplace_back( item.first );
           auto obj = item.second.get();
           removed.emplace_back( obj );
-          get_relevant_accounts(obj, removed_accounts_impacted);
+          registry.collect( *obj, collector );
         }
 
-        removed_objects(removed_ids, removed, removed_accounts_impacted);
+        removed_objects(removed_ids, removed, make_sorted_account_set( uids ));
       }
    }
 } FC_CAPTURE_AND_LOG( (0) ) }
@@ -34,6 +34,8 @@ void fork_database::reset()
 {
    _head.reset();
    _index.clear();
+   _unlinked_index.clear();
+   _unlinked_bytes = 0;
 }
 
 void fork_database::pop_block()
@@ -63,11 +65,18 @@ shared_ptr<fork_item>  fork_database::push_block(const signed_block& b)
    }
    catch ( const unlinkable_block_exception& e )
    {
+      if( _push_unlinked( item ) )
+      {
+         dlog( "Buffering block ${num} ${id} until its predecessor ${prev} arrives, ${n} blocks waiting",
+               ("num",item->num)("id",item->id)("prev",item->previous_id())("n",_unlinked_index.size()) );
+         FC_THROW_EXCEPTION( unlinkable_block_buffered, "block ${num} ${id} is waiting for its predecessor ${prev}",
+                             ("num",item->num)("id",item->id)("prev",item->previous_id()) );
+      }
       wlog( "Pushing block to fork database that failed to link: ${id}, ${num}", ("id",b.id())("num",b.block_num()) );
       wlog( "Head: ${num}, ${id}", ("num",_head->data.block_num())("id",_head->data.id()) );
       throw;
-      _unlinked_index.insert( item );
    }
+   _push_next( item );
    return _head;
 }
 
@@ -99,31 +108,81 @@ void  fork_database::_push_block(const item_ptr& item)
       auto& num_idx = _index.get<block_num>();
       while( num_idx.size() && (*num_idx.begin())->num < min_num )
          num_idx.erase( num_idx.begin() );
-      
-      _unlinked_index.get<block_num>().erase(_head->num - _max_size);
+
+      _remove_unlinked_below( min_num );
    }
-   //_push_next( item );
 }
 
 /**
  *  Iterate through the unlinked cache and insert anything that
- *  links to the newly inserted item.  This will start a recursive
- *  set of calls performing a depth-first insertion of pending blocks as
- *  _push_next(..) calls _push_block(...) which will in turn call _push_next
+ *  links to the newly inserted item, then anything that links to
+ *  those, until no waiting block links any more.  The blocks are
+ *  kept on an explicit stack rather than by recursion, a chain of
+ *  waiting blocks can be MAX_BLOCK_REORDERING long.
  */
 void fork_database::_push_next( const item_ptr& new_item )
 {
-    auto& prev_idx = _unlinked_index.get<by_previous>();
+   auto& prev_idx = _unlinked_index.get<by_previous>();
+
+   vector<item_ptr> linked( 1, new_item );
+   while( !linked.empty() )
+   {
+      item_ptr parent = linked.back();
+      linked.pop_back();
 
-    auto itr = prev_idx.find( new_item->id );
-    while( itr != prev_idx.end() )
-    {
-       auto tmp = *itr;
-       prev_idx.erase( itr );
-       _push_block( tmp );
+      auto itr = prev_idx.find( parent->id );
+      while( itr != prev_idx.end() )
+      {
+         auto tmp = *itr;
+         _unlinked_bytes -= tmp->packed_size;
+         prev_idx.erase( itr );
+         try {
+            _push_block( tmp );
+            linked.push_back( tmp );
+         }
+         catch ( const fc::exception& e )
+         {
+            wlog( "Dropping buffered block ${num} ${id} which failed to link: ${e}",
+                  ("num",tmp->num)("id",tmp->id)("e",e.to_detail_string()) );
+         }
+
+         itr = prev_idx.find( parent->id );
+      }
+   }
+}
+
+bool fork_database::_push_unlinked( const item_ptr& item )
+{
+   if( !_head || item->num > _head->num + MAX_BLOCK_REORDERING )
+      return false;
+
+   auto& id_idx = _unlinked_index.get<block_id>();
+   if( id_idx.find( item->id ) != id_idx.end() )
+      return true;
+
+   item->packed_size = fc::raw::pack_size( item->data );
+   _unlinked_index.insert( item );
+   _unlinked_bytes += item->packed_size;
+
+   // make room by dropping the blocks furthest ahead of the head, they will be needed last
+   auto& num_idx = _unlinked_index.get<block_num>();
+   while( _unlinked_index.size() > MAX_BLOCK_REORDERING || _unlinked_bytes > MAX_UNLINKED_BYTES )
+   {
+      auto last = std::prev( num_idx.end() );
+      _unlinked_bytes -= (*last)->packed_size;
+      num_idx.erase( last );
+   }
+   return id_idx.find( item->id ) != id_idx.end();
+}
 
-       itr = prev_idx.find( new_item->id );
-    }
+void fork_database::_remove_unlinked_below( uint32_t num )
+{
+   auto& num_idx = _unlinked_index.get<block_num>();
+   while( num_idx.size() && (*num_idx.begin())->num < num )
+   {
+      _unlinked_bytes -= (*num_idx.begin())->packed_size;
+      num_idx.erase( num_idx.begin() );
+   }
 }
 
 void fork_database::set_max_size( uint32_t s )
@@ -143,18 +202,8 @@ void fork_database::set_max_size( uint32_t s )
          itr = by_num_idx.begin();
       }
    }
-   { /// unlinked_index
-      auto& by_num_idx = _unlinked_index.get<block_num>();
-      auto itr = by_num_idx.begin();
-      while( itr != by_num_idx.end() )
-      {
-         if( (*itr)->num < std::max(int64_t(0),int64_t(_head->num) - _max_size) )
-            by_num_idx.erase(itr);
-         else
-            break;
-         itr = by_num_idx.begin();
-      }
-   }
+   /// unlinked_index
+   _remove_unlinked_below( std::max(int64_t(0),int64_t(_head->num) - _max_size) );
 }
 
 bool fork_database::is_known_block(const block_id_type& id)const
@@ -248,6 +297,14 @@ void fork_database::set_head(shared_ptr<fork_item> h)
 void fork_database::remove(block_id_type id)
 {
    _index.get<block_id>().erase(id);
+
+   auto& unlinked_index = _unlinked_index.get<block_id>();
+   auto unlinked_itr = unlinked_index.find(id);
+   if( unlinked_itr != unlinked_index.end() )
+   {
+      _unlinked_bytes -= (*unlinked_itr)->packed_size;
+      unlinked_index.erase(unlinked_itr);
+   }
 }
 
 } } // graphene::chain
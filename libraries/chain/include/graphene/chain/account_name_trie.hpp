@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+#pragma once
+#include <graphene/chain/protocol/types.hpp>
+
+namespace graphene { namespace chain {
+
+   /**
+    *  A radix trie mapping account names to account UIDs, for looking up accounts by name prefix.
+    *
+    *  Every node holds the bytes of the edge leading to it and the number of names at or below it, so
+    *  counting the names with a prefix takes one walk down the trie, and enumerating them visits only
+    *  the subtree of the prefix.  Names are enumerated in the same byte order as std::string compares.
+    *
+    *  Prefixes and cursors passed to the queries are lower-cased first: account names hold no upper
+    *  case letters, so lower-casing makes the queries case-insensitive.
+    */
+   class account_name_trie
+   {
+      public:
+         account_name_trie();
+
+         /// @return false if @p name is already in the trie
+         bool insert( const string& name, account_uid_type uid );
+         /// @return false if @p name is not in the trie
+         bool remove( const string& name );
+         optional<account_uid_type> find( const string& name )const;
+
+         /// number of names in the trie
+         uint64_t size()const;
+         /// number of names starting with @p prefix
+         uint64_t count_prefix( const string& prefix )const;
+         /**
+          * @param prefix only names starting with this are returned
+          * @param start_after continuation cursor: only names after this are returned; pass the last name
+          * of the previous page to get the next one, or an empty string to start with the first name
+          * @param limit maximum number of names to return
+          * @return the names and UIDs of the matching accounts, in ascending order of names
+          */
+         vector<pair<string,account_uid_type>> find_prefix( const string& prefix, const string& start_after,
+                                                            uint32_t limit )const;
+
+         /// number of nodes in use, including the root
+         uint64_t node_count()const { return _nodes.size() - _free_nodes.size(); }
+         /// estimated heap memory held by the trie
+         uint64_t heap_bytes()const;
+
+         /// @p s with ASCII letters lower-cased
+         static string fold_case( const string& s );
+
+      private:
+         struct node
+         {
+            /// bytes of the edge from the parent, empty for the root only
+            string                label;
+            /// children, in the order of the first bytes of their labels
+            vector<uint32_t>      children;
+            /// names ending at or below this node
+            uint64_t              count = 0;
+            account_uid_type      uid = 0;
+            /// whether a name ends at this node
+            bool                  terminal = false;
+         };
+
+         static const uint32_t npos = uint32_t(-1);
+
+         uint32_t new_node();
+         void     free_node( uint32_t index );
+         uint32_t find_child( uint32_t parent, char first )const;
+         void     add_child( uint32_t parent, uint32_t child );
+         /// Append the only child of a non-terminal node to it
+         void     merge_with_child( uint32_t index );
+         /// @return the node at or below which the names starting with @p prefix are, or npos; @p key is set to its name
+         uint32_t locate( const string& prefix, string& key )const;
+         void     collect( uint32_t index, string& key, const string* cursor, uint32_t limit,
+                           vector<pair<string,account_uid_type>>& result )const;
+
+         /// nodes addressed by their positions, the root is at 0
+         vector<node>     _nodes;
+         /// positions of unused nodes in _nodes
+         vector<uint32_t> _free_nodes;
+   };
+
+} } // graphene::chain
@@ -23,6 +23,7 @@
  */
 #pragma once
 #include <graphene/chain/protocol/operations.hpp>
+#include <graphene/chain/account_name_trie.hpp>
 #include <graphene/db/generic_index.hpp>
 #include <boost/multi_index/composite_key.hpp>
 #include <numeric>
@@ -481,6 +482,7 @@ namespace graphene { namespace chain {
          virtual void object_removed( const object& obj ) override;
          virtual void about_to_modify( const object& before ) override;
          virtual void object_modified( const object& after  ) override;
+         virtual secondary_index_memory_usage memory_usage()const override;
 
 
          /** given an account or key, map it to the set of accounts that reference it in an active or owner authority */
@@ -508,11 +510,66 @@ namespace graphene { namespace chain {
          virtual void object_removed( const object& obj ) override;
          virtual void about_to_modify( const object& before ) override;
          virtual void object_modified( const object& after  ) override;
+         virtual secondary_index_memory_usage memory_usage()const override;
 
          /** maps the referrer to the set of accounts that they have referred */
          map< account_uid_type, set<account_uid_type> > referred_by;
    };
 
+   /**
+    *  @brief This secondary index counts the changes to the owner, active and secondary authorities of
+    *  accounts, so that results derived from authorities can be cached and invalidated per account.
+    *
+    *  Only the accounts a cached result depends on are counted, see watch().
+    */
+   class account_authority_change_index : public secondary_index
+   {
+      public:
+         virtual void object_inserted( const object& obj ) override;
+         virtual void object_removed( const object& obj ) override;
+         virtual void about_to_modify( const object& before ) override;
+         virtual void object_modified( const object& after  ) override;
+         virtual secondary_index_memory_usage memory_usage()const override;
+
+         /**
+          *  Count the changes of account @p uid from now on: its creation, its removal and changes of its
+          *  authorities.  The account need not exist yet.
+          *  @return the number of changes counted so far
+          */
+         uint64_t watch( account_uid_type uid )const;
+         /** @return true if none of the accounts changed since watch() returned the given counts for them */
+         bool unchanged( const flat_map<account_uid_type, uint64_t>& changes )const;
+
+      protected:
+         void account_changed( account_uid_type uid );
+
+         /** changes of the watched accounts; a cache, it is not part of the state, so watch() is const */
+         mutable map<account_uid_type, uint64_t> authority_changes;
+
+         authority before_owner;
+         authority before_active;
+         authority before_secondary;
+   };
+
+   /**
+    *  @brief This secondary index keeps the names of all accounts in a radix trie, so that accounts can
+    *  be looked up and counted by name prefix, e.g. to autocomplete names as they are typed.
+    */
+   class account_name_prefix_index : public secondary_index
+   {
+      public:
+         virtual void object_inserted( const object& obj ) override;
+         virtual void object_removed( const object& obj ) override;
+         virtual void about_to_modify( const object& before ) override;
+         virtual void object_modified( const object& after  ) override;
+         virtual secondary_index_memory_usage memory_usage()const override;
+
+         account_name_trie names;
+
+      protected:
+         string before_name;
+   };
+
    struct by_account_asset;
    struct by_asset_balance;
    /**
@@ -773,3 +830,8 @@ FC_REFLECT_DERIVED( graphene::chain::account_statistics_object,
                     (last_post_sequence)
                   )
 
+GRAPHENE_DEFINE_INDEX_TYPE( graphene::chain::account_object,            graphene::chain::account_index )
+GRAPHENE_DEFINE_INDEX_TYPE( graphene::chain::account_balance_object,    graphene::chain::account_balance_index )
+GRAPHENE_DEFINE_INDEX_TYPE( graphene::chain::account_statistics_object, graphene::chain::account_statistics_index )
+GRAPHENE_DEFINE_INDEX_TYPE( graphene::chain::voter_object,              graphene::chain::voter_index )
+GRAPHENE_DEFINE_INDEX_TYPE( graphene::chain::registrar_takeover_object, graphene::chain::registrar_takeover_index )
@@ -25,6 +25,7 @@
 #include <graphene/chain/protocol/asset_ops.hpp>
 #include <boost/multi_index/composite_key.hpp>
 #include <graphene/db/generic_index.hpp>
+#include <graphene/db/simple_index.hpp>
 
 /**
  * @defgroup prediction_market Prediction Market
@@ -183,3 +184,6 @@ FC_REFLECT_DERIVED( graphene::chain::asset_object, (graphene::db::object),
                     (options)
                     (dynamic_asset_data_id)
                   )
+
+GRAPHENE_DEFINE_INDEX_TYPE( graphene::chain::asset_object,              graphene::chain::asset_index )
+GRAPHENE_DEFINE_INDEX_TYPE( graphene::chain::asset_dynamic_data_object, graphene::db::simple_index<graphene::chain::asset_dynamic_data_object> )
@@ -23,20 +23,168 @@
  */
 #pragma once
 #include <fstream>
+#include <list>
+#include <map>
+#include <memory>
 #include <graphene/chain/protocol/block.hpp>
 
+#include <fc/thread/future.hpp>
+#include <fc/time.hpp>
+
+namespace fc { class thread; }
+
 namespace graphene { namespace chain {
    struct index_entry;
 
+   /** Result of block_database::verify() */
+   struct block_log_verification
+   {
+      /// number of index entries, including the unused entry 0
+      uint32_t         index_entries = 0;
+      uint32_t         blocks_checked = 0;
+      /// entries of removed blocks, or never written
+      uint32_t         empty_entries = 0;
+      /// blocks whose data is out of range, does not unpack, or does not match the id or merkle root
+      vector<uint32_t> corrupt_blocks;
+      /// blocks which do not build on the block stored before them
+      vector<uint32_t> unlinked_blocks;
+
+      bool ok()const { return corrupt_blocks.empty() && unlinked_blocks.empty(); }
+   };
+
+   /**
+    *  Irreversible blocks grouped into segments of consecutive blocks, each compressed into its own file.
+    *
+    *  A segment file starts with the offsets of its blocks within the uncompressed payload, so a block is
+    *  found without scanning, followed by the payload compressed with zlib at its fastest level.  The most
+    *  recently used segments are kept decompressed.  Segments leave gaps where blocks were pruned before
+    *  they were compressed.
+    */
+   class block_log_segments
+   {
+      public:
+         /// number of decompressed segments kept in memory
+         const static uint32_t MAX_CACHED_SEGMENTS = 4;
+
+         /// @return false if this build has no codec for segments
+         static bool is_supported();
+
+         void open( const fc::path& dir );
+         void close();
+
+         const fc::path& dir()const { return _dir; }
+         bool     empty()const { return _segments.empty(); }
+         /// @return first block number in the segments, or end_block_num() if there are none
+         uint32_t begin_block_num()const;
+         /// @return block number following the last segment
+         uint32_t end_block_num()const { return _end_block_num; }
+         bool     contains( uint32_t block_num )const;
+
+         /// @return the packed block @p block_num, which must be contained in a segment
+         vector<char> fetch( uint32_t block_num )const;
+
+         /**
+          *  Compress and write the files of @p segments, which hold the packed blocks of consecutive segments
+          *  starting at @p first_block_num, to @p dir using up to @p thread_count threads.  Touches no open
+          *  segments, so it may run on any thread; the files are picked up by add().
+          */
+         static void write( const fc::path& dir, uint32_t first_block_num,
+                            const vector< vector< vector<char> > >& segments, uint32_t thread_count );
+         /**
+          *  Add @p segment_count consecutive segments starting at @p first_block_num, whose files were
+          *  written by write().  @p first_block_num must not be below end_block_num(), the blocks in between
+          *  are not in any segment.
+          */
+         void add( uint32_t first_block_num, uint32_t segment_count );
+         /// delete the segments which hold only blocks below @p block_num
+         void remove_below( uint32_t block_num );
+
+      private:
+         struct segment_info
+         {
+            fc::path          filename;
+            /// offsets of the blocks in the uncompressed payload, followed by the payload size
+            vector<uint32_t>  offsets;
+            uint64_t          payload_pos = 0;
+            uint64_t          payload_size = 0;
+            uint64_t          payload_checksum = 0;
+         };
+
+         static segment_info read_segment_info( const fc::path& filename, uint32_t& first_block_num );
+         std::shared_ptr< const vector<char> > load_payload( uint32_t first_block_num, const segment_info& info )const;
+
+         fc::path                             _dir;
+         /// first block number => segment
+         std::map< uint32_t, segment_info >   _segments;
+         uint32_t                             _end_block_num = 1;
+         mutable std::list< std::pair< uint32_t, std::shared_ptr< const vector<char> > > > _cache;
+   };
+
+   /**
+    *  Stores blocks in an append-only log, with an index from block number to position in the log.
+    *
+    *  Every update of the index is also appended to a journal of checksummed records, so that after an
+    *  unclean shutdown the index is restored from the journal tail rather than by scanning the log.
+    *  The log and the journal are synced to disk in groups, see set_sync_interval(); once the journal
+    *  holds MAX_JOURNAL_RECORDS records the index itself is synced and the journal emptied.
+    */
    class block_database 
    {
       public:
+         /// number of journal records after which the index is synced and the journal emptied
+         const static uint32_t MAX_JOURNAL_RECORDS = 4096;
+         /// number of blocks pruned at most by one call to prune()
+         const static uint32_t MAX_PRUNED_BLOCKS = 10000;
+
          void open( const fc::path& dbdir );
          bool is_open()const;
          void flush();
          void close();
 
+         /**
+          *  Stored blocks are synced to disk at most @p interval after they were stored, a zero interval
+          *  syncs on every store.
+          */
+         void set_sync_interval( fc::microseconds interval ) { _sync_interval = interval; }
+         /// sync the block log and the journal to disk, and release the space of pruned blocks
+         void sync();
+
+         /**
+          *  Check every block in the block database in @p dbdir, which must not be open for writing.
+          *  The index is split into @p thread_count ranges which are read and hashed in parallel.
+          */
+         static block_log_verification verify( const fc::path& dbdir, uint32_t thread_count );
+
+         /**
+          *  Move irreversible blocks into compressed segments of @p blocks_per_segment blocks, see
+          *  compress_irreversible(); 0 disables it.  Blocks already in segments stay readable either way.
+          */
+         void set_segment_size( uint32_t blocks_per_segment, uint32_t thread_count );
+         /**
+          *  Start writing the complete segments up to @p last_irreversible_block_num, at most one per thread,
+          *  in the background.  Once they are written, a later call or wait_for_compression() adds them and
+          *  releases the space of their blocks in the block log where the file system allows it.  Until then
+          *  the blocks are read from the block log; being irreversible, their index entries don't change.
+          */
+         void compress_irreversible( uint32_t last_irreversible_block_num );
+         /// wait for the segments being written in the background, if any, and add them
+         void wait_for_compression() { finish_compression( true ); }
+
+         /**
+          *  Drop the blocks below @p block_num, keeping their ids in the index.  Pruned blocks are reported as
+          *  not contained.  Their space is released by the next sync(), once the index no longer refers to it
+          *  after a crash.
+          */
+         void prune( uint32_t block_num );
+         /// @return the lowest block number which has not been pruned
+         uint32_t first_available_block_num()const { return _first_available_block_num; }
+
          void store( const block_id_type& id, const signed_block& b );
+         /**
+          *  Record the id of a block whose body is not available, like the ids of pruned blocks.  Only used
+          *  below every stored block, when starting from a state snapshot.
+          */
+         void store_id( const block_id_type& id );
          void remove( const block_id_type& id );
 
          bool                   contains( const block_id_type& id )const;
@@ -47,8 +195,43 @@ namespace graphene { namespace chain {
          optional<block_id_type> last_id()const;
       private:
          optional<index_entry> last_index_entry()const;
+         /// @return the packed block of @p e, from its segment or the block log
+         vector<char> read_block( const index_entry& e )const;
+         void append_journal( const index_entry& e, uint64_t block_checksum );
+         void replay_journal();
+         /// sync the index and empty the journal
+         void checkpoint_journal();
+         /// add the segments written in the background once they are, or right away if @p wait is set
+         void finish_compression( bool wait );
+
          fc::path _index_filename;
+         fc::path _blocks_filename;
+         fc::path _journal_filename;
          mutable std::fstream _blocks;
          mutable std::fstream _block_num_to_pos;
+         std::fstream         _journal;
+         uint32_t             _journal_records = 0;
+         bool                 _unsynced = false;
+         fc::microseconds     _sync_interval = fc::seconds(1);
+         fc::time_point       _last_sync;
+         block_log_segments   _segments;
+         uint32_t             _segment_size = 0;
+         uint32_t             _compression_threads = 1;
+         /// writes segments in the background, started by the first call to compress_irreversible()
+         std::shared_ptr<fc::thread> _compression_thread;
+         fc::future<void>     _compression_done;
+         /// number of segments being written in the background, 0 if none
+         uint32_t             _compressing_segments = 0;
+         /// index entries of the blocks being compressed, in block number order
+         vector<index_entry>  _compressing_entries;
+         fc::time_point       _compression_start;
+         uint32_t             _first_available_block_num = 1;
+         /// blocks pruned since the last sync, whose space is still in use
+         vector<index_entry>  _unreleased_blocks;
+         /// segments below this block number are removed by the next sync
+         uint32_t             _unreleased_segments_end = 0;
    };
 } }
+
+FC_REFLECT( graphene::chain::block_log_verification,
+            (index_entries)(blocks_checked)(empty_entries)(corrupt_blocks)(unlinked_blocks) )
@@ -24,6 +24,7 @@
 #pragma once
 
 #include <graphene/chain/immutable_chain_parameters.hpp>
+#include <graphene/db/simple_index.hpp>
 
 namespace graphene { namespace chain {
 
@@ -48,3 +49,5 @@ FC_REFLECT_DERIVED( graphene::chain::chain_property_object, (graphene::db::objec
                     (chain_id)
                     (immutable_parameters)
                   )
+
+GRAPHENE_DEFINE_INDEX_TYPE( graphene::chain::chain_property_object, graphene::db::simple_index<graphene::chain::chain_property_object> )
@@ -285,3 +285,7 @@ FC_REFLECT_DERIVED( graphene::chain::committee_proposal_object, (graphene::db::o
                     (approve_threshold)
                     (is_approved)
                   )
+
+GRAPHENE_DEFINE_INDEX_TYPE( graphene::chain::committee_member_object,      graphene::chain::committee_member_index )
+GRAPHENE_DEFINE_INDEX_TYPE( graphene::chain::committee_member_vote_object, graphene::chain::committee_member_vote_index )
+GRAPHENE_DEFINE_INDEX_TYPE( graphene::chain::committee_proposal_object,    graphene::chain::committee_proposal_index )
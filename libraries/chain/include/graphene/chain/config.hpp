@@ -55,6 +55,10 @@
 
 #define GRAPHENE_MIN_UNDO_HISTORY 10
 #define GRAPHENE_MAX_UNDO_HISTORY 10000
+/// number of popped blocks whose changes are kept for a cheap switch back, see database::pop_block()
+#define GRAPHENE_MAX_REDO_HISTORY 64
+/// minimum number of blocks pruned at once, see database::set_block_prune_window()
+#define GRAPHENE_BLOCK_PRUNE_BATCH 100
 
 #define GRAPHENE_MIN_BLOCK_SIZE_LIMIT (GRAPHENE_MIN_TRANSACTION_SIZE_LIMIT*5) // 5 transactions per block
 #define GRAPHENE_MIN_TRANSACTION_EXPIRATION_LIMIT (GRAPHENE_MAX_BLOCK_INTERVAL * 5) // 5 transactions per block
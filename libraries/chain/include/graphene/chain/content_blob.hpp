@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+#pragma once
+
+#include <fc/io/raw.hpp>
+#include <fc/reflect/reflect.hpp>
+#include <fc/variant.hpp>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace graphene { namespace chain {
+
+   /**
+    * @brief An immutable, shared reference to content held by the content_blob_store
+    *
+    * Copying a content_blob copies a pointer, not the content, so objects with large payloads
+    * (post title, body, etc.) can be cloned by the undo database without copying the payload.
+    * Identical payloads are stored only once.
+    *
+    * Serialization (binary and variant) is identical to std::string.
+    */
+   class content_blob
+   {
+      public:
+         content_blob() {}
+         content_blob( const std::string& s );
+         content_blob( std::string&& s );
+
+         content_blob& operator=( const std::string& s ) { return *this = content_blob( s ); }
+         content_blob& operator=( std::string&& s ) { return *this = content_blob( std::move( s ) ); }
+
+         const std::string& value()const { return _data ? *_data : empty_string(); }
+         operator const std::string&()const { return value(); }
+
+         size_t size()const  { return _data ? _data->size() : 0; }
+         bool   empty()const { return size() == 0; }
+
+         friend bool operator == ( const content_blob& a, const content_blob& b )
+         {
+            return a._data == b._data || a.value() == b.value();
+         }
+         friend bool operator != ( const content_blob& a, const content_blob& b ) { return !( a == b ); }
+         friend bool operator == ( const content_blob& a, const std::string& b ) { return a.value() == b; }
+         friend bool operator != ( const content_blob& a, const std::string& b ) { return a.value() != b; }
+
+      private:
+         static const std::string& empty_string();
+
+         std::shared_ptr<const std::string> _data;
+   };
+
+   /**
+    * @brief Process-wide, content-addressed store of content blobs
+    *
+    * Blobs are keyed by the hash of their content and are released as soon as the last
+    * content_blob referring to them goes away. Inserting content equal to an existing blob
+    * returns the existing one.
+    */
+   class content_blob_store
+   {
+      public:
+         struct store_stats
+         {
+            uint64_t blob_count  = 0;
+            uint64_t total_bytes = 0;
+         };
+
+         static content_blob_store& instance();
+
+         std::shared_ptr<const std::string> intern( std::string&& content );
+
+         store_stats get_stats()const;
+
+      private:
+         content_blob_store() {}
+
+         void release( uint64_t key, const std::string* content );
+
+         mutable std::mutex                                                 _mutex;
+         std::unordered_map< uint64_t, std::weak_ptr<const std::string> >   _blobs;
+         uint64_t                                                           _total_bytes = 0;
+   };
+
+} } // graphene::chain
+
+namespace fc {
+
+   inline void to_variant( const graphene::chain::content_blob& blob, fc::variant& var, uint32_t max_depth = 1 )
+   {
+      var = blob.value();
+   }
+
+   inline void from_variant( const fc::variant& var, graphene::chain::content_blob& blob, uint32_t max_depth = 1 )
+   {
+      blob = var.as_string();
+   }
+
+   namespace raw {
+
+      template< typename Stream >
+      inline void pack( Stream& s, const graphene::chain::content_blob& blob, uint32_t _max_depth=FC_PACK_MAX_DEPTH )
+      {
+         fc::raw::pack( s, blob.value(), _max_depth );
+      }
+
+      template< typename Stream >
+      inline void unpack( Stream& s, graphene::chain::content_blob& blob, uint32_t _max_depth=FC_PACK_MAX_DEPTH )
+      {
+         std::string content;
+         fc::raw::unpack( s, content, _max_depth );
+         blob = std::move( content );
+      }
+
+   } // fc::raw
+
+} // fc
+
+FC_REFLECT_TYPENAME( graphene::chain::content_blob )
+FC_REFLECT( graphene::chain::content_blob_store::store_stats, (blob_count)(total_bytes) )
@@ -3,6 +3,7 @@
  */
 #pragma once
 #include <graphene/chain/protocol/operations.hpp>
+#include <graphene/chain/content_blob.hpp>
 #include <graphene/db/generic_index.hpp>
 #include <boost/multi_index/composite_key.hpp>
 
@@ -197,10 +198,12 @@ namespace graphene { namespace chain {
          /// If it is a transcript, this value is required for the source platform
          optional<account_uid_type>   origin_platform;
 
-         string                       hash_value;
-         string                       extra_data; ///< category, tags and etc
-         string                       title;
-         string                       body;
+         /// Payloads are shared references into the content_blob_store, so that cloning a post
+         /// (e.g. by the undo database on post_update) doesn't copy them
+         content_blob                 hash_value;
+         content_blob                 extra_data; ///< category, tags and etc
+         content_blob                 title;
+         content_blob                 body;
 
          time_point_sec create_time;
          time_point_sec last_update_time;
@@ -287,4 +290,6 @@ FC_REFLECT_DERIVED( graphene::chain::post_object,
                     (create_time)(last_update_time)
                   )
 
-
+GRAPHENE_DEFINE_INDEX_TYPE( graphene::chain::platform_object,      graphene::chain::platform_index )
+GRAPHENE_DEFINE_INDEX_TYPE( graphene::chain::platform_vote_object, graphene::chain::platform_vote_index )
+GRAPHENE_DEFINE_INDEX_TYPE( graphene::chain::post_object,          graphene::chain::post_index )
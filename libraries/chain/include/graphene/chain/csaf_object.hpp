@@ -78,3 +78,4 @@ FC_REFLECT_DERIVED( graphene::chain::csaf_lease_object,
                     (from)(to)(amount)(expiration)
                   )
 
+GRAPHENE_DEFINE_INDEX_TYPE( graphene::chain::csaf_lease_object, graphene::chain::csaf_lease_index )
@@ -31,7 +31,9 @@
 #include <graphene/chain/asset_object.hpp>
 #include <graphene/chain/fork_database.hpp>
 #include <graphene/chain/block_database.hpp>
+#include <graphene/chain/pending_transaction_pool.hpp>
 #include <graphene/chain/genesis_state.hpp>
+#include <graphene/chain/state_snapshot.hpp>
 #include <graphene/chain/evaluator.hpp>
 
 #include <graphene/db/object_database.hpp>
@@ -43,6 +45,7 @@
 
 #include <fc/log/logger.hpp>
 
+#include <deque>
 #include <map>
 
 namespace graphene { namespace chain {
@@ -53,6 +56,40 @@ namespace graphene { namespace chain {
 
    struct budget_record;
 
+   /**
+    * @brief What happened to the pending transactions while a block was generated
+    */
+   struct block_generation_stats
+   {
+      /// transactions included in the block
+      uint32_t           included = 0;
+      /// transactions left in the pending pool because of the block size limit or the deadline
+      uint32_t           deferred = 0;
+      /// transactions which failed to apply
+      uint32_t           failed = 0;
+      /// true if transaction inclusion was stopped by the deadline
+      bool               deadline_reached = false;
+      /// time spent applying pending transactions
+      fc::microseconds   elapsed;
+   };
+
+   /**
+    * @brief Totals over the blocks generated by this node since it started
+    */
+   struct block_production_stats
+   {
+      uint32_t           blocks_produced = 0;
+      /// blocks for which transaction inclusion was stopped by the deadline
+      uint32_t           deadline_hits = 0;
+      uint64_t           transactions_included = 0;
+      uint64_t           transactions_deferred = 0;
+      /// time from starting generation to having the block signed and pushed
+      fc::microseconds   last_production_time;
+      fc::microseconds   max_production_time;
+      fc::microseconds   total_production_time;
+      block_generation_stats last_block;
+   };
+
    /**
     *   @class database
     *   @brief tracks the blockchain state in an extensible manner
@@ -100,6 +137,29 @@ namespace graphene { namespace chain {
              std::function<genesis_state_type()> genesis_loader,
              const std::string& db_version );
 
+         /**
+          * @brief Open a new database from a state snapshot instead of from genesis
+          *
+          * @param snapshot_dir Directory written by export_snapshot()
+          * @param trusted_block_id The snapshot must be of this block
+          * @param trusted_state_hash The state hash of the trusted block, as recorded by a node tracking the
+          *        state hash; the data directory is wiped if the imported state does not have this hash
+          * @param data_dir Path to create the database in, it must not hold a database yet
+          */
+         void open_from_snapshot(
+            const fc::path& snapshot_dir,
+            const block_id_type& trusted_block_id,
+            const fc::uint128& trusted_state_hash,
+            const fc::path& data_dir,
+            std::function<genesis_state_type()> genesis_loader,
+            const std::string& db_version );
+
+         /**
+          * Write a state snapshot of the last irreversible block into @p snapshot_dir.  The reversible blocks
+          * are rewound for it and restored afterwards.
+          */
+         void export_snapshot( const fc::path& snapshot_dir );
+
          /**
           * @brief Rebuild object graph from block history and open detabase
           *
@@ -117,6 +177,34 @@ namespace graphene { namespace chain {
          void wipe(const fc::path& data_dir, bool include_blocks);
          void close(bool rewind = true);
 
+         /**
+          * Flush the object database in the background after every @p blocks pushed blocks, 0 disables it.
+          * After a crash the node then restarts from the last flushed state and replays only the blocks
+          * pushed after it, instead of everything since the last clean shutdown.  Like close(), a flush
+          * saves the state as of the last irreversible block.
+          */
+         void set_flush_interval( uint32_t blocks );
+         /// Sync stored blocks to disk at most @p interval after they were stored, see block_database
+         void set_block_log_sync_interval( fc::microseconds interval ) { _block_id_to_block.set_sync_interval( interval ); }
+         /// Compress irreversible blocks into segments of @p blocks_per_segment blocks, see block_database
+         void set_block_log_segment_size( uint32_t blocks_per_segment, uint32_t thread_count )
+         { _block_id_to_block.set_segment_size( blocks_per_segment, thread_count ); }
+         /**
+          * Keep only the last @p blocks blocks and the reversible blocks, 0 keeps every block.  The ids of
+          * pruned blocks are kept, their bodies are no longer available to peers and the API.  Blocks are
+          * pruned in batches of GRAPHENE_BLOCK_PRUNE_BATCH, and never past the head block of the last state
+          * saved to disk, which a replay after a crash starts from: without set_flush_interval() nothing
+          * is pruned past the state the database was opened with.
+          */
+         void set_block_prune_window( uint32_t blocks ) { _block_prune_window = blocks; }
+         /**
+          * Log the estimated memory of the indexes every @p blocks blocks, 0 disables it.  Each log walks every
+          * object, see object_database::get_index_memory_usage().
+          */
+         void set_memory_usage_log_interval( uint32_t blocks ) { _memory_usage_log_interval = blocks; }
+         /// @return the lowest block number whose block is stored
+         uint32_t first_available_block_num()const { return _block_id_to_block.first_available_block_num(); }
+
          //////////////////// db_block.cpp ////////////////////
 
          /**
@@ -129,6 +217,13 @@ namespace graphene { namespace chain {
          block_id_type              fetch_block_id_for_num( uint32_t block_num )const; // check fork db first
          optional<signed_block>     fetch_block_by_id( const block_id_type& id )const;
          optional<signed_block>     fetch_block_by_number( uint32_t num )const;
+         /// @throws fc::key_not_found_exception if the block is not known or has been pruned
+         signed_block               get_block_by_id( const block_id_type& id )const;
+         /**
+          *  @return the ids of the blocks on the current chain from @p block_num on, at most @p limit of them,
+          *  or nothing if the blocks following @p block_num have been pruned
+          */
+         vector<block_id_type>      get_block_ids_from( uint32_t block_num, uint32_t limit )const;
          const signed_transaction&  get_recent_transaction( const transaction_id_type& trx_id )const;
          std::vector<block_id_type> get_block_ids_on_fork(block_id_type head_of_fork) const;
 
@@ -140,12 +235,34 @@ namespace graphene { namespace chain {
 
          void                              add_checkpoints( const flat_map<uint32_t,block_id_type>& checkpts );
          const flat_map<uint32_t,block_id_type> get_checkpoints()const { return _checkpoints; }
+
+         /**
+          * @brief Maintain a hash of the chain state incrementally and record it after every block
+          *
+          * The state hash covers the indexes created by the database itself, not the ones added by plugins,
+          * so nodes running different plugins can compare it.
+          */
+         void                              enable_state_hash( bool enabled );
+         bool                              state_hash_enabled()const { return _state_hash_enabled; }
+         /// @return hash of the current state
+         fc::uint128                       get_state_hash()const;
+         /// @return hash of the state after the given block was applied, if the block is recent enough
+         optional<fc::uint128>             get_block_state_hash( uint32_t block_num )const;
+         /// State hashes expected after the given blocks, a divergence is logged
+         void                              add_state_hash_checkpoints( const flat_map<uint32_t,fc::uint128>& checkpts );
+         /// Recompute the state hash from scratch, log the indexes whose incremental hash differs
+         bool                              verify_state_hash()const;
          bool before_last_checkpoint()const;
 
          bool push_block( const signed_block& b, uint32_t skip = skip_nothing );
          processed_transaction push_transaction( const signed_transaction& trx, uint32_t skip = skip_nothing );
          bool _push_block( const signed_block& b );
          processed_transaction _push_transaction( const signed_transaction& trx );
+         /**
+          * Apply a transaction taken from a pending pool again and put it back into the pending pool,
+          * reusing the id, size and priority cached in @p entry instead of computing them again.
+          */
+         void _push_pending_transaction( pending_transaction entry );
 
          ///@throws fc::exception if the proposed transaction fails to apply.
          processed_transaction push_proposal( const proposal_object& proposal );
@@ -156,15 +273,39 @@ namespace graphene { namespace chain {
             const fc::ecc::private_key& block_signing_private_key,
             uint32_t skip
             );
+         /**
+          * Generate a block, stop including pending transactions when @p deadline (wall clock) is reached.
+          * Transactions which are not included stay in the pending pool.
+          */
+         signed_block generate_block(
+            const fc::time_point_sec when,
+            account_uid_type witness_uid,
+            const fc::ecc::private_key& block_signing_private_key,
+            uint32_t skip,
+            const fc::time_point deadline,
+            block_generation_stats& stats
+            );
+         /// @return the totals of the blocks generated by this node
+         const block_production_stats& get_block_production_stats()const { return _production_stats; }
          signed_block _generate_block(
             const fc::time_point_sec when,
             account_uid_type witness_uid,
-            const fc::ecc::private_key& block_signing_private_key
+            const fc::ecc::private_key& block_signing_private_key,
+            const fc::time_point deadline,
+            block_generation_stats& stats
             );
 
          void pop_block();
          void clear_pending();
 
+         /**
+          *  True while applied_block is emitted for a block which was restored from the redo state kept
+          *  when it was popped.  The objects its handlers changed the first time round are part of that
+          *  state already, so handlers which write to the database must not repeat their changes, and
+          *  get_applied_operations() is empty.
+          */
+         bool is_reapplying_block()const { return _reapplying_block; }
+
          /**
           *  This method is used to track appied operations during the evaluation of a block, these
           *  operations should include any operation actually included in a transaction as well
@@ -405,7 +546,7 @@ namespace graphene { namespace chain {
 
       protected:
          //Mark pop_undo() as protected -- we do not want outside calling pop_undo(); it should call pop_block() instead
-         void pop_undo() { object_database::pop_undo(); }
+         void pop_undo( redo_state* redo = nullptr ) { object_database::pop_undo( redo ); }
 
       private:
          optional<undo_database::session>       _pending_tx_session;
@@ -430,6 +571,8 @@ namespace graphene { namespace chain {
 
          void                  _apply_block( const signed_block& next_block );
          processed_transaction _apply_transaction( const signed_transaction& trx );
+         /// @p trx_id must be trx.id()
+         processed_transaction _apply_transaction( const signed_transaction& trx, const transaction_id_type& trx_id );
 
          ///Steps involved in applying a new block
          ///@{
@@ -481,7 +624,7 @@ namespace graphene { namespace chain {
 
       private:
 
-         vector< processed_transaction >        _pending_tx;
+         pending_transaction_pool               _pending_tx;
          fork_database                          _fork_db;
 
          /**
@@ -511,6 +654,50 @@ namespace graphene { namespace chain {
 
          flat_map<uint32_t,block_id_type>  _checkpoints;
 
+         void record_state_hash( uint32_t block_num );
+         /// @return the state hash, computed from scratch if it is not maintained
+         fc::uint128 compute_state_hash();
+
+         /// start a background flush if one is due, called between blocks without pending transactions
+         void check_background_flush();
+
+         uint32_t                          _flush_interval = 0;
+         uint32_t                          _next_flush_block = 0;
+         /// head block of the last state saved to disk, a replay after a crash starts after it
+         uint32_t                          _flushed_head_block_num = 0;
+         /// head block of the state the running background flush saves, 0 if none is running
+         uint32_t                          _flushing_head_block_num = 0;
+
+         /// compress and prune the block log as configured, called after every pushed block
+         void maintain_block_log();
+
+         uint32_t                          _block_prune_window = 0;
+
+         /// log the memory of the largest indexes if it is due, called after every pushed block
+         void check_memory_usage_log()const;
+
+         uint32_t                          _memory_usage_log_interval = 0;
+
+         block_production_stats            _production_stats;
+
+         /**
+          * Restore @p next_block from the redo state kept when it was popped, instead of applying its
+          * transactions again.  Must be called in an undo session.
+          * @return false if there is no usable redo state, the block has to be applied normally then
+          */
+         bool apply_popped_block( const signed_block& next_block );
+
+         /// redo states of the most recently popped blocks, oldest first
+         std::deque< std::pair<block_id_type, redo_state> > _popped_block_redo;
+         bool                              _reapplying_block = false;
+
+         /// indexes created by initialize_indexes(), they are covered by the state hash
+         vector<db::index*>                _state_hash_indexes;
+         bool                              _state_hash_enabled = false;
+         /// state hash after each recent block
+         std::map<uint32_t,fc::uint128>    _block_state_hashes;
+         flat_map<uint32_t,fc::uint128>    _state_hash_checkpoints;
+
          node_property_object              _node_property_object;
    };
 
@@ -534,3 +721,8 @@ namespace graphene { namespace chain {
    }
 
 } }
+
+FC_REFLECT( graphene::chain::block_generation_stats, (included)(deferred)(failed)(deadline_reached)(elapsed) )
+FC_REFLECT( graphene::chain::block_production_stats,
+            (blocks_produced)(deadline_hits)(transactions_included)(transactions_deferred)
+            (last_production_time)(max_production_time)(total_production_time)(last_block) )
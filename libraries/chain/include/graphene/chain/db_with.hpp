@@ -68,9 +68,10 @@ struct skip_flags_restorer
  */
 struct pending_transactions_restorer
 {
-   pending_transactions_restorer( database& db, std::vector<processed_transaction>&& pending_transactions )
-      : _db(db), _pending_transactions( std::move(pending_transactions) )
+   pending_transactions_restorer( database& db, pending_transaction_pool&& pending_transactions )
+      : _db(db)
    {
+      _pending_transactions.swap( pending_transactions );
       _db.clear_pending();
    }
 
@@ -88,15 +89,20 @@ struct pending_transactions_restorer
          }
       }
       _db._popped_tx.clear();
-      for( const processed_transaction& tx : _pending_transactions )
+
+      // Drop expired transactions without trying to apply them,
+      // _apply_transaction() would reject them anyway.
+      if( _db.head_block_num() > 0 )
+         _pending_transactions.remove_expired( _db.head_block_time() );
+
+      const auto& seq_idx = _pending_transactions.indices().get<pending_transaction_pool::by_sequence>();
+      for( const pending_transaction& entry : seq_idx )
       {
          try
          {
-            if( !_db.is_known_transaction( tx.id() ) ) {
-               // since push_transaction() takes a signed_transaction,
-               // the operation_results field will be ignored.
-               _db._push_transaction( tx );
-            }
+            // The entry keeps its id, size and priority, only the transaction is applied again
+            if( !_db.is_known_transaction( entry.id ) )
+               _db._push_pending_transaction( entry );
          }
          catch( const fc::exception& e )
          {
@@ -109,7 +115,7 @@ struct pending_transactions_restorer
    }
 
    database& _db;
-   std::vector< processed_transaction > _pending_transactions;
+   pending_transaction_pool _pending_transactions;
 };
 
 /**
@@ -139,7 +145,7 @@ void with_skip_flags(
 template< typename Lambda >
 void without_pending_transactions(
    database& db,
-   std::vector<processed_transaction>&& pending_transactions,
+   pending_transaction_pool&& pending_transactions,
    Lambda callback )
 {
     pending_transactions_restorer restorer( db, std::move(pending_transactions) );
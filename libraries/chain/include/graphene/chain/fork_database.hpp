@@ -51,6 +51,8 @@ namespace graphene { namespace chain {
       bool                  invalid = false;
       block_id_type         id;
       signed_block          data;
+      /// packed size of data, only set while the block waits in the unlinked index
+      uint32_t              packed_size = 0;
    };
    typedef shared_ptr<fork_item> item_ptr;
 
@@ -64,6 +66,12 @@ namespace graphene { namespace chain {
     *
     *  Every time a block is pushed into the fork DB the
     *  block with the highest block_num will be returned.
+    *
+    *  A block which arrives before its predecessor is kept in
+    *  the unlinked index, bounded by MAX_BLOCK_REORDERING blocks
+    *  and MAX_UNLINKED_BYTES, and linked as soon as the missing
+    *  block is pushed, together with every block that was
+    *  waiting for it in turn.
     */
    class fork_database
    {
@@ -71,6 +79,8 @@ namespace graphene { namespace chain {
          typedef vector<item_ptr> branch_type;
          /// The maximum number of blocks that may be skipped in an out-of-order push
          const static int MAX_BLOCK_REORDERING = 1024;
+         /// The maximum total packed size of the blocks waiting for their predecessor
+         const static uint64_t MAX_UNLINKED_BYTES = 64 * 1024 * 1024;
 
          fork_database();
          void reset();
@@ -84,6 +94,8 @@ namespace graphene { namespace chain {
 
          /**
           *  @return the new head block ( the longest fork )
+          *  @throws unlinkable_block_buffered if the block does not link yet but was kept
+          *  @throws unlinkable_block_exception if the block does not link and was dropped
           */
          shared_ptr<fork_item>            push_block(const signed_block& b);
          shared_ptr<fork_item>            head()const { return _head; }
@@ -110,14 +122,21 @@ namespace graphene { namespace chain {
 
          void set_max_size( uint32_t s );
 
+         size_t   unlinked_size()const  { return _unlinked_index.size(); }
+         uint64_t unlinked_bytes()const { return _unlinked_bytes; }
+
       private:
          /** @return a pointer to the newly pushed item */
          void _push_block(const item_ptr& b );
          void _push_next(const item_ptr& newly_inserted);
+         /** @return false if the block was not kept because it is too far ahead of the head */
+         bool _push_unlinked(const item_ptr& item );
+         void _remove_unlinked_below( uint32_t num );
 
          uint32_t                 _max_size = 1024;
 
          fork_multi_index_type    _unlinked_index;
+         uint64_t                 _unlinked_bytes = 0;
          fork_multi_index_type    _index;
          shared_ptr<fork_item>    _head;
    };
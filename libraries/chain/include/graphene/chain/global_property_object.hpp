@@ -28,6 +28,7 @@
 #include <graphene/chain/protocol/types.hpp>
 #include <graphene/chain/database.hpp>
 #include <graphene/db/object.hpp>
+#include <graphene/db/simple_index.hpp>
 
 namespace graphene { namespace chain {
 
@@ -157,3 +158,6 @@ FC_REFLECT_DERIVED( graphene::chain::global_property_object, (graphene::db::obje
                     (active_committee_members)
                     (active_witnesses)
                   )
+
+GRAPHENE_DEFINE_INDEX_TYPE( graphene::chain::global_property_object,         graphene::db::simple_index<graphene::chain::global_property_object> )
+GRAPHENE_DEFINE_INDEX_TYPE( graphene::chain::dynamic_global_property_object, graphene::db::simple_index<graphene::chain::dynamic_global_property_object> )
@@ -47,4 +47,7 @@ void transaction_get_impacted_account_uids(
 
 void get_relevant_accounts( const object* obj, flat_set<account_uid_type>& accounts );
 
+/// Appends accounts relevant to @p obj to @p accounts, may contain duplicates
+void get_relevant_accounts( const object* obj, vector<account_uid_type>& accounts );
+
 } } // graphene::app
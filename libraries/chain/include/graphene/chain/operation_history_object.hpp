@@ -24,6 +24,7 @@
 #pragma once
 #include <graphene/chain/protocol/operations.hpp>
 #include <graphene/db/object.hpp>
+#include <graphene/db/generic_index.hpp>
 #include <boost/multi_index/composite_key.hpp>
 
 namespace graphene { namespace chain {
@@ -158,3 +159,5 @@ FC_REFLECT_DERIVED( graphene::chain::operation_history_object, (graphene::chain:
 
 FC_REFLECT_DERIVED( graphene::chain::account_transaction_history_object, (graphene::chain::object),
                     (account)(operation_id)(operation_type)(sequence)(next) )
+
+GRAPHENE_DEFINE_INDEX_TYPE( graphene::chain::operation_history_object, graphene::chain::operation_history_index )
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+#pragma once
+#include <graphene/chain/protocol/transaction.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/composite_key.hpp>
+
+namespace graphene { namespace chain {
+   using boost::multi_index_container;
+   using namespace boost::multi_index;
+
+   /**
+    * A transaction waiting in the pending pool, together with the values derived from it which are
+    * needed to order and pack it.  They are computed once when the transaction enters the pool.
+    */
+   struct pending_transaction
+   {
+      processed_transaction trx;
+      transaction_id_type   id;
+      time_point_sec        expiration;
+      /// fee payer of the first operation
+      account_uid_type      fee_payer = 0;
+      /// arrival order, unique within a pool
+      uint64_t              sequence = 0;
+      /// total fee (including the part paid with CSAF) per kilobyte of packed transaction
+      uint64_t              priority = 0;
+      /// fc::raw::pack_size() of the signed transaction, without operation results
+      uint32_t              packed_size = 0;
+   };
+
+   /**
+    *  The pending transaction pool holds the transactions which have been pushed to the database but
+    *  are not yet included in a block.
+    *
+    *  Transactions are indexed by id, arrival order, priority, expiration and fee payer, so that the
+    *  block producer can fill a block greedily by priority, and the pool can drop transactions that were
+    *  included in a block or have expired without re-applying them.
+    */
+   class pending_transaction_pool
+   {
+      public:
+         struct by_trx_id;
+         struct by_sequence;
+         struct by_priority;
+         struct by_expiration;
+         struct by_fee_payer;
+         typedef multi_index_container<
+            pending_transaction,
+            indexed_by<
+               hashed_unique< tag<by_trx_id>,
+                  member< pending_transaction, transaction_id_type, &pending_transaction::id >,
+                  std::hash<transaction_id_type> >,
+               ordered_unique< tag<by_sequence>,
+                  member< pending_transaction, uint64_t, &pending_transaction::sequence > >,
+               ordered_unique< tag<by_priority>,
+                  composite_key< pending_transaction,
+                     member< pending_transaction, uint64_t, &pending_transaction::priority >,
+                     member< pending_transaction, uint64_t, &pending_transaction::sequence >
+                  >,
+                  composite_key_compare< std::greater<uint64_t>, std::less<uint64_t> >
+               >,
+               ordered_non_unique< tag<by_expiration>,
+                  member< pending_transaction, time_point_sec, &pending_transaction::expiration > >,
+               ordered_unique< tag<by_fee_payer>,
+                  composite_key< pending_transaction,
+                     member< pending_transaction, account_uid_type, &pending_transaction::fee_payer >,
+                     member< pending_transaction, uint64_t, &pending_transaction::sequence >
+                  >
+               >
+            >
+         > pending_transaction_multi_index_type;
+
+         /**
+          * Add a transaction to the end of the pool.
+          * @return false if a transaction with the same id is already in the pool
+          */
+         bool insert( const processed_transaction& trx );
+         /// Add an entry which was taken from another pool, keeping its cached values.
+         bool insert( pending_transaction entry );
+
+         bool contains( const transaction_id_type& id )const;
+         void remove( const transaction_id_type& id );
+         /**
+          * Remove every transaction which expired before @p now.
+          * @return number of transactions removed
+          */
+         uint32_t remove_expired( time_point_sec now );
+
+         /// Number of transactions paid by @p fee_payer
+         size_t count_by_fee_payer( account_uid_type fee_payer )const;
+
+         size_t   size()const        { return _index.size(); }
+         bool     empty()const       { return _index.empty(); }
+         uint64_t total_packed_size()const { return _total_packed_size; }
+         void     clear();
+         void     swap( pending_transaction_pool& other );
+
+         const pending_transaction_multi_index_type& indices()const { return _index; }
+
+         /// @return transactions in arrival order
+         vector<processed_transaction> get_transactions()const;
+
+      private:
+         pending_transaction_multi_index_type _index;
+         uint64_t                             _next_sequence = 0;
+         uint64_t                             _total_packed_size = 0;
+   };
+} } // graphene::chain
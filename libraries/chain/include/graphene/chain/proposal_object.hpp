@@ -53,7 +53,14 @@ class proposal_object : public abstract_object<proposal_object>
       flat_set<account_uid_type>     available_owner_approvals;
       flat_set<public_key_type>     available_key_approvals;
 
+      /**
+       * The result is cached in the required_approval_index until the proposal or an account
+       * authority changes, so this must be called on the object in the database.
+       */
       bool is_authorized_to_execute(database& db)const;
+
+      /// accounts which are required or available approvers
+      flat_set<account_uid_type> get_approver_accounts()const;
 };
 
 /**
@@ -65,19 +72,39 @@ class proposal_object : public abstract_object<proposal_object>
  *
  *  This is a secondary index on the proposal_index
  *
- *  @note the set of required approvals is constant
+ *  @note the set of required approvals is constant, the available approvals
+ *  are updated when the proposal is modified
  */
 class required_approval_index : public secondary_index
 {
    public:
       virtual void object_inserted( const object& obj ) override;
       virtual void object_removed( const object& obj ) override;
-      virtual void about_to_modify( const object& before ) override{};
-      virtual void object_modified( const object& after  ) override{};
+      virtual void about_to_modify( const object& before ) override;
+      virtual void object_modified( const object& after  ) override;
+      virtual secondary_index_memory_usage memory_usage()const override;
 
       void remove( account_uid_type a, proposal_id_type p );
 
       map<account_uid_type, set<proposal_id_type> > _account_to_proposals;
+
+      /**
+       *  Result of proposal_object::is_authorized_to_execute(), valid as long as the proposal is not
+       *  modified, none of the accounts whose authorities were consulted has changed and the maximum
+       *  authority depth has not changed.
+       */
+      struct cached_authorization
+      {
+         /** changes of the consulted accounts, as counted by account_authority_change_index */
+         flat_map<account_uid_type, uint64_t> authority_changes;
+         uint8_t  max_authority_depth = 0;
+         bool     authorized = false;
+      };
+      /** a cache, it is not part of the state, so it may be filled in through a const index */
+      mutable map<proposal_id_type, cached_authorization> _authorizations;
+
+   protected:
+      flat_set<account_uid_type> _before_approvers;
 };
 
 struct by_expiration{};
@@ -107,3 +134,8 @@ FC_REFLECT_DERIVED( graphene::chain::proposal_object, (graphene::chain::object),
                     (required_owner_approvals)
                     (available_owner_approvals)
                     (available_key_approvals) )
+
+FC_REFLECT( graphene::chain::required_approval_index::cached_authorization,
+            (authority_changes)(max_authority_depth)(authorized) )
+
+GRAPHENE_DEFINE_INDEX_TYPE( graphene::chain::proposal_object, graphene::chain::proposal_index )
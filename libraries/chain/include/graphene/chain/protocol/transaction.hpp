@@ -25,6 +25,7 @@
 #include <graphene/chain/protocol/operations.hpp>
 #include <graphene/chain/protocol/types.hpp>
 
+#include <memory>
 #include <numeric>
 
 namespace graphene { namespace chain {
@@ -176,12 +177,28 @@ namespace graphene { namespace chain {
          ) const;
       */
 
+      /**
+       * Recover the public keys of all signatures.
+       *
+       * The result is cached (not serialized), later calls return it without running the recovery again
+       * as long as the transaction and its signatures haven't changed. This allows the recovery to be done
+       * on a worker thread before the transaction is pushed to the database.
+       */
       flat_map<public_key_type,signature_type> get_signature_keys( const chain_id_type& chain_id )const;
 
       vector<signature_type> signatures;
 
       /// Removes all operations and signatures
-      void clear() { operations.clear(); signatures.clear(); }
+      void clear() { operations.clear(); signatures.clear(); _signature_keys_cache.reset(); }
+
+   private:
+      struct signature_keys_cache
+      {
+         digest_type                                sig_digest;
+         vector<signature_type>                     signatures;
+         flat_map<public_key_type,signature_type>   keys;
+      };
+      mutable std::shared_ptr<const signature_keys_cache> _signature_keys_cache;
    };
 
 void verify_authority( const vector<operation>& ops, const flat_map<public_key_type,signature_type>& sigs,
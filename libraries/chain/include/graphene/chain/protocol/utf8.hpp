@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace graphene { namespace chain {
+
+   enum utf8_validation_result
+   {
+      utf8_valid,
+      utf8_invalid,
+      utf8_too_long
+   };
+
+   /**
+    * Decode the UTF-8 sequence at @p itr and advance @p itr past it.
+    *
+    * Accepts exactly what utf8::next() accepts: invalid lead bytes, truncated sequences, overlong forms,
+    * surrogates and code points above U+10FFFF are rejected. Unlike utf8::next() it doesn't throw.
+    *
+    * @return false if the sequence is invalid, @p itr is left unchanged in that case
+    */
+   bool utf8_decode_next( const char*& itr, const char* end, uint32_t& code_point );
+
+   /**
+    * Validate @p str as UTF-8 and count its code points, stopping as soon as there are more than
+    * @p max_code_points of them. Runs of ASCII are skipped 16 bytes at a time with SSE2 where available.
+    *
+    * @param code_points number of code points seen before returning
+    */
+   utf8_validation_result validate_utf8( const std::string& str, uint32_t max_code_points, uint32_t& code_points );
+
+} } // graphene::chain
@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+#pragma once
+#include <graphene/chain/protocol/block.hpp>
+
+#include <fc/uint128.hpp>
+
+namespace graphene { namespace chain {
+
+   /**
+    *  Describes a state snapshot, which is a directory holding this header as snapshot.json and the
+    *  object database, as of an irreversible block, in object_database/.
+    *
+    *  A node started from a snapshot checks it against a block id it trusts and then only syncs the
+    *  blocks following it.
+    */
+   struct state_snapshot_header
+   {
+      chain_id_type  chain_id;
+      block_id_type  block_id;
+      /// sum of the state hashes of all indexes, see database::get_state_hash()
+      fc::uint128    state_hash;
+      /// the block of block_id, stored as the first block of the importing node
+      signed_block   head_block;
+
+      uint32_t block_num()const { return block_header::num_from_id( block_id ); }
+   };
+
+} }
+
+FC_REFLECT( graphene::chain::state_snapshot_header, (chain_id)(block_id)(state_hash)(head_block) )
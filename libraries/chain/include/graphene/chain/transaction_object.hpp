@@ -72,3 +72,5 @@ namespace graphene { namespace chain {
 } }
 
 FC_REFLECT_DERIVED( graphene::chain::transaction_object, (graphene::db::object), (trx)(trx_id) )
+
+GRAPHENE_DEFINE_INDEX_TYPE( graphene::chain::transaction_object, graphene::chain::transaction_index )
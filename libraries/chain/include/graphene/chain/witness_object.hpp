@@ -258,3 +258,6 @@ FC_REFLECT_DERIVED( graphene::chain::witness_vote_object, (graphene::db::object)
                     (witness_uid)
                     (witness_sequence)
                   )
+
+GRAPHENE_DEFINE_INDEX_TYPE( graphene::chain::witness_object,      graphene::chain::witness_index )
+GRAPHENE_DEFINE_INDEX_TYPE( graphene::chain::witness_vote_object, graphene::chain::witness_vote_index )
@@ -25,6 +25,7 @@
 #include <graphene/chain/protocol/types.hpp>
 #include <graphene/db/object.hpp>
 #include <graphene/db/generic_index.hpp>
+#include <graphene/db/simple_index.hpp>
 
 namespace graphene { namespace chain {
 
@@ -52,3 +53,5 @@ FC_REFLECT_DERIVED(
    (current_by_vote_time)
    (current_shuffled_witnesses)
 )
+
+GRAPHENE_DEFINE_INDEX_TYPE( graphene::chain::witness_schedule_object, graphene::db::simple_index<graphene::chain::witness_schedule_object> )
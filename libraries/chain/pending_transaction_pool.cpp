@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+#include <graphene/chain/pending_transaction_pool.hpp>
+#include <graphene/chain/protocol/fee_schedule.hpp>
+
+#include <fc/smart_ref_impl.hpp>
+#include <fc/uint128.hpp>
+
+namespace graphene { namespace chain {
+
+namespace {
+
+struct pending_fee_visitor
+{
+   typedef void result_type;
+
+   share_type total_fee = 0;
+
+   static share_type fee_amount( const asset& fee )    { return fee.amount; }
+   static share_type fee_amount( const fee_type& fee ) { return fee.total.amount; }
+
+   template<typename Op>
+   void operator()( const Op& op )
+   {
+      total_fee += std::max( fee_amount( op.fee ), share_type(0) );
+   }
+};
+
+struct pending_fee_payer_visitor
+{
+   typedef account_uid_type result_type;
+
+   template<typename Op>
+   account_uid_type operator()( const Op& op )const { return op.fee_payer_uid(); }
+};
+
+}
+
+bool pending_transaction_pool::insert( const processed_transaction& trx )
+{
+   pending_transaction entry;
+   entry.id = trx.id();
+   if( _index.find( entry.id ) != _index.end() )
+      return false;
+
+   entry.expiration = trx.expiration;
+   entry.packed_size = fc::raw::pack_size( static_cast<const signed_transaction&>( trx ) );
+
+   pending_fee_visitor fee_visitor;
+   for( const auto& op : trx.operations )
+      op.visit( fee_visitor );
+   if( !trx.operations.empty() )
+      entry.fee_payer = trx.operations.front().visit( pending_fee_payer_visitor() );
+   fc::uint128 priority = fc::uint128( uint64_t( fee_visitor.total_fee.value ) ) * 1024;
+   priority /= std::max( entry.packed_size, uint32_t(1) );
+   entry.priority = priority.to_uint64();
+
+   entry.trx = trx;
+   return insert( std::move( entry ) );
+}
+
+bool pending_transaction_pool::insert( pending_transaction entry )
+{
+   entry.sequence = _next_sequence++;
+   const uint32_t packed_size = entry.packed_size;
+   bool inserted = _index.insert( std::move( entry ) ).second;
+   if( inserted )
+      _total_packed_size += packed_size;
+   return inserted;
+}
+
+bool pending_transaction_pool::contains( const transaction_id_type& id )const
+{
+   return _index.find( id ) != _index.end();
+}
+
+void pending_transaction_pool::remove( const transaction_id_type& id )
+{
+   auto itr = _index.find( id );
+   if( itr == _index.end() )
+      return;
+   _total_packed_size -= itr->packed_size;
+   _index.erase( itr );
+}
+
+uint32_t pending_transaction_pool::remove_expired( time_point_sec now )
+{
+   auto& exp_idx = _index.get<by_expiration>();
+   auto end = exp_idx.lower_bound( now );
+   uint32_t count = 0;
+   for( auto itr = exp_idx.begin(); itr != end; ++itr, ++count )
+      _total_packed_size -= itr->packed_size;
+   exp_idx.erase( exp_idx.begin(), end );
+   return count;
+}
+
+size_t pending_transaction_pool::count_by_fee_payer( account_uid_type fee_payer )const
+{
+   return _index.get<by_fee_payer>().count( boost::make_tuple( fee_payer ) );
+}
+
+void pending_transaction_pool::clear()
+{
+   _index.clear();
+   _total_packed_size = 0;
+}
+
+void pending_transaction_pool::swap( pending_transaction_pool& other )
+{
+   _index.swap( other._index );
+   std::swap( _next_sequence, other._next_sequence );
+   std::swap( _total_packed_size, other._total_packed_size );
+}
+
+vector<processed_transaction> pending_transaction_pool::get_transactions()const
+{
+   vector<processed_transaction> result;
+   result.reserve( _index.size() );
+   for( const pending_transaction& entry : _index.get<by_sequence>() )
+      result.push_back( entry.trx );
+   return result;
+}
+
+} } // graphene::chain
@@ -25,12 +25,35 @@
 #include <graphene/chain/account_object.hpp>
 #include <graphene/chain/proposal_object.hpp>
 
+#include <algorithm>
+#include <iterator>
+
 namespace graphene { namespace chain {
 
 bool proposal_object::is_authorized_to_execute(database& db) const
 {
+   const auto& approvals = dynamic_cast<const primary_index<proposal_index>&>( db.get_index_type<proposal_index>() )
+                              .get_secondary_index<required_approval_index>();
+   const auto& authorities = dynamic_cast<const primary_index<account_index>&>( db.get_index_type<account_index>() )
+                                .get_secondary_index<account_authority_change_index>();
+   const uint8_t max_authority_depth = db.get_global_properties().parameters.max_authority_depth;
+
+   auto cached = approvals._authorizations.find( id );
+   if( cached != approvals._authorizations.end()
+         && cached->second.max_authority_depth == max_authority_depth
+         && authorities.unchanged( cached->second.authority_changes ) )
+      return cached->second.authorized;
+
    transaction_evaluation_state dry_run_eval(&db);
 
+   // record the accounts whose authorities are consulted, the result stays valid while they don't change
+   flat_map<account_uid_type, uint64_t> consulted;
+   auto get_account = [&]( account_uid_type uid ) -> const account_object& {
+      consulted.emplace( uid, authorities.watch( uid ) );
+      return db.get_account_by_uid( uid );
+   };
+
+   bool authorized = true;
    try {
        flat_map<public_key_type,signature_type> map;
        signature_type st;
@@ -40,10 +63,10 @@ bool proposal_object::is_authorized_to_execute(database& db) const
        }
         verify_authority( proposed_transaction.operations,
                        map,
-                       [&]( account_uid_type uid ){ return &(db.get_account_by_uid(uid).owner); },
-                       [&]( account_uid_type uid ){ return &(db.get_account_by_uid(uid).active); },
-                       [&]( account_uid_type uid ){ return &(db.get_account_by_uid(uid).secondary); },
-                       db.get_global_properties().parameters.max_authority_depth,
+                       [&]( account_uid_type uid ){ return &(get_account(uid).owner); },
+                       [&]( account_uid_type uid ){ return &(get_account(uid).active); },
+                       [&]( account_uid_type uid ){ return &(get_account(uid).secondary); },
+                       max_authority_depth,
                        true, /* allow committeee */
                        available_owner_approvals,
                        available_active_approvals,
@@ -53,9 +76,29 @@ bool proposal_object::is_authorized_to_execute(database& db) const
    {
       //idump((available_active_approvals));
       //wlog((e.to_detail_string()));
-      return false;
+      authorized = false;
    }
-   return true;
+
+   auto& entry = approvals._authorizations[id];
+   entry.authority_changes = std::move( consulted );
+   entry.max_authority_depth = max_authority_depth;
+   entry.authorized = authorized;
+   return authorized;
+}
+
+flat_set<account_uid_type> proposal_object::get_approver_accounts()const
+{
+   flat_set<account_uid_type> result;
+   result.reserve( required_secondary_approvals.size() + required_active_approvals.size()
+                   + required_owner_approvals.size() + available_secondary_approvals.size()
+                   + available_active_approvals.size() + available_owner_approvals.size() );
+   result.insert( required_secondary_approvals.begin(), required_secondary_approvals.end() );
+   result.insert( required_active_approvals.begin(), required_active_approvals.end() );
+   result.insert( required_owner_approvals.begin(), required_owner_approvals.end() );
+   result.insert( available_secondary_approvals.begin(), available_secondary_approvals.end() );
+   result.insert( available_active_approvals.begin(), available_active_approvals.end() );
+   result.insert( available_owner_approvals.begin(), available_owner_approvals.end() );
+   return result;
 }
 
 
@@ -64,18 +107,9 @@ void required_approval_index::object_inserted( const object& obj )
     assert( dynamic_cast<const proposal_object*>(&obj) );
     const proposal_object& p = static_cast<const proposal_object&>(obj);
 
-    for( const auto& a : p.required_secondary_approvals )
-       _account_to_proposals[a].insert( p.id );
-    for( const auto& a : p.required_active_approvals )
-       _account_to_proposals[a].insert( p.id );
-    for( const auto& a : p.required_owner_approvals )
-       _account_to_proposals[a].insert( p.id );
-    for( const auto& a : p.available_secondary_approvals )
-       _account_to_proposals[a].insert( p.id );
-    for( const auto& a : p.available_active_approvals )
-       _account_to_proposals[a].insert( p.id );
-    for( const auto& a : p.available_owner_approvals )
+    for( const auto& a : p.get_approver_accounts() )
        _account_to_proposals[a].insert( p.id );
+    _authorizations.erase( p.id );
 }
 
 void required_approval_index::remove( account_uid_type a, proposal_id_type p )
@@ -94,18 +128,46 @@ void required_approval_index::object_removed( const object& obj )
     assert( dynamic_cast<const proposal_object*>(&obj) );
     const proposal_object& p = static_cast<const proposal_object&>(obj);
 
-    for( const auto& a : p.required_secondary_approvals )
-       remove( a, p.id );
-    for( const auto& a : p.required_active_approvals )
-       remove( a, p.id );
-    for( const auto& a : p.required_owner_approvals )
+    for( const auto& a : p.get_approver_accounts() )
        remove( a, p.id );
-    for( const auto& a : p.available_secondary_approvals )
-       remove( a, p.id );
-    for( const auto& a : p.available_active_approvals )
-       remove( a, p.id );
-    for( const auto& a : p.available_owner_approvals )
+    _authorizations.erase( p.id );
+}
+
+void required_approval_index::about_to_modify( const object& before )
+{
+    assert( dynamic_cast<const proposal_object*>(&before) );
+    _before_approvers = static_cast<const proposal_object&>(before).get_approver_accounts();
+}
+
+void required_approval_index::object_modified( const object& after )
+{
+    assert( dynamic_cast<const proposal_object*>(&after) );
+    const proposal_object& p = static_cast<const proposal_object&>(after);
+    const flat_set<account_uid_type> after_approvers = p.get_approver_accounts();
+
+    vector<account_uid_type> removed;
+    std::set_difference( _before_approvers.begin(), _before_approvers.end(),
+                         after_approvers.begin(), after_approvers.end(),
+                         std::back_inserter(removed) );
+    for( const auto& a : removed )
        remove( a, p.id );
+
+    vector<account_uid_type> added;
+    std::set_difference( after_approvers.begin(), after_approvers.end(),
+                         _before_approvers.begin(), _before_approvers.end(),
+                         std::back_inserter(added) );
+    for( const auto& a : added )
+       _account_to_proposals[a].insert( p.id );
+
+    _authorizations.erase( p.id );
+}
+
+secondary_index_memory_usage required_approval_index::memory_usage()const
+{
+    secondary_index_memory_usage result = secondary_index::memory_usage();
+    result.entry_count = _account_to_proposals.size() + _authorizations.size();
+    result.heap_bytes = heap_size_of( _account_to_proposals ) + heap_size_of( _authorizations );
+    return result;
 }
 
 } } // graphene::chain
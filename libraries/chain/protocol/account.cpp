@@ -22,8 +22,7 @@
  * THE SOFTWARE.
  */
 #include <graphene/chain/protocol/account.hpp>
-
-#include "../utf8/checked.h"
+#include <graphene/chain/protocol/utf8.hpp>
 
 namespace graphene { namespace chain {
 
@@ -47,44 +46,41 @@ void validate_account_name( const string& name, const string& object_name = "" )
 
    uint32_t len = 0;
    uint32_t last_char = 0;
-   auto itr = name.begin();
-   while( itr != name.end() )
+   const char* itr = name.data();
+   const char* const end = itr + name.size();
+   while( itr != end )
    {
-      try
+      if( !utf8_decode_next( itr, end, last_char ) )
+      {
+         name_is_utf8 = false;
+         break;
+      }
+      ++len;
+      if( len > GRAPHENE_MAX_ACCOUNT_NAME_LENGTH )
       {
-         last_char = utf8::next( itr, name.end() );
-         ++len;
-         if( len > GRAPHENE_MAX_ACCOUNT_NAME_LENGTH )
+         name_too_long = true;
+         break;
+      }
+      if( len == 1 )
+      {
+         if( last_char == '_')
          {
-            name_too_long = true;
+            name_start_with_underline = true;
             break;
          }
-         if( len == 1 )
+         if( last_char >= '0' && last_char <= '9' )
          {
-            if( last_char == '_')
-            {
-               name_start_with_underline = true;
-               break;
-            }
-            if( last_char >= '0' && last_char <= '9' )
-            {
-               name_start_with_number = true;
-               break;
-            }
-         }
-         if( last_char != '_' &&
-             !( last_char >= '0' && last_char <= '9' ) &&
-             !( last_char >= 'a' && last_char <= 'z' ) &&
-             !( last_char >= 0x4E00 && last_char <= 0x9FA5 ) &&
-             !( last_char == 0xFF08 || last_char == 0xFF09 ) )
-         {
-            name_contains_invalid_char = true;
+            name_start_with_number = true;
             break;
          }
       }
-      catch( utf8::invalid_utf8 e )
+      if( last_char != '_' &&
+          !( last_char >= '0' && last_char <= '9' ) &&
+          !( last_char >= 'a' && last_char <= 'z' ) &&
+          !( last_char >= 0x4E00 && last_char <= 0x9FA5 ) &&
+          !( last_char == 0xFF08 || last_char == 0xFF09 ) )
       {
-         name_is_utf8 = false;
+         name_contains_invalid_char = true;
          break;
       }
    }
@@ -96,7 +92,7 @@ void validate_account_name( const string& name, const string& object_name = "" )
 
    FC_ASSERT( !name_contains_invalid_char, "${o}account name contains invalid character", ("o", object_name) );
 
-   if( len > 0 && itr == name.end() && name_is_utf8 && last_char == '_' )
+   if( len > 0 && itr == end && name_is_utf8 && last_char == '_' )
       name_end_with_underline = true;
    FC_ASSERT( !name_end_with_underline, "${o}account name should not end with an underline", ("o", object_name) );
 
@@ -430,7 +430,13 @@ void get_authority_uid( const authority* au,
 flat_map<public_key_type,signature_type> signed_transaction::get_signature_keys( const chain_id_type& chain_id )const
 { try {
    auto d = sig_digest( chain_id );
+   // the digest covers chain_id and all signed content, so the cache is valid iff digest and signatures match
+   auto cache = _signature_keys_cache;
+   if( cache && cache->sig_digest == d && cache->signatures == signatures )
+      return cache->keys;
+
    flat_map<public_key_type,signature_type> result;
+   result.reserve( signatures.size() );
    for( const auto&  sig : signatures )
    {
       const auto& key = fc::ecc::public_key(sig,d);
@@ -440,6 +446,12 @@ flat_map<public_key_type,signature_type> signed_transaction::get_signature_keys(
          "Duplicate Signature detected" );
       result[key] = sig;
    }
+
+   auto new_cache = std::make_shared<signature_keys_cache>();
+   new_cache->sig_digest = d;
+   new_cache->signatures = signatures;
+   new_cache->keys       = result;
+   _signature_keys_cache = new_cache;
    return result;
 } FC_CAPTURE_AND_RETHROW() }
 
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+#include <graphene/chain/protocol/utf8.hpp>
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define GRAPHENE_UTF8_SSE2 1
+#endif
+
+namespace graphene { namespace chain {
+
+bool utf8_decode_next( const char*& itr, const char* end, uint32_t& code_point )
+{
+   const unsigned char* p = reinterpret_cast<const unsigned char*>( itr );
+   const size_t available = end - itr;
+   if( available == 0 )
+      return false;
+
+   const uint32_t lead = p[0];
+   size_t length;
+   uint32_t cp;
+   if( lead < 0x80 )
+   {
+      code_point = lead;
+      ++itr;
+      return true;
+   }
+   else if( ( lead >> 5 ) == 0x6 )
+   {
+      length = 2;
+      cp = lead & 0x1f;
+   }
+   else if( ( lead >> 4 ) == 0xe )
+   {
+      length = 3;
+      cp = lead & 0x0f;
+   }
+   else if( ( lead >> 3 ) == 0x1e )
+   {
+      length = 4;
+      cp = lead & 0x07;
+   }
+   else
+      return false;
+
+   if( available < length )
+      return false;
+   for( size_t i = 1; i < length; ++i )
+   {
+      if( ( p[i] & 0xc0 ) != 0x80 )
+         return false;
+      cp = ( cp << 6 ) | ( p[i] & 0x3f );
+   }
+
+   // out of range or surrogate
+   if( cp > 0x10ffff || ( cp >= 0xd800 && cp <= 0xdfff ) )
+      return false;
+   // overlong
+   if( ( length == 2 && cp < 0x80 ) || ( length == 3 && cp < 0x800 ) || ( length == 4 && cp < 0x10000 ) )
+      return false;
+
+   code_point = cp;
+   itr += length;
+   return true;
+}
+
+utf8_validation_result validate_utf8( const std::string& str, uint32_t max_code_points, uint32_t& code_points )
+{
+   const char* itr = str.data();
+   const char* const end = itr + str.size();
+   uint64_t count = 0;
+
+   while( itr != end )
+   {
+      // every ASCII byte is a complete code point
+#ifdef GRAPHENE_UTF8_SSE2
+      while( end - itr >= 16 )
+      {
+         const __m128i chunk = _mm_loadu_si128( reinterpret_cast<const __m128i*>( itr ) );
+         if( _mm_movemask_epi8( chunk ) != 0 )
+            break;
+         itr += 16;
+         count += 16;
+      }
+#endif
+      while( end - itr >= 8 )
+      {
+         uint64_t word;
+         memcpy( &word, itr, sizeof(word) );
+         if( word & 0x8080808080808080ULL )
+            break;
+         itr += 8;
+         count += 8;
+      }
+      if( count > max_code_points )
+      {
+         code_points = max_code_points + 1;
+         return utf8_too_long;
+      }
+      if( itr == end )
+         break;
+
+      uint32_t cp;
+      if( !utf8_decode_next( itr, end, cp ) )
+      {
+         code_points = count;
+         return utf8_invalid;
+      }
+      if( ++count > max_code_points )
+      {
+         code_points = count;
+         return utf8_too_long;
+      }
+   }
+
+   code_points = count;
+   return utf8_valid;
+}
+
+} } // graphene::chain
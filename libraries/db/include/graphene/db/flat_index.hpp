@@ -101,6 +101,18 @@ namespace graphene { namespace db {
             return result;
          }
 
+         virtual index_memory_usage memory_usage()const override
+         {
+            index_memory_usage result;
+            result.object_count = _objects.size();
+            result.object_bytes = result.object_count * sizeof( T );
+            for( const auto& item : _objects )
+               result.dynamic_bytes += heap_size_of( item );
+            // the unused capacity of the vector
+            result.node_overhead_bytes = heap_allocation_size( _objects.capacity() * sizeof( T ) ) - result.object_bytes;
+            return result;
+         }
+
          class const_iterator
          {
             public:
@@ -27,6 +27,7 @@
 #include <boost/multi_index/member.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/mem_fun.hpp>
+#include <boost/mpl/size.hpp>
 
 namespace graphene { namespace chain {
 
@@ -73,6 +74,26 @@ namespace graphene { namespace chain {
             FC_ASSERT( ok, "Could not modify object, most likely a index constraint was violated" );
          }
 
+         /// Statically typed create(), the caller is responsible for assigning the next id
+         template<typename Constructor>
+         const ObjectType& create_object( object_id_type id, const Constructor& constructor )
+         {
+            ObjectType item;
+            item.id = id;
+            constructor( item );
+            auto insert_result = _indices.insert( std::move(item) );
+            FC_ASSERT(insert_result.second, "Could not create object! Most likely a uniqueness constraint is violated.");
+            return *insert_result.first;
+         }
+
+         /// Statically typed modify(), the lambda is passed to multi_index::modify without type erasure
+         template<typename Lambda>
+         void modify_object( const ObjectType& obj, const Lambda& m )
+         {
+            auto ok = _indices.modify( _indices.iterator_to( obj ), [&m]( ObjectType& o ){ m(o); } );
+            FC_ASSERT( ok, "Could not modify object, most likely a index constraint was violated" );
+         }
+
          virtual void remove( const object& obj )override
          {
             _indices.erase( _indices.iterator_to( static_cast<const ObjectType&>(obj) ) );
@@ -95,6 +116,21 @@ namespace graphene { namespace chain {
             } FC_CAPTURE_AND_RETHROW()
          }
 
+         virtual index_memory_usage memory_usage()const override
+         {
+            index_memory_usage result;
+            result.object_count = _indices.size();
+            result.object_bytes = result.object_count * sizeof( ObjectType );
+            for( const auto& item : _indices )
+               result.dynamic_bytes += graphene::db::heap_size_of( item );
+            // each object lives in a node of its own, which every index of the container links in
+            // with about 3 pointers
+            const uint64_t index_count = boost::mpl::size< typename MultiIndexType::index_type_list >::value;
+            const uint64_t node_size = sizeof( ObjectType ) + index_count * 3 * sizeof(void*);
+            result.node_overhead_bytes = result.object_count * ( graphene::db::heap_allocation_size( node_size ) - sizeof( ObjectType ) );
+            return result;
+         }
+
          const index_type& indices()const { return _indices; }
 
          virtual fc::uint128 hash()const override {
@@ -23,11 +23,15 @@
  */
 #pragma once
 #include <graphene/db/object.hpp>
+#include <graphene/db/memory_usage.hpp>
 #include <fc/interprocess/file_mapping.hpp>
 #include <fc/io/raw.hpp>
 #include <fc/io/json.hpp>
 #include <fc/crypto/sha256.hpp>
+#include <boost/core/demangle.hpp>
 #include <fstream>
+#include <type_traits>
+#include <typeinfo>
 
 namespace graphene { namespace db {
    class object_database;
@@ -128,12 +132,48 @@ namespace graphene { namespace db {
 
          virtual void               inspect_all_objects(std::function<void(const object&)> inspector)const = 0;
          virtual fc::uint128        hash()const = 0;
+
+         /**
+          *  The state hash is the sum of the hashes of all objects in the index, the same value as hash(), but it
+          *  is maintained incrementally by create, modify and remove (including undo) once enabled, so it is
+          *  cheap to read after every block.  Enabling it computes the hash from scratch.
+          */
+         /// @{
+         virtual void               enable_state_hash( bool enabled ) {}
+         virtual bool               state_hash_enabled()const { return false; }
+         virtual fc::uint128        state_hash()const { return fc::uint128(); }
+         /// @}
          virtual void               add_observer( const shared_ptr<index_observer>& ) = 0;
 
          virtual void               object_from_variant( const fc::variant& var, object& obj, uint32_t max_depth )const = 0;
          virtual void               object_default( object& obj )const = 0;
+
+         /** Estimate the memory held by the objects of this index, only the object count is known by default */
+         virtual index_memory_usage memory_usage()const
+         {
+            index_memory_usage result;
+            inspect_all_objects( [&result]( const object& ) { ++result.object_count; } );
+            return result;
+         }
+   };
+
+   /**
+    *  Maps an object type to the type of the index it is stored in (the type passed to primary_index<>).
+    *
+    *  When specialized with GRAPHENE_DEFINE_INDEX_TYPE, object_database::create() and object_database::modify()
+    *  resolve the index at compile time and call it directly, instead of going through the virtual
+    *  interface which takes a std::function.
+    */
+   template<typename ObjectType>
+   struct index_type_of
+   {
+      typedef void type;
    };
 
+   template<typename ObjectType>
+   struct has_static_index
+      : public std::integral_constant<bool, !std::is_void<typename index_type_of<ObjectType>::type>::value> {};
+
    class secondary_index
    {
       public:
@@ -142,6 +182,8 @@ namespace graphene { namespace db {
          virtual void object_removed( const object& obj ){};
          virtual void about_to_modify( const object& before ){};
          virtual void object_modified( const object& after  ){};
+         /** Estimate the memory held by this index, only its type name is known by default */
+         virtual secondary_index_memory_usage memory_usage()const;
    };
 
    /**
@@ -164,6 +206,9 @@ namespace graphene { namespace db {
          /** called just after obj is modified */
          void on_modify( const object& obj );
 
+         /** @return true if any secondary index or observer has to be told about changes */
+         bool has_listeners()const { return !_sindex.empty() || !_observers.empty(); }
+
          template<typename T>
          T* add_secondary_index()
          {
@@ -264,6 +309,7 @@ namespace graphene { namespace db {
             const auto& result = DerivedIndex::insert( fc::raw::unpack<object_type>( data ) );
             for( const auto& item : _sindex )
                item->object_inserted( result );
+            add_state_hash( result );
             return result;
          }
 
@@ -273,6 +319,7 @@ namespace graphene { namespace db {
             const auto& result = DerivedIndex::create( constructor );
             for( const auto& item : _sindex )
                item->object_inserted( result );
+            add_state_hash( result );
             on_add( result );
             return result;
          }
@@ -282,6 +329,7 @@ namespace graphene { namespace db {
             const auto& result = DerivedIndex::insert( std::move( obj ) );
             for( const auto& item : _sindex )
                item->object_inserted( result );
+            add_state_hash( result );
             on_add( result );
             return result;
          }
@@ -291,19 +339,75 @@ namespace graphene { namespace db {
             for( const auto& item : _sindex )
                item->object_removed( obj );
             on_remove(obj);
+            subtract_state_hash( obj );
             DerivedIndex::remove(obj);
          }
 
          virtual void modify( const object& obj, const std::function<void(object&)>& m )override
          {
             save_undo( obj );
+            subtract_state_hash( obj );
             for( const auto& item : _sindex )
                item->about_to_modify( obj );
             DerivedIndex::modify( obj, m );
             for( const auto& item : _sindex )
                item->object_modified( obj );
+            add_state_hash( obj );
+            on_modify( obj );
+         }
+
+         virtual void enable_state_hash( bool enabled ) override
+         {
+            _state_hash_enabled = enabled;
+            _state_hash = fc::uint128();
+            if( enabled )
+               this->inspect_all_objects( [this]( const object& o ) { _state_hash += o.hash(); } );
+         }
+         virtual bool        state_hash_enabled()const override { return _state_hash_enabled; }
+         virtual fc::uint128 state_hash()const override { return _state_hash; }
+
+         /**
+          *  Statically typed versions of create() and modify(), used by object_database when the
+          *  object type has been mapped to this index with GRAPHENE_DEFINE_INDEX_TYPE.
+          *  DerivedIndex must provide create_object() and modify_object().
+          */
+         /// @{
+         template<typename Constructor>
+         const object_type& create_object( const Constructor& constructor, bool undo_enabled )
+         {
+            const object_type& result = DerivedIndex::create_object( _next_id, constructor );
+            ++_next_id.number;
+            for( const auto& item : _sindex )
+               item->object_inserted( result );
+            add_state_hash( result );
+            if( undo_enabled )
+               on_add( result );
+            else
+               for( const auto& ob : _observers ) ob->on_add( result );
+            return result;
+         }
+
+         template<typename Lambda>
+         void modify_object( const object_type& obj, const Lambda& m, bool undo_enabled )
+         {
+            if( undo_enabled )
+               save_undo( obj );
+            subtract_state_hash( obj );
+            if( !has_listeners() )
+            {
+               DerivedIndex::modify_object( obj, m );
+               add_state_hash( obj );
+               return;
+            }
+            for( const auto& item : _sindex )
+               item->about_to_modify( obj );
+            DerivedIndex::modify_object( obj, m );
+            for( const auto& item : _sindex )
+               item->object_modified( obj );
+            add_state_hash( obj );
             on_modify( obj );
          }
+         /// @}
 
          virtual void add_observer( const shared_ptr<index_observer>& o ) override
          {
@@ -328,8 +432,41 @@ namespace graphene { namespace db {
             obj.id = id;
          }
 
+         virtual index_memory_usage memory_usage()const override
+         {
+            index_memory_usage result = DerivedIndex::memory_usage();
+            result.space_id = object_type::space_id;
+            result.type_id = object_type::type_id;
+            result.name = boost::core::demangle( typeid( object_type ).name() );
+            for( const auto& item : _sindex )
+               result.secondary_indexes.push_back( item->memory_usage() );
+            return result;
+         }
+
       private:
+         void add_state_hash( const object& obj )
+         {
+            if( _state_hash_enabled )
+               _state_hash += obj.hash();
+         }
+         void subtract_state_hash( const object& obj )
+         {
+            if( _state_hash_enabled )
+               _state_hash -= obj.hash();
+         }
+
          object_id_type _next_id;
+         bool           _state_hash_enabled = false;
+         fc::uint128    _state_hash;
    };
 
 } } // graphene::db
+
+/**
+ *  Declare that objects of type OBJECT are stored in primary_index<INDEX>, see graphene::db::index_type_of.
+ *  Must be used in the global namespace.
+ */
+#define GRAPHENE_DEFINE_INDEX_TYPE( OBJECT, INDEX ) \
+namespace graphene { namespace db { \
+   template<> struct index_type_of< OBJECT > { typedef INDEX type; }; \
+} }
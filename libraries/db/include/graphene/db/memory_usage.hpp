@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+#pragma once
+#include <fc/optional.hpp>
+#include <fc/reflect/reflect.hpp>
+#include <fc/static_variant.hpp>
+
+#include <boost/container/flat_map.hpp>
+#include <boost/container/flat_set.hpp>
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace graphene { namespace db {
+
+   /** Memory held by a secondary index */
+   struct secondary_index_memory_usage
+   {
+      std::string name;
+      /// number of keys the index maps
+      uint64_t    entry_count = 0;
+      uint64_t    heap_bytes = 0;
+   };
+
+   /**
+    *  Memory held by an index and its secondary indexes.  The figures are estimates: they assume that the
+    *  standard containers allocate one node per element and that every allocation costs what
+    *  heap_allocation_size() says.
+    */
+   struct index_memory_usage
+   {
+      uint8_t     space_id = 0;
+      uint8_t     type_id = 0;
+      /// type name of the objects
+      std::string name;
+      uint64_t    object_count = 0;
+      /// sizeof() of the objects times their number
+      uint64_t    object_bytes = 0;
+      /// heap memory owned by members of the objects, like the characters of long strings and container elements
+      uint64_t    dynamic_bytes = 0;
+      /// memory of the container the objects are stored in, other than the objects themselves
+      uint64_t    node_overhead_bytes = 0;
+      std::vector<secondary_index_memory_usage> secondary_indexes;
+
+      uint64_t total_bytes()const
+      {
+         uint64_t result = object_bytes + dynamic_bytes + node_overhead_bytes;
+         for( const auto& secondary : secondary_indexes )
+            result += secondary.heap_bytes;
+         return result;
+      }
+   };
+
+   /**
+    *  Approximate heap memory taken by an allocation of @p bytes bytes: a size field in front, rounded up to
+    *  a multiple of 16 bytes, 32 bytes at least, which is how glibc's malloc lays out its chunks.
+    */
+   inline uint64_t heap_allocation_size( uint64_t bytes )
+   {
+      if( bytes == 0 )
+         return 0;
+      return std::max<uint64_t>( ( bytes + sizeof(void*) + 15 ) / 16 * 16, 32 );
+   }
+
+   /// bookkeeping of a node of std::set and std::map besides the element: color and 3 pointers
+   const uint64_t tree_node_overhead = 4 * sizeof(void*);
+
+   /**
+    *  heap_size<T>::of( value ) estimates the heap memory owned by @p value, not counting sizeof( value ).
+    *  Reflected types add up their members, other types are assumed to own no heap memory unless
+    *  heap_size is specialized for them.
+    */
+   template<typename T, typename Enable = void>
+   struct heap_size;
+
+   template<typename T>
+   uint64_t heap_size_of( const T& value ) { return heap_size<T>::of( value ); }
+
+   namespace detail {
+      template<typename T>
+      struct heap_size_visitor
+      {
+         heap_size_visitor( const T& v, uint64_t& r ) : value( v ), result( r ) {}
+
+         template<typename Member, class Class, Member (Class::*member)>
+         void operator()( const char* )const { result += heap_size_of( value.*member ); }
+
+         const T&  value;
+         uint64_t& result;
+      };
+
+      template<typename T>
+      uint64_t reflected_heap_size( const T& value, std::true_type )
+      {
+         uint64_t result = 0;
+         fc::reflector<T>::visit( heap_size_visitor<T>( value, result ) );
+         return result;
+      }
+
+      template<typename T>
+      uint64_t reflected_heap_size( const T&, std::false_type ) { return 0; }
+
+      template<typename Container>
+      uint64_t elements_heap_size( const Container& container )
+      {
+         uint64_t result = 0;
+         for( const auto& element : container )
+            result += heap_size_of( element );
+         return result;
+      }
+
+      template<typename Container>
+      uint64_t tree_heap_size( const Container& container )
+      {
+         return container.size() * heap_allocation_size( sizeof( typename Container::value_type ) + tree_node_overhead )
+                + elements_heap_size( container );
+      }
+
+      template<typename Container>
+      uint64_t hash_table_heap_size( const Container& container )
+      {
+         // a node holds the element, the next pointer and the cached hash
+         return container.size() * heap_allocation_size( sizeof( typename Container::value_type ) + 2 * sizeof(void*) )
+                + heap_allocation_size( container.bucket_count() * sizeof(void*) )
+                + elements_heap_size( container );
+      }
+
+      struct static_variant_heap_size_visitor
+      {
+         typedef uint64_t result_type;
+         template<typename T>
+         uint64_t operator()( const T& value )const { return heap_size_of( value ); }
+      };
+   }
+
+   template<typename T, typename Enable>
+   struct heap_size
+   {
+      static uint64_t of( const T& value )
+      {
+         return detail::reflected_heap_size( value, std::integral_constant< bool,
+                    fc::reflector<T>::is_defined::value && !std::is_enum<T>::value >() );
+      }
+   };
+
+   template<typename... Rest>
+   struct heap_size< std::basic_string<char, Rest...> >
+   {
+      static uint64_t of( const std::basic_string<char, Rest...>& value )
+      {
+         // short strings are kept inside the string object
+         const char* data = value.data();
+         const char* self = reinterpret_cast<const char*>( &value );
+         if( value.capacity() == 0 || ( data >= self && data < self + sizeof( value ) ) )
+            return 0;
+         return heap_allocation_size( value.capacity() + 1 );
+      }
+   };
+
+   template<typename T, typename... Rest>
+   struct heap_size< std::vector<T, Rest...> >
+   {
+      static uint64_t of( const std::vector<T, Rest...>& value )
+      {
+         return heap_allocation_size( value.capacity() * sizeof( T ) ) + detail::elements_heap_size( value );
+      }
+   };
+
+   template<typename T, typename... Rest>
+   struct heap_size< boost::container::flat_set<T, Rest...> >
+   {
+      static uint64_t of( const boost::container::flat_set<T, Rest...>& value )
+      {
+         return heap_allocation_size( value.capacity() * sizeof( T ) ) + detail::elements_heap_size( value );
+      }
+   };
+
+   template<typename K, typename V, typename... Rest>
+   struct heap_size< boost::container::flat_map<K, V, Rest...> >
+   {
+      static uint64_t of( const boost::container::flat_map<K, V, Rest...>& value )
+      {
+         return heap_allocation_size( value.capacity() * sizeof( std::pair<K, V> ) ) + detail::elements_heap_size( value );
+      }
+   };
+
+   template<typename T, typename... Rest>
+   struct heap_size< std::set<T, Rest...> >
+   {
+      static uint64_t of( const std::set<T, Rest...>& value ) { return detail::tree_heap_size( value ); }
+   };
+
+   template<typename K, typename V, typename... Rest>
+   struct heap_size< std::map<K, V, Rest...> >
+   {
+      static uint64_t of( const std::map<K, V, Rest...>& value ) { return detail::tree_heap_size( value ); }
+   };
+
+   template<typename T, typename... Rest>
+   struct heap_size< std::unordered_set<T, Rest...> >
+   {
+      static uint64_t of( const std::unordered_set<T, Rest...>& value ) { return detail::hash_table_heap_size( value ); }
+   };
+
+   template<typename K, typename V, typename... Rest>
+   struct heap_size< std::unordered_map<K, V, Rest...> >
+   {
+      static uint64_t of( const std::unordered_map<K, V, Rest...>& value ) { return detail::hash_table_heap_size( value ); }
+   };
+
+   template<typename A, typename B>
+   struct heap_size< std::pair<A, B> >
+   {
+      static uint64_t of( const std::pair<A, B>& value ) { return heap_size_of( value.first ) + heap_size_of( value.second ); }
+   };
+
+   template<typename T>
+   struct heap_size< fc::optional<T> >
+   {
+      static uint64_t of( const fc::optional<T>& value ) { return value.valid() ? heap_size_of( *value ) : 0; }
+   };
+
+   template<typename... Types>
+   struct heap_size< fc::static_variant<Types...> >
+   {
+      static uint64_t of( const fc::static_variant<Types...>& value )
+      {
+         return value.visit( detail::static_variant_heap_size_visitor() );
+      }
+   };
+
+} } // graphene::db
+
+FC_REFLECT( graphene::db::secondary_index_memory_usage, (name)(entry_count)(heap_bytes) )
+FC_REFLECT( graphene::db::index_memory_usage,
+            (space_id)(type_id)(name)(object_count)(object_bytes)(dynamic_bytes)(node_overhead_bytes)
+            (secondary_indexes) )
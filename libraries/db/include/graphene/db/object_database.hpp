@@ -27,7 +27,9 @@
 #include <graphene/db/undo_database.hpp>
 
 #include <fc/log/logger.hpp>
+#include <fc/time.hpp>
 
+#include <functional>
 #include <map>
 
 namespace graphene { namespace db {
@@ -50,18 +52,39 @@ namespace graphene { namespace db {
           * Saves the complete state of the object_database to disk, this could take a while
           */
          void flush();
+
+         /**
+          * Starts saving the state like flush() does, without making the caller wait for it.  The process
+          * is forked and the child, which sees a copy-on-write image of the state as of this call, writes
+          * it out.  Where fork() is not available the state is saved before returning.
+          * @param prepare run in the child before saving, e.g. to undo changes which must not be saved;
+          * where fork() is not available and @p prepare is set nothing is saved, since the state of the
+          * caller cannot be changed
+          * @return false if the previous background flush is still running, nothing is started then
+          */
+         bool start_background_flush( const std::function<void()>& prepare = std::function<void()>() );
+         /**
+          * Reaps the background flush if it has finished, or waits for it with @p wait.
+          * @return true if no background flush is running any more
+          */
+         bool finish_background_flush( bool wait = false );
+         bool background_flush_in_progress()const { return _flush_pid != 0; }
+         /// @return false if the last background flush which finished did not save the state
+         bool last_background_flush_succeeded()const { return _flush_succeeded; }
+         /**
+          * Saves the complete state into @p dir, laid out like the object_database directory which open()
+          * reads from, so that another node can open it.
+          */
+         void export_indexes( const fc::path& dir );
+         /// Estimate the memory held by every index, in the order of their space and type ids
+         vector<index_memory_usage> get_index_memory_usage()const;
          void wipe(const fc::path& data_dir); // remove from disk
          void close();
 
          template<typename T, typename F>
          const T& create( F&& constructor )
          {
-            auto& idx = get_mutable_index<T>();
-            return static_cast<const T&>( idx.create( [&](object& o)
-            {
-               assert( dynamic_cast<T*>(&o) );
-               constructor( static_cast<T&>(o) );
-            } ));
+            return create<T>( constructor, has_static_index<T>() );
          }
 
          ///These methods are used to retrieve indexes on the object_database. All public index accessors are const-access only.
@@ -88,7 +111,7 @@ namespace graphene { namespace db {
          void          remove( const object& obj ) { get_mutable_index(obj.id).remove( obj ); }
          template<typename T, typename Lambda>
          void modify( const T& obj, const Lambda& m ) {
-            get_mutable_index(obj.id).modify(obj,m);
+            modify( obj, m, has_static_index<T>() );
          }
 
          ///@}
@@ -131,6 +154,9 @@ namespace graphene { namespace db {
          IndexType* add_index()
          {
             typedef typename IndexType::object_type ObjectType;
+            static_assert( !has_static_index<ObjectType>::value ||
+                           std::is_same< IndexType, primary_index< typename index_type_of<ObjectType>::type > >::value,
+                           "Index type does not match the one declared with GRAPHENE_DEFINE_INDEX_TYPE" );
             if( _index[ObjectType::space_id].size() <= ObjectType::type_id  )
                 _index[ObjectType::space_id].resize( 255 );
             assert(!_index[ObjectType::space_id][ObjectType::type_id]);
@@ -145,7 +171,7 @@ namespace graphene { namespace db {
             return get_mutable_index_type<IndexType>().template add_secondary_index<SecondaryIndexType, Args...>(args...);
          }
 
-         void pop_undo();
+         void pop_undo( redo_state* redo = nullptr );
 
          fc::path get_data_dir()const { return _data_dir; }
 
@@ -161,8 +187,48 @@ namespace graphene { namespace db {
          index& get_mutable_index()                   { return get_mutable_index(T::space_id,T::type_id); }
          index& get_mutable_index(object_id_type id)  { return get_mutable_index(id.space(),id.type());   }
          index& get_mutable_index(uint8_t space_id, uint8_t type_id);
+         /// @return all indexes added so far
+         vector<index*> get_mutable_indexes();
+
+         template<typename T>
+         primary_index< typename index_type_of<T>::type >& get_mutable_primary_index()
+         {
+            return static_cast< primary_index< typename index_type_of<T>::type >& >( get_mutable_index<T>() );
+         }
 
      private:
+         /// create() and modify() when the index of T is known at compile time
+         /// @{
+         template<typename T, typename F>
+         const T& create( const F& constructor, std::true_type )
+         {
+            return get_mutable_primary_index<T>().create_object( constructor, _undo_db.enabled() );
+         }
+         template<typename T, typename Lambda>
+         void modify( const T& obj, const Lambda& m, std::true_type )
+         {
+            get_mutable_primary_index<T>().modify_object( obj, m, _undo_db.enabled() );
+         }
+         /// @}
+
+         /// create() and modify() through the virtual index interface
+         /// @{
+         template<typename T, typename F>
+         const T& create( const F& constructor, std::false_type )
+         {
+            auto& idx = get_mutable_index<T>();
+            return static_cast<const T&>( idx.create( [&](object& o)
+            {
+               assert( dynamic_cast<T*>(&o) );
+               constructor( static_cast<T&>(o) );
+            } ));
+         }
+         template<typename T, typename Lambda>
+         void modify( const T& obj, const Lambda& m, std::false_type )
+         {
+            get_mutable_index(obj.id).modify(obj,m);
+         }
+         /// @}
 
          friend class base_primary_index;
          friend class undo_database;
@@ -170,7 +236,13 @@ namespace graphene { namespace db {
          void save_undo_add( const object& obj );
          void save_undo_remove( const object& obj );
 
+         void save_indexes();
+
          fc::path                                                  _data_dir;
+         /// process id of the child writing a background flush, 0 if none is running
+         int64_t                                                   _flush_pid = 0;
+         fc::time_point                                            _flush_start;
+         bool                                                      _flush_succeeded = true;
          vector< vector< unique_ptr<index> > >                     _index;
    };
 
@@ -59,6 +59,28 @@ namespace graphene { namespace db {
             modify_callback( *_objects[obj.id.instance()] );
          }
 
+         /// Statically typed create(), the caller is responsible for assigning the next id
+         template<typename Constructor>
+         const T& create_object( object_id_type id, const Constructor& constructor )
+         {
+             auto instance = id.instance();
+             if( instance >= _objects.size() ) _objects.resize( instance + 1 );
+             T* item = new T;
+             _objects[instance].reset( item );
+             item->id = id;
+             constructor( *item );
+             item->id = id; // just in case it changed
+             return *item;
+         }
+
+         /// Statically typed modify()
+         template<typename Lambda>
+         void modify_object( const T& obj, const Lambda& m )
+         {
+            assert( obj.id.instance() < _objects.size() );
+            m( static_cast<T&>( *_objects[obj.id.instance()] ) );
+         }
+
          virtual const object& insert( object&& obj )override
          {
             auto instance = obj.id.instance();
@@ -106,6 +128,23 @@ namespace graphene { namespace db {
             return result;
          }
 
+         virtual index_memory_usage memory_usage()const override
+         {
+            index_memory_usage result;
+            for( const auto& ptr : _objects )
+            {
+               if( !ptr )
+                  continue;
+               ++result.object_count;
+               result.dynamic_bytes += heap_size_of( static_cast<const T&>( *ptr ) );
+            }
+            result.object_bytes = result.object_count * sizeof( T );
+            // every object is allocated on its own and pointed to from the vector
+            result.node_overhead_bytes = result.object_count * ( heap_allocation_size( sizeof( T ) ) - sizeof( T ) )
+                                       + heap_allocation_size( _objects.capacity() * sizeof( unique_ptr<object> ) );
+            return result;
+         }
+
          class const_iterator
          {
             public:
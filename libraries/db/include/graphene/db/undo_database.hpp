@@ -40,6 +40,22 @@ namespace graphene { namespace db {
       unordered_map<object_id_type, unique_ptr<object> > removed;
    };
 
+   /**
+    * The forward change set of an undo state which has been popped.  Applying it to the state which
+    * pop_commit() left behind recreates the state as it was before the pop, without repeating the work
+    * which produced the changes in the first place.
+    */
+   struct redo_state
+   {
+      /// values of the objects modified by the popped state, as of the time it was popped
+      std::vector< unique_ptr<object> >              modified;
+      /// objects created by the popped state, ordered by id
+      std::vector< unique_ptr<object> >              created;
+      std::vector< object_id_type >                  removed;
+      /// next ids of every index the popped state allocated ids from
+      unordered_map<object_id_type, object_id_type>  index_next_ids;
+   };
+
 
    /**
     * @class undo_database
@@ -123,8 +139,18 @@ namespace graphene { namespace db {
           *  note... this is dangerous if there are
           *  active sessions... thus active sessions should
           *  track
+          *
+          *  If @p redo is given, the changes made by the popped state are captured into it before they
+          *  are undone, see redo().
+          */
+         void pop_commit( redo_state* redo = nullptr );
+
+         /**
+          *  Reapplies the changes captured by pop_commit().  The database must be in the state the pop
+          *  left it in, and a session must be active; the changes are recorded in it like any others,
+          *  so the redone state can be undone or popped again.  The objects are moved out of @p state.
           */
-         void pop_commit();
+         void redo( redo_state& state );
 
          std::size_t size()const { return _stack.size(); }
          void set_max_size(size_t new_max_size) { _max_size = new_max_size; }
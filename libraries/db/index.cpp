@@ -40,4 +40,11 @@ namespace graphene { namespace db {
 
    void base_primary_index::on_modify( const object& obj )
    {for( auto ob : _observers ) ob->on_modify(  obj ); }
+
+   secondary_index_memory_usage secondary_index::memory_usage()const
+   {
+      secondary_index_memory_usage result;
+      result.name = boost::core::demangle( typeid( *this ).name() );
+      return result;
+   }
 } } // graphene::chain
@@ -27,6 +27,13 @@
 #include <fc/container/flat.hpp>
 #include <fc/uint128.hpp>
 
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
 namespace graphene { namespace db {
 
 object_database::object_database()
@@ -36,10 +43,14 @@ object_database::object_database()
    _undo_db.enable();
 }
 
-object_database::~object_database(){}
+object_database::~object_database()
+{
+   finish_background_flush( true );
+}
 
 void object_database::close()
 {
+   finish_background_flush( true );
 }
 
 const object* object_database::find_object( object_id_type id )const
@@ -68,18 +79,114 @@ index& object_database::get_mutable_index(uint8_t space_id, uint8_t type_id)
    return *idx;
 }
 
+vector<index*> object_database::get_mutable_indexes()
+{
+   vector<index*> result;
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+         if( idx )
+            result.push_back( idx.get() );
+   return result;
+}
+
 void object_database::flush()
 {
-//   ilog("Save object_database in ${d}", ("d", _data_dir));
-   fc::create_directories( _data_dir / "object_database.tmp" / "lock" );
+   finish_background_flush( true );
+   save_indexes();
+}
+
+bool object_database::start_background_flush( const std::function<void()>& prepare )
+{
+   if( !finish_background_flush() )
+      return false;
+#ifndef _WIN32
+   pid_t pid = fork();
+   if( pid == 0 )
+   {
+      // The child only has this thread and a copy of the parent's memory.  It must not log, nor run
+      // destructors or atexit handlers which would touch the parent's files and threads.
+      int result = 0;
+      try {
+         if( prepare )
+            prepare();
+         save_indexes();
+      } catch( ... ) {
+         result = 1;
+      }
+      _exit( result );
+   }
+   if( pid > 0 )
+   {
+      _flush_pid = pid;
+      _flush_start = fc::time_point::now();
+      return true;
+   }
+   if( prepare )
+   {
+      wlog( "Unable to fork for a background flush (errno ${e}), skipping it", ("e",errno) );
+      return true;
+   }
+   wlog( "Unable to fork for a background flush (errno ${e}), flushing now", ("e",errno) );
+#else
+   if( prepare )
+      return true;
+#endif
+   save_indexes();
+   return true;
+}
+
+bool object_database::finish_background_flush( bool wait )
+{
+#ifndef _WIN32
+   if( _flush_pid == 0 )
+      return true;
+
+   int status = 0;
+   pid_t result;
+   do {
+      result = waitpid( pid_t(_flush_pid), &status, wait ? 0 : WNOHANG );
+   } while( result < 0 && errno == EINTR );
+   if( result == 0 )
+      return false;
+
+   _flush_succeeded = ( result == pid_t(_flush_pid) && WIFEXITED(status) && WEXITSTATUS(status) == 0 );
+   if( _flush_succeeded )
+      ilog( "Background flush of object database finished in ${t} ms",
+            ("t",(fc::time_point::now() - _flush_start).count() / 1000) );
+   else
+      elog( "Background flush of object database failed, status ${s}", ("s",status) );
+   _flush_pid = 0;
+#endif
+   return true;
+}
+
+void object_database::export_indexes( const fc::path& dir )
+{
    for( uint32_t space = 0; space < _index.size(); ++space )
    {
-      fc::create_directories( _data_dir / "object_database.tmp" / fc::to_string(space) );
+      fc::create_directories( dir / fc::to_string(space) );
       const auto types = _index[space].size();
       for( uint32_t type = 0; type  <  types; ++type )
          if( _index[space][type] )
-            _index[space][type]->save( _data_dir / "object_database.tmp" / fc::to_string(space)/fc::to_string(type) );
+            _index[space][type]->save( dir / fc::to_string(space)/fc::to_string(type) );
    }
+}
+
+vector<index_memory_usage> object_database::get_index_memory_usage()const
+{
+   vector<index_memory_usage> result;
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+         if( idx )
+            result.push_back( idx->memory_usage() );
+   return result;
+}
+
+void object_database::save_indexes()
+{
+//   ilog("Save object_database in ${d}", ("d", _data_dir));
+   fc::create_directories( _data_dir / "object_database.tmp" / "lock" );
+   export_indexes( _data_dir / "object_database.tmp" );
    fc::remove_all( _data_dir / "object_database.tmp" / "lock" );
    if( fc::exists( _data_dir / "object_database" ) )
       fc::rename( _data_dir / "object_database", _data_dir / "object_database.old" );
@@ -113,9 +220,9 @@ void object_database::open(const fc::path& data_dir)
 } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
 
 
-void object_database::pop_undo()
+void object_database::pop_undo( redo_state* redo )
 { try {
-   _undo_db.pop_commit();
+   _undo_db.pop_commit( redo );
 } FC_CAPTURE_AND_RETHROW() }
 
 void object_database::save_undo( const object& obj )
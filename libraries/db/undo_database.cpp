@@ -25,6 +25,8 @@
 #include <graphene/db/undo_database.hpp>
 #include <fc/reflect/variant.hpp>
 
+#include <algorithm>
+
 namespace graphene { namespace db {
 
 void undo_database::enable()  { _disabled = false; }
@@ -248,7 +250,7 @@ void undo_database::commit()
    --_active_sessions;
 }
 
-void undo_database::pop_commit()
+void undo_database::pop_commit( redo_state* redo )
 {
    FC_ASSERT( _active_sessions == 0 );
    FC_ASSERT( !_stack.empty() );
@@ -257,6 +259,27 @@ void undo_database::pop_commit()
    try {
       auto& state = _stack.back();
 
+      if( redo != nullptr )
+      {
+         redo->modified.reserve( state.old_values.size() );
+         for( auto& item : state.old_values )
+            redo->modified.push_back( _db.get_object( item.first ).clone() );
+
+         redo->created.reserve( state.new_ids.size() );
+         for( const auto& id : state.new_ids )
+            redo->created.push_back( _db.get_object( id ).clone() );
+         // insert them in the order they were created
+         std::sort( redo->created.begin(), redo->created.end(),
+                    []( const unique_ptr<object>& a, const unique_ptr<object>& b ) { return a->id < b->id; } );
+
+         redo->removed.reserve( state.removed.size() );
+         for( auto& item : state.removed )
+            redo->removed.push_back( item.first );
+
+         for( auto& item : state.old_index_next_ids )
+            redo->index_next_ids[item.first] = _db.get_index( item.first.space(), item.first.type() ).get_next_id();
+      }
+
       for( auto& item : state.old_values )
       {
          _db.modify( _db.get_object( item.second->id ), [&]( object& obj ){ obj.move_from( *item.second ); } );
@@ -285,6 +308,34 @@ void undo_database::pop_commit()
    }
    enable();
 }
+void undo_database::redo( redo_state& state )
+{ try {
+   FC_ASSERT( !_disabled );
+   FC_ASSERT( _active_sessions > 0 );
+
+   // Ids of objects which were created and removed again by the popped state show up only in the
+   // next ids, so record those here; on_create() would miss them.
+   auto& head = _stack.back();
+   for( auto& item : state.index_next_ids )
+   {
+      const auto& idx = _db.get_index( item.first.space(), item.first.type() );
+      if( head.old_index_next_ids.find( item.first ) == head.old_index_next_ids.end() )
+         head.old_index_next_ids[item.first] = idx.get_next_id();
+   }
+
+   for( const auto& id : state.removed )
+      _db.remove( _db.get_object( id ) );
+
+   for( auto& item : state.modified )
+      _db.modify( _db.get_object( item->id ), [&]( object& obj ){ obj.move_from( *item ); } );
+
+   for( auto& item : state.created )
+      _db.insert( std::move( *item ) );
+
+   for( auto& item : state.index_next_ids )
+      _db.get_mutable_index( item.first.space(), item.first.type() ).set_next_id( item.second );
+} FC_CAPTURE_AND_RETHROW() }
+
 const undo_state& undo_database::head()const
 {
    FC_ASSERT( !_stack.empty() );
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+#include <graphene/net/blockchain_synopsis.hpp>
+
+namespace graphene { namespace net {
+
+uint32_t block_id_cache::update( uint32_t first_block_num, uint32_t head_block_num, const item_hash_t& head_block_id,
+                                 const id_lookup_type& get_block_id_for_num )
+{
+   if( head_block_num < first_block_num )
+   {
+      _ids.clear();
+      _first_block_num = first_block_num;
+      return 0;
+   }
+   if( !_ids.empty() && head_block_num == _first_block_num + _ids.size() - 1 && _ids.back() == head_block_id
+       && first_block_num >= _first_block_num )
+   {
+      // only the last irreversible block moved
+      _ids.erase( _ids.begin(), _ids.begin() + ( first_block_num - _first_block_num ) );
+      _first_block_num = first_block_num;
+      return 0;
+   }
+
+   if( first_block_num < _first_block_num || _ids.empty() )
+      _ids.clear();
+   else
+      _ids.erase( _ids.begin(), _ids.begin() + std::min<size_t>( first_block_num - _first_block_num, _ids.size() ) );
+   _first_block_num = first_block_num;
+
+   uint32_t lookups = 0;
+   while( _ids.size() > head_block_num - first_block_num + 1 )
+      _ids.pop_back();
+   // a block id commits to all of its ancestors, so once the last cached id is still on the preferred
+   // chain, all of the window is
+   while( !_ids.empty() )
+   {
+      const uint32_t block_num = _first_block_num + _ids.size() - 1;
+      const item_hash_t id = block_num == head_block_num ? head_block_id : get_block_id_for_num( block_num );
+      if( block_num != head_block_num )
+         ++lookups;
+      if( id == _ids.back() )
+         break;
+      _ids.pop_back();
+   }
+   for( uint32_t block_num = _first_block_num + _ids.size(); block_num < head_block_num; ++block_num, ++lookups )
+      _ids.push_back( get_block_id_for_num( block_num ) );
+   if( _ids.size() < head_block_num - first_block_num + 1 )
+      _ids.push_back( head_block_id );
+   return lookups;
+}
+
+void append_synopsis_tail( std::vector<item_hash_t>& synopsis, uint32_t low_block_num,
+                           const boost::container::deque<item_hash_t>& ids_of_items_to_get, uint32_t first_block_num )
+{
+   if( ids_of_items_to_get.empty() )
+      return;
+   const uint32_t true_high_block_num = first_block_num + ids_of_items_to_get.size() - 1;
+   do
+   {
+      if( low_block_num >= first_block_num )
+         synopsis.push_back( ids_of_items_to_get[low_block_num - first_block_num] );
+      low_block_num += ( true_high_block_num - low_block_num + 2 ) / 2;
+   }
+   while( low_block_num <= true_high_block_num );
+}
+
+} } // graphene::net
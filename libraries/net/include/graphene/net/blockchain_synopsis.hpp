@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+#pragma once
+#include <graphene/net/core_messages.hpp>
+
+#include <boost/container/deque.hpp>
+
+#include <functional>
+#include <vector>
+
+namespace graphene { namespace net {
+
+   /**
+    *  Ids of the blocks of our preferred chain from the last irreversible block to the head, which
+    *  blockchain synopses are built from.
+    *
+    *  The window is maintained incrementally when the head or the last irreversible block changes:
+    *  blocks which became irreversible are dropped from the front, blocks of a chain we switched away
+    *  from are popped from the back and new blocks are appended.  Each block id is looked up about once
+    *  while it is in the window, instead of once per synopsis point per peer.
+    */
+   class block_id_cache
+   {
+      public:
+         typedef std::function<item_hash_t(uint32_t)> id_lookup_type;
+
+         /**
+          * Make the window cover blocks @p first_block_num to @p head_block_num of the preferred chain.
+          * @return number of ids looked up with @p get_block_id_for_num
+          */
+         uint32_t update( uint32_t first_block_num, uint32_t head_block_num, const item_hash_t& head_block_id,
+                          const id_lookup_type& get_block_id_for_num );
+
+         bool contains( uint32_t block_num )const
+         {
+            return block_num >= _first_block_num && block_num - _first_block_num < _ids.size();
+         }
+         /// @pre contains( block_num )
+         const item_hash_t& at( uint32_t block_num )const { return _ids[block_num - _first_block_num]; }
+
+         uint32_t first_block_num()const { return _first_block_num; }
+         size_t   size()const { return _ids.size(); }
+         void     clear() { _ids.clear(); }
+
+      private:
+         boost::container::deque<item_hash_t> _ids;
+         uint32_t                             _first_block_num = 0;
+   };
+
+   /**
+    * Complete a blockchain synopsis with the ids a peer has told us about but we haven't got yet.
+    *
+    * The points continue the walk which built @p synopsis, halving the distance to the last id in each
+    * step.  Points before the first id still in @p ids_of_items_to_get are skipped, so the peer's list
+    * may be read in place even if it was trimmed while the first part of the synopsis was generated.
+    *
+    * @param low_block_num the block number of the first point of @p synopsis, or 1 if it is empty
+    * @param first_block_num block number of the first id in @p ids_of_items_to_get
+    */
+   void append_synopsis_tail( std::vector<item_hash_t>& synopsis, uint32_t low_block_num,
+                              const boost::container::deque<item_hash_t>& ids_of_items_to_get, uint32_t first_block_num );
+
+} } // graphene::net
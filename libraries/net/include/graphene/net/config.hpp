@@ -81,6 +81,28 @@
 
 #define GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING      200
 
+/**
+ * During sync, the number of blocks requested from a peer at once adapts to how fast
+ * the peer delivers them, between these bounds and the maximum above.  A new peer
+ * starts with the initial window.
+ */
+#define GRAPHENE_NET_MIN_BLOCKS_PER_PEER_DURING_SYNCING      2
+#define GRAPHENE_NET_INITIAL_BLOCKS_PER_PEER_DURING_SYNCING  16
+
+/**
+ * The sync window of a peer is sized to hold about this much of the peer's
+ * measured throughput
+ */
+#define GRAPHENE_NET_SYNC_WINDOW_TARGET_MS                   2000
+
+/**
+ * A sync block is requested again from a faster peer once it has been outstanding
+ * for this many times the peer's smoothed request latency, and at least the minimum
+ * timeout
+ */
+#define GRAPHENE_NET_SYNC_STRAGGLER_LATENCY_MULTIPLE         4
+#define GRAPHENE_NET_SYNC_STRAGGLER_MIN_TIMEOUT_MS           2000
+
 /**
  * During normal operation, how many items will be fetched from each
  * peer at a time.  This will only come into play when the network
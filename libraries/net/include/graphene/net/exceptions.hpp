@@ -34,5 +34,6 @@ namespace graphene { namespace net {
    FC_DECLARE_DERIVED_EXCEPTION( block_older_than_undo_history,         graphene::net::net_exception, 90004, "block is older than our undo history allows us to process" );
    FC_DECLARE_DERIVED_EXCEPTION( peer_is_on_an_unreachable_fork,        graphene::net::net_exception, 90005, "peer is on another fork" );
    FC_DECLARE_DERIVED_EXCEPTION( unlinkable_block_exception,            graphene::net::net_exception, 90006, "unlinkable block" )
+   FC_DECLARE_DERIVED_EXCEPTION( unlinkable_block_buffered,             graphene::net::unlinkable_block_exception, 90007, "unlinkable block buffered until its predecessor arrives" )
 
 } }
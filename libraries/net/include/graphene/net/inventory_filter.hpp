@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+#pragma once
+#include <graphene/net/core_messages.hpp>
+#include <graphene/net/config.hpp>
+
+#include <fc/time.hpp>
+
+#include <array>
+#include <vector>
+
+namespace graphene { namespace net {
+
+   /**
+    *  Approximate set of recently seen items, such as the items a peer is known to have because we
+    *  advertised them to the peer or the peer advertised them to us.
+    *
+    *  Items are kept in a ring of bloom filters, one per time bucket.  An item is added to the newest
+    *  bucket and looked up in all of them; a bucket is recycled once it is older than the inventory
+    *  lifetime or holds items_per_bucket items, which forgets its items.  Lookups never miss an item
+    *  which was added and not forgotten, and wrongly report a foreign item about once in
+    *  FALSE_POSITIVE_INVERSE lookups per bucket.
+    */
+   class inventory_filter
+   {
+      public:
+         const static uint32_t BUCKET_COUNT = 4;
+         /// number of bit positions per item, optimal for the bits per item chosen in the constructor
+         const static uint32_t HASH_COUNT = 10;
+         const static uint32_t FALSE_POSITIVE_INVERSE = 1000;
+
+         /**
+          * @param items_per_bucket expected number of items added per bucket lifetime
+          * @param lifetime how long a bucket is kept after its first item was added, an item is remembered for
+          *                 at least (BUCKET_COUNT - 1) / BUCKET_COUNT of it unless its bucket fills up
+          */
+         explicit inventory_filter( uint32_t items_per_bucket = GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES * 60
+                                                                * GRAPHENE_NET_MAX_TRX_PER_SECOND / BUCKET_COUNT,
+                                    fc::microseconds lifetime = fc::minutes( GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES ) );
+
+         void insert( const item_id& item, fc::time_point now = fc::time_point::now() );
+         bool contains( const item_id& item, fc::time_point now = fc::time_point::now() )const;
+         void clear();
+
+         /// number of items added to the buckets which have not expired at @p now
+         uint32_t size( fc::time_point now = fc::time_point::now() )const;
+         /// bytes allocated for the buckets
+         size_t   memory_usage()const;
+
+      private:
+         struct bucket
+         {
+            /// allocated when the first item is added
+            std::vector<uint64_t> bits;
+            fc::time_point        start;
+            uint32_t              count = 0;
+         };
+
+         std::array<uint64_t, HASH_COUNT> bit_positions( const item_id& item )const;
+         bool is_expired( const bucket& b, fc::time_point now )const;
+         /// recycle buckets until the newest one can take another item at @p now
+         void rotate( fc::time_point now );
+
+         std::array<bucket, BUCKET_COUNT> _buckets;
+         uint32_t                         _newest = 0;
+         uint32_t                         _items_per_bucket;
+         /// bits per bucket minus one, the number of bits is a power of two
+         uint64_t                         _bit_mask;
+         fc::microseconds                 _bucket_lifetime;
+   };
+
+} } // graphene::net
@@ -29,6 +29,8 @@
 #include <fc/crypto/ripemd160.hpp>
 #include <fc/reflect/variant.hpp>
 
+#include <memory>
+
 namespace graphene { namespace net {
 
   /**
@@ -108,8 +110,8 @@ namespace graphene { namespace net {
      }
   };
 
-
-
+  /// an immutable message body which is shared by the caches and send queues holding it
+  typedef std::shared_ptr<const message> shared_message;
 
 } } // graphene::net
 
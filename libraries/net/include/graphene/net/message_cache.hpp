@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+#pragma once
+#include <graphene/net/message.hpp>
+#include <graphene/net/node.hpp>
+#include <graphene/net/config.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+namespace graphene { namespace net {
+
+   /**
+    *  Cache of the messages we have received and might be required to provide to other peers via
+    *  inventory requests.  A message is kept for cache_duration_in_blocks accepted blocks.
+    *
+    *  Messages are hashed by message hash and by contents hash, and each one is also listed in the
+    *  bucket of the block clock it was received at.  The buckets form a ring, so expiring the messages
+    *  of a block clears one bucket without searching for them.
+    */
+   class blockchain_tied_message_cache
+   {
+      public:
+         explicit blockchain_tied_message_cache( uint32_t cache_duration_in_blocks = GRAPHENE_NET_MESSAGE_CACHE_DURATION_IN_BLOCKS );
+
+         /// advance the block clock and expire the messages which were received too many blocks ago
+         void block_accepted();
+
+         /// does nothing if a message with the same hash is cached already
+         void cache_message( shared_message message_to_cache, const message_hash_type& hash_of_message_to_cache,
+                             const message_propagation_data& propagation_data, const fc::uint160_t& message_content_hash );
+         void cache_message( const message& message_to_cache, const message_hash_type& hash_of_message_to_cache,
+                             const message_propagation_data& propagation_data, const fc::uint160_t& message_content_hash );
+
+         /// @throws fc::key_not_found_exception if the message is not cached
+         shared_message get_message( const message_hash_type& hash_of_message_to_lookup )const;
+         /// @throws fc::key_not_found_exception if no message with these contents is cached
+         message_propagation_data get_message_propagation_data( const fc::uint160_t& hash_of_message_contents_to_lookup )const;
+
+         size_t   size()const { return _messages.size(); }
+         uint32_t block_clock()const { return _block_clock; }
+
+      private:
+         struct message_info
+         {
+            shared_message           message_body;
+            message_propagation_data propagation_data;
+            /// hash of whatever the message contains (if it's a transaction, this is the transaction id, if it's a block, it's the block_id)
+            fc::uint160_t            message_contents_hash;
+         };
+
+         const uint32_t                                             _cache_duration_in_blocks;
+         std::unordered_map<message_hash_type, message_info>        _messages;
+         /// contents hash to the hash of the most recent message cached with these contents
+         std::unordered_map<fc::uint160_t, message_hash_type>       _messages_by_contents;
+         /// hashes of the messages received at each block clock still cached, indexed by block clock modulo their count
+         std::vector<std::vector<message_hash_type>>                _buckets;
+         uint32_t                                                   _block_clock = 0;
+   };
+
+} } // graphene::net
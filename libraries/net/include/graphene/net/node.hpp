@@ -26,6 +26,7 @@
 #include <graphene/net/core_messages.hpp>
 #include <graphene/net/message.hpp>
 #include <graphene/net/peer_database.hpp>
+#include <graphene/net/sync_scheduler.hpp>
 
 #include <graphene/chain/protocol/types.hpp>
 
@@ -289,6 +290,8 @@ namespace graphene { namespace net {
         fc::variant_object network_get_usage_stats() const;
 
         std::vector<potential_peer_record> get_potential_peers() const;
+        /// throughput and latency of the peers we are fetching sync blocks from
+        std::vector<sync_peer_stats> get_sync_peer_stats() const;
 
         void disable_peer_advertising();
         fc::variant_object get_call_statistics() const;
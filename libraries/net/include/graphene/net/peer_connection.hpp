@@ -28,6 +28,8 @@
 #include <graphene/net/message_oriented_connection.hpp>
 #include <graphene/net/stcp_socket.hpp>
 #include <graphene/net/config.hpp>
+#include <graphene/net/inventory_filter.hpp>
+#include <graphene/net/sync_scheduler.hpp>
 
 #include <boost/tuple/tuple.hpp>
 
@@ -68,7 +70,7 @@ namespace graphene { namespace net
       virtual void on_message(peer_connection* originating_peer,
                               const message& received_message) = 0;
       virtual void on_connection_closed(peer_connection* originating_peer) = 0;
-      virtual message get_message_for_item(const item_id& item) = 0;
+      virtual shared_message get_message_for_item(const item_id& item) = 0;
     };
 
     class peer_connection;
@@ -123,7 +125,7 @@ namespace graphene { namespace net
           enqueue_time(enqueue_time)
         {}
 
-        virtual message get_message(peer_connection_delegate* node) = 0;
+        virtual shared_message get_message(peer_connection_delegate* node) = 0;
         /** returns roughly the number of bytes of memory the message is consuming while
          * it is sitting on the queue
          */
@@ -136,16 +138,31 @@ namespace graphene { namespace net
        */
       struct real_queued_message : queued_message
       {
-        message        message_to_send;
-        size_t         message_send_time_field_offset;
+        std::shared_ptr<message> message_to_send;
+        size_t                   message_send_time_field_offset;
 
         real_queued_message(message message_to_send,
                             size_t message_send_time_field_offset = (size_t)-1) :
-          message_to_send(std::move(message_to_send)),
+          message_to_send(std::make_shared<message>(std::move(message_to_send))),
           message_send_time_field_offset(message_send_time_field_offset)
         {}
 
-        message get_message(peer_connection_delegate* node) override;
+        shared_message get_message(peer_connection_delegate* node) override;
+        size_t get_size_in_queue() override;
+      };
+
+      /* when you queue up a 'shared_queued_message', the queue shares the message body
+       * with its other holders, typically the message cache, instead of copying it
+       */
+      struct shared_queued_message : queued_message
+      {
+        shared_message message_to_send;
+
+        shared_queued_message(shared_message message_to_send) :
+          message_to_send(std::move(message_to_send))
+        {}
+
+        shared_message get_message(peer_connection_delegate* node) override;
         size_t get_size_in_queue() override;
       };
 
@@ -161,7 +178,7 @@ namespace graphene { namespace net
           item_to_send(std::move(item_to_send))
         {}
 
-        message get_message(peer_connection_delegate* node) override;
+        shared_message get_message(peer_connection_delegate* node) override;
         size_t get_size_in_queue() override;
       };
 
@@ -228,6 +245,7 @@ namespace graphene { namespace net
       fc::optional<boost::tuple<std::vector<item_hash_t>, fc::time_point> > item_ids_requested_from_peer; /// we check this to detect a timed-out request and in busy()
       fc::time_point last_sync_item_received_time; /// the time we received the last sync item or the time we sent the last batch of sync item requests to this peer
       std::set<item_hash_t> sync_items_requested_from_peer; /// ids of blocks we've requested from this peer during sync.  fetch from another peer if this peer disconnects
+      sync_peer_tracker sync_performance; /// how fast this peer answers sync block requests, sizes how many we send it at once
       item_hash_t last_block_delegate_has_seen; /// the hash of the last block  this peer has told us about that the peer knows
       fc::time_point_sec last_block_time_delegate_has_seen;
       bool inhibit_fetching_sync_blocks;
@@ -250,8 +268,12 @@ namespace graphene { namespace net
                                                                                                             std::hash<item_id> >,
                                                                           boost::multi_index::ordered_non_unique<boost::multi_index::tag<timestamp_index>,
                                                                                                                  boost::multi_index::member<timestamped_item_id, fc::time_point_sec, &timestamped_item_id::timestamp> > > > timestamped_items_set_type;
-      timestamped_items_set_type inventory_peer_advertised_to_us;
-      timestamped_items_set_type inventory_advertised_to_peer;
+      /// approximate set of items this peer advertised to us, we fetch them from it
+      inventory_filter           inventory_peer_advertised_to_us;
+      /// items this peer advertised to us but then said it doesn't have, we don't ask it for them again
+      inventory_filter           inventory_not_available_from_peer;
+      /// approximate set of items we advertised to this peer or it advertised to us, so we don't advertise them (again)
+      inventory_filter           known_inventory;
 
       item_to_time_map_type items_requested_from_peer;  /// items we've requested from this peer during normal operation.  fetch from another peer if this peer disconnects
       /// @}
@@ -287,6 +309,7 @@ namespace graphene { namespace net
 
       void send_queueable_message(std::unique_ptr<queued_message>&& message_to_send);
       void send_message(const message& message_to_send, size_t message_send_time_field_offset = (size_t)-1);
+      void send_message(shared_message message_to_send);
       void send_item(const item_id& item_to_send);
       void close_connection();
       void destroy_connection();
@@ -307,7 +330,8 @@ namespace graphene { namespace net
 
       bool is_transaction_fetching_inhibited() const;
       fc::sha512 get_shared_secret() const;
-      void clear_old_inventory();
+      /// true if the peer advertised @p item to us recently and did not tell us it doesn't have it
+      bool may_have_item(const item_id& item) const;
       bool is_inventory_advertised_to_us_list_full_for_transactions() const;
       bool is_inventory_advertised_to_us_list_full() const;
       bool performing_firewall_check() const;
@@ -32,6 +32,10 @@
 #include <fc/exception/exception.hpp>
 #include <fc/io/raw.hpp>
 
+#include <graphene/net/config.hpp>
+
+#include <functional>
+
 namespace graphene { namespace net {
 
   enum potential_peer_last_connection_disposition
@@ -52,6 +56,10 @@ namespace graphene { namespace net {
     uint32_t                          number_of_successful_connection_attempts;
     uint32_t                          number_of_failed_connection_attempts;
     fc::optional<fc::exception>       last_error;
+    /// round trip delay measured during the last connection, 0 if unknown
+    uint32_t                          round_trip_delay_ms = 0;
+    /// average rate we received data at during the last connection
+    uint32_t                          bytes_per_second_received = 0;
 
     potential_peer_record() :
       number_of_successful_connection_attempts(0),
@@ -66,6 +74,14 @@ namespace graphene { namespace net {
       number_of_successful_connection_attempts(0),
       number_of_failed_connection_attempts(0)
     {}  
+
+    /**
+     * How much we'd like to connect to this peer, higher is better.  Measured in minutes of
+     * last_seen_time: a failed connection attempt in excess of the successful ones costs an hour,
+     * 100 ms of round trip delay cost a minute, and each doubling of the observed bandwidth is worth
+     * five minutes.
+     */
+    int64_t connection_score() const;
   };
 
   namespace detail
@@ -98,7 +114,13 @@ namespace graphene { namespace net {
     peer_database();
     ~peer_database();
 
-    void open(const fc::path& databaseFilename);
+    /**
+     * Load the database from @p databaseFilename and log further changes to it.  If the file doesn't
+     * exist, the peers of the JSON file with the same name and a .json extension are imported.  When
+     * more than @p maximum_size peers are loaded, the ones with the lowest score are dropped.
+     */
+    void open(const fc::path& databaseFilename, size_t maximum_size = MAXIMUM_PEERDB_SIZE);
+    /// rewrite the file with the current peers and stop logging changes
     void close();
     void clear();
 
@@ -108,6 +130,14 @@ namespace graphene { namespace net {
     potential_peer_record lookup_or_create_entry_for_endpoint(const fc::ip::endpoint& endpointToLookup);
     fc::optional<potential_peer_record> lookup_entry_for_endpoint(const fc::ip::endpoint& endpointToLookup);
 
+    /**
+     * Returns up to @p limit peers to connect to, highest connection_score() first.  Peers whose last
+     * connection failed less than (number_of_failed_connection_attempts + 1) * @p retry_timeout_sec
+     * seconds before @p now are skipped, as are those @p skip returns true for.
+     */
+    std::vector<potential_peer_record> get_connection_candidates(uint32_t limit, fc::time_point now, uint32_t retry_timeout_sec,
+                                                                 const std::function<bool(const fc::ip::endpoint&)>& skip) const;
+
     typedef detail::peer_database_iterator iterator;
     iterator begin() const;
     iterator end() const;
@@ -119,4 +149,4 @@ namespace graphene { namespace net {
 } } // end namespace graphene::net
 
 FC_REFLECT_ENUM(graphene::net::potential_peer_last_connection_disposition, (never_attempted_to_connect)(last_connection_failed)(last_connection_rejected)(last_connection_handshaking_failed)(last_connection_succeeded))
-FC_REFLECT(graphene::net::potential_peer_record, (endpoint)(last_seen_time)(last_connection_disposition)(last_connection_attempt_time)(number_of_successful_connection_attempts)(number_of_failed_connection_attempts)(last_error) )
+FC_REFLECT(graphene::net::potential_peer_record, (endpoint)(last_seen_time)(last_connection_disposition)(last_connection_attempt_time)(number_of_successful_connection_attempts)(number_of_failed_connection_attempts)(last_error)(round_trip_delay_ms)(bytes_per_second_received) )
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+#pragma once
+#include <graphene/net/core_messages.hpp>
+#include <graphene/net/config.hpp>
+
+#include <fc/network/ip.hpp>
+#include <fc/time.hpp>
+
+#include <boost/container/deque.hpp>
+
+#include <functional>
+#include <unordered_set>
+#include <vector>
+
+namespace graphene { namespace net {
+
+   /** How quickly a peer has been answering our requests for sync blocks */
+   struct sync_peer_stats
+   {
+      fc::ip::endpoint host;
+      uint64_t         blocks_received = 0;
+      uint64_t         bytes_received = 0;
+      /// smoothed rate at which the peer delivers blocks while it has requests outstanding
+      uint64_t         bytes_per_second = 0;
+      /// smoothed time between requesting a block and receiving it
+      uint32_t         latency_ms = 0;
+      /// number of blocks we are currently willing to have outstanding with the peer
+      uint32_t         window = 0;
+      uint32_t         blocks_outstanding = 0;
+      /// blocks which took too long and were requested again from a faster peer
+      uint64_t         blocks_rerequested = 0;
+   };
+
+   /**
+    *  Per-peer bookkeeping for the sync block scheduler.
+    *
+    *  The tracker measures the peer's throughput and request latency from the blocks it delivers, and
+    *  sizes the number of requests we keep outstanding with it from those: enough to keep about
+    *  GRAPHENE_NET_SYNC_WINDOW_TARGET_MS worth of blocks in flight, additively increased while blocks
+    *  arrive in time and halved whenever a request has to be handed to another peer.
+    */
+   class sync_peer_tracker
+   {
+      public:
+         void set_max_window( uint32_t max_window );
+
+         void block_requested( const item_hash_t& block_id, fc::time_point now );
+         /// @return false if the block was not outstanding with this peer
+         bool block_received( const item_hash_t& block_id, uint32_t size, fc::time_point now );
+         /// Forget a request which will not be answered
+         void request_cancelled( const item_hash_t& block_id );
+         /// Note that an outstanding request has been sent to another peer as well
+         void straggler_rerequested( const item_hash_t& block_id );
+
+         uint32_t window()const;
+         uint32_t outstanding()const { return _outstanding.size(); }
+         uint32_t free_slots()const;
+         uint64_t bytes_per_second()const;
+         /// How long a request may be outstanding before another peer is asked for the block
+         fc::microseconds straggler_timeout()const;
+         /// Outstanding requests older than straggler_timeout() which were not yet re-requested, oldest first
+         std::vector<item_hash_t> get_stragglers( fc::time_point now )const;
+
+         sync_peer_stats get_stats()const;
+
+      private:
+         struct outstanding_request
+         {
+            item_hash_t    block_id;
+            fc::time_point request_time;
+            bool           rerequested;
+         };
+         std::vector<outstanding_request> _outstanding; ///< in the order requested
+
+         uint32_t       _max_window = GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING;
+         uint32_t       _window_limit = GRAPHENE_NET_INITIAL_BLOCKS_PER_PEER_DURING_SYNCING;
+         fc::time_point _last_block_time;
+         /// bytes received and time spent receiving them, decayed so that recent blocks dominate
+         uint64_t       _busy_bytes = 0;
+         int64_t        _busy_us = 0;
+         int64_t        _latency_us = 0;
+         /// closest we have seen to the bare round trip time
+         int64_t        _min_latency_us = 0;
+         uint64_t       _blocks_received = 0;
+         uint64_t       _bytes_received = 0;
+         uint64_t       _blocks_rerequested = 0;
+   };
+
+   /** A syncing peer as seen by schedule_sync_requests() */
+   struct sync_peer_candidate
+   {
+      sync_peer_tracker*                           tracker;
+      /// ids of the blocks the peer has and we don't, in blockchain order
+      const boost::container::deque<item_hash_t>* ids_of_items_to_get;
+      /// false if no new requests may be sent to the peer right now
+      bool                                         can_request;
+   };
+
+   /**
+    * Decide which sync blocks to request from which peers.
+    *
+    * Peers are served fastest first, so that the blocks the backlog is waiting for next come from the
+    * peers most likely to deliver them soon, and each peer gets as many requests as its window has room
+    * for.  Requests which have been outstanding longer than their peer's straggler timeout are sent once
+    * more to a faster peer that has the block.
+    *
+    * @param already_requested true for blocks which are on hand or outstanding with some peer
+    * @param rerequested ids of blocks outstanding with two peers; the re-requests scheduled here are added
+    * @return for each of @p peers, the ids to request from it
+    */
+   std::vector<std::vector<item_hash_t>> schedule_sync_requests( const std::vector<sync_peer_candidate>& peers,
+                                                                 const std::function<bool(const item_hash_t&)>& already_requested,
+                                                                 std::unordered_set<item_hash_t>& rerequested,
+                                                                 uint32_t max_window, fc::time_point now );
+
+} } // graphene::net
+
+FC_REFLECT( graphene::net::sync_peer_stats,
+            (host)(blocks_received)(bytes_received)(bytes_per_second)(latency_ms)(window)(blocks_outstanding)
+            (blocks_rerequested) )
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+#include <graphene/net/inventory_filter.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace net {
+
+inventory_filter::inventory_filter( uint32_t items_per_bucket, fc::microseconds lifetime )
+   : _items_per_bucket( std::max( items_per_bucket, 1u ) ),
+     _bucket_lifetime( lifetime.count() / BUCKET_COUNT )
+{
+   // about 14.4 bits per item with HASH_COUNT positions give one false positive in FALSE_POSITIVE_INVERSE,
+   // rounded up to a power of two so that positions are found with a mask
+   const uint64_t wanted_bits = uint64_t( _items_per_bucket ) * 144 / 10;
+   uint64_t bits = 64;
+   while( bits < wanted_bits )
+      bits <<= 1;
+   _bit_mask = bits - 1;
+}
+
+std::array<uint64_t, inventory_filter::HASH_COUNT> inventory_filter::bit_positions( const item_id& item )const
+{
+   // item hashes are uniformly distributed already, derive the positions from two of their words by
+   // double hashing
+   const uint32_t* words = item.item_hash._hash;
+   const uint64_t h1 = ( ( uint64_t( words[0] ) << 32 ) | words[1] ) ^ ( uint64_t( item.item_type ) * 0x9e3779b97f4a7c15ULL );
+   const uint64_t h2 = ( ( uint64_t( words[2] ) << 32 ) | words[3] ) | 1;
+   std::array<uint64_t, HASH_COUNT> result;
+   for( uint32_t i = 0; i < HASH_COUNT; ++i )
+      result[i] = ( h1 + i * h2 ) & _bit_mask;
+   return result;
+}
+
+bool inventory_filter::is_expired( const bucket& b, fc::time_point now )const
+{
+   return b.count == 0 || now - b.start >= fc::microseconds( _bucket_lifetime.count() * BUCKET_COUNT );
+}
+
+void inventory_filter::rotate( fc::time_point now )
+{
+   bucket& newest = _buckets[_newest];
+   if( newest.count > 0 && newest.count < _items_per_bucket && now - newest.start < _bucket_lifetime )
+      return;
+   if( newest.count > 0 )
+      _newest = ( _newest + 1 ) % BUCKET_COUNT;
+
+   bucket& next = _buckets[_newest];
+   if( next.bits.empty() )
+      next.bits.resize( ( _bit_mask + 1 ) / 64 );
+   else if( next.count > 0 )
+      std::fill( next.bits.begin(), next.bits.end(), 0 );
+   next.count = 0;
+   next.start = now;
+}
+
+void inventory_filter::insert( const item_id& item, fc::time_point now )
+{
+   rotate( now );
+   bucket& newest = _buckets[_newest];
+   for( uint64_t pos : bit_positions( item ) )
+      newest.bits[pos >> 6] |= uint64_t(1) << ( pos & 63 );
+   ++newest.count;
+}
+
+bool inventory_filter::contains( const item_id& item, fc::time_point now )const
+{
+   const auto positions = bit_positions( item );
+   for( const bucket& b : _buckets )
+   {
+      if( is_expired( b, now ) )
+         continue;
+      bool found = true;
+      for( uint64_t pos : positions )
+      {
+         if( ( b.bits[pos >> 6] & ( uint64_t(1) << ( pos & 63 ) ) ) == 0 )
+         {
+            found = false;
+            break;
+         }
+      }
+      if( found )
+         return true;
+   }
+   return false;
+}
+
+void inventory_filter::clear()
+{
+   for( bucket& b : _buckets )
+   {
+      b.bits.clear();
+      b.bits.shrink_to_fit();
+      b.count = 0;
+   }
+   _newest = 0;
+}
+
+uint32_t inventory_filter::size( fc::time_point now )const
+{
+   uint32_t result = 0;
+   for( const bucket& b : _buckets )
+      if( !is_expired( b, now ) )
+         result += b.count;
+   return result;
+}
+
+size_t inventory_filter::memory_usage()const
+{
+   size_t result = 0;
+   for( const bucket& b : _buckets )
+      result += b.bits.capacity() * sizeof(uint64_t);
+   return result;
+}
+
+} } // graphene::net
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+#include <graphene/net/message_cache.hpp>
+
+#include <fc/exception/exception.hpp>
+
+namespace graphene { namespace net {
+
+blockchain_tied_message_cache::blockchain_tied_message_cache( uint32_t cache_duration_in_blocks )
+   : _cache_duration_in_blocks( cache_duration_in_blocks ),
+     // the messages of the current block clock and of the cache_duration_in_blocks before it
+     _buckets( cache_duration_in_blocks + 1 )
+{}
+
+void blockchain_tied_message_cache::block_accepted()
+{
+   ++_block_clock;
+   // the bucket of the new block clock held the messages which are now one block too old
+   std::vector<message_hash_type>& expired = _buckets[_block_clock % _buckets.size()];
+   for( const message_hash_type& hash : expired )
+   {
+      auto itr = _messages.find( hash );
+      if( itr == _messages.end() )
+         continue;
+      auto contents_itr = _messages_by_contents.find( itr->second.message_contents_hash );
+      if( contents_itr != _messages_by_contents.end() && contents_itr->second == hash )
+         _messages_by_contents.erase( contents_itr );
+      _messages.erase( itr );
+   }
+   expired.clear();
+}
+
+void blockchain_tied_message_cache::cache_message( shared_message message_to_cache,
+                                                   const message_hash_type& hash_of_message_to_cache,
+                                                   const message_propagation_data& propagation_data,
+                                                   const fc::uint160_t& message_content_hash )
+{
+   message_info info{ std::move( message_to_cache ), propagation_data, message_content_hash };
+   if( !_messages.emplace( hash_of_message_to_cache, std::move( info ) ).second )
+      return;
+   _buckets[_block_clock % _buckets.size()].push_back( hash_of_message_to_cache );
+   if( message_content_hash != fc::uint160_t() )
+      _messages_by_contents[message_content_hash] = hash_of_message_to_cache;
+}
+
+void blockchain_tied_message_cache::cache_message( const message& message_to_cache,
+                                                   const message_hash_type& hash_of_message_to_cache,
+                                                   const message_propagation_data& propagation_data,
+                                                   const fc::uint160_t& message_content_hash )
+{
+   if( _messages.find( hash_of_message_to_cache ) != _messages.end() )
+      return;
+   cache_message( std::make_shared<const message>( message_to_cache ), hash_of_message_to_cache,
+                  propagation_data, message_content_hash );
+}
+
+shared_message blockchain_tied_message_cache::get_message( const message_hash_type& hash_of_message_to_lookup )const
+{
+   auto itr = _messages.find( hash_of_message_to_lookup );
+   if( itr != _messages.end() )
+      return itr->second.message_body;
+   FC_THROW_EXCEPTION( fc::key_not_found_exception, "Requested message not in cache" );
+}
+
+message_propagation_data blockchain_tied_message_cache::get_message_propagation_data( const fc::uint160_t& hash_of_message_contents_to_lookup )const
+{
+   if( hash_of_message_contents_to_lookup != fc::uint160_t() )
+   {
+      auto itr = _messages_by_contents.find( hash_of_message_contents_to_lookup );
+      if( itr != _messages_by_contents.end() )
+         return _messages.at( itr->second ).propagation_data;
+   }
+   FC_THROW_EXCEPTION( fc::key_not_found_exception, "Requested message not in cache" );
+}
+
+} } // graphene::net
@@ -74,6 +74,9 @@
 #include <graphene/net/node.hpp>
 #include <graphene/net/peer_database.hpp>
 #include <graphene/net/peer_connection.hpp>
+#include <graphene/net/message_cache.hpp>
+#include <graphene/net/blockchain_synopsis.hpp>
+#include <graphene/net/sync_scheduler.hpp>
 #include <graphene/net/stcp_socket.hpp>
 #include <graphene/net/config.hpp>
 #include <graphene/net/exceptions.hpp>
@@ -126,104 +129,6 @@ namespace graphene { namespace net {
 
   namespace detail
   {
-    namespace bmi = boost::multi_index;
-    class blockchain_tied_message_cache
-    {
-    private:
-      static const uint32_t cache_duration_in_blocks = GRAPHENE_NET_MESSAGE_CACHE_DURATION_IN_BLOCKS;
-
-      struct message_hash_index{};
-      struct message_contents_hash_index{};
-      struct block_clock_index{};
-      struct message_info
-      {
-        message_hash_type message_hash;
-        message           message_body;
-        uint32_t          block_clock_when_received;
-
-        // for network performance stats
-        message_propagation_data propagation_data;
-        fc::uint160_t     message_contents_hash; // hash of whatever the message contains (if it's a transaction, this is the transaction id, if it's a block, it's the block_id)
-
-        message_info( const message_hash_type& message_hash,
-                      const message&           message_body,
-                      uint32_t                 block_clock_when_received,
-                      const message_propagation_data& propagation_data,
-                      fc::uint160_t            message_contents_hash ) :
-          message_hash( message_hash ),
-          message_body( message_body ),
-          block_clock_when_received( block_clock_when_received ),
-          propagation_data( propagation_data ),
-          message_contents_hash( message_contents_hash )
-        {}
-      };
-      typedef boost::multi_index_container
-        < message_info,
-            bmi::indexed_by< bmi::ordered_unique< bmi::tag<message_hash_index>,
-                                                  bmi::member<message_info, message_hash_type, &message_info::message_hash> >,
-                             bmi::ordered_non_unique< bmi::tag<message_contents_hash_index>,
-                                                      bmi::member<message_info, fc::uint160_t, &message_info::message_contents_hash> >,
-                             bmi::ordered_non_unique< bmi::tag<block_clock_index>,
-                                                      bmi::member<message_info, uint32_t, &message_info::block_clock_when_received> > >
-        > message_cache_container;
-
-      message_cache_container _message_cache;
-
-      uint32_t block_clock;
-
-    public:
-      blockchain_tied_message_cache() :
-        block_clock( 0 )
-      {}
-      void block_accepted();
-      void cache_message( const message& message_to_cache, const message_hash_type& hash_of_message_to_cache,
-                        const message_propagation_data& propagation_data, const fc::uint160_t& message_content_hash );
-      message get_message( const message_hash_type& hash_of_message_to_lookup );
-      message_propagation_data get_message_propagation_data( const fc::uint160_t& hash_of_message_contents_to_lookup ) const;
-      size_t size() const { return _message_cache.size(); }
-    };
-
-    void blockchain_tied_message_cache::block_accepted()
-    {
-      ++block_clock;
-      if( block_clock > cache_duration_in_blocks )
-        _message_cache.get<block_clock_index>().erase(_message_cache.get<block_clock_index>().begin(),
-                                                      _message_cache.get<block_clock_index>().lower_bound(block_clock - cache_duration_in_blocks ) );
-    }
-
-    void blockchain_tied_message_cache::cache_message( const message& message_to_cache,
-                                                     const message_hash_type& hash_of_message_to_cache,
-                                                     const message_propagation_data& propagation_data,
-                                                     const fc::uint160_t& message_content_hash )
-    {
-      _message_cache.insert( message_info(hash_of_message_to_cache,
-                                         message_to_cache,
-                                         block_clock,
-                                         propagation_data,
-                                         message_content_hash ) );
-    }
-
-    message blockchain_tied_message_cache::get_message( const message_hash_type& hash_of_message_to_lookup )
-    {
-      message_cache_container::index<message_hash_index>::type::const_iterator iter =
-         _message_cache.get<message_hash_index>().find(hash_of_message_to_lookup );
-      if( iter != _message_cache.get<message_hash_index>().end() )
-        return iter->message_body;
-      FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
-    }
-
-    message_propagation_data blockchain_tied_message_cache::get_message_propagation_data( const fc::uint160_t& hash_of_message_contents_to_lookup ) const
-    {
-      if( hash_of_message_contents_to_lookup != fc::uint160_t() )
-      {
-        message_cache_container::index<message_contents_hash_index>::type::const_iterator iter =
-           _message_cache.get<message_contents_hash_index>().find(hash_of_message_contents_to_lookup );
-        if( iter != _message_cache.get<message_contents_hash_index>().end() )
-          return iter->propagation_data;
-      }
-      FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
-    }
-
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
 
     // This specifies configuration info for the local node.  It's stored as JSON
@@ -417,7 +322,7 @@ namespace graphene { namespace net { namespace detail {
       fc::sha256           _chain_id;
 
 #define NODE_CONFIGURATION_FILENAME      "node_config.json"
-#define POTENTIAL_PEER_DATABASE_FILENAME "peers.json"
+#define POTENTIAL_PEER_DATABASE_FILENAME "peers.dat"
       fc::path             _node_configuration_directory;
       node_configuration   _node_configuration;
 
@@ -451,6 +356,7 @@ namespace graphene { namespace net { namespace detail {
       typedef std::unordered_map<graphene::net::block_id_type, fc::time_point> active_sync_requests_map;
 
       active_sync_requests_map              _active_sync_requests; /// list of sync blocks we've asked for from peers but have not yet received
+      std::unordered_set<item_hash_t>       _rerequested_sync_items; /// sync blocks we've asked two peers for because the first was too slow; the copy that arrives last is dropped
       std::list<graphene::net::block_message> _new_received_sync_items; /// list of sync blocks we've just received but haven't yet tried to process
       std::list<graphene::net::block_message> _received_sync_items; /// list of sync blocks we've received, but can't yet process because we are still missing blocks that come earlier in the chain
       // @}
@@ -481,6 +387,7 @@ namespace graphene { namespace net { namespace detail {
       fc::promise<void>::ptr        _retrigger_advertise_inventory_loop_promise;
       fc::future<void>              _advertise_inventory_loop_done;
       std::unordered_set<item_id>   _new_inventory; /// list of items we have received but not yet advertised to our peers
+      inventory_filter              _advertised_inventory; /// approximate set of items we have advertised to at least one peer recently
       // @}
 
       fc::future<void>     _terminate_inactive_connections_loop_done;
@@ -741,6 +648,7 @@ namespace graphene { namespace net { namespace detail {
       void sync_from(const item_id& current_head_block, const std::vector<uint32_t>& hard_fork_block_numbers);
       bool is_connected() const;
       std::vector<potential_peer_record> get_potential_peers() const;
+      std::vector<sync_peer_stats> get_sync_peer_stats() const;
       void set_advanced_node_parameters( const fc::variant_object& params );
 
       fc::variant_object         get_advanced_node_parameters();
@@ -753,7 +661,7 @@ namespace graphene { namespace net { namespace detail {
       void                       set_total_bandwidth_limit( uint32_t upload_bytes_per_second, uint32_t download_bytes_per_second );
       void                       disable_peer_advertising();
       fc::variant_object         get_call_statistics() const;
-      message                    get_message_for_item(const item_id& item) override;
+      shared_message             get_message_for_item(const item_id& item) override;
 
       fc::variant_object         network_get_info() const;
       fc::variant_object         network_get_usage_stats() const;
@@ -923,21 +831,21 @@ namespace graphene { namespace net { namespace detail {
             bool initiated_connection_this_pass = false;
             _potential_peer_database_updated = false;
 
-            for (peer_database::iterator iter = _potential_peer_db.begin();
-                 iter != _potential_peer_db.end() && is_wanting_new_connections();
-                 ++iter)
+            // take the best candidates we aren't connecting to already and which aren't waiting to be retried
+            // don't rely on the loop condition to keep the subtraction from wrapping around
+            const uint32_t number_of_connections = get_number_of_connections();
+            if (number_of_connections >= _desired_number_of_connections)
+              break;
+            uint32_t connections_wanted = _desired_number_of_connections - number_of_connections;
+            std::vector<potential_peer_record> candidates =
+               _potential_peer_db.get_connection_candidates(connections_wanted, fc::time_point::now(), _peer_connection_retry_timeout,
+                                                            [this](const fc::ip::endpoint& endpoint) { return is_connection_to_endpoint_in_progress(endpoint); });
+            for (const potential_peer_record& candidate : candidates)
             {
-              fc::microseconds delay_until_retry = fc::seconds((iter->number_of_failed_connection_attempts + 1) * _peer_connection_retry_timeout);
-
-              if (!is_connection_to_endpoint_in_progress(iter->endpoint) &&
-                  ((iter->last_connection_disposition != last_connection_failed &&
-                    iter->last_connection_disposition != last_connection_rejected &&
-                    iter->last_connection_disposition != last_connection_handshaking_failed) ||
-                   (fc::time_point::now() - iter->last_connection_attempt_time) > delay_until_retry))
-              {
-                connect_to_endpoint(iter->endpoint);
-                initiated_connection_this_pass = true;
-              }
+              if (!is_wanting_new_connections())
+                break;
+              connect_to_endpoint(candidate.endpoint);
+              initiated_connection_this_pass = true;
             }
 
             if (!initiated_connection_this_pass && !_potential_peer_database_updated)
@@ -1007,6 +915,7 @@ namespace graphene { namespace net { namespace detail {
       _active_sync_requests.insert( active_sync_requests_map::value_type(item_to_request, fc::time_point::now() ) );
       peer->last_sync_item_received_time = fc::time_point::now();
       peer->sync_items_requested_from_peer.insert(item_to_request);
+      peer->sync_performance.block_requested(item_to_request, fc::time_point::now());
       peer->send_message( fetch_items_message(item_id_to_request.item_type, std::vector<item_hash_t>{item_id_to_request.item_hash} ) );
     }
 
@@ -1015,11 +924,14 @@ namespace graphene { namespace net { namespace detail {
       VERIFY_CORRECT_THREAD();
       dlog( "requesting ${item_count} item(s) ${items_to_request} from peer ${endpoint}",
             ("item_count", items_to_request.size())("items_to_request", items_to_request)("endpoint", peer->get_remote_endpoint()) );
+      // topping up a peer which still owes us blocks doesn't count as progress on those
+      if (peer->sync_items_requested_from_peer.empty())
+        peer->last_sync_item_received_time = fc::time_point::now();
       for (const item_hash_t& item_to_request : items_to_request)
       {
         _active_sync_requests.insert( active_sync_requests_map::value_type(item_to_request, fc::time_point::now() ) );
-        peer->last_sync_item_received_time = fc::time_point::now();
         peer->sync_items_requested_from_peer.insert(item_to_request);
+        peer->sync_performance.block_requested(item_to_request, fc::time_point::now());
       }
       peer->send_message(fetch_items_message(graphene::net::block_message_type, items_to_request));
     }
@@ -1034,46 +946,43 @@ namespace graphene { namespace net { namespace detail {
 
         if (!_suspend_fetching_sync_blocks)
         {
-          std::map<peer_connection_ptr, std::vector<item_hash_t> > sync_item_requests_to_send;
+          std::vector<peer_connection_ptr> syncing_peers;
+          std::vector<std::vector<item_hash_t> > sync_item_requests_to_send;
 
           {
             ASSERT_TASK_NOT_PREEMPTED();
-            std::set<item_hash_t> sync_items_to_request;
-
-            // for each idle peer that we're syncing with
+            std::vector<sync_peer_candidate> candidates;
             for( const peer_connection_ptr& peer : _active_connections )
             {
-              if( peer->we_need_sync_items_from_peer &&
-                  sync_item_requests_to_send.find(peer) == sync_item_requests_to_send.end() && // if we've already scheduled a request for this peer, don't consider scheduling another
-                  peer->idle() )
-              {
-                if (!peer->inhibit_fetching_sync_blocks)
-                {
-                  // loop through the items it has that we don't yet have on our blockchain
-                  for( unsigned i = 0; i < peer->ids_of_items_to_get.size(); ++i )
-                  {
-                    item_hash_t item_to_potentially_request = peer->ids_of_items_to_get[i];
-                    // if we don't already have this item in our temporary storage and we haven't requested from another syncing peer
-                    if( !have_already_received_sync_item(item_to_potentially_request) && // already got it, but for some reson it's still in our list of items to fetch
-                        sync_items_to_request.find(item_to_potentially_request) == sync_items_to_request.end() &&  // we have already decided to request it from another peer during this iteration
-                        _active_sync_requests.find(item_to_potentially_request) == _active_sync_requests.end() ) // we've requested it in a previous iteration and we're still waiting for it to arrive
-                    {
-                      // then schedule a request from this peer
-                      sync_item_requests_to_send[peer].push_back(item_to_potentially_request);
-                      sync_items_to_request.insert( item_to_potentially_request );
-                      if (sync_item_requests_to_send[peer].size() >= _maximum_blocks_per_peer_during_syncing)
-                        break;
-                    }
-                  }
-                }
-              }
+              if( !peer->we_need_sync_items_from_peer )
+                continue;
+              // a peer which is running out of block ids is left to drain, so it goes idle and we can ask it for more
+              bool needs_more_item_ids = peer->number_of_unfetched_item_ids > 0 &&
+                                         peer->ids_of_items_to_get.size() < GRAPHENE_NET_MIN_BLOCK_IDS_TO_PREFETCH;
+              sync_peer_candidate candidate;
+              candidate.tracker = &peer->sync_performance;
+              candidate.ids_of_items_to_get = &peer->ids_of_items_to_get;
+              candidate.can_request = !peer->inhibit_fetching_sync_blocks &&
+                                      !peer->item_ids_requested_from_peer &&
+                                      peer->items_requested_from_peer.empty() &&
+                                      (peer->sync_items_requested_from_peer.empty() || !needs_more_item_ids);
+              syncing_peers.push_back(peer);
+              candidates.push_back(candidate);
             }
+
+            sync_item_requests_to_send = schedule_sync_requests( candidates,
+                                                                 [this]( const item_hash_t& item_hash ) {
+                                                                   return _active_sync_requests.find(item_hash) != _active_sync_requests.end() ||
+                                                                          have_already_received_sync_item(item_hash);
+                                                                 },
+                                                                 _rerequested_sync_items, _maximum_blocks_per_peer_during_syncing,
+                                                                 fc::time_point::now() );
           } // end non-preemptable section
 
           // make all the requests we scheduled in the loop above
-          for( auto sync_item_request : sync_item_requests_to_send )
-            request_sync_items_from_peer( sync_item_request.first, sync_item_request.second );
-          sync_item_requests_to_send.clear();
+          for( unsigned i = 0; i < syncing_peers.size(); ++i )
+            if( !sync_item_requests_to_send[i].empty() )
+              request_sync_items_from_peer( syncing_peers[i], sync_item_requests_to_send[i] );
         }
         else
           dlog("fetch_sync_items_loop is suspended pending backlog processing");
@@ -1082,7 +991,17 @@ namespace graphene { namespace net { namespace detail {
         {
           dlog( "no sync items to fetch right now, going to sleep" );
           _retrigger_fetch_sync_items_loop_promise = fc::promise<void>::ptr( new fc::promise<void>("graphene::net::retrigger_fetch_sync_items_loop") );
-          _retrigger_fetch_sync_items_loop_promise->wait();
+          try
+          {
+            // while blocks are outstanding, wake up now and then to look for requests that are taking too long
+            if( !_active_sync_requests.empty() )
+              _retrigger_fetch_sync_items_loop_promise->wait_until( fc::time_point::now() + fc::milliseconds(GRAPHENE_NET_SYNC_STRAGGLER_MIN_TIMEOUT_MS / 2) );
+            else
+              _retrigger_fetch_sync_items_loop_promise->wait();
+          }
+          catch ( fc::timeout_exception& ) //intentionally not logged
+          {
+          }
           _retrigger_fetch_sync_items_loop_promise.reset();
         }
       } // while( !canceled )
@@ -1101,7 +1020,7 @@ namespace graphene { namespace net { namespace detail {
     {
       for( const peer_connection_ptr& peer : _active_connections )
       {
-        if (peer->inventory_peer_advertised_to_us.find(item) != peer->inventory_peer_advertised_to_us.end() )
+        if (peer->may_have_item(item))
           return true;
       }
       return false;
@@ -1162,7 +1081,7 @@ namespace graphene { namespace net { namespace detail {
               const peer_connection_ptr& peer = peer_iter->peer;
               // if they have the item and we haven't already decided to ask them for too many other items
               if (peer_iter->item_ids.size() < GRAPHENE_NET_MAX_ITEMS_PER_PEER_DURING_NORMAL_OPERATION &&
-                  peer->inventory_peer_advertised_to_us.find(item_iter->item) != peer->inventory_peer_advertised_to_us.end())
+                  peer->may_have_item(item_iter->item))
               {
                 if (item_iter->item.item_type == graphene::net::trx_message_type && peer->is_transaction_fetching_inhibited())
                   next_peer_unblocked_time = std::min(peer->transaction_fetching_inhibited_until, next_peer_unblocked_time);
@@ -1249,46 +1168,49 @@ namespace graphene { namespace net { namespace detail {
         // we're computing the messages)
         std::list<std::pair<peer_connection_ptr, item_ids_inventory_message> > inventory_messages_to_send;
 
+        // group the items by type once, because we'll need to send one inventory message per type
+        std::map<uint32_t, std::vector<item_id> > inventory_to_advertise_by_type;
+        for (const item_id& item_to_advertise : inventory_to_advertise)
+          inventory_to_advertise_by_type[item_to_advertise.item_type].push_back(item_to_advertise);
+
+        const fc::time_point now = fc::time_point::now();
         for (const peer_connection_ptr& peer : _active_connections)
         {
           // only advertise to peers who are in sync with us
-           p2pddump((peer->peer_needs_sync_items_from_us));
           if( !peer->peer_needs_sync_items_from_us )
           {
-            std::map<uint32_t, std::vector<item_hash_t> > items_to_advertise_by_type;
             // don't send the peer anything we've already advertised to it
             // or anything it has advertised to us
-            // group the items we need to send by type, because we'll need to send one inventory message per type
             unsigned total_items_to_send_to_this_peer = 0;
-            p2pddump((inventory_to_advertise));
-            for (const item_id& item_to_advertise : inventory_to_advertise)
+            for (const auto& items_group : inventory_to_advertise_by_type)
             {
-              if (peer->inventory_advertised_to_peer.find(item_to_advertise) != peer->inventory_advertised_to_peer.end() )
-                 p2pddump((*peer->inventory_advertised_to_peer.find(item_to_advertise)));
-              if (peer->inventory_peer_advertised_to_us.find(item_to_advertise) != peer->inventory_peer_advertised_to_us.end() )
-                 p2pddump((*peer->inventory_peer_advertised_to_us.find(item_to_advertise)));
-
-              if (peer->inventory_advertised_to_peer.find(item_to_advertise) == peer->inventory_advertised_to_peer.end() &&
-                  peer->inventory_peer_advertised_to_us.find(item_to_advertise) == peer->inventory_peer_advertised_to_us.end())
+              item_ids_inventory_message message;
+              message.item_type = items_group.first;
+              for (const item_id& item_to_advertise : items_group.second)
               {
-                items_to_advertise_by_type[item_to_advertise.item_type].push_back(item_to_advertise.item_hash);
-                peer->inventory_advertised_to_peer.insert(peer_connection::timestamped_item_id(item_to_advertise, fc::time_point::now()));
-                ++total_items_to_send_to_this_peer;
-                if (item_to_advertise.item_type == trx_message_type)
-                  testnetlog("advertising transaction ${id} to peer ${endpoint}", ("id", item_to_advertise.item_hash)("endpoint", peer->get_remote_endpoint()));
-                dlog("advertising item ${id} to peer ${endpoint}", ("id", item_to_advertise.item_hash)("endpoint", peer->get_remote_endpoint()));
+                if (!peer->known_inventory.contains(item_to_advertise, now))
+                {
+                  peer->known_inventory.insert(item_to_advertise, now);
+                  message.item_hashes_available.push_back(item_to_advertise.item_hash);
+                  if (item_to_advertise.item_type == trx_message_type)
+                    testnetlog("advertising transaction ${id} to peer ${endpoint}", ("id", item_to_advertise.item_hash)("endpoint", peer->get_remote_endpoint()));
+                }
               }
+              total_items_to_send_to_this_peer += message.item_hashes_available.size();
+              if (!message.item_hashes_available.empty())
+                inventory_messages_to_send.push_back(std::make_pair(peer, std::move(message)));
             }
-              dlog("advertising ${count} new item(s) of ${types} type(s) to peer ${endpoint}",
-                   ("count", total_items_to_send_to_this_peer)
-                   ("types", items_to_advertise_by_type.size())
-                   ("endpoint", peer->get_remote_endpoint()));
-            for (auto items_group : items_to_advertise_by_type)
-              inventory_messages_to_send.push_back(std::make_pair(peer, item_ids_inventory_message(items_group.first, items_group.second)));
+            dlog("advertising ${count} new item(s) to peer ${endpoint}",
+                 ("count", total_items_to_send_to_this_peer)
+                 ("endpoint", peer->get_remote_endpoint()));
           }
-          peer->clear_old_inventory();
         }
 
+        // remember what we advertised, so that we don't fetch it back when peers advertise it to us
+        if (!inventory_messages_to_send.empty())
+          for (const item_id& item_to_advertise : inventory_to_advertise)
+            _advertised_inventory.insert(item_to_advertise, now);
+
         for (auto iter = inventory_messages_to_send.begin(); iter != inventory_messages_to_send.end(); ++iter)
           iter->first->send_message(iter->second);
         inventory_messages_to_send.clear();
@@ -2375,11 +2297,10 @@ namespace graphene { namespace net { namespace detail {
       //uint32_t reference_point_block_num = _delegate->get_block_number(peer->last_block_delegate_has_seen);
 
       // when we call _delegate->get_blockchain_synopsis(), we may yield and there's a
-      // chance this peer's state will change before we get control back.  Save off
-      // the stuff necessary for generating the synopsis.
-      // This is pretty expensive, we should find a better way to do this
-      std::vector<item_hash_t> original_ids_of_items_to_get(peer->ids_of_items_to_get.begin(), peer->ids_of_items_to_get.end());
-      uint32_t number_of_blocks_after_reference_point = original_ids_of_items_to_get.size();
+      // chance this peer's state will change before we get control back.  The tail of the
+      // synopsis is read from the peer's current list afterwards, skipping any ids that were
+      // fetched in the meantime, so the list doesn't have to be copied here.
+      uint32_t number_of_blocks_after_reference_point = peer->ids_of_items_to_get.size();
 
       std::vector<item_hash_t> synopsis = _delegate->get_blockchain_synopsis(reference_point, number_of_blocks_after_reference_point);
 
@@ -2396,24 +2317,17 @@ namespace graphene { namespace net { namespace detail {
         FC_THROW_EXCEPTION(block_older_than_undo_history, "You are on a fork I'm unable to switch to");
 #endif
 
-      if( number_of_blocks_after_reference_point )
+      if( number_of_blocks_after_reference_point && !peer->ids_of_items_to_get.empty() )
       {
         // then the synopsis is incomplete, add the missing elements from ids_of_items_to_get
-        uint32_t first_block_num_in_ids_to_get = _delegate->get_block_number(original_ids_of_items_to_get.front());
-        uint32_t true_high_block_num = first_block_num_in_ids_to_get + original_ids_of_items_to_get.size() - 1;
+        uint32_t first_block_num_in_ids_to_get = _delegate->get_block_number(peer->ids_of_items_to_get.front());
 
         // in order to generate a seamless synopsis, we need to be using the same low_block_num as the 
         // backend code; the first block in the synopsis will be the low block number it used
         uint32_t low_block_num = synopsis.empty() ? 1 : _delegate->get_block_number(synopsis.front());
-        
-        do
-        {
-          if( low_block_num >= first_block_num_in_ids_to_get )
-            synopsis.push_back(original_ids_of_items_to_get[low_block_num - first_block_num_in_ids_to_get]);
-          low_block_num += (true_high_block_num - low_block_num + 2 ) / 2;
-        }
-        while ( low_block_num <= true_high_block_num );
-        assert(synopsis.back() == original_ids_of_items_to_get.back());
+
+        append_synopsis_tail(synopsis, low_block_num, peer->ids_of_items_to_get, first_block_num_in_ids_to_get);
+        assert(synopsis.back() == peer->ids_of_items_to_get.back());
       }
       return synopsis;
     }
@@ -2739,7 +2653,7 @@ namespace graphene { namespace net { namespace detail {
       }
     }
 
-    message node_impl::get_message_for_item(const item_id& item)
+    shared_message node_impl::get_message_for_item(const item_id& item)
     {
       try
       {
@@ -2749,11 +2663,11 @@ namespace graphene { namespace net { namespace detail {
       {}
       try
       {
-        return _delegate->get_item(item);
+        return std::make_shared<const message>(_delegate->get_item(item));
       }
       catch (fc::key_not_found_exception&)
       {}
-      return item_not_available_message(item);
+      return std::make_shared<const message>(item_not_available_message(item));
     }
 
     void node_impl::on_fetch_items_message(peer_connection* originating_peer, const fetch_items_message& fetch_items_message_received)
@@ -2764,17 +2678,17 @@ namespace graphene { namespace net { namespace detail {
            ("type", fetch_items_message_received.item_type)
            ("endpoint", originating_peer->get_remote_endpoint()));
 
-      fc::optional<message> last_block_message_sent;
+      shared_message last_block_message_sent;
 
-      std::list<message> reply_messages;
+      std::list<shared_message> reply_messages;
       for (const item_hash_t& item_hash : fetch_items_message_received.items_to_fetch)
       {
         try
         {
-          message requested_message = _message_cache.get_message(item_hash);
+          shared_message requested_message = _message_cache.get_message(item_hash);
           dlog("received item request for item ${id} from peer ${endpoint}, returning the item from my message cache",
                ("endpoint", originating_peer->get_remote_endpoint())
-               ("id", requested_message.id()));
+               ("id", item_hash));
           reply_messages.push_back(requested_message);
           if (fetch_items_message_received.item_type == block_message_type)
             last_block_message_sent = requested_message;
@@ -2793,14 +2707,14 @@ namespace graphene { namespace net { namespace detail {
                ("id", requested_message.id())
                ("size", requested_message.size)
                ("endpoint", originating_peer->get_remote_endpoint()));
-          reply_messages.push_back(requested_message);
+          reply_messages.push_back(std::make_shared<const message>(std::move(requested_message)));
           if (fetch_items_message_received.item_type == block_message_type)
-            last_block_message_sent = requested_message;
+            last_block_message_sent = reply_messages.back();
           continue;
         }
         catch (fc::key_not_found_exception&)
         {
-          reply_messages.push_back(item_not_available_message(item_to_fetch));
+          reply_messages.push_back(std::make_shared<const message>(item_not_available_message(item_to_fetch)));
           dlog("received item request from peer ${endpoint} but we don't have it",
                ("endpoint", originating_peer->get_remote_endpoint()));
         }
@@ -2814,10 +2728,10 @@ namespace graphene { namespace net { namespace detail {
         originating_peer->last_block_time_delegate_has_seen = _delegate->get_block_time(block.block_id);
       }
 
-      for (const message& reply : reply_messages)
+      for (const shared_message& reply : reply_messages)
       {
-        if (reply.msg_type == block_message_type)
-          originating_peer->send_item(item_id(block_message_type, reply.as<graphene::net::block_message>().block_id));
+        if (reply->msg_type == block_message_type)
+          originating_peer->send_item(item_id(block_message_type, reply->as<graphene::net::block_message>().block_id));
         else
           originating_peer->send_message(reply);
       }
@@ -2831,7 +2745,7 @@ namespace graphene { namespace net { namespace detail {
       if (regular_item_iter != originating_peer->items_requested_from_peer.end())
       {
         originating_peer->items_requested_from_peer.erase( regular_item_iter );
-        originating_peer->inventory_peer_advertised_to_us.erase( requested_item );
+        originating_peer->inventory_not_available_from_peer.insert( requested_item );
         if (is_item_in_any_peers_inventory(requested_item))
           _items_to_fetch.insert(prioritized_item_id(requested_item, _items_to_fetch_sequence_counter++));
         wlog("Peer doesn't have the requested item.");
@@ -2843,6 +2757,7 @@ namespace graphene { namespace net { namespace detail {
       if (sync_item_iter != originating_peer->sync_items_requested_from_peer.end())
       {
         originating_peer->sync_items_requested_from_peer.erase(sync_item_iter);
+        originating_peer->sync_performance.request_cancelled(requested_item.item_hash);
 
         if (originating_peer->peer_needs_sync_items_from_us)
           originating_peer->inhibit_fetching_sync_blocks = true;
@@ -2862,26 +2777,26 @@ namespace graphene { namespace net { namespace detail {
     {
       VERIFY_CORRECT_THREAD();
 
-      // expire old inventory so we'll be making decisions our about whether to fetch blocks below based only on recent inventory
-      originating_peer->clear_old_inventory();
-
       dlog( "received inventory of ${count} items from peer ${endpoint}",
            ( "count", item_ids_inventory_message_received.item_hashes_available.size() )("endpoint", originating_peer->get_remote_endpoint() ) );
       for( const item_hash_t& item_hash : item_ids_inventory_message_received.item_hashes_available )
       {
         item_id advertised_item_id(item_ids_inventory_message_received.item_type, item_hash);
-        bool we_advertised_this_item_to_a_peer = false;
+        // the peer has the item, never advertise it back
+        originating_peer->known_inventory.insert(advertised_item_id);
+        // a false positive of the filter would keep us from ever fetching the item, which is only harmless for
+        // transactions (they reach us in a block), so blocks are confirmed with the blockchain
+        bool we_advertised_this_item_to_a_peer = _advertised_inventory.contains(advertised_item_id) &&
+                                                 (advertised_item_id.item_type != graphene::net::block_message_type ||
+                                                  _delegate->has_item(advertised_item_id));
         bool we_requested_this_item_from_a_peer = false;
-        for (const peer_connection_ptr peer : _active_connections)
-        {
-          if (peer->inventory_advertised_to_peer.find(advertised_item_id) != peer->inventory_advertised_to_peer.end())
-          {
-            we_advertised_this_item_to_a_peer = true;
-            break;
-          }
-          if (peer->items_requested_from_peer.find(advertised_item_id) != peer->items_requested_from_peer.end())
-            we_requested_this_item_from_a_peer = true;
-        }
+        if (!we_advertised_this_item_to_a_peer)
+          for (const peer_connection_ptr peer : _active_connections)
+            if (peer->items_requested_from_peer.find(advertised_item_id) != peer->items_requested_from_peer.end())
+            {
+              we_requested_this_item_from_a_peer = true;
+              break;
+            }
 
         // if we have already advertised it to a peer, we must have it, no need to do anything else
         if (!we_advertised_this_item_to_a_peer)
@@ -2893,7 +2808,7 @@ namespace graphene { namespace net { namespace detail {
                originating_peer->is_inventory_advertised_to_us_list_full_for_transactions()) ||
               originating_peer->is_inventory_advertised_to_us_list_full())
             break;
-          originating_peer->inventory_peer_advertised_to_us.insert(peer_connection::timestamped_item_id(advertised_item_id, fc::time_point::now()));
+          originating_peer->inventory_peer_advertised_to_us.insert(advertised_item_id);
           if (!we_requested_this_item_from_a_peer)
           {
             if (_recently_failed_items.find(item_id(item_ids_inventory_message_received.item_type, item_hash)) != _recently_failed_items.end())
@@ -2988,7 +2903,15 @@ namespace graphene { namespace net { namespace detail {
           fc::optional<potential_peer_record> updated_peer_record = _potential_peer_db.lookup_entry_for_endpoint(*inbound_endpoint);
           if (updated_peer_record)
           {
-            updated_peer_record->last_seen_time = fc::time_point::now();
+            fc::time_point now = fc::time_point::now();
+            updated_peer_record->last_seen_time = now;
+            // remember how well the connection performed, for choosing peers to connect to later
+            if (originating_peer->round_trip_delay.count() > 0)
+              updated_peer_record->round_trip_delay_ms = originating_peer->round_trip_delay.count() / 1000;
+            int64_t connected_seconds = (now - originating_peer->connection_initiation_time).to_seconds();
+            if (connected_seconds > 0)
+              updated_peer_record->bytes_per_second_received = (uint32_t)std::min<uint64_t>(originating_peer->get_total_bytes_received() / connected_seconds,
+                                                                                             std::numeric_limits<uint32_t>::max());
             _potential_peer_db.update_entry(*updated_peer_record);
           }
         }
@@ -3028,7 +2951,14 @@ namespace graphene { namespace net { namespace detail {
       if (!originating_peer->sync_items_requested_from_peer.empty())
       {
         for (auto sync_item : originating_peer->sync_items_requested_from_peer)
+        {
+          // a block we also asked another peer for is still on its way from that peer
+          if (_rerequested_sync_items.erase(sync_item) &&
+              std::any_of(_active_connections.begin(), _active_connections.end(), [&](const peer_connection_ptr& peer) {
+                return peer.get() != originating_peer && peer->sync_items_requested_from_peer.count(sync_item); }))
+            continue;
           _active_sync_requests.erase(sync_item);
+        }
         trigger_fetch_sync_items_loop();
       }
 
@@ -3064,6 +2994,15 @@ namespace graphene { namespace net { namespace detail {
 
         client_accepted_block = true;
       }
+      catch (const unlinkable_block_buffered& e)
+      {
+        // the client keeps the block and pushes it as soon as the block it builds on has arrived,
+        // so there is nothing to fetch again and no reason to blame the peer
+        dlog("Sync block ${num} (id:${id}) was buffered until its predecessor arrives",
+             ("num", block_message_to_send.block.block_num())
+             ("id", block_message_to_send.block_id));
+        client_accepted_block = true;
+      }
       catch (const block_older_than_undo_history& e)
       {
         wlog("Failed to push sync block ${num} (id:${id}): block is on a fork older than our undo history would "
@@ -3439,17 +3378,15 @@ namespace graphene { namespace net { namespace detail {
         {
           ASSERT_TASK_NOT_PREEMPTED(); // don't yield while iterating over _active_connections
 
-          auto iter = peer->inventory_peer_advertised_to_us.find(block_message_item_id);
-          if (iter != peer->inventory_peer_advertised_to_us.end())
+          if (peer->inventory_peer_advertised_to_us.contains(block_message_item_id))
           {
             // this peer offered us the item.  It will eventually expire from the peer's
-            // inventory_peer_advertised_to_us list after some time has passed (currently 2 minutes).
+            // known_inventory after some time has passed (currently 2 minutes).
             // For now, it will remain there, which will prevent us from offering the peer this
             // block back when we rebroadcast the block below
             peer->last_block_delegate_has_seen = block_message_to_process.block_id;
             peer->last_block_time_delegate_has_seen = block_time;
           }
-          peer->clear_old_inventory();
         }
         message_propagation_data propagation_data{message_receive_time, message_validated_time, originating_peer->node_id};
         broadcast( block_message_to_process, propagation_data );
@@ -3488,6 +3425,16 @@ namespace graphene { namespace net { namespace detail {
       {
         throw;
       }
+      catch (const unlinkable_block_buffered& e)
+      {
+        // the block is kept until its predecessor arrives; fetch that unless we are syncing with the peer anyway
+        dlog("Block ${num} (id:${id}) from peer ${peer} was buffered until its predecessor arrives",
+             ("num", block_message_to_process.block.block_num())
+             ("id", block_message_to_process.block_id)
+             ("peer", originating_peer->get_remote_endpoint()));
+        if (!originating_peer->we_need_sync_items_from_peer)
+          restart_sync_exception = e;
+      }
       catch (const unlinkable_block_exception& e) 
       {
         restart_sync_exception = e;
@@ -3555,8 +3502,21 @@ namespace graphene { namespace net { namespace detail {
           try
           {
             originating_peer->last_sync_item_received_time = fc::time_point::now();
-            _active_sync_requests.erase(block_message_to_process.block_id);
-            process_block_during_sync(originating_peer, block_message_to_process, message_hash);
+            originating_peer->sync_performance.block_received(block_message_to_process.block_id, message_to_process.size,
+                                                              originating_peer->last_sync_item_received_time);
+            auto rerequested_iter = _rerequested_sync_items.find(block_message_to_process.block_id);
+            if (rerequested_iter != _rerequested_sync_items.end() &&
+                _active_sync_requests.find(block_message_to_process.block_id) == _active_sync_requests.end())
+            {
+              // we asked two peers for this block and the other one delivered it first
+              dlog("dropping second copy of re-requested sync block ${id}", ("id", block_message_to_process.block_id));
+              _rerequested_sync_items.erase(rerequested_iter);
+            }
+            else
+            {
+              _active_sync_requests.erase(block_message_to_process.block_id);
+              process_block_during_sync(originating_peer, block_message_to_process, message_hash);
+            }
             if (originating_peer->idle())
             {
               // we have finished fetching a batch of items, so we either need to grab another batch of items
@@ -3567,6 +3527,8 @@ namespace graphene { namespace net { namespace detail {
               else
                 trigger_fetch_sync_items_loop();
             }
+            else if (originating_peer->sync_performance.free_slots() > 0)
+              trigger_fetch_sync_items_loop(); // top up the peer's window
             return;
           }
           catch (const fc::canceled_exception& e)
@@ -4776,7 +4738,7 @@ namespace graphene { namespace net { namespace detail {
         ilog( "  peer ${endpoint}", ("endpoint", peer->get_remote_endpoint() ) );
         ilog( "    peer.ids_of_items_to_get size: ${size}", ("size", peer->ids_of_items_to_get.size() ) );
         ilog( "    peer.inventory_peer_advertised_to_us size: ${size}", ("size", peer->inventory_peer_advertised_to_us.size() ) );
-        ilog( "    peer.inventory_advertised_to_peer size: ${size}", ("size", peer->inventory_advertised_to_peer.size() ) );
+        ilog( "    peer.known_inventory size: ${size}", ("size", peer->known_inventory.size() ) );
         ilog( "    peer.items_requested_from_peer size: ${size}", ("size", peer->items_requested_from_peer.size() ) );
         ilog( "    peer.sync_items_requested_from_peer size: ${size}", ("size", peer->sync_items_requested_from_peer.size() ) );
       }
@@ -4997,6 +4959,21 @@ namespace graphene { namespace net { namespace detail {
       return result;
     }
 
+    std::vector<sync_peer_stats> node_impl::get_sync_peer_stats() const
+    {
+      VERIFY_CORRECT_THREAD();
+      std::vector<sync_peer_stats> result;
+      for (const peer_connection_ptr& peer : _active_connections)
+      {
+        sync_peer_stats stats = peer->sync_performance.get_stats();
+        if (!peer->we_need_sync_items_from_peer && stats.blocks_received == 0)
+          continue;
+        stats.host = peer->get_remote_endpoint() ? *peer->get_remote_endpoint() : fc::ip::endpoint();
+        result.push_back(stats);
+      }
+      return result;
+    }
+
     void node_impl::set_advanced_node_parameters(const fc::variant_object& params)
     {
       VERIFY_CORRECT_THREAD();
@@ -5248,6 +5225,11 @@ namespace graphene { namespace net { namespace detail {
     INVOKE_IN_IMPL(get_potential_peers);
   }
 
+  std::vector<sync_peer_stats> node::get_sync_peer_stats()const
+  {
+    INVOKE_IN_IMPL(get_sync_peer_stats);
+  }
+
   void node::set_advanced_node_parameters( const fc::variant_object& params )
   {
     INVOKE_IN_IMPL(set_advanced_node_parameters, params);
@@ -28,6 +28,7 @@
 #include <boost/multi_index/mem_fun.hpp>
 #include <boost/multi_index/tag.hpp>
 
+#include <fc/crypto/city.hpp>
 #include <fc/io/raw.hpp>
 #include <fc/io/raw_variant.hpp>
 #include <fc/log/logger.hpp>
@@ -37,18 +38,68 @@
 
 #include <graphene/net/config.hpp>
 
+#include <fstream>
 
+namespace graphene { namespace net { namespace detail {
+
+  /// a peer record as it is stored in the peer database file, with the error in its variant form
+  struct stored_peer_record
+  {
+    fc::ip::endpoint             endpoint;
+    fc::time_point_sec           last_seen_time;
+    uint8_t                      last_connection_disposition = never_attempted_to_connect;
+    fc::time_point_sec           last_connection_attempt_time;
+    uint32_t                     number_of_successful_connection_attempts = 0;
+    uint32_t                     number_of_failed_connection_attempts = 0;
+    uint32_t                     round_trip_delay_ms = 0;
+    uint32_t                     bytes_per_second_received = 0;
+    fc::optional<fc::variant>    last_error;
+  };
+
+} } } // graphene::net::detail
+
+FC_REFLECT( graphene::net::detail::stored_peer_record,
+            (endpoint)(last_seen_time)(last_connection_disposition)(last_connection_attempt_time)
+            (number_of_successful_connection_attempts)(number_of_failed_connection_attempts)
+            (round_trip_delay_ms)(bytes_per_second_received)(last_error) )
 
 namespace graphene { namespace net {
+
+  int64_t potential_peer_record::connection_score() const
+  {
+    int64_t score = last_seen_time.sec_since_epoch() / 60;
+    score -= 60 * std::max<int64_t>(int64_t(number_of_failed_connection_attempts) - number_of_successful_connection_attempts, 0);
+    score -= round_trip_delay_ms / 100;
+    for (uint32_t bandwidth = bytes_per_second_received; bandwidth; bandwidth >>= 1)
+      score += 5;
+    return score;
+  }
+
   namespace detail
   {
     using namespace boost::multi_index;
 
+    /**
+     * The database file is a log of changes: each entry is
+     * [uint32_t size][uint8_t log_op][packed stored_peer_record or endpoint][uint64_t city_hash64 of the op and payload].
+     * Changes are appended as they happen, and the file is rewritten with one entry per peer when it has
+     * grown to several times that size, or on close.  A torn entry at the end is dropped on open.
+     */
+    enum log_op : uint8_t
+    {
+      log_op_update = 0,
+      log_op_erase  = 1
+    };
+
+    const uint32_t MAX_LOG_ENTRY_SIZE = 1024 * 1024;
+    const uint64_t MIN_LOG_ENTRIES_TO_COMPACT = 1000;
+
     class peer_database_impl
     {
     public:
       struct last_seen_time_index {};
       struct endpoint_index {};
+      struct score_index {};
       typedef boost::multi_index_container<potential_peer_record, 
                                            indexed_by<ordered_non_unique<tag<last_seen_time_index>, 
                                                                          member<potential_peer_record, 
@@ -58,20 +109,37 @@ namespace graphene { namespace net {
                                                                     member<potential_peer_record, 
                                                                            fc::ip::endpoint, 
                                                                            &potential_peer_record::endpoint>, 
-                                                                    std::hash<fc::ip::endpoint> > > > potential_peer_set;
+                                                                    std::hash<fc::ip::endpoint> >,
+                                                      ordered_non_unique<tag<score_index>,
+                                                                         const_mem_fun<potential_peer_record,
+                                                                                       int64_t,
+                                                                                       &potential_peer_record::connection_score>,
+                                                                         std::greater<int64_t> > > > potential_peer_set;
 
     private:
       potential_peer_set     _potential_peer_set;
       fc::path _peer_database_filename;
+      std::ofstream _log;
+      /// number of entries in the log file, compacted when it exceeds twice the number of peers
+      uint64_t _log_entries = 0;
+
+      void import_json(const fc::path& json_filename);
+      /// @return the size of the valid prefix of the log
+      uint64_t replay_log();
+      void append_log(log_op op, const std::vector<char>& payload);
+      /// rewrite the log with one entry per peer
+      void write_snapshot();
 
     public:
-      void open(const fc::path& databaseFilename);
+      void open(const fc::path& databaseFilename, size_t maximum_size);
       void close();
       void clear();
       void erase(const fc::ip::endpoint& endpointToErase);
       void update_entry(const potential_peer_record& updatedRecord);
       potential_peer_record lookup_or_create_entry_for_endpoint(const fc::ip::endpoint& endpointToLookup);
       fc::optional<potential_peer_record> lookup_entry_for_endpoint(const fc::ip::endpoint& endpointToLookup);
+      std::vector<potential_peer_record> get_connection_candidates(uint32_t limit, fc::time_point now, uint32_t retry_timeout_sec,
+                                                                   const std::function<bool(const fc::ip::endpoint&)>& skip) const;
 
       peer_database::iterator begin() const;
       peer_database::iterator end() const;
@@ -90,62 +158,236 @@ namespace graphene { namespace net {
     peer_database_iterator::peer_database_iterator( const peer_database_iterator& c ) :
       boost::iterator_facade<peer_database_iterator, const potential_peer_record, boost::forward_traversal_tag>(c){}
 
-    void peer_database_impl::open(const fc::path& peer_database_filename)
+    static std::vector<char> pack_record(const potential_peer_record& record)
+    {
+      stored_peer_record stored;
+      stored.endpoint = record.endpoint;
+      stored.last_seen_time = record.last_seen_time;
+      stored.last_connection_disposition = static_cast<potential_peer_last_connection_disposition>(record.last_connection_disposition);
+      stored.last_connection_attempt_time = record.last_connection_attempt_time;
+      stored.number_of_successful_connection_attempts = record.number_of_successful_connection_attempts;
+      stored.number_of_failed_connection_attempts = record.number_of_failed_connection_attempts;
+      stored.round_trip_delay_ms = record.round_trip_delay_ms;
+      stored.bytes_per_second_received = record.bytes_per_second_received;
+      if (record.last_error)
+        stored.last_error = fc::variant(*record.last_error, GRAPHENE_NET_MAX_NESTED_OBJECTS);
+      return fc::raw::pack(stored);
+    }
+
+    static potential_peer_record unpack_record(const std::vector<char>& data)
+    {
+      stored_peer_record stored;
+      fc::datastream<const char*> ds(data.data() + 1, data.size() - 1);
+      fc::raw::unpack(ds, stored);
+      potential_peer_record record(stored.endpoint, stored.last_seen_time,
+                                   (potential_peer_last_connection_disposition)stored.last_connection_disposition);
+      record.last_connection_attempt_time = stored.last_connection_attempt_time;
+      record.number_of_successful_connection_attempts = stored.number_of_successful_connection_attempts;
+      record.number_of_failed_connection_attempts = stored.number_of_failed_connection_attempts;
+      record.round_trip_delay_ms = stored.round_trip_delay_ms;
+      record.bytes_per_second_received = stored.bytes_per_second_received;
+      if (stored.last_error)
+        record.last_error = stored.last_error->as<fc::exception>(GRAPHENE_NET_MAX_NESTED_OBJECTS);
+      return record;
+    }
+
+    static void write_log_entry(std::ofstream& out, log_op op, const std::vector<char>& payload)
+    {
+      std::vector<char> data;
+      data.reserve(payload.size() + 1);
+      data.push_back(char(op));
+      data.insert(data.end(), payload.begin(), payload.end());
+      const uint32_t size = data.size();
+      const uint64_t checksum = fc::city_hash64(data.data(), data.size());
+      out.write((const char*)&size, sizeof(size));
+      out.write(data.data(), data.size());
+      out.write((const char*)&checksum, sizeof(checksum));
+    }
+
+    void peer_database_impl::open(const fc::path& peer_database_filename, size_t maximum_size)
     {
       _peer_database_filename = peer_database_filename;
+      _log_entries = 0;
+      bool rewrite = false;
       if (fc::exists(_peer_database_filename))
       {
+        uint64_t valid_size = replay_log();
+        if (valid_size < fc::file_size(_peer_database_filename))
+        {
+          wlog("dropping a damaged entry at the end of peer database file ${peer_database_filename}",
+               ("peer_database_filename", _peer_database_filename));
+          rewrite = true;
+        }
+      }
+      else
+      {
+        fc::path json_filename = _peer_database_filename;
+        json_filename.replace_extension(".json");
+        if (json_filename != _peer_database_filename && fc::exists(json_filename))
+        {
+          import_json(json_filename);
+          rewrite = true;
+        }
+      }
+
+      if (_potential_peer_set.size() > maximum_size)
+      {
+        // prune database to a reasonable size, keeping the peers we'd most like to connect to
+        auto iter = _potential_peer_set.get<score_index>().begin();
+        std::advance(iter, maximum_size);
+        _potential_peer_set.get<score_index>().erase(iter, _potential_peer_set.get<score_index>().end());
+        rewrite = true;
+      }
+
+      if (rewrite || _log_entries > 2 * _potential_peer_set.size() + MIN_LOG_ENTRIES_TO_COMPACT)
+        write_snapshot();
+      else
+      {
+        try
+        {
+          fc::path peer_database_filename_dir = _peer_database_filename.parent_path();
+          if (!fc::exists(peer_database_filename_dir))
+            fc::create_directories(peer_database_filename_dir);
+          _log.open(_peer_database_filename.generic_string().c_str(), std::ios::binary | std::ios::out | std::ios::app);
+        }
+        catch (const fc::exception& e)
+        {
+          elog("error opening peer database file ${peer_database_filename} for writing: ${e}",
+               ("peer_database_filename", _peer_database_filename)("e", e.to_detail_string()));
+        }
+      }
+    }
+
+    void peer_database_impl::import_json(const fc::path& json_filename)
+    {
+      try
+      {
+        std::vector<potential_peer_record> peer_records = fc::json::from_file(json_filename).as<std::vector<potential_peer_record> >( GRAPHENE_NET_MAX_NESTED_OBJECTS );
+        std::copy(peer_records.begin(), peer_records.end(), std::inserter(_potential_peer_set, _potential_peer_set.end()));
+        ilog("imported ${count} peers from ${json_filename}", ("count", peer_records.size())("json_filename", json_filename));
+      }
+      catch (const fc::exception& e)
+      {
+        elog("error opening peer database file ${peer_database_filename}, starting with a clean database", 
+             ("peer_database_filename", json_filename));
+      }
+    }
+
+    uint64_t peer_database_impl::replay_log()
+    {
+      std::ifstream in(_peer_database_filename.generic_string().c_str(), std::ios::binary);
+      uint64_t valid_size = 0;
+      std::vector<char> data;
+      while (true)
+      {
+        uint32_t size = 0;
+        uint64_t checksum = 0;
+        if (!in.read((char*)&size, sizeof(size)) || size == 0 || size > MAX_LOG_ENTRY_SIZE)
+          break;
+        data.resize(size);
+        if (!in.read(data.data(), size) || !in.read((char*)&checksum, sizeof(checksum)))
+          break;
+        if (fc::city_hash64(data.data(), size) != checksum)
+          break;
         try
         {
-          std::vector<potential_peer_record> peer_records = fc::json::from_file(_peer_database_filename).as<std::vector<potential_peer_record> >( GRAPHENE_NET_MAX_NESTED_OBJECTS );
-          std::copy(peer_records.begin(), peer_records.end(), std::inserter(_potential_peer_set, _potential_peer_set.end()));
-          if (_potential_peer_set.size() > MAXIMUM_PEERDB_SIZE)
+          if (data[0] == log_op_update)
           {
-            // prune database to a reasonable size
-            auto iter = _potential_peer_set.begin();
-            std::advance(iter, MAXIMUM_PEERDB_SIZE);
-            _potential_peer_set.erase(iter, _potential_peer_set.end());
+            potential_peer_record record = unpack_record(data);
+            auto iter = _potential_peer_set.get<endpoint_index>().find(record.endpoint);
+            if (iter != _potential_peer_set.get<endpoint_index>().end())
+              _potential_peer_set.get<endpoint_index>().replace(iter, record);
+            else
+              _potential_peer_set.get<endpoint_index>().insert(record);
           }
+          else if (data[0] == log_op_erase)
+          {
+            fc::datastream<const char*> ds(data.data() + 1, data.size() - 1);
+            fc::ip::endpoint endpoint;
+            fc::raw::unpack(ds, endpoint);
+            _potential_peer_set.get<endpoint_index>().erase(endpoint);
+          }
+          else
+            break;
         }
-        catch (const fc::exception& e)
+        catch (const fc::exception&)
         {
-          elog("error opening peer database file ${peer_database_filename}, starting with a clean database", 
-               ("peer_database_filename", _peer_database_filename));
+          break;
         }
+        valid_size += sizeof(size) + size + sizeof(checksum);
+        ++_log_entries;
       }
+      return valid_size;
     }
 
-    void peer_database_impl::close()
+    void peer_database_impl::append_log(log_op op, const std::vector<char>& payload)
     {
-      std::vector<potential_peer_record> peer_records;
-      peer_records.reserve(_potential_peer_set.size());
-      std::copy(_potential_peer_set.begin(), _potential_peer_set.end(), std::back_inserter(peer_records));
+      if (!_log.is_open())
+        return;
+      if (_log_entries >= 2 * _potential_peer_set.size() + MIN_LOG_ENTRIES_TO_COMPACT)
+      {
+        // the snapshot includes this change
+        write_snapshot();
+        return;
+      }
+      write_log_entry(_log, op, payload);
+      ++_log_entries;
+    }
 
+    void peer_database_impl::write_snapshot()
+    {
+      _log.close();
       try
       {
         fc::path peer_database_filename_dir = _peer_database_filename.parent_path();
         if (!fc::exists(peer_database_filename_dir))
           fc::create_directories(peer_database_filename_dir);
-        fc::json::save_to_file( peer_records, _peer_database_filename, GRAPHENE_NET_MAX_NESTED_OBJECTS );
+        fc::path tmp_filename = _peer_database_filename.generic_string() + ".tmp";
+        _log.open(tmp_filename.generic_string().c_str(), std::ios::binary | std::ios::out | std::ios::trunc);
+        _log_entries = 0;
+        for (const potential_peer_record& record : _potential_peer_set)
+        {
+          write_log_entry(_log, log_op_update, pack_record(record));
+          ++_log_entries;
+        }
+        _log.flush();
+        FC_ASSERT(_log.good(), "error writing ${tmp_filename}", ("tmp_filename", tmp_filename));
+        _log.close();
+        fc::rename(tmp_filename, _peer_database_filename);
+        _log.open(_peer_database_filename.generic_string().c_str(), std::ios::binary | std::ios::out | std::ios::app);
       }
       catch (const fc::exception& e)
       {
-        elog("error saving peer database to file ${peer_database_filename}", 
-             ("peer_database_filename", _peer_database_filename));
+        // stop logging changes rather than append them to a partial file
+        _log.close();
+        elog("error saving peer database to file ${peer_database_filename}: ${e}", 
+             ("peer_database_filename", _peer_database_filename)("e", e.to_detail_string()));
       }
+    }
+
+    void peer_database_impl::close()
+    {
+      if (_log.is_open())
+        write_snapshot();
+      _log.close();
       _potential_peer_set.clear();
     }
 
     void peer_database_impl::clear()
     {
       _potential_peer_set.clear();
+      if (_log.is_open())
+        write_snapshot();
     }
 
     void peer_database_impl::erase(const fc::ip::endpoint& endpointToErase)
     {
       auto iter = _potential_peer_set.get<endpoint_index>().find(endpointToErase);
       if (iter != _potential_peer_set.get<endpoint_index>().end())
+      {
         _potential_peer_set.get<endpoint_index>().erase(iter);
+        append_log(log_op_erase, fc::raw::pack(endpointToErase));
+      }
     }
 
     void peer_database_impl::update_entry(const potential_peer_record& updatedRecord)
@@ -155,6 +397,7 @@ namespace graphene { namespace net {
         _potential_peer_set.get<endpoint_index>().modify(iter, [&updatedRecord](potential_peer_record& record) { record = updatedRecord; });
       else
         _potential_peer_set.get<endpoint_index>().insert(updatedRecord);
+      append_log(log_op_update, pack_record(updatedRecord));
     }
 
     potential_peer_record peer_database_impl::lookup_or_create_entry_for_endpoint(const fc::ip::endpoint& endpointToLookup)
@@ -173,6 +416,27 @@ namespace graphene { namespace net {
       return fc::optional<potential_peer_record>();
     }
 
+    std::vector<potential_peer_record> peer_database_impl::get_connection_candidates(uint32_t limit, fc::time_point now, uint32_t retry_timeout_sec,
+                                                                                     const std::function<bool(const fc::ip::endpoint&)>& skip) const
+    {
+      std::vector<potential_peer_record> candidates;
+      for (auto iter = _potential_peer_set.get<score_index>().begin();
+           iter != _potential_peer_set.get<score_index>().end() && candidates.size() < limit;
+           ++iter)
+      {
+        fc::microseconds delay_until_retry = fc::seconds((iter->number_of_failed_connection_attempts + 1) * retry_timeout_sec);
+        if ((iter->last_connection_disposition == last_connection_failed ||
+             iter->last_connection_disposition == last_connection_rejected ||
+             iter->last_connection_disposition == last_connection_handshaking_failed) &&
+            (now - iter->last_connection_attempt_time) <= delay_until_retry)
+          continue;
+        if (skip && skip(iter->endpoint))
+          continue;
+        candidates.push_back(*iter);
+      }
+      return candidates;
+    }
+
     peer_database::iterator peer_database_impl::begin() const
     {
       return peer_database::iterator(new peer_database_iterator_impl(_potential_peer_set.get<last_seen_time_index>().begin()));
@@ -226,9 +490,9 @@ namespace graphene { namespace net {
   peer_database::~peer_database()
   {}
 
-  void peer_database::open(const fc::path& databaseFilename)
+  void peer_database::open(const fc::path& databaseFilename, size_t maximum_size)
   {
-    my->open(databaseFilename);
+    my->open(databaseFilename, maximum_size);
   }
 
   void peer_database::close()
@@ -261,6 +525,12 @@ namespace graphene { namespace net {
     return my->lookup_entry_for_endpoint(endpoint_to_lookup);
   }
 
+  std::vector<potential_peer_record> peer_database::get_connection_candidates(uint32_t limit, fc::time_point now, uint32_t retry_timeout_sec,
+                                                                              const std::function<bool(const fc::ip::endpoint&)>& skip) const
+  {
+    return my->get_connection_candidates(limit, now, retry_timeout_sec, skip);
+  }
+
   peer_database::iterator peer_database::begin() const
   {
     return my->begin();
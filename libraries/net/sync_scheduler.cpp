@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+#include <graphene/net/sync_scheduler.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace net {
+
+   namespace {
+      /// once this much receiving time has been accumulated, older measurements are given half the weight
+      const int64_t busy_time_horizon_us = 10 * 1000000;
+   }
+
+   void sync_peer_tracker::set_max_window( uint32_t max_window )
+   {
+      _max_window = std::max<uint32_t>( max_window, 1 );
+      _window_limit = std::min( _window_limit, _max_window );
+   }
+
+   void sync_peer_tracker::block_requested( const item_hash_t& block_id, fc::time_point now )
+   {
+      _outstanding.push_back( outstanding_request{ block_id, now, false } );
+   }
+
+   bool sync_peer_tracker::block_received( const item_hash_t& block_id, uint32_t size, fc::time_point now )
+   {
+      auto iter = std::find_if( _outstanding.begin(), _outstanding.end(),
+                                [&block_id]( const outstanding_request& request ) { return request.block_id == block_id; } );
+      if( iter == _outstanding.end() )
+         return false;
+
+      // the peer has been working on this block since it was requested or since the previous block
+      // arrived, whichever is later; time in between when nothing was outstanding doesn't count
+      const fc::time_point start_time = std::max( iter->request_time, _last_block_time );
+      _busy_us += std::max<int64_t>( (now - start_time).count(), 0 );
+      _busy_bytes += size;
+      if( _busy_us > busy_time_horizon_us )
+      {
+         _busy_us /= 2;
+         _busy_bytes /= 2;
+      }
+
+      const int64_t latency_us = std::max<int64_t>( (now - iter->request_time).count(), 0 );
+      const bool in_time = !iter->rerequested && latency_us <= straggler_timeout().count();
+      if( _blocks_received == 0 )
+         _latency_us = _min_latency_us = latency_us;
+      else
+      {
+         _latency_us += (latency_us - _latency_us) / 8;
+         _min_latency_us = std::min( _min_latency_us, latency_us );
+      }
+      if( in_time )
+         _window_limit = std::min( _window_limit + 1, _max_window );
+
+      _last_block_time = now;
+      ++_blocks_received;
+      _bytes_received += size;
+      _outstanding.erase( iter );
+      return true;
+   }
+
+   void sync_peer_tracker::request_cancelled( const item_hash_t& block_id )
+   {
+      _outstanding.erase( std::remove_if( _outstanding.begin(), _outstanding.end(),
+                                          [&block_id]( const outstanding_request& request ) { return request.block_id == block_id; } ),
+                          _outstanding.end() );
+   }
+
+   void sync_peer_tracker::straggler_rerequested( const item_hash_t& block_id )
+   {
+      for( outstanding_request& request : _outstanding )
+         if( request.block_id == block_id && !request.rerequested )
+         {
+            request.rerequested = true;
+            ++_blocks_rerequested;
+            _window_limit = std::max<uint32_t>( window() / 2, GRAPHENE_NET_MIN_BLOCKS_PER_PEER_DURING_SYNCING );
+            return;
+         }
+   }
+
+   uint64_t sync_peer_tracker::bytes_per_second()const
+   {
+      if( _busy_us <= 0 )
+         return 0;
+      return _busy_bytes * 1000000 / _busy_us;
+   }
+
+   uint32_t sync_peer_tracker::window()const
+   {
+      uint64_t result = std::min( _window_limit, _max_window );
+      if( _blocks_received > 0 && _busy_us > 0 )
+      {
+         // enough blocks to keep the peer busy for the target time plus one round trip.  The smoothed
+         // latency includes the time requests wait behind each other, so it can't be used here
+         const uint64_t average_block_size = std::max<uint64_t>( _bytes_received / _blocks_received, 1 );
+         const uint64_t target_ms = GRAPHENE_NET_SYNC_WINDOW_TARGET_MS + _min_latency_us / 1000;
+         result = std::min( result, bytes_per_second() * target_ms / 1000 / average_block_size + 1 );
+      }
+      return std::max<uint64_t>( result, std::min<uint32_t>( GRAPHENE_NET_MIN_BLOCKS_PER_PEER_DURING_SYNCING, _max_window ) );
+   }
+
+   uint32_t sync_peer_tracker::free_slots()const
+   {
+      const uint32_t current_window = window();
+      return current_window > _outstanding.size() ? current_window - _outstanding.size() : 0;
+   }
+
+   fc::microseconds sync_peer_tracker::straggler_timeout()const
+   {
+      return fc::microseconds( std::max<int64_t>( _latency_us * GRAPHENE_NET_SYNC_STRAGGLER_LATENCY_MULTIPLE,
+                                                  int64_t(GRAPHENE_NET_SYNC_STRAGGLER_MIN_TIMEOUT_MS) * 1000 ) );
+   }
+
+   std::vector<item_hash_t> sync_peer_tracker::get_stragglers( fc::time_point now )const
+   {
+      std::vector<item_hash_t> result;
+      const fc::time_point threshold = now - straggler_timeout();
+      for( const outstanding_request& request : _outstanding )
+      {
+         if( request.request_time >= threshold )
+            break; // requests are kept in the order they were sent
+         if( !request.rerequested )
+            result.push_back( request.block_id );
+      }
+      return result;
+   }
+
+   sync_peer_stats sync_peer_tracker::get_stats()const
+   {
+      sync_peer_stats result;
+      result.blocks_received = _blocks_received;
+      result.bytes_received = _bytes_received;
+      result.bytes_per_second = bytes_per_second();
+      result.latency_ms = _latency_us / 1000;
+      result.window = window();
+      result.blocks_outstanding = _outstanding.size();
+      result.blocks_rerequested = _blocks_rerequested;
+      return result;
+   }
+
+   std::vector<std::vector<item_hash_t>> schedule_sync_requests( const std::vector<sync_peer_candidate>& peers,
+                                                                 const std::function<bool(const item_hash_t&)>& already_requested,
+                                                                 std::unordered_set<item_hash_t>& rerequested,
+                                                                 uint32_t max_window, fc::time_point now )
+   {
+      std::vector<std::vector<item_hash_t>> result( peers.size() );
+      std::vector<uint32_t> free_slots( peers.size() );
+      std::vector<uint64_t> speed( peers.size() );
+      std::vector<size_t> order;
+      for( size_t i = 0; i < peers.size(); ++i )
+      {
+         peers[i].tracker->set_max_window( max_window );
+         speed[i] = peers[i].tracker->bytes_per_second();
+         if( peers[i].can_request )
+         {
+            free_slots[i] = peers[i].tracker->free_slots();
+            order.push_back( i );
+         }
+      }
+      // fastest first; peers we haven't measured yet go last, in connection order
+      std::stable_sort( order.begin(), order.end(), [&speed]( size_t a, size_t b ) { return speed[a] > speed[b]; } );
+
+      std::unordered_set<item_hash_t> scheduled;
+
+      // hand the requests which are holding things up to faster peers
+      for( size_t slow = 0; slow < peers.size(); ++slow )
+         for( const item_hash_t& block_id : peers[slow].tracker->get_stragglers( now ) )
+         {
+            if( rerequested.count( block_id ) )
+               continue;
+            for( size_t fast : order )
+            {
+               if( speed[fast] <= speed[slow] )
+                  break;
+               const auto& ids = *peers[fast].ids_of_items_to_get;
+               if( fast != slow && free_slots[fast] > 0 && std::find( ids.begin(), ids.end(), block_id ) != ids.end() )
+               {
+                  result[fast].push_back( block_id );
+                  --free_slots[fast];
+                  rerequested.insert( block_id );
+                  scheduled.insert( block_id );
+                  peers[slow].tracker->straggler_rerequested( block_id );
+                  break;
+               }
+            }
+         }
+
+      // then fill every window, earliest blocks to the fastest peers
+      for( size_t i : order )
+      {
+         for( const item_hash_t& block_id : *peers[i].ids_of_items_to_get )
+         {
+            if( free_slots[i] == 0 )
+               break;
+            if( scheduled.count( block_id ) || already_requested( block_id ) )
+               continue;
+            result[i].push_back( block_id );
+            --free_slots[i];
+            scheduled.insert( block_id );
+         }
+      }
+      return result;
+   }
+
+} } // graphene::net
@@ -0,0 +1,350 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+#include <graphene/change_feed/change_feed_plugin.hpp>
+
+#include <graphene/chain/database.hpp>
+
+#include <fc/io/raw.hpp>
+#include <fc/smart_ref_impl.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <atomic>
+#include <deque>
+#include <fstream>
+
+namespace graphene { namespace change_feed {
+
+namespace bpo = boost::program_options;
+
+namespace detail
+{
+
+class change_feed_plugin_impl
+{
+   public:
+      change_feed_plugin_impl( change_feed_plugin& _plugin )
+         : _self( _plugin )
+      { }
+      ~change_feed_plugin_impl();
+
+      graphene::chain::database& database()
+      {
+         return _self.database();
+      }
+
+      void start();
+      void stop();
+      void disconnect();
+
+      // called on the chain thread
+      void on_applied_block( const graphene::chain::signed_block& b );
+      void on_objects( const vector<object_id_type>& ids, change_kind kind );
+      void on_removed_objects( const vector<const graphene::db::object*>& objs );
+      void submit_current_block();
+      /// Wait for a block handed to the writer thread, and stop the feed if it was not written
+      void wait_for_write( fc::future<void>& f );
+
+      // called on the writer thread
+      void write_block( const change_feed_block& block );
+      void open_next_file();
+      void remove_old_files();
+
+      change_feed_plugin&                   _self;
+
+      fc::path                              _dir;
+      uint64_t                              _max_file_size  = 256 * 1024 * 1024;
+      uint32_t                              _max_files      = 0;
+      uint32_t                              _max_queue_size = 1000;
+
+      /// The block currently being collected
+      std::shared_ptr<change_feed_block>    _current;
+      /// Blocks handed to the writer thread and not known to be written yet
+      std::deque< fc::future<void> >        _pending;
+      std::atomic<uint32_t>                 _queued{ 0 };
+      std::unique_ptr<fc::thread>           _thread;
+      /// Set on the chain thread once a block failed to be written
+      bool                                  _stopped = false;
+
+      std::ofstream                         _file;
+      uint32_t                              _sequence  = 0;
+      uint64_t                              _file_size = 0;
+      /// Set on the writer thread once a record may be incomplete, nothing is written after it
+      bool                                  _write_failed = false;
+
+      boost::signals2::scoped_connection    _applied_block_conn;
+      boost::signals2::scoped_connection    _new_objects_conn;
+      boost::signals2::scoped_connection    _changed_objects_conn;
+      boost::signals2::scoped_connection    _removed_objects_conn;
+};
+
+change_feed_plugin_impl::~change_feed_plugin_impl()
+{
+   try {
+      stop();
+   } FC_CAPTURE_AND_LOG( (_dir) )
+}
+
+void change_feed_plugin_impl::start()
+{
+   fc::create_directories( _dir );
+
+   // Always start a new file, a previous run may have left an incomplete record at the end of the last one
+   for( boost::filesystem::directory_iterator itr( _dir.to_native_ansi_path() ), end; itr != end; ++itr )
+   {
+      uint32_t seq;
+      if( parse_change_feed_file_name( itr->path().filename().string(), seq ) && seq > _sequence )
+         _sequence = seq;
+   }
+
+   _thread.reset( new fc::thread( "change_feed" ) );
+   _thread->async( [this](){ open_next_file(); }, "change_feed open" ).wait();
+
+   auto& db = database();
+   _applied_block_conn = db.applied_block.connect( [this]( const graphene::chain::signed_block& b ){
+      on_applied_block( b );
+   } );
+   _new_objects_conn = db.new_objects.connect( [this]( const vector<object_id_type>& ids,
+                                                       const flat_set<graphene::chain::account_uid_type>& ){
+      on_objects( ids, object_created );
+   } );
+   _changed_objects_conn = db.changed_objects.connect( [this]( const vector<object_id_type>& ids,
+                                                               const flat_set<graphene::chain::account_uid_type>& ){
+      on_objects( ids, object_changed );
+   } );
+   _removed_objects_conn = db.removed_objects.connect( [this]( const vector<object_id_type>&,
+                                                               const vector<const graphene::db::object*>& objs,
+                                                               const flat_set<graphene::chain::account_uid_type>& ){
+      on_removed_objects( objs );
+   } );
+
+   ilog( "change_feed: writing to ${d}, starting with ${f}", ("d", _dir)("f", change_feed_file_name( _sequence )) );
+}
+
+void change_feed_plugin_impl::disconnect()
+{
+   _applied_block_conn.disconnect();
+   _new_objects_conn.disconnect();
+   _changed_objects_conn.disconnect();
+   _removed_objects_conn.disconnect();
+}
+
+void change_feed_plugin_impl::stop()
+{
+   disconnect();
+
+   if( !_thread )
+      return;
+
+   submit_current_block();
+   for( auto& f : _pending )
+      wait_for_write( f );
+   _pending.clear();
+
+   _thread->async( [this](){
+      if( _file.is_open() )
+         _file.close();
+   }, "change_feed close" ).wait();
+   _thread->quit();
+   _thread.reset();
+}
+
+void change_feed_plugin_impl::on_applied_block( const graphene::chain::signed_block& b )
+{
+   // new/changed/removed signals are emitted after applied_block, so whatever is left here
+   // belongs to the previous block
+   submit_current_block();
+
+   _current = std::make_shared<change_feed_block>();
+   _current->block_num = b.block_num();
+   _current->block_id  = b.id();
+   _current->timestamp = b.timestamp;
+}
+
+void change_feed_plugin_impl::on_objects( const vector<object_id_type>& ids, change_kind kind )
+{
+   if( !_current )
+      return;
+   const auto& db = database();
+   _current->objects.reserve( _current->objects.size() + ids.size() );
+   for( const auto& id : ids )
+   {
+      const graphene::db::object* obj = db.find_object( id );
+      if( obj == nullptr )
+         continue;
+      change_feed_object item;
+      item.id   = id;
+      item.kind = kind;
+      item.data = obj->pack();
+      _current->objects.emplace_back( std::move( item ) );
+   }
+}
+
+void change_feed_plugin_impl::on_removed_objects( const vector<const graphene::db::object*>& objs )
+{
+   if( !_current )
+      return;
+   _current->objects.reserve( _current->objects.size() + objs.size() );
+   for( const graphene::db::object* obj : objs )
+   {
+      change_feed_object item;
+      item.id   = obj->id;
+      item.kind = object_removed;
+      item.data = obj->pack();
+      _current->objects.emplace_back( std::move( item ) );
+   }
+   // removed_objects is the last of the three signals, the block is complete
+   submit_current_block();
+}
+
+void change_feed_plugin_impl::submit_current_block()
+{
+   if( !_current || !_thread )
+      return;
+
+   while( !_pending.empty() && _pending.front().ready() )
+   {
+      wait_for_write( _pending.front() );
+      _pending.pop_front();
+   }
+   if( _pending.size() >= _max_queue_size )
+   {
+      wlog( "change_feed: writer is ${n} blocks behind, waiting for it", ("n", _pending.size()) );
+      while( _pending.size() >= _max_queue_size )
+      {
+         wait_for_write( _pending.front() );
+         _pending.pop_front();
+      }
+   }
+   if( _stopped )
+   {
+      _current.reset();
+      return;
+   }
+
+   std::shared_ptr<change_feed_block> block = std::move( _current );
+   ++_queued;
+   _pending.emplace_back( _thread->async( [this,block](){ write_block( *block ); }, "change_feed write" ) );
+}
+
+void change_feed_plugin_impl::wait_for_write( fc::future<void>& f )
+{
+   try
+   {
+      f.wait();
+   }
+   catch( const fc::exception& e )
+   {
+      if( _stopped )
+         return;
+      // consumers find the feed ending at the last complete record instead of a gap in it
+      elog( "change_feed: stopping the feed, a block could not be written: ${e}", ("e", e.to_detail_string()) );
+      _stopped = true;
+      disconnect();
+   }
+}
+
+void change_feed_plugin_impl::write_block( const change_feed_block& block )
+{ try {
+   const bool caught_up = ( --_queued == 0 );
+   FC_ASSERT( !_write_failed, "The change feed is stopped after a failed write" );
+   _write_failed = true;
+
+   if( _file_size > 0 && _file_size + change_feed_frame_header_size + fc::raw::pack_size( block ) > _max_file_size )
+      open_next_file();
+
+   _file_size += write_change_feed_record( _file, block );
+
+   // group flushes when the writer catches up
+   if( caught_up )
+      _file.flush();
+   FC_ASSERT( _file.good(), "Failed to write change feed file ${f}", ("f", change_feed_file_name( _sequence )) );
+   _write_failed = false;
+} FC_CAPTURE_AND_RETHROW( (block.block_num)(block.block_id) ) }
+
+void change_feed_plugin_impl::open_next_file()
+{
+   if( _file.is_open() )
+      _file.close();
+   ++_sequence;
+   const fc::path path = _dir / change_feed_file_name( _sequence );
+   _file.open( path.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+   FC_ASSERT( _file.is_open(), "Unable to open change feed file ${f}", ("f", path) );
+   _file_size = 0;
+   remove_old_files();
+}
+
+void change_feed_plugin_impl::remove_old_files()
+{
+   if( _max_files == 0 || _sequence <= _max_files )
+      return;
+   const uint32_t first_kept = _sequence - _max_files + 1;
+   for( boost::filesystem::directory_iterator itr( _dir.to_native_ansi_path() ), end; itr != end; ++itr )
+   {
+      uint32_t seq;
+      if( parse_change_feed_file_name( itr->path().filename().string(), seq ) && seq < first_kept )
+         fc::remove( fc::path( itr->path() ) );
+   }
+}
+
+} // end namespace detail
+
+change_feed_plugin::change_feed_plugin() :
+   my( new detail::change_feed_plugin_impl(*this) )
+{
+}
+
+change_feed_plugin::~change_feed_plugin()
+{
+}
+
+std::string change_feed_plugin::plugin_name()const
+{
+   return "change_feed";
+}
+
+void change_feed_plugin::plugin_set_program_options(
+   boost::program_options::options_description& cli,
+   boost::program_options::options_description& cfg
+   )
+{
+   cli.add_options()
+         ("change-feed-dir", bpo::value<boost::filesystem::path>(), "Directory to write the object change feed to, the feed is disabled if not set")
+         ("change-feed-max-file-size", bpo::value<uint32_t>()->default_value(256), "Rotate change feed files when they reach this size in MiB")
+         ("change-feed-max-files", bpo::value<uint32_t>()->default_value(0), "Number of change feed files to keep, 0 to keep all")
+         ("change-feed-queue-size", bpo::value<uint32_t>()->default_value(1000), "Maximum number of blocks waiting to be written before block processing waits for the writer")
+         ;
+   cfg.add(cli);
+}
+
+void change_feed_plugin::plugin_initialize(const boost::program_options::variables_map& options)
+{
+   if( options.count("change-feed-dir") )
+   {
+      my->_dir = options["change-feed-dir"].as<boost::filesystem::path>();
+      if( my->_dir.is_relative() )
+         my->_dir = fc::current_path() / my->_dir;
+   }
+   if( options.count("change-feed-max-file-size") )
+      my->_max_file_size = uint64_t( std::max<uint32_t>( options["change-feed-max-file-size"].as<uint32_t>(), 1 ) ) * 1024 * 1024;
+   if( options.count("change-feed-max-files") )
+      my->_max_files = options["change-feed-max-files"].as<uint32_t>();
+   if( options.count("change-feed-queue-size") )
+      my->_max_queue_size = std::max<uint32_t>( options["change-feed-queue-size"].as<uint32_t>(), 1 );
+}
+
+void change_feed_plugin::plugin_startup()
+{
+   if( my->_dir == fc::path() )
+      return;
+   my->start();
+}
+
+void change_feed_plugin::plugin_shutdown()
+{
+   my->stop();
+}
+
+} }
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+#include <graphene/change_feed/change_feed_reader.hpp>
+
+#include <fc/crypto/city.hpp>
+#include <fc/exception/exception.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <boost/filesystem.hpp>
+
+namespace graphene { namespace change_feed {
+
+change_feed_reader::change_feed_reader( const fc::path& dir, const fc::optional<position>& start )
+   : _dir( dir )
+{
+   if( start.valid() )
+      _position = *start;
+}
+
+change_feed_reader::~change_feed_reader()
+{
+   if( _file.is_open() )
+      _file.close();
+}
+
+bool change_feed_reader::open_file( uint32_t sequence )
+{
+   if( !fc::exists( _dir ) )
+      return false;
+
+   bool found = false;
+   uint32_t best = 0;
+   for( boost::filesystem::directory_iterator itr( _dir.to_native_ansi_path() ), end; itr != end; ++itr )
+   {
+      uint32_t seq;
+      if( !parse_change_feed_file_name( itr->path().filename().string(), seq ) || seq < sequence )
+         continue;
+      if( !found || seq < best )
+      {
+         best = seq;
+         found = true;
+      }
+   }
+   if( !found )
+      return false;
+
+   if( _file.is_open() )
+      _file.close();
+   if( best != _position.sequence )
+      _position.offset = 0;
+   _position.sequence = best;
+   _file_path = _dir / change_feed_file_name( best );
+   _file.open( _file_path.generic_string().c_str(), std::ios::in | std::ios::binary );
+   return _file.is_open();
+}
+
+bool change_feed_reader::next_file_exists()const
+{
+   uint32_t seq;
+   for( boost::filesystem::directory_iterator itr( _dir.to_native_ansi_path() ), end; itr != end; ++itr )
+      if( parse_change_feed_file_name( itr->path().filename().string(), seq ) && seq > _position.sequence )
+         return true;
+   return false;
+}
+
+fc::optional<change_feed_block> change_feed_reader::read_next()
+{ try {
+   while( true )
+   {
+      if( !_file.is_open() && !open_file( _position.sequence ) )
+         return fc::optional<change_feed_block>();
+
+      const uint64_t file_size = fc::file_size( _file_path );
+      bool complete = false;
+      change_feed_frame_header header;
+      if( file_size >= _position.offset + change_feed_frame_header_size )
+      {
+         _file.clear();
+         _file.seekg( _position.offset );
+         fc::raw::unpack( _file, header );
+         complete = ( file_size >= _position.offset + change_feed_frame_header_size + header.size );
+      }
+
+      if( !complete )
+      {
+         // The writer only moves on to the next file after finishing the current one, so a partial
+         // record followed by a newer file is the tail of an interrupted write and is skipped.
+         if( next_file_exists() )
+         {
+            if( file_size > _position.offset )
+               wlog( "Skipping ${n} bytes of incomplete change feed record at the end of ${f}",
+                     ("n", file_size - _position.offset)("f", _file_path) );
+            _file.close();
+            _position.offset = 0;
+            ++_position.sequence;
+            continue;
+         }
+         return fc::optional<change_feed_block>();
+      }
+
+      vector<char> payload( header.size );
+      if( header.size > 0 )
+         _file.read( payload.data(), payload.size() );
+      FC_ASSERT( fc::city_hash64( payload.data(), payload.size() ) == header.checksum,
+                 "Corrupted change feed record in ${f} at offset ${o}",
+                 ("f", _file_path)("o", _position.offset) );
+
+      _position.offset += change_feed_frame_header_size + header.size;
+      return fc::raw::unpack<change_feed_block>( payload );
+   }
+} FC_CAPTURE_AND_RETHROW( (_dir)(_position.sequence)(_position.offset) ) }
+
+change_feed_block change_feed_reader::wait_next( const fc::microseconds& poll_interval )
+{
+   while( true )
+   {
+      auto result = read_next();
+      if( result.valid() )
+         return std::move( *result );
+      fc::usleep( poll_interval );
+   }
+}
+
+} } // graphene::change_feed
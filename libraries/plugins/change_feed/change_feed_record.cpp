@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+#include <graphene/change_feed/change_feed_record.hpp>
+
+#include <fc/crypto/city.hpp>
+#include <fc/io/raw.hpp>
+
+#include <cstdio>
+#include <ostream>
+
+namespace graphene { namespace change_feed {
+
+string change_feed_file_name( uint32_t sequence )
+{
+   char buf[32];
+   snprintf( buf, sizeof(buf), "change_feed.%010u.log", sequence );
+   return string( buf );
+}
+
+bool parse_change_feed_file_name( const string& name, uint32_t& sequence )
+{
+   static const string prefix = "change_feed.";
+   static const string suffix = ".log";
+   if( name.size() <= prefix.size() + suffix.size()
+         || name.compare( 0, prefix.size(), prefix ) != 0
+         || name.compare( name.size() - suffix.size(), suffix.size(), suffix ) != 0 )
+      return false;
+   const string digits = name.substr( prefix.size(), name.size() - prefix.size() - suffix.size() );
+   if( digits.find_first_not_of( "0123456789" ) != string::npos )
+      return false;
+   sequence = static_cast<uint32_t>( std::stoul( digits ) );
+   return true;
+}
+
+uint64_t write_change_feed_record( std::ostream& out, const change_feed_block& block )
+{
+   const vector<char> payload = fc::raw::pack( block );
+   change_feed_frame_header header;
+   header.size     = payload.size();
+   header.checksum = fc::city_hash64( payload.data(), payload.size() );
+   fc::raw::pack( out, header );
+   out.write( payload.data(), payload.size() );
+   return change_feed_frame_header_size + payload.size();
+}
+
+} } // graphene::change_feed
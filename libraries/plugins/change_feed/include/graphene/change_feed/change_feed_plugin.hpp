@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+#pragma once
+
+#include <graphene/app/plugin.hpp>
+#include <graphene/change_feed/change_feed_record.hpp>
+
+namespace graphene { namespace change_feed {
+
+namespace detail { class change_feed_plugin_impl; }
+
+/**
+ * Change data capture for off-chain indexers.
+ *
+ * For every applied block, collects the objects created, changed and removed by it and hands them to a
+ * background writer thread, which appends one length-prefixed binary record per block to rotating files
+ * in change-feed-dir. The chain thread only packs the touched objects; framing, hashing and file I/O
+ * happen on the writer thread. The queue between them is bounded by change-feed-queue-size blocks, when
+ * it is full block application waits for the writer instead of dropping records. If a record cannot be
+ * written, the feed stops there and an error is logged; after a restart it continues in a new file.
+ *
+ * Use change_feed_reader to consume the files.
+ */
+class change_feed_plugin : public graphene::app::plugin
+{
+   public:
+      change_feed_plugin();
+      virtual ~change_feed_plugin();
+
+      std::string plugin_name()const override;
+      virtual void plugin_set_program_options(
+         boost::program_options::options_description& cli,
+         boost::program_options::options_description& cfg) override;
+      virtual void plugin_initialize(const boost::program_options::variables_map& options) override;
+      virtual void plugin_startup() override;
+      virtual void plugin_shutdown() override;
+
+      friend class detail::change_feed_plugin_impl;
+      std::unique_ptr<detail::change_feed_plugin_impl> my;
+};
+
+} } //graphene::change_feed
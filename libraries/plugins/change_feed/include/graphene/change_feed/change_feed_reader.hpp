@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+#pragma once
+
+#include <graphene/change_feed/change_feed_record.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/optional.hpp>
+
+#include <fstream>
+
+namespace graphene { namespace change_feed {
+
+   /**
+    * Tails the files written by change_feed_plugin.
+    *
+    * The reader keeps its position as ( file sequence, offset ), which can be persisted by the consumer
+    * and passed back to resume. A record is only returned once it has been completely written, so it's
+    * safe to read a feed that is still being appended to.
+    */
+   class change_feed_reader
+   {
+      public:
+         struct position
+         {
+            uint32_t  sequence = 0;
+            uint64_t  offset   = 0;
+         };
+
+         /**
+          * @param dir directory the plugin writes to
+          * @param start where to resume; by default reading starts at the oldest file available
+          */
+         explicit change_feed_reader( const fc::path& dir, const fc::optional<position>& start = fc::optional<position>() );
+         ~change_feed_reader();
+
+         /**
+          * Read the next record.
+          *
+          * @return the record, or an empty optional if no complete record is available yet
+          * @throws fc::exception if a complete record fails its checksum
+          */
+         fc::optional<change_feed_block> read_next();
+
+         /**
+          * Block until the next record is available, checking for new data every @p poll_interval.
+          */
+         change_feed_block wait_next( const fc::microseconds& poll_interval = fc::milliseconds(100) );
+
+         /// Position of the next record to be read
+         position current_position()const { return _position; }
+
+      private:
+         /// Find the oldest file with sequence >= @p sequence, returns false if there is none
+         bool open_file( uint32_t sequence );
+         bool next_file_exists()const;
+
+         fc::path       _dir;
+         position       _position;
+         fc::path       _file_path;
+         std::ifstream  _file;
+   };
+
+} } // graphene::change_feed
+
+FC_REFLECT( graphene::change_feed::change_feed_reader::position, (sequence)(offset) )
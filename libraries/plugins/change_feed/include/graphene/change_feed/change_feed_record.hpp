@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+#pragma once
+
+#include <graphene/chain/protocol/types.hpp>
+#include <graphene/db/object_id.hpp>
+
+#include <fc/reflect/reflect.hpp>
+#include <fc/time.hpp>
+
+#include <iosfwd>
+
+namespace graphene { namespace change_feed {
+   using graphene::chain::block_id_type;
+   using graphene::db::object_id_type;
+   using std::string;
+   using std::vector;
+
+   enum change_kind
+   {
+      object_created = 0,
+      object_changed = 1,
+      object_removed = 2
+   };
+
+   /**
+    * One object touched by a block.
+    *
+    * @ref data is the object serialized with fc::raw::pack, for removed objects it is the last value
+    * before removal. The concrete type follows from id.space() and id.type().
+    */
+   struct change_feed_object
+   {
+      object_id_type  id;
+      uint8_t         kind = object_created;
+      vector<char>    data;
+   };
+
+   /**
+    * All objects created, changed and removed by one applied block.
+    *
+    * Records are written in the order blocks are applied. When the node switches to another fork,
+    * a block number may appear again with a different block_id, consumers should treat the later
+    * record as superseding everything they have seen at or above that block number.
+    */
+   struct change_feed_block
+   {
+      uint32_t                    block_num = 0;
+      block_id_type               block_id;
+      fc::time_point_sec          timestamp;
+      vector<change_feed_object>  objects;
+   };
+
+   /**
+    * On-disk framing of a record. A feed file is a sequence of frames, each one is this header
+    * followed by @ref size bytes holding a packed change_feed_block.
+    */
+   struct change_feed_frame_header
+   {
+      uint32_t  size     = 0;
+      uint64_t  checksum = 0; ///< fc::city_hash64 of the payload
+   };
+
+   /// Size of a packed change_feed_frame_header
+   const size_t change_feed_frame_header_size = sizeof(uint32_t) + sizeof(uint64_t);
+
+   /**
+    * Append @p block to @p out as one frame.
+    *
+    * @return the number of bytes written, check @p out to see whether they were written successfully
+    */
+   uint64_t write_change_feed_record( std::ostream& out, const change_feed_block& block );
+
+   /// Feed files are named change_feed.<sequence>.log, sequence numbers increase by one on each rotation
+   string change_feed_file_name( uint32_t sequence );
+
+   /// Parse the sequence number out of a feed file name, returns false for other files
+   bool parse_change_feed_file_name( const string& name, uint32_t& sequence );
+
+} } // graphene::change_feed
+
+FC_REFLECT_ENUM( graphene::change_feed::change_kind, (object_created)(object_changed)(object_removed) )
+FC_REFLECT( graphene::change_feed::change_feed_object, (id)(kind)(data) )
+FC_REFLECT( graphene::change_feed::change_feed_block, (block_num)(block_id)(timestamp)(objects) )
+FC_REFLECT( graphene::change_feed::change_feed_frame_header, (size)(checksum) )
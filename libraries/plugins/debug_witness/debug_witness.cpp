@@ -93,15 +93,24 @@ void debug_witness_plugin::plugin_initialize(const boost::program_options::varia
 void debug_witness_plugin::plugin_startup()
 {
    ilog("debug_witness_plugin::plugin_startup() begin");
-   chain::database& db = database();
+   // signals are only connected while a json object stream is open, see set_json_object_stream()
+   return;
+}
 
-   // connect needed signals
+void debug_witness_plugin::connect_json_object_stream_signals()
+{
+   chain::database& db = database();
 
    _applied_block_conn  = db.applied_block.connect([this](const graphene::chain::signed_block& b){ on_applied_block(b); });
    _changed_objects_conn = db.changed_objects.connect([this](const std::vector<graphene::db::object_id_type>& ids, const fc::flat_set<graphene::chain::account_uid_type>& impacted_accounts){ on_changed_objects(ids, impacted_accounts); });
    _removed_objects_conn = db.removed_objects.connect([this](const std::vector<graphene::db::object_id_type>& ids, const std::vector<const graphene::db::object*>& objs, const fc::flat_set<graphene::chain::account_uid_type>& impacted_accounts){ on_removed_objects(ids, objs, impacted_accounts); });
+}
 
-   return;
+void debug_witness_plugin::disconnect_json_object_stream_signals()
+{
+   _applied_block_conn.disconnect();
+   _changed_objects_conn.disconnect();
+   _removed_objects_conn.disconnect();
 }
 
 void debug_witness_plugin::on_changed_objects( const std::vector<graphene::db::object_id_type>& ids, const fc::flat_set<graphene::chain::account_uid_type>& impacted_accounts )
@@ -143,10 +152,12 @@ void debug_witness_plugin::set_json_object_stream( const std::string& filename )
 {
    if( _json_object_stream )
    {
+      disconnect_json_object_stream_signals();
       _json_object_stream->close();
       _json_object_stream.reset();
    }
    _json_object_stream = std::make_shared< std::ofstream >( filename );
+   connect_json_object_stream_signals();
 }
 
 void debug_witness_plugin::flush_json_object_stream()
@@ -157,6 +168,7 @@ void debug_witness_plugin::flush_json_object_stream()
 
 void debug_witness_plugin::plugin_shutdown()
 {
+   disconnect_json_object_stream_signals();
    if( _json_object_stream )
    {
       _json_object_stream->close();
@@ -52,6 +52,9 @@ public:
 
 private:
 
+   void connect_json_object_stream_signals();
+   void disconnect_json_object_stream_signals();
+
    void on_changed_objects( const std::vector<graphene::db::object_id_type>& ids, const fc::flat_set<graphene::chain::account_uid_type>& impacted_accounts );
    void on_removed_objects( const std::vector<graphene::db::object_id_type>& ids, const std::vector<const graphene::db::object*> objs, const fc::flat_set<graphene::chain::account_uid_type>& impacted_accounts );
    void on_applied_block( const graphene::chain::signed_block& b );
@@ -82,6 +82,8 @@ private:
    bool _consecutive_production_enabled = false;
    uint32_t _required_witness_participation = 33 * GRAPHENE_1_PERCENT;
    uint32_t _production_skip_flags = graphene::chain::database::skip_nothing;
+   /// transactions are included until this many milliseconds after the scheduled slot time
+   uint32_t _block_production_deadline_ms = 500;
 
    std::map<chain::public_key_type, fc::ecc::private_key> _private_keys;
    std::set<chain::account_uid_type> _witnesses;
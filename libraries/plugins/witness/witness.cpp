@@ -72,6 +72,8 @@ void witness_plugin::plugin_set_program_options(
          ("private-key", bpo::value<vector<string>>()->composing()->multitoken()->
           DEFAULT_VALUE_VECTOR(std::make_pair(chain::public_key_type(default_priv_key.get_public_key()), graphene::utilities::key_to_wif(default_priv_key))),
           "Tuple of [PublicKey, WIF private key] (may specify multiple times)")
+         ("block-production-deadline-ms", bpo::value<uint32_t>()->default_value(500),
+          "Stop including pending transactions this many milliseconds after the scheduled block time")
          ;
    config_file_options.add(command_line_options);
 }
@@ -86,6 +88,8 @@ void witness_plugin::plugin_initialize(const boost::program_options::variables_m
    ilog("witness plugin:  plugin_initialize() begin");
    _options = &options;
    LOAD_VALUE_SET(options, "witness", _witnesses, chain::account_uid_type )
+   if( options.count("block-production-deadline-ms") )
+      _block_production_deadline_ms = options["block-production-deadline-ms"].as<uint32_t>();
 
    if( options.count("private-key") )
    {
@@ -177,7 +181,8 @@ block_production_condition::block_production_condition_enum witness_plugin::bloc
    switch( result )
    {
       case block_production_condition::produced:
-         ilog("Generated block #${n} ${bid} with timestamp ${t} at time ${c} by ${w}/${wname}", (capture));
+         ilog("Generated block #${n} ${bid} with timestamp ${t} at time ${c} by ${w}/${wname}, "
+              "${i} transactions included, ${d} deferred, ${ms} ms", (capture));
          break;
       case block_production_condition::not_synced:
          ilog("Not producing block because production is disabled until we receive a recent block (see: --enable-stale-production)");
@@ -272,18 +277,26 @@ block_production_condition::block_production_condition_enum witness_plugin::mayb
    }
    const auto& witness_name = db.get_account_by_uid( scheduled_witness ).name;
 
+   // Leave the rest of the slot for signing, pushing and broadcasting the block
+   const fc::time_point deadline = fc::time_point( scheduled_time ) + fc::milliseconds( _block_production_deadline_ms );
+
    int retry = 0;
    do
    {
       try
       {
+         chain::block_generation_stats stats;
          auto block = db.generate_block(
             scheduled_time,
             scheduled_witness,
             private_key_itr->second,
-            _production_skip_flags
+            _production_skip_flags,
+            deadline,
+            stats
             );
-         capture("n", block.block_num())("t", block.timestamp)("c", now)("w",scheduled_witness)("wname",witness_name)("bid",block.id());
+         const fc::microseconds production_time = fc::time_point::now() - now_fine;
+         capture("n", block.block_num())("t", block.timestamp)("c", now)("w",scheduled_witness)("wname",witness_name)("bid",block.id())
+                ("i", stats.included)("d", stats.deferred)("ms", production_time.count() / 1000);
          fc::async( [this,block](){ p2p_node().broadcast(net::block_message(block)); } );
 
          return block_production_condition::produced;
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+
+#include <iostream>
+#include <thread>
+
+#include <fc/io/json.hpp>
+#include <fc/smart_ref_impl.hpp>
+
+#include <graphene/chain/block_database.hpp>
+#include <graphene/chain/protocol/fee_schedule.hpp>
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+using namespace graphene::chain;
+namespace bpo = boost::program_options;
+
+int main( int argc, char** argv )
+{
+   try
+   {
+      bpo::options_description cli_options("Verify the block database of a stopped node");
+      cli_options.add_options()
+            ("help,h", "Print this help message and exit.")
+            ("data-dir,d", bpo::value<boost::filesystem::path>()->default_value("yoyow_node_data_dir"), "Directory containing databases, configuration file, etc.")
+            ("threads,t", bpo::value<uint32_t>()->default_value( std::max( std::thread::hardware_concurrency(), 1u ) ),
+             "Number of threads reading and hashing blocks")
+            ;
+
+      bpo::variables_map options;
+      try
+      {
+         boost::program_options::store( boost::program_options::parse_command_line(argc, argv, cli_options), options );
+      }
+      catch (const boost::program_options::error& e)
+      {
+         std::cerr << "block_log_verify:  error parsing command line: " << e.what() << "\n";
+         return 1;
+      }
+
+      if( options.count("help") )
+      {
+         std::cout << cli_options << "\n";
+         return 1;
+      }
+
+      const fc::path block_dir = fc::path( options["data-dir"].as<boost::filesystem::path>() )
+                                 / "blockchain" / "database" / "block_num_to_block";
+      const uint32_t threads = options["threads"].as<uint32_t>();
+
+      const auto start = fc::time_point::now();
+      const block_log_verification result = block_database::verify( block_dir, threads );
+      const auto elapsed = fc::time_point::now() - start;
+
+      std::cout << fc::json::to_pretty_string( result ) << "\n";
+      std::cerr << "checked " << result.blocks_checked << " blocks in " << elapsed.count() / 1000 << " ms with "
+                << threads << " threads\n";
+      return result.ok() ? 0 : 1;
+   }
+   catch ( const fc::exception& e )
+   {
+      std::cerr << e.to_detail_string() << "\n";
+   }
+   return 1;
+}
@@ -0,0 +1,479 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <future>
+#include <random>
+#include <thread>
+
+#include <fc/io/json.hpp>
+#include <fc/smart_ref_impl.hpp>
+#include <fc/variant_object.hpp>
+
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/genesis_state.hpp>
+#include <graphene/chain/protocol/fee_schedule.hpp>
+#include <graphene/utilities/tempdir.hpp>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+using namespace graphene::chain;
+namespace bpo = boost::program_options;
+
+namespace {
+
+enum load_operation_type
+{
+   transfer_load,
+   post_load,
+   csaf_collect_load,
+   csaf_lease_load,
+   vote_load,
+   account_update_load,
+   load_operation_type_count
+};
+
+const char* const load_operation_names[load_operation_type_count] =
+   { "transfer", "post", "csaf_collect", "csaf_lease", "vote", "account_update" };
+
+/// What a generated transaction will do, decided in advance so that it can be built and signed on any thread
+struct planned_transaction
+{
+   load_operation_type type;
+   uint64_t            sequence = 0;
+   uint32_t            account = 0; ///< index of the fee payer in the load accounts
+   uint32_t            other = 0;   ///< index of the transfer or lease recipient
+   post_pid_type       post_pid = 0;
+   bool                first_vote = false;
+};
+
+/// Chain state a batch of transactions is built against, captured before the batch is handed to the signers
+struct signing_context
+{
+   chain_id_type  chain_id;
+   block_id_type  head_block_id;
+   time_point_sec head_block_time;
+};
+
+struct load_account
+{
+   account_uid_type     uid;
+   fc::ecc::private_key key;
+};
+
+struct load_generator
+{
+   std::vector<load_account>          accounts;
+   std::vector<account_uid_type>      witnesses;
+   fc::ecc::private_key               witness_key;
+   std::vector<public_key_type>       memo_keys;
+   std::vector<post_pid_type>         last_post_pid;
+   std::vector<bool>                  has_voted;
+   std::discrete_distribution<int>    mix;
+   std::mt19937_64                    rng;
+   uint64_t                           next_sequence = 0;
+   uint32_t                           post_size = 200;
+
+   genesis_state_type make_genesis( uint32_t account_count, time_point_sec initial_timestamp );
+
+   std::vector<planned_transaction>   plan_batch( uint32_t count );
+   signed_transaction                 build_transaction( const planned_transaction& plan, const signing_context& context )const;
+   std::vector<signed_transaction>    sign_batch( const std::vector<planned_transaction>& plans,
+                                                  const signing_context& context, uint32_t threads )const;
+};
+
+genesis_state_type load_generator::make_genesis( uint32_t account_count, time_point_sec initial_timestamp )
+{
+   genesis_state_type genesis;
+   genesis.initial_timestamp = initial_timestamp;
+   genesis.initial_parameters.current_fees->zero_all_fees();
+
+   witness_key = fc::ecc::private_key::regenerate( fc::sha256::hash( std::string( "load_generator witness" ) ) );
+   genesis.initial_active_witnesses = GRAPHENE_DEFAULT_MIN_WITNESS_COUNT;
+   for( uint32_t i = 0; i < genesis.initial_active_witnesses; ++i )
+   {
+      const string name = "init" + fc::to_string( i );
+      witnesses.push_back( calc_account_uid( 10 + i ) );
+      genesis.initial_accounts.emplace_back( witnesses.back(), name, 0, witness_key.get_public_key(),
+                                             public_key_type(), public_key_type(), public_key_type(), true );
+      genesis.initial_committee_candidates.push_back( { name } );
+      genesis.initial_witness_candidates.push_back( { name, witness_key.get_public_key() } );
+   }
+
+   // enough for every account to vote, lease and pledge a platform
+   const share_type balance = GRAPHENE_MAX_SHARE_SUPPLY / 2 / account_count;
+   for( uint32_t i = 0; i < account_count; ++i )
+   {
+      load_account account;
+      account.uid = calc_account_uid( 1000 + i );
+      account.key = fc::ecc::private_key::regenerate( fc::sha256::hash( "load_generator account " + fc::to_string( i ) ) );
+      genesis.initial_accounts.emplace_back( account.uid, "load" + fc::to_string( i ), 0, account.key.get_public_key() );
+      genesis.initial_account_balances.emplace_back( account.uid, GRAPHENE_SYMBOL, balance );
+      accounts.push_back( account );
+   }
+   for( uint32_t i = 0; i < 2; ++i )
+      memo_keys.push_back( fc::ecc::private_key::regenerate(
+                              fc::sha256::hash( "load_generator memo " + fc::to_string( i ) ) ).get_public_key() );
+
+   last_post_pid.resize( account_count, 0 );
+   has_voted.resize( account_count, false );
+   return genesis;
+}
+
+std::vector<planned_transaction> load_generator::plan_batch( uint32_t count )
+{
+   std::vector<planned_transaction> result( count );
+   for( planned_transaction& plan : result )
+   {
+      plan.type = load_operation_type( mix( rng ) );
+      plan.sequence = next_sequence++;
+      plan.account = rng() % accounts.size();
+      plan.other = ( plan.account + 1 + rng() % ( accounts.size() - 1 ) ) % accounts.size();
+      if( plan.type == post_load )
+         plan.post_pid = ++last_post_pid[plan.account];
+      else if( plan.type == vote_load && !has_voted[plan.account] )
+      {
+         plan.first_vote = true;
+         has_voted[plan.account] = true;
+      }
+   }
+   return result;
+}
+
+signed_transaction load_generator::build_transaction( const planned_transaction& plan, const signing_context& context )const
+{
+   const load_account& account = accounts[plan.account];
+   const load_account& other = accounts[plan.other];
+   // the first account runs the platform all posts go to
+   const load_account& platform = accounts.front();
+
+   signed_transaction trx;
+   switch( plan.type )
+   {
+      case transfer_load:
+      {
+         transfer_operation op;
+         op.from = account.uid;
+         op.to = other.uid;
+         op.amount = asset( int64_t( 1 + plan.sequence % 1000 ) );
+         trx.operations.push_back( op );
+         break;
+      }
+      case post_load:
+      {
+         post_operation op;
+         op.post_pid = plan.post_pid;
+         op.platform = platform.uid;
+         op.poster = account.uid;
+         op.hash_value = fc::to_string( plan.sequence );
+         op.title = "load test post " + fc::to_string( plan.sequence );
+         op.body = string( post_size, 'x' );
+         trx.operations.push_back( op );
+         break;
+      }
+      case csaf_collect_load:
+      {
+         csaf_collect_operation op;
+         op.from = account.uid;
+         op.to = account.uid;
+         op.amount = asset( 1 );
+         op.time = time_point_sec( context.head_block_time.sec_since_epoch() / 60 * 60 );
+         trx.operations.push_back( op );
+         break;
+      }
+      case csaf_lease_load:
+      {
+         csaf_lease_operation op;
+         op.from = account.uid;
+         op.to = other.uid;
+         op.amount = asset( int64_t( GRAPHENE_BLOCKCHAIN_PRECISION ) );
+         op.expiration = context.head_block_time + fc::seconds( 86400 + plan.sequence % 86400 );
+         trx.operations.push_back( op );
+         break;
+      }
+      case vote_load:
+      {
+         // an account's first vote adds a witness, later ones refresh its votes
+         witness_vote_update_operation op;
+         op.voter = account.uid;
+         if( plan.first_vote )
+            op.witnesses_to_add.insert( witnesses[plan.account % witnesses.size()] );
+         trx.operations.push_back( op );
+         break;
+      }
+      case account_update_load:
+      {
+         account_update_auth_operation op;
+         op.uid = account.uid;
+         op.memo_key = memo_keys[plan.sequence % memo_keys.size()];
+         trx.operations.push_back( op );
+         break;
+      }
+      default:
+         FC_THROW( "Unknown operation type ${t}", ("t", int( plan.type )) );
+   }
+
+   // spread the expiration times so that otherwise identical transactions get different ids
+   trx.set_expiration( context.head_block_time + fc::seconds( 60 + plan.sequence % 80000 ) );
+   trx.set_reference_block( context.head_block_id );
+   trx.sign( account.key, context.chain_id );
+   if( plan.type == post_load && account.uid != platform.uid )
+      trx.sign( platform.key, context.chain_id );
+   return trx;
+}
+
+std::vector<signed_transaction> load_generator::sign_batch( const std::vector<planned_transaction>& plans,
+                                                            const signing_context& context, uint32_t threads )const
+{
+   std::vector<signed_transaction> result( plans.size() );
+   std::vector<std::thread> workers;
+   for( uint32_t t = 0; t < threads; ++t )
+      workers.emplace_back( [this, &plans, &context, &result, t, threads]() {
+         for( size_t i = t; i < plans.size(); i += threads )
+            result[i] = build_transaction( plans[i], context );
+      } );
+   for( std::thread& worker : workers )
+      worker.join();
+   return result;
+}
+
+std::vector<double> parse_mix( const string& mix )
+{
+   std::vector<double> weights( load_operation_type_count, 0 );
+   std::vector<string> entries;
+   boost::split( entries, mix, boost::is_any_of( "," ) );
+   for( const string& entry : entries )
+   {
+      const auto separator = entry.find( '=' );
+      FC_ASSERT( separator != string::npos, "Operation mix entry '${e}' is not of the form name=weight", ("e", entry) );
+      const string name = boost::trim_copy( entry.substr( 0, separator ) );
+      const auto found = std::find_if( std::begin( load_operation_names ), std::end( load_operation_names ),
+                                       [&name]( const char* n ) { return name == n; } );
+      FC_ASSERT( found != std::end( load_operation_names ), "Unknown operation '${n}' in the operation mix", ("n", name) );
+      weights[found - std::begin( load_operation_names )] = std::stod( entry.substr( separator + 1 ) );
+   }
+   FC_ASSERT( std::any_of( weights.begin(), weights.end(), []( double w ) { return w > 0; } ),
+              "The operation mix is empty" );
+   return weights;
+}
+
+int64_t percentile( std::vector<int64_t>& samples, double fraction )
+{
+   if( samples.empty() )
+      return 0;
+   const size_t index = std::min( samples.size() - 1, size_t( samples.size() * fraction ) );
+   std::nth_element( samples.begin(), samples.begin() + index, samples.end() );
+   return samples[index];
+}
+
+signed_block generate_block( database& db, const load_generator& generator, uint32_t skip, uint32_t slot = 1 )
+{
+   return db.generate_block( db.get_slot_time( slot ), db.get_scheduled_witness( slot ), generator.witness_key,
+                             skip | database::skip_undo_history_check );
+}
+
+}
+
+int main( int argc, char** argv )
+{
+   try
+   {
+      bpo::options_description cli_options("Generate a transaction load against an in-process database and report its throughput");
+      cli_options.add_options()
+            ("help,h", "Print this help message and exit.")
+            ("accounts,a", bpo::value<uint32_t>()->default_value(1000), "Number of funded accounts created at genesis")
+            ("blocks,b", bpo::value<uint32_t>()->default_value(100), "Number of blocks to produce under load")
+            ("rate,r", bpo::value<uint32_t>()->default_value(2000), "Transactions pushed per block")
+            ("threads,t", bpo::value<uint32_t>()->default_value( std::max( std::thread::hardware_concurrency(), 1u ) ),
+             "Number of threads signing transactions")
+            ("mix,m", bpo::value<string>()->default_value("transfer=40,post=20,csaf_collect=10,csaf_lease=10,vote=10,account_update=10"),
+             "Relative weights of the generated operations")
+            ("post-size", bpo::value<uint32_t>()->default_value(200), "Size of the body of generated posts in bytes")
+            ("seed", bpo::value<uint64_t>()->default_value(1), "Seed of the operation and account choices")
+            ("warmup-minutes", bpo::value<uint32_t>()->default_value(60),
+             "Chain time to skip after genesis so that accounts have CSAF to collect")
+            ("skip-signature-checks", "Don't verify transaction signatures when pushing transactions and blocks")
+            ("data-dir,d", bpo::value<boost::filesystem::path>(),
+             "Directory to create the database in, must not exist yet. A temporary directory is used by default.")
+            ;
+
+      bpo::variables_map options;
+      try
+      {
+         boost::program_options::store( boost::program_options::parse_command_line(argc, argv, cli_options), options );
+      }
+      catch (const boost::program_options::error& e)
+      {
+         std::cerr << "load_generator:  error parsing command line: " << e.what() << "\n";
+         return 1;
+      }
+
+      if( options.count("help") )
+      {
+         std::cout << cli_options << "\n";
+         return 1;
+      }
+
+      const uint32_t account_count = options["accounts"].as<uint32_t>();
+      const uint32_t block_count = options["blocks"].as<uint32_t>();
+      const uint32_t rate = options["rate"].as<uint32_t>();
+      const uint32_t threads = std::max( options["threads"].as<uint32_t>(), 1u );
+      const uint32_t skip = options.count("skip-signature-checks") ? uint32_t(database::skip_transaction_signatures)
+                                                                   : uint32_t(database::skip_nothing);
+      FC_ASSERT( account_count >= 2, "Need at least 2 accounts" );
+      FC_ASSERT( block_count > 0, "Need at least 1 block" );
+
+      fc::optional<fc::temp_directory> temp_dir;
+      fc::path data_dir;
+      if( options.count("data-dir") )
+      {
+         data_dir = fc::path( options["data-dir"].as<boost::filesystem::path>() );
+         FC_ASSERT( !fc::exists( data_dir ), "${d} already exists", ("d", data_dir) );
+      }
+      else
+      {
+         temp_dir = fc::temp_directory( graphene::utilities::temp_directory_path() );
+         data_dir = temp_dir->path();
+      }
+
+      load_generator generator;
+      const std::vector<double> weights = parse_mix( options["mix"].as<string>() );
+      generator.mix = std::discrete_distribution<int>( weights.begin(), weights.end() );
+      generator.rng.seed( options["seed"].as<uint64_t>() );
+      generator.post_size = options["post-size"].as<uint32_t>();
+
+      // start far enough in the past that the chain doesn't run ahead of the clock
+      const uint32_t warmup_seconds = options["warmup-minutes"].as<uint32_t>() * 60;
+      const uint32_t chain_seconds = warmup_seconds + ( block_count + 10 ) * GRAPHENE_DEFAULT_BLOCK_INTERVAL;
+      const time_point_sec genesis_time( ( fc::time_point::now().sec_since_epoch() - chain_seconds )
+                                         / GRAPHENE_DEFAULT_BLOCK_INTERVAL * GRAPHENE_DEFAULT_BLOCK_INTERVAL );
+      const genesis_state_type genesis = generator.make_genesis( account_count, genesis_time );
+
+      database db;
+      db.open( data_dir, [&genesis]{ return genesis; }, "load_generator" );
+      std::cerr << "created " << account_count << " accounts in " << data_dir.string() << "\n";
+
+      // set up the platform posts go to, then let the accounts earn some CSAF
+      {
+         const load_account& owner = generator.accounts.front();
+         platform_create_operation op;
+         op.account = owner.uid;
+         op.pledge = asset( int64_t( db.get_global_properties().parameters.platform_min_pledge ) );
+         op.name = "load test platform";
+         op.url = "http://localhost";
+         signed_transaction trx;
+         trx.operations.push_back( op );
+         trx.set_expiration( db.head_block_time() + fc::minutes( 1 ) );
+         trx.set_reference_block( db.head_block_id() );
+         trx.sign( owner.key, db.get_chain_id() );
+         db.push_transaction( trx, skip );
+         generate_block( db, generator, skip );
+         const uint32_t warmup_slots = warmup_seconds / db.get_global_properties().parameters.block_interval;
+         if( warmup_slots > 1 )
+            generate_block( db, generator, skip, warmup_slots );
+      }
+
+      std::vector<int64_t> push_latencies;
+      push_latencies.reserve( uint64_t( rate ) * block_count );
+      std::vector<uint64_t> rejected( load_operation_type_count, 0 );
+      std::vector<uint64_t> planned( load_operation_type_count, 0 );
+      uint64_t accepted = 0;
+      uint64_t included = 0;
+      int64_t push_us = 0;
+      int64_t block_us = 0;
+      int64_t max_block_us = 0;
+      int64_t signing_wait_us = 0;
+
+      auto sign_next_batch = [&]( std::vector<planned_transaction> plans ) {
+         signing_context context;
+         context.chain_id = db.get_chain_id();
+         context.head_block_id = db.head_block_id();
+         context.head_block_time = db.head_block_time();
+         return std::async( std::launch::async, [&generator, context, threads]( std::vector<planned_transaction> batch_plans ) {
+            auto transactions = generator.sign_batch( batch_plans, context, threads );
+            return std::make_pair( std::move( batch_plans ), std::move( transactions ) );
+         }, std::move( plans ) );
+      };
+
+      // sign the next batch while the current one is pushed
+      auto next_batch = sign_next_batch( generator.plan_batch( rate ) );
+      const fc::time_point start = fc::time_point::now();
+      for( uint32_t block = 0; block < block_count; ++block )
+      {
+         fc::time_point wait_start = fc::time_point::now();
+         auto batch = next_batch.get();
+         signing_wait_us += ( fc::time_point::now() - wait_start ).count();
+         if( block + 1 < block_count )
+            next_batch = sign_next_batch( generator.plan_batch( rate ) );
+
+         for( size_t i = 0; i < batch.second.size(); ++i )
+         {
+            const planned_transaction& plan = batch.first[i];
+            ++planned[plan.type];
+            const fc::time_point push_start = fc::time_point::now();
+            try
+            {
+               db.push_transaction( batch.second[i], skip );
+               ++accepted;
+            }
+            catch( const fc::exception& e )
+            {
+               if( rejected[plan.type]++ == 0 )
+                  std::cerr << "first rejected " << load_operation_names[plan.type] << ": " << e.to_string() << "\n";
+            }
+            const int64_t latency = ( fc::time_point::now() - push_start ).count();
+            push_latencies.push_back( latency );
+            push_us += latency;
+         }
+
+         const fc::time_point block_start = fc::time_point::now();
+         block_generation_stats stats;
+         db.generate_block( db.get_slot_time( 1 ), db.get_scheduled_witness( 1 ), generator.witness_key,
+                            skip | database::skip_undo_history_check, fc::time_point::maximum(), stats );
+         const int64_t elapsed = ( fc::time_point::now() - block_start ).count();
+         block_us += elapsed;
+         max_block_us = std::max( max_block_us, elapsed );
+         included += stats.included;
+      }
+      const int64_t total_us = std::max<int64_t>( ( fc::time_point::now() - start ).count(), 1 );
+
+      fc::mutable_variant_object operations;
+      for( int type = 0; type < load_operation_type_count; ++type )
+         if( planned[type] > 0 )
+            operations( load_operation_names[type], fc::mutable_variant_object( "pushed", planned[type] )( "rejected", rejected[type] ) );
+
+      const uint64_t pushed = push_latencies.size();
+      fc::mutable_variant_object report;
+      report( "accounts", account_count )
+            ( "blocks", block_count )
+            ( "transactions_per_block", rate )
+            ( "signing_threads", threads )
+            ( "signatures_checked", skip == database::skip_nothing )
+            ( "operations", operations )
+            ( "transactions_pushed", pushed )
+            ( "transactions_accepted", accepted )
+            ( "transactions_in_blocks", included )
+            ( "elapsed_ms", total_us / 1000 )
+            ( "accepted_tps", accepted * 1000000 / total_us )
+            ( "push_only_tps", accepted * 1000000 / std::max<int64_t>( push_us, 1 ) )
+            ( "push_latency_us", fc::mutable_variant_object( "p50", percentile( push_latencies, 0.5 ) )
+                                                           ( "p99", percentile( push_latencies, 0.99 ) )
+                                                           ( "max", percentile( push_latencies, 1.0 ) ) )
+            ( "block_generation_ms", fc::mutable_variant_object( "average", double( block_us ) / block_count / 1000 )
+                                                               ( "max", double( max_block_us ) / 1000 ) )
+            ( "signing_wait_ms", signing_wait_us / 1000 );
+      std::cout << fc::json::to_pretty_string( report ) << "\n";
+
+      db.close();
+      return 0;
+   }
+   catch ( const fc::exception& e )
+   {
+      std::cerr << e.to_detail_string() << "\n";
+   }
+   return 1;
+}
@@ -898,6 +898,17 @@ void set_expiration( const database& db, transaction& tx )
    return;
 }
 
+vector<signed_block> make_linked_blocks( size_t count )
+{
+   vector<signed_block> blocks( count );
+   for( size_t i = 1; i < blocks.size(); ++i )
+   {
+      blocks[i].previous = blocks[i-1].id();
+      blocks[i].timestamp = blocks[i-1].timestamp + GRAPHENE_DEFAULT_BLOCK_INTERVAL;
+   }
+   return blocks;
+}
+
 bool _push_block( database& db, const signed_block& b, uint32_t skip_flags /* = 0 */ )
 {
    return db.push_block( b, skip_flags);
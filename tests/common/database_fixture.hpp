@@ -279,6 +279,8 @@ struct database_fixture {
 namespace test {
 /// set a reasonable expiration time for the transaction
 void set_expiration( const database& db, transaction& tx );
+/// @return @p count empty blocks, each linked to the one before it and produced one block interval later
+vector<signed_block> make_linked_blocks( size_t count );
 
 bool _push_block( database& db, const signed_block& b, uint32_t skip_flags = 0 );
 processed_transaction _push_transaction( database& db, const signed_transaction& tx, uint32_t skip_flags = 0 );
@@ -32,9 +32,19 @@
 
 #include <graphene/db/simple_index.hpp>
 
+#include <graphene/net/peer_connection.hpp>
+#include <graphene/net/message_cache.hpp>
+#include <graphene/net/blockchain_synopsis.hpp>
+#include <graphene/net/peer_database.hpp>
+#include <graphene/utilities/tempdir.hpp>
+
+#include <fc/bitutil.hpp>
 #include <fc/crypto/digest.hpp>
+#include <fc/io/json.hpp>
 #include "../common/database_fixture.hpp"
 
+#include <random>
+
 using namespace graphene::chain;
 
 //BOOST_FIXTURE_TEST_SUITE( performance_tests, database_fixture )
@@ -51,6 +61,452 @@ BOOST_AUTO_TEST_CASE( sigcheck_benchmark )
    auto elapsed = end-start;
    wdump( ((100000.0*1000000.0) / elapsed.count()) );
 }
+
+template<typename Lambda>
+static void run_modify_benchmark( const char* name, uint32_t count, const Lambda& modify_once )
+{
+   auto start = fc::time_point::now();
+   for( uint32_t i = 0; i < count; ++i )
+      modify_once();
+   auto elapsed = fc::time_point::now() - start;
+   ilog( "${name}: ${n} modifies in ${ms} ms, ${rate} per second",
+         ("name",name)("n",count)("ms",elapsed.count()/1000)("rate",uint64_t(count*1000000.0/elapsed.count())) );
+}
+
+BOOST_FIXTURE_TEST_CASE( object_modify_benchmark, database_fixture )
+{
+   const uint32_t count = 1000 * 1000;
+   const account_statistics_object& stats = db.get_account_statistics_by_uid( GRAPHENE_COMMITTEE_ACCOUNT_UID );
+   auto bump = [&]( account_statistics_object& s ) { ++s.witness_total_reported; };
+
+   graphene::db::index& virtual_idx = const_cast<graphene::db::index&>( db.get_index_type<account_statistics_index>() );
+   {
+      auto session = db._undo_db.start_undo_session();
+      run_modify_benchmark( "virtual index::modify, undo enabled", count, [&]() { virtual_idx.modify( stats, bump ); } );
+   }
+   {
+      auto session = db._undo_db.start_undo_session();
+      run_modify_benchmark( "database::modify, undo enabled", count, [&]() { db.modify( stats, bump ); } );
+   }
+
+   db._undo_db.disable();
+   run_modify_benchmark( "virtual index::modify, undo disabled", count, [&]() { virtual_idx.modify( stats, bump ); } );
+   run_modify_benchmark( "database::modify, undo disabled", count, [&]() { db.modify( stats, bump ); } );
+   db._undo_db.enable();
+}
+
+BOOST_AUTO_TEST_CASE( advertise_inventory_benchmark )
+{
+   using graphene::net::item_id;
+   using graphene::net::inventory_filter;
+   using graphene::net::peer_connection;
+
+   // each round advertises a batch of new transactions to every peer, like one iteration of the
+   // node's advertise inventory loop
+   const uint32_t batch_size = 100;
+   for( uint32_t peer_count : { 8u, 32u, 128u } )
+   {
+      for( uint32_t known_items : { 10000u, 100000u } )
+      {
+         const uint32_t rounds = known_items / batch_size;
+         std::vector<item_id> items;
+         items.reserve( known_items );
+         for( uint32_t i = 0; i < known_items; ++i )
+            items.emplace_back( graphene::net::trx_message_type, fc::ripemd160::hash( (const char*)&i, sizeof(i) ) );
+
+         const fc::time_point now = fc::time_point::now();
+         std::vector<peer_connection::timestamped_items_set_type> exact_sets( peer_count );
+         auto start = fc::time_point::now();
+         uint64_t advertised = 0;
+         for( uint32_t r = 0; r < rounds; ++r )
+            for( auto& known : exact_sets )
+               for( uint32_t i = r * batch_size; i < ( r + 1 ) * batch_size; ++i )
+                  if( known.find( items[i] ) == known.end() )
+                  {
+                     known.insert( peer_connection::timestamped_item_id( items[i], now ) );
+                     ++advertised;
+                  }
+         auto elapsed = fc::time_point::now() - start;
+         ilog( "exact sets, ${p} peers, ${k} items: ${n} advertised in ${ms} ms, ${rate} per second",
+               ("p",peer_count)("k",known_items)("n",advertised)("ms",elapsed.count()/1000)
+               ("rate",uint64_t(advertised*1000000.0/elapsed.count())) );
+         exact_sets.clear();
+
+         std::vector<inventory_filter> filters( peer_count );
+         start = fc::time_point::now();
+         advertised = 0;
+         for( uint32_t r = 0; r < rounds; ++r )
+            for( auto& known : filters )
+               for( uint32_t i = r * batch_size; i < ( r + 1 ) * batch_size; ++i )
+                  if( !known.contains( items[i], now ) )
+                  {
+                     known.insert( items[i], now );
+                     ++advertised;
+                  }
+         elapsed = fc::time_point::now() - start;
+         ilog( "inventory filters, ${p} peers, ${k} items: ${n} advertised in ${ms} ms, ${rate} per second, ${kb} KiB per peer",
+               ("p",peer_count)("k",known_items)("n",advertised)("ms",elapsed.count()/1000)
+               ("rate",uint64_t(advertised*1000000.0/elapsed.count()))("kb",filters.front().memory_usage()/1024) );
+      }
+   }
+}
+
+BOOST_AUTO_TEST_CASE( message_cache_benchmark )
+{
+   using namespace graphene::net;
+
+   // 2000 transactions per second in 3 second blocks, for 10 times the cache duration
+   const uint32_t trx_per_block = 2000 * 3;
+   const uint32_t blocks = GRAPHENE_NET_MESSAGE_CACHE_DURATION_IN_BLOCKS * 10;
+   blockchain_tied_message_cache cache;
+
+   std::vector<shared_message> bodies;
+   std::vector<message_hash_type> hashes;
+   bodies.reserve( trx_per_block );
+   hashes.reserve( trx_per_block );
+   for( uint32_t i = 0; i < trx_per_block; ++i )
+   {
+      bodies.push_back( std::make_shared<const message>(
+            item_ids_inventory_message( i, std::vector<item_hash_t>( 10, fc::ripemd160::hash( (const char*)&i, sizeof(i) ) ) ) ) );
+      hashes.push_back( bodies.back()->id() );
+   }
+
+   fc::microseconds insert_time, lookup_time, expire_time;
+   uint64_t lookups_found = 0;
+   const message_propagation_data propagation_data{ fc::time_point::now(), fc::time_point::now(), node_id_t() };
+   for( uint32_t b = 0; b < blocks; ++b )
+   {
+      // make every block's hashes unique by mixing in the block number
+      auto start = fc::time_point::now();
+      for( uint32_t i = 0; i < trx_per_block; ++i )
+      {
+         message_hash_type hash = hashes[i];
+         hash._hash[0] ^= b;
+         cache.cache_message( bodies[i], hash, propagation_data, hash );
+      }
+      insert_time += fc::time_point::now() - start;
+
+      start = fc::time_point::now();
+      for( uint32_t i = 0; i < trx_per_block; ++i )
+      {
+         // look up messages of every block which is still cached
+         const uint32_t age = std::min<uint32_t>( i % GRAPHENE_NET_MESSAGE_CACHE_DURATION_IN_BLOCKS, b );
+         message_hash_type hash = hashes[i];
+         hash._hash[0] ^= b - age;
+         if( cache.get_message( hash ) )
+            ++lookups_found;
+      }
+      lookup_time += fc::time_point::now() - start;
+
+      start = fc::time_point::now();
+      cache.block_accepted();
+      expire_time += fc::time_point::now() - start;
+   }
+   const uint64_t operations = uint64_t( trx_per_block ) * blocks;
+   ilog( "message cache: ${n} inserts in ${ms} ms, ${rate} per second",
+         ("n",operations)("ms",insert_time.count()/1000)("rate",uint64_t(operations*1000000.0/insert_time.count())) );
+   ilog( "message cache: ${n} lookups in ${ms} ms, ${rate} per second",
+         ("n",lookups_found)("ms",lookup_time.count()/1000)("rate",uint64_t(lookups_found*1000000.0/lookup_time.count())) );
+   ilog( "message cache: ${n} block expiries in ${ms} ms, ${us} us per block, ${size} messages cached",
+         ("n",blocks)("ms",expire_time.count()/1000)("us",expire_time.count()/blocks)("size",cache.size()) );
+}
+
+BOOST_AUTO_TEST_CASE( sync_synopsis_benchmark )
+{
+   using namespace graphene::net;
+
+   // catch up on 1M blocks from in-process peers which each know the ids of the next blocks we need
+   const uint32_t total_blocks = 1000 * 1000;
+   const uint32_t peer_count = 8;
+   const uint32_t blocks_per_round = GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING;
+   const uint32_t irreversible_lag = 30;
+   const uint32_t ids_known_ahead = GRAPHENE_NET_MIN_BLOCK_IDS_TO_PREFETCH;
+
+   std::vector<item_hash_t> chain( total_blocks + ids_known_ahead + 1 );
+   for( uint32_t num = 1; num < chain.size(); ++num )
+   {
+      chain[num] = fc::ripemd160::hash( (const char*)&num, sizeof(num) );
+      chain[num]._hash[0] = fc::endian_reverse_u32( num );
+   }
+   uint64_t lookups = 0;
+   auto get_block_id_for_num = [&]( uint32_t num ) { ++lookups; return chain[num]; };
+
+   // the synopsis of our chain from the last irreversible block to the head, followed by the peer's ids
+   auto our_synopsis = [&]( uint32_t low_block_num, uint32_t head_block_num, uint32_t true_high_block_num,
+                            const std::function<item_hash_t(uint32_t)>& id_for_num ) {
+      std::vector<item_hash_t> synopsis;
+      do
+      {
+         synopsis.push_back( id_for_num( low_block_num ) );
+         low_block_num += ( true_high_block_num - low_block_num + 2 ) / 2;
+      }
+      while( low_block_num <= head_block_num );
+      return synopsis;
+   };
+
+   for( bool incremental : { false, true } )
+   {
+      std::vector<boost::container::deque<item_hash_t>> peers( peer_count );
+      for( auto& ids_of_items_to_get : peers )
+         ids_of_items_to_get.assign( chain.begin() + 1, chain.begin() + 1 + ids_known_ahead );
+      block_id_cache cache;
+      lookups = 0;
+      uint64_t synopsis_points = 0;
+      fc::microseconds elapsed;
+
+      for( uint32_t head = 0; head < total_blocks; head += blocks_per_round )
+      {
+         const uint32_t low_block_num = std::max( head > irreversible_lag ? head - irreversible_lag : 0, 1u );
+         const auto start = fc::time_point::now();
+         for( auto& ids_of_items_to_get : peers )
+         {
+            std::vector<item_hash_t> synopsis;
+            const uint32_t true_high_block_num = head + ids_of_items_to_get.size();
+            if( incremental )
+            {
+               cache.update( low_block_num, head, chain[head], get_block_id_for_num );
+               if( head > 0 )
+                  synopsis = our_synopsis( low_block_num, head, true_high_block_num,
+                                           [&]( uint32_t num ) { return cache.at( num ); } );
+               append_synopsis_tail( synopsis, synopsis.empty() ? 1 : low_block_num, ids_of_items_to_get, head + 1 );
+            }
+            else
+            {
+               std::vector<item_hash_t> original_ids_of_items_to_get( ids_of_items_to_get.begin(), ids_of_items_to_get.end() );
+               if( head > 0 )
+                  synopsis = our_synopsis( low_block_num, head, true_high_block_num, get_block_id_for_num );
+               uint32_t num = synopsis.empty() ? 1 : low_block_num;
+               do
+               {
+                  if( num > head )
+                     synopsis.push_back( original_ids_of_items_to_get[num - head - 1] );
+                  num += ( true_high_block_num - num + 2 ) / 2;
+               }
+               while( num <= true_high_block_num );
+            }
+            synopsis_points += synopsis.size();
+         }
+         elapsed += fc::time_point::now() - start;
+
+         // we fetch the next blocks, and the peers tell us the ids after the ones we knew
+         for( auto& ids_of_items_to_get : peers )
+         {
+            ids_of_items_to_get.erase( ids_of_items_to_get.begin(), ids_of_items_to_get.begin() + blocks_per_round );
+            ids_of_items_to_get.insert( ids_of_items_to_get.end(),
+                                        chain.begin() + head + ids_known_ahead + 1,
+                                        chain.begin() + head + ids_known_ahead + 1 + blocks_per_round );
+         }
+      }
+      const uint64_t synopses = uint64_t( peer_count ) * ( total_blocks / blocks_per_round );
+      ilog( "${mode} synopses: ${n} synopses of ${points} points in ${ms} ms, ${us} us per synopsis, ${lookups} block id lookups",
+            ("mode",incremental ? "incremental" : "full")("n",synopses)("points",synopsis_points)
+            ("ms",elapsed.count()/1000)("us",elapsed.count()/synopses)("lookups",lookups) );
+   }
+}
+
+BOOST_AUTO_TEST_CASE( peer_database_benchmark )
+{
+   using namespace graphene::net;
+
+   const uint32_t record_count = 100 * 1000;
+   const uint32_t selections = 10 * 1000;
+   fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+   const fc::path filename = data_dir.path() / "peers.dat";
+   const fc::time_point now = fc::time_point::now();
+
+   std::vector<potential_peer_record> records;
+   records.reserve( record_count );
+   for( uint32_t i = 0; i < record_count; ++i )
+   {
+      potential_peer_record record( fc::ip::endpoint( fc::ip::address( 0x0a000000 + i ), 1776 ),
+                                    now - fc::seconds( i % 86400 ) );
+      record.number_of_failed_connection_attempts = i % 7;
+      record.round_trip_delay_ms = i % 500;
+      record.bytes_per_second_received = i * 13 % 100000;
+      if( i % 3 == 0 )
+      {
+         record.last_connection_disposition = last_connection_failed;
+         record.last_connection_attempt_time = now - fc::seconds( i % 600 );
+      }
+      records.push_back( record );
+   }
+   auto log_rate = []( const char* name, uint64_t count, fc::microseconds elapsed ) {
+      ilog( "${name}: ${n} in ${ms} ms, ${rate} per second",
+            ("name",name)("n",count)("ms",elapsed.count()/1000)("rate",uint64_t(count*1000000.0/std::max<int64_t>(elapsed.count(),1))) );
+   };
+
+   // the former format, one JSON array written on close
+   const fc::path json_filename = data_dir.path() / "peers.json";
+   auto start = fc::time_point::now();
+   fc::json::save_to_file( records, json_filename, GRAPHENE_NET_MAX_NESTED_OBJECTS );
+   log_rate( "peer database JSON save", record_count, fc::time_point::now() - start );
+   start = fc::time_point::now();
+   auto loaded = fc::json::from_file( json_filename ).as<std::vector<potential_peer_record>>( GRAPHENE_NET_MAX_NESTED_OBJECTS );
+   log_rate( "peer database JSON load", loaded.size(), fc::time_point::now() - start );
+   fc::remove( json_filename );
+
+   {
+      peer_database db;
+      db.open( filename, record_count );
+      start = fc::time_point::now();
+      for( const potential_peer_record& record : records )
+         db.update_entry( record );
+      log_rate( "peer database logged updates", record_count, fc::time_point::now() - start );
+      start = fc::time_point::now();
+      db.close();
+      log_rate( "peer database compacting save", record_count, fc::time_point::now() - start );
+   }
+
+   peer_database db;
+   start = fc::time_point::now();
+   db.open( filename, record_count );
+   log_rate( "peer database load", db.size(), fc::time_point::now() - start );
+   BOOST_CHECK_EQUAL( db.size(), record_count );
+
+   auto no_skip = []( const fc::ip::endpoint& ) { return false; };
+   start = fc::time_point::now();
+   uint64_t chosen = 0;
+   for( uint32_t i = 0; i < selections; ++i )
+      chosen += db.get_connection_candidates( 8, now, 30, no_skip ).size();
+   log_rate( "peer database best 8 candidate selections", selections, fc::time_point::now() - start );
+   BOOST_CHECK_EQUAL( chosen, uint64_t( selections ) * 8 );
+
+   // the former selection, a scan of the whole database by last seen time
+   start = fc::time_point::now();
+   const uint32_t scans = selections / 100;
+   for( uint32_t i = 0; i < scans; ++i )
+   {
+      uint32_t eligible = 0;
+      for( peer_database::iterator iter = db.begin(); iter != db.end(); ++iter )
+      {
+         fc::microseconds delay_until_retry = fc::seconds( ( iter->number_of_failed_connection_attempts + 1 ) * 30 );
+         if( iter->last_connection_disposition != last_connection_failed || ( now - iter->last_connection_attempt_time ) > delay_until_retry )
+            ++eligible;
+      }
+      BOOST_CHECK( eligible > 0 );
+   }
+   log_rate( "peer database full scans", scans, fc::time_point::now() - start );
+   db.close();
+}
+
+BOOST_AUTO_TEST_CASE( account_name_lookup_benchmark )
+{
+   // autocompletion of account names over 1M accounts: the former lower bound walk over an ordered index of
+   // names, copying the results into a map, against the name trie
+   const uint32_t account_count = 1000 * 1000;
+   const uint32_t queries = 200 * 1000;
+   const uint32_t limit = 10;
+
+   struct name_entry
+   {
+      std::string      name;
+      account_uid_type uid;
+   };
+   struct by_name;
+   typedef boost::multi_index_container<
+      name_entry,
+      boost::multi_index::indexed_by<
+         boost::multi_index::ordered_unique< boost::multi_index::tag<by_name>,
+            boost::multi_index::member< name_entry, std::string, &name_entry::name > >
+      >
+   > name_index_type;
+
+   std::mt19937_64 rng( 42 );
+   const std::string letters = "abcdefghijklmnopqrstuvwxyz0123456789_";
+   std::vector<std::string> names;
+   names.reserve( account_count );
+   std::set<std::string> seen;
+   while( names.size() < account_count )
+   {
+      // letters drawn from a skewed distribution, so that some prefixes are much more common than others
+      std::string name( 1, letters[ std::min<uint64_t>( rng() % 26, rng() % 26 ) ] );
+      const uint32_t length = 3 + rng() % 12;
+      while( name.size() < length )
+         name.push_back( letters[ std::min<uint64_t>( rng() % letters.size(), rng() % letters.size() ) ] );
+      if( seen.insert( name ).second )
+         names.push_back( name );
+   }
+   seen.clear();
+
+   auto log_rate = []( const char* name, uint64_t count, fc::microseconds elapsed ) {
+      ilog( "${name}: ${n} in ${ms} ms, ${rate} per second",
+            ("name",name)("n",count)("ms",elapsed.count()/1000)("rate",uint64_t(count*1000000.0/std::max<int64_t>(elapsed.count(),1))) );
+   };
+
+   name_index_type ordered_names;
+   auto start = fc::time_point::now();
+   for( uint32_t i = 0; i < account_count; ++i )
+      ordered_names.insert( name_entry{ names[i], i } );
+   log_rate( "account names ordered index inserts", account_count, fc::time_point::now() - start );
+
+   account_name_trie trie;
+   start = fc::time_point::now();
+   for( uint32_t i = 0; i < account_count; ++i )
+      trie.insert( names[i], i );
+   log_rate( "account names trie inserts", account_count, fc::time_point::now() - start );
+   ilog( "account names trie: ${n} nodes, ${mb} MiB",
+         ("n",trie.node_count())("mb",trie.heap_bytes() / (1024*1024)) );
+
+   // what a user types: the first 1 to 4 characters of existing names
+   std::vector<std::string> prefixes;
+   prefixes.reserve( queries );
+   for( uint32_t i = 0; i < queries; ++i )
+   {
+      const std::string& name = names[ rng() % account_count ];
+      prefixes.push_back( name.substr( 0, 1 + rng() % 4 ) );
+   }
+
+   const auto& by_name_idx = ordered_names.get<by_name>();
+   uint64_t found = 0;
+   start = fc::time_point::now();
+   for( const std::string& prefix : prefixes )
+   {
+      std::map<std::string,account_uid_type> result;
+      uint32_t remaining = limit;
+      for( auto itr = by_name_idx.lower_bound( prefix ); remaining-- && itr != by_name_idx.end(); ++itr )
+         result.insert( std::make_pair( itr->name, itr->uid ) );
+      found += result.size();
+   }
+   log_rate( "account names ordered index lookups", queries, fc::time_point::now() - start );
+
+   uint64_t trie_found = 0;
+   start = fc::time_point::now();
+   for( const std::string& prefix : prefixes )
+      trie_found += trie.find_prefix( prefix, std::string(), limit ).size();
+   log_rate( "account names trie prefix lookups", queries, fc::time_point::now() - start );
+   BOOST_CHECK_GT( trie_found, 0u );
+   BOOST_CHECK_LE( trie_found, found );
+
+   // the second page of every query
+   start = fc::time_point::now();
+   for( const std::string& prefix : prefixes )
+   {
+      auto page = trie.find_prefix( prefix, std::string(), limit );
+      if( page.size() == limit )
+         trie.find_prefix( prefix, page.back().first, limit );
+   }
+   log_rate( "account names trie two page lookups", queries, fc::time_point::now() - start );
+
+   uint64_t ordered_count = 0;
+   const uint32_t count_queries = queries / 100;
+   start = fc::time_point::now();
+   for( uint32_t i = 0; i < count_queries; ++i )
+   {
+      const std::string& prefix = prefixes[i];
+      for( auto itr = by_name_idx.lower_bound( prefix );
+           itr != by_name_idx.end() && itr->name.compare( 0, prefix.size(), prefix ) == 0; ++itr )
+         ++ordered_count;
+   }
+   log_rate( "account names ordered index prefix counts", count_queries, fc::time_point::now() - start );
+
+   uint64_t trie_count = 0;
+   start = fc::time_point::now();
+   for( uint32_t i = 0; i < count_queries; ++i )
+      trie_count += trie.count_prefix( prefixes[i] );
+   log_rate( "account names trie prefix counts", count_queries, fc::time_point::now() - start );
+   BOOST_CHECK_EQUAL( trie_count, ordered_count );
+}
+
 /*
 BOOST_AUTO_TEST_CASE( transfer_benchmark )
 {
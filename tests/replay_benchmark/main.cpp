@@ -0,0 +1,691 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+#include <fc/io/json.hpp>
+#include <fc/smart_ref_impl.hpp>
+#include <fc/variant_object.hpp>
+
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/genesis_state.hpp>
+#include <graphene/chain/protocol/fee_schedule.hpp>
+#include <graphene/utilities/tempdir.hpp>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#ifndef WIN32
+#include <sys/resource.h>
+#endif
+
+using namespace graphene::chain;
+namespace bpo = boost::program_options;
+
+namespace replay_benchmark {
+
+/// Everything the synthetic chain is generated from; the same spec always gives the same blocks
+struct chain_spec
+{
+   uint64_t           seed = 1;
+   uint32_t           accounts = 1000;
+   /// blocks produced under load on the replayed chain, the second branch of the fork comes on top
+   uint32_t           blocks = 1000;
+   uint32_t           transactions_per_block = 100;
+   /// relative weights of the generated operations
+   fc::variant_object mix;
+   uint32_t           post_size = 200;
+   /// accounts which run a witness and change its pledge in "pledge" operations
+   uint32_t           pledgers = 20;
+   /// chain time skipped after genesis so that accounts have CSAF to lease
+   uint32_t           warmup_minutes = 60;
+   /// blocks each branch of the fork gets before the first switch
+   uint32_t           fork_depth = 50;
+   /// number of times the longest chain alternates between the two branches, 0 for no fork
+   uint32_t           fork_rounds = 4;
+   time_point_sec     genesis_time = time_point_sec( 1577836800 ); // 2020-01-01 00:00:00 UTC
+};
+
+enum bench_operation_type
+{
+   transfer_bench,
+   post_bench,
+   pledge_bench,
+   vote_bench,
+   proposal_bench,
+   csaf_lease_bench,
+   bench_operation_type_count
+};
+
+const char* const bench_operation_names[bench_operation_type_count] =
+   { "transfer", "post", "pledge", "vote", "proposal", "csaf_lease" };
+
+struct bench_account
+{
+   account_uid_type     uid;
+   fc::ecc::private_key key;
+};
+
+/**
+ * Builds and pushes the transactions of the synthetic chain.  The generator is copied to produce a second
+ * branch from the same state, so it refers to chain objects by uid only.
+ */
+struct chain_generator
+{
+   chain_spec                         spec;
+   std::vector<bench_account>         accounts;
+   std::vector<account_uid_type>      witnesses;
+   fc::ecc::private_key               witness_key;
+   std::vector<share_type>            pledges;
+   std::vector<post_pid_type>         last_post_pid;
+   std::vector<bool>                  has_voted;
+   std::discrete_distribution<int>    mix;
+   std::mt19937_64                    rng;
+   uint64_t                           next_sequence = 0;
+   std::vector<uint64_t>              pushed = std::vector<uint64_t>( bench_operation_type_count, 0 );
+   std::vector<uint64_t>              rejected = std::vector<uint64_t>( bench_operation_type_count, 0 );
+
+   explicit chain_generator( const chain_spec& s );
+
+   genesis_state_type make_genesis();
+   /// Create the platform and the pledgers' witnesses, then skip the warmup time
+   std::vector<signed_block> setup( database& db );
+   /// Push a block's worth of transactions and produce the block in @p slot
+   signed_block produce_block( database& db, uint32_t slot );
+
+   signed_transaction build_transaction( const database& db, bench_operation_type type );
+   signed_block       generate_block( database& db, uint32_t slot )const;
+};
+
+chain_generator::chain_generator( const chain_spec& s ) : spec( s ), rng( s.seed )
+{
+   std::vector<double> weights( bench_operation_type_count, 0 );
+   for( const auto& entry : spec.mix )
+   {
+      const auto found = std::find_if( std::begin( bench_operation_names ), std::end( bench_operation_names ),
+                                       [&entry]( const char* n ) { return entry.key() == n; } );
+      FC_ASSERT( found != std::end( bench_operation_names ), "Unknown operation '${n}' in the operation mix",
+                 ("n", entry.key()) );
+      weights[found - std::begin( bench_operation_names )] = entry.value().as_double();
+   }
+   FC_ASSERT( std::any_of( weights.begin(), weights.end(), []( double w ) { return w > 0; } ),
+              "The operation mix is empty" );
+   FC_ASSERT( spec.accounts >= 2, "Need at least 2 accounts" );
+   FC_ASSERT( spec.pledgers <= spec.accounts, "There are more pledgers than accounts" );
+   FC_ASSERT( spec.pledgers > 0 || weights[pledge_bench] == 0, "Pledge operations need at least 1 pledger" );
+   FC_ASSERT( spec.fork_rounds == 0 || spec.fork_depth > 0, "Forks need a depth of at least 1" );
+   mix = std::discrete_distribution<int>( weights.begin(), weights.end() );
+}
+
+genesis_state_type chain_generator::make_genesis()
+{
+   genesis_state_type genesis;
+   genesis.initial_timestamp = spec.genesis_time;
+   genesis.initial_parameters.current_fees->zero_all_fees();
+
+   witness_key = fc::ecc::private_key::regenerate( fc::sha256::hash( std::string( "replay_benchmark witness" ) ) );
+   genesis.initial_active_witnesses = GRAPHENE_DEFAULT_MIN_WITNESS_COUNT;
+   for( uint32_t i = 0; i < genesis.initial_active_witnesses; ++i )
+   {
+      const string name = "init" + fc::to_string( i );
+      witnesses.push_back( calc_account_uid( 10 + i ) );
+      genesis.initial_accounts.emplace_back( witnesses.back(), name, 0, witness_key.get_public_key(),
+                                             public_key_type(), public_key_type(), public_key_type(), true );
+      genesis.initial_committee_candidates.push_back( { name } );
+      genesis.initial_witness_candidates.push_back( { name, witness_key.get_public_key() } );
+   }
+
+   const share_type balance = GRAPHENE_MAX_SHARE_SUPPLY / 2 / spec.accounts;
+   for( uint32_t i = 0; i < spec.accounts; ++i )
+   {
+      bench_account account;
+      account.uid = calc_account_uid( 1000 + i );
+      account.key = fc::ecc::private_key::regenerate( fc::sha256::hash( "replay_benchmark account " + fc::to_string( i ) ) );
+      genesis.initial_accounts.emplace_back( account.uid, "bench" + fc::to_string( i ), 0, account.key.get_public_key() );
+      genesis.initial_account_balances.emplace_back( account.uid, GRAPHENE_SYMBOL, balance );
+      accounts.push_back( account );
+   }
+   last_post_pid.resize( spec.accounts, 0 );
+   has_voted.resize( spec.accounts, false );
+   return genesis;
+}
+
+signed_block chain_generator::generate_block( database& db, uint32_t slot )const
+{
+   return db.generate_block( db.get_slot_time( slot ), db.get_scheduled_witness( slot ), witness_key,
+                             database::skip_nothing );
+}
+
+std::vector<signed_block> chain_generator::setup( database& db )
+{
+   const auto& params = db.get_global_properties().parameters;
+   auto push = [&db]( const operation& op, const fc::ecc::private_key& key ) {
+      signed_transaction trx;
+      trx.operations.push_back( op );
+      trx.set_expiration( db.head_block_time() + fc::minutes( 1 ) );
+      trx.set_reference_block( db.head_block_id() );
+      trx.sign( key, db.get_chain_id() );
+      db.push_transaction( trx );
+   };
+
+   // the first account runs the platform all posts go to
+   platform_create_operation platform_op;
+   platform_op.account = accounts.front().uid;
+   platform_op.pledge = asset( int64_t( params.platform_min_pledge ) );
+   platform_op.name = "replay benchmark platform";
+   platform_op.url = "http://localhost";
+   push( platform_op, accounts.front().key );
+
+   for( uint32_t i = 0; i < spec.pledgers; ++i )
+   {
+      witness_create_operation op;
+      op.account = accounts[i].uid;
+      op.block_signing_key = witness_key.get_public_key();
+      op.pledge = asset( int64_t( params.min_witness_pledge ) );
+      op.url = "http://localhost/" + fc::to_string( i );
+      push( op, accounts[i].key );
+      pledges.push_back( op.pledge.amount );
+   }
+
+   std::vector<signed_block> result;
+   result.push_back( generate_block( db, 1 ) );
+   const uint32_t warmup_slots = spec.warmup_minutes * 60 / db.get_global_properties().parameters.block_interval;
+   if( warmup_slots > 1 )
+      result.push_back( generate_block( db, warmup_slots ) );
+   return result;
+}
+
+signed_transaction chain_generator::build_transaction( const database& db, bench_operation_type type )
+{
+   const uint64_t sequence = next_sequence++;
+   const uint32_t account_index = rng() % accounts.size();
+   const bench_account& account = accounts[account_index];
+   const bench_account& other = accounts[( account_index + 1 + rng() % ( accounts.size() - 1 ) ) % accounts.size()];
+   const bench_account& platform = accounts.front();
+   const fc::ecc::private_key* signer = &account.key;
+
+   signed_transaction trx;
+   switch( type )
+   {
+      case transfer_bench:
+      {
+         transfer_operation op;
+         op.from = account.uid;
+         op.to = other.uid;
+         op.amount = asset( int64_t( 1 + sequence % 1000 ) );
+         trx.operations.push_back( op );
+         break;
+      }
+      case post_bench:
+      {
+         post_operation op;
+         op.post_pid = ++last_post_pid[account_index];
+         op.platform = platform.uid;
+         op.poster = account.uid;
+         op.hash_value = fc::to_string( sequence );
+         op.title = "replay benchmark post " + fc::to_string( sequence );
+         op.body = string( spec.post_size, 'x' );
+         trx.operations.push_back( op );
+         break;
+      }
+      case pledge_bench:
+      {
+         const uint32_t pledger = rng() % spec.pledgers;
+         const share_type min_pledge = int64_t( db.get_global_properties().parameters.min_witness_pledge );
+         share_type new_pledge = min_pledge + int64_t( 1 + rng() % 1000 ) * GRAPHENE_BLOCKCHAIN_PRECISION;
+         if( new_pledge == pledges[pledger] )
+            new_pledge = min_pledge;
+         pledges[pledger] = new_pledge;
+         witness_update_operation op;
+         op.account = accounts[pledger].uid;
+         op.new_pledge = asset( new_pledge );
+         trx.operations.push_back( op );
+         signer = &accounts[pledger].key;
+         break;
+      }
+      case vote_bench:
+      {
+         // an account's first vote adds a witness, later ones refresh its votes
+         witness_vote_update_operation op;
+         op.voter = account.uid;
+         if( !has_voted[account_index] )
+         {
+            op.witnesses_to_add.insert( witnesses[account_index % witnesses.size()] );
+            has_voted[account_index] = true;
+         }
+         trx.operations.push_back( op );
+         break;
+      }
+      case proposal_bench:
+      {
+         // the committee is made of the initial witness accounts, which all use the witness key
+         const auto& committee = db.get_global_properties().active_committee_members;
+         FC_ASSERT( !committee.empty(), "There is no active committee" );
+         const uint32_t next_update = db.get_dynamic_global_properties().next_committee_update_block;
+         committee_update_account_priviledge_item_type item;
+         item.account = other.uid;
+         item.new_priviledges.value.can_vote = true;
+         committee_proposal_create_operation op;
+         op.proposer = *( committee.begin() + rng() % committee.size() );
+         op.items.push_back( item );
+         op.voting_closing_block_num = std::min( db.head_block_num() + 20, next_update );
+         op.execution_block_num = op.voting_closing_block_num;
+         op.expiration_block_num = op.voting_closing_block_num;
+         op.proposer_opinion = opinion_for;
+         trx.operations.push_back( op );
+         signer = &witness_key;
+         break;
+      }
+      case csaf_lease_bench:
+      {
+         csaf_lease_operation op;
+         op.from = account.uid;
+         op.to = other.uid;
+         op.amount = asset( int64_t( GRAPHENE_BLOCKCHAIN_PRECISION ) );
+         op.expiration = db.head_block_time() + fc::seconds( 86400 + sequence % 86400 );
+         trx.operations.push_back( op );
+         break;
+      }
+      default:
+         FC_THROW( "Unknown operation type ${t}", ("t", int( type )) );
+   }
+
+   // spread the expiration times so that otherwise identical transactions get different ids
+   trx.set_expiration( db.head_block_time() + fc::seconds( 60 + sequence % 3600 ) );
+   trx.set_reference_block( db.head_block_id() );
+   trx.sign( *signer, db.get_chain_id() );
+   if( type == post_bench && account.uid != platform.uid )
+      trx.sign( platform.key, db.get_chain_id() );
+   return trx;
+}
+
+signed_block chain_generator::produce_block( database& db, uint32_t slot )
+{
+   for( uint32_t i = 0; i < spec.transactions_per_block; ++i )
+   {
+      const bench_operation_type type = bench_operation_type( mix( rng ) );
+      ++pushed[type];
+      try
+      {
+         db.push_transaction( build_transaction( db, type ) );
+      }
+      catch( const fc::exception& e )
+      {
+         if( rejected[type]++ == 0 )
+            std::cerr << "first rejected " << bench_operation_names[type] << ": " << e.to_string() << "\n";
+      }
+   }
+   return generate_block( db, slot );
+}
+
+/// The @p occurrence'th upcoming slot of @p witness
+uint32_t slot_of_witness( const database& db, account_uid_type witness, uint32_t occurrence )
+{
+   const uint32_t search_limit = 4 * db.get_global_properties().active_witnesses.size();
+   for( uint32_t slot = 1; slot <= search_limit; ++slot )
+      if( db.get_scheduled_witness( slot ) == witness && --occurrence == 0 )
+         return slot;
+   FC_THROW( "Witness ${w} is not scheduled in the next ${n} slots", ("w", witness)("n", search_limit) );
+}
+
+void copy_directory( const fc::path& from, const fc::path& to )
+{
+   namespace bfs = boost::filesystem;
+   const bfs::path source( from.string() );
+   const bfs::path target( to.string() );
+   bfs::create_directories( target );
+   for( bfs::recursive_directory_iterator itr( source ), end; itr != end; ++itr )
+   {
+      const bfs::path destination = target / itr->path().string().substr( source.string().size() );
+      if( bfs::is_directory( itr->status() ) )
+         bfs::create_directories( destination );
+      else
+         bfs::copy_file( itr->path(), destination );
+   }
+}
+
+const std::string db_version = "replay_benchmark";
+
+struct generated_chain
+{
+   genesis_state_type                     genesis;
+   /// the chain replayed by every phase but the fork switch, starting with block 1
+   std::vector<signed_block>              blocks;
+   /// head block of the state saved in the replay base directory
+   uint32_t                               replay_base_block_num = 0;
+   /// last block both branches of the fork have in common
+   uint32_t                               fork_block_num = 0;
+   /// the blocks pushed in each round of the fork switch phase, alternately of the second and of the first branch
+   std::vector<std::vector<signed_block>> fork_rounds;
+   std::vector<uint64_t>                  pushed;
+   std::vector<uint64_t>                  rejected;
+};
+
+/**
+ * Generate the chain in @p work_dir / "chain" and save the state halfway in @p work_dir / "replay_base".
+ *
+ * The last blocks of both branches of the fork are all produced by the same witness, so that the last
+ * irreversible block stays behind the fork point and the branches can replace each other.
+ */
+generated_chain generate_chain( const chain_spec& spec, const fc::path& work_dir )
+{
+   generated_chain result;
+   chain_generator generator( spec );
+   result.genesis = generator.make_genesis();
+   const auto genesis_loader = [&result]{ return result.genesis; };
+   const fc::path chain_dir = work_dir / "chain";
+
+   const uint32_t tail_blocks = spec.fork_rounds > 0 ? spec.fork_depth + spec.fork_rounds / 2 * 2 : 0;
+   FC_ASSERT( spec.blocks > tail_blocks, "Need more than ${n} blocks for the fork", ("n", tail_blocks) );
+   const uint32_t common_blocks = spec.blocks - tail_blocks;
+
+   fc::create_directories( chain_dir );
+   database db;
+   db.open( chain_dir, genesis_loader, db_version );
+   result.blocks = generator.setup( db );
+   for( uint32_t i = 0; i < common_blocks; ++i )
+   {
+      if( i == common_blocks / 2 )
+      {
+         result.replay_base_block_num = db.head_block_num();
+         db.close( false );
+         copy_directory( chain_dir, work_dir / "replay_base" );
+         db.open( chain_dir, genesis_loader, db_version );
+      }
+      result.blocks.push_back( generator.produce_block( db, 1 ) );
+   }
+
+   if( spec.fork_rounds > 0 )
+   {
+      result.fork_block_num = db.head_block_num();
+      db.close( false );
+      copy_directory( chain_dir, work_dir / "fork" );
+      db.open( chain_dir, genesis_loader, db_version );
+      database fork_db;
+      fork_db.open( work_dir / "fork", genesis_loader, db_version );
+      chain_generator fork_generator = generator;
+      fork_generator.rng.seed( spec.seed + 1 );
+
+      const account_uid_type producer = db.get_scheduled_witness( 1 );
+      for( uint32_t i = 0; i < spec.fork_depth; ++i )
+         result.blocks.push_back( generator.produce_block( db, slot_of_witness( db, producer, 1 ) ) );
+
+      // each round makes the other branch one block longer than the current one
+      for( uint32_t round = 0; round < spec.fork_rounds; ++round )
+      {
+         std::vector<signed_block> round_blocks;
+         if( round % 2 == 0 )
+         {
+            for( uint32_t i = 0; i < ( round == 0 ? spec.fork_depth + 1 : 2 ); ++i )
+            {
+               // the branches take different slots right after the fork point
+               const uint32_t occurrence = ( fork_db.head_block_num() == result.fork_block_num ? 2 : 1 );
+               round_blocks.push_back( fork_generator.produce_block( fork_db, slot_of_witness( fork_db, producer, occurrence ) ) );
+            }
+         }
+         else
+         {
+            for( uint32_t i = 0; i < 2; ++i )
+            {
+               round_blocks.push_back( generator.produce_block( db, slot_of_witness( db, producer, 1 ) ) );
+               result.blocks.push_back( round_blocks.back() );
+            }
+         }
+         result.fork_rounds.push_back( std::move( round_blocks ) );
+      }
+      fork_db.close( false );
+   }
+   db.close( false );
+
+   result.pushed = generator.pushed;
+   result.rejected = generator.rejected;
+   return result;
+}
+
+uint64_t peak_rss_kb()
+{
+#ifdef WIN32
+   return 0;
+#else
+   struct rusage usage;
+   getrusage( RUSAGE_SELF, &usage );
+#ifdef __APPLE__
+   return usage.ru_maxrss / 1024;
+#else
+   return usage.ru_maxrss;
+#endif
+#endif
+}
+
+struct phase_timer
+{
+   fc::time_point start = fc::time_point::now();
+   uint32_t       blocks = 0;
+   uint64_t       transactions = 0;
+   uint64_t       operations = 0;
+
+   void count( const signed_block& block )
+   {
+      ++blocks;
+      transactions += block.transactions.size();
+      for( const auto& trx : block.transactions )
+         operations += trx.operations.size();
+   }
+
+   fc::mutable_variant_object report( const string& name )const
+   {
+      const int64_t elapsed_us = std::max<int64_t>( ( fc::time_point::now() - start ).count(), 1 );
+      return fc::mutable_variant_object( "name", name )
+                                       ( "elapsed_ms", double( elapsed_us ) / 1000 )
+                                       ( "blocks", blocks )
+                                       ( "transactions", transactions )
+                                       ( "operations", operations )
+                                       ( "blocks_per_second", double( blocks ) * 1000000 / elapsed_us )
+                                       ( "operations_per_second", double( operations ) * 1000000 / elapsed_us )
+                                       ( "peak_rss_kb", peak_rss_kb() );
+   }
+};
+
+fc::mutable_variant_object push_blocks( const generated_chain& chain, const fc::path& data_dir, uint32_t skip,
+                                        const string& name )
+{
+   fc::create_directories( data_dir );
+   database db;
+   db.open( data_dir, [&chain]{ return chain.genesis; }, db_version );
+   phase_timer timer;
+   for( const signed_block& block : chain.blocks )
+   {
+      db.push_block( block, skip );
+      timer.count( block );
+   }
+   auto result = timer.report( name );
+   db.close();
+   fc::remove_all( data_dir );
+   return result;
+}
+
+} // replay_benchmark
+
+FC_REFLECT( replay_benchmark::chain_spec,
+            (seed)(accounts)(blocks)(transactions_per_block)(mix)(post_size)(pledgers)(warmup_minutes)
+            (fork_depth)(fork_rounds)(genesis_time) )
+
+using namespace replay_benchmark;
+
+int main( int argc, char** argv )
+{
+   try
+   {
+      bpo::options_description cli_options("Generate a deterministic synthetic chain and measure how fast it is replayed");
+      cli_options.add_options()
+            ("help,h", "Print this help message and exit.")
+            ("spec,s", bpo::value<boost::filesystem::path>(), "JSON file describing the chain to generate, see chains/")
+            ("phases,p", bpo::value<string>()->default_value("replay,reindex,push_block,push_block_no_signatures,fork_switch"),
+             "Phases to run after the chain has been generated")
+            ("work-dir,d", bpo::value<boost::filesystem::path>(),
+             "Directory to generate the chain in, must not exist yet. A temporary directory is used by default.")
+            ("output,o", bpo::value<boost::filesystem::path>(), "Also write the JSON report to this file")
+            ;
+
+      bpo::variables_map options;
+      try
+      {
+         boost::program_options::store( boost::program_options::parse_command_line(argc, argv, cli_options), options );
+      }
+      catch (const boost::program_options::error& e)
+      {
+         std::cerr << "replay_benchmark:  error parsing command line: " << e.what() << "\n";
+         return 1;
+      }
+
+      if( options.count("help") )
+      {
+         std::cout << cli_options << "\n";
+         return 1;
+      }
+
+      chain_spec spec;
+      if( options.count("spec") )
+         spec = fc::json::from_file( fc::path( options["spec"].as<boost::filesystem::path>() ) )
+                   .as<chain_spec>( GRAPHENE_MAX_NESTED_OBJECTS );
+      if( spec.mix.size() == 0 )
+         spec.mix = fc::mutable_variant_object( "transfer", 50 )( "post", 20 )( "pledge", 5 )( "vote", 10 )
+                                              ( "proposal", 1 )( "csaf_lease", 14 );
+
+      std::vector<string> phases;
+      boost::split( phases, options["phases"].as<string>(), boost::is_any_of( "," ) );
+      const auto run_phase = [&phases]( const string& name ) {
+         return std::find( phases.begin(), phases.end(), name ) != phases.end();
+      };
+
+      fc::optional<fc::temp_directory> temp_dir;
+      fc::path work_dir;
+      if( options.count("work-dir") )
+      {
+         work_dir = fc::path( options["work-dir"].as<boost::filesystem::path>() );
+         FC_ASSERT( !fc::exists( work_dir ), "${d} already exists", ("d", work_dir) );
+      }
+      else
+      {
+         temp_dir = fc::temp_directory( graphene::utilities::temp_directory_path() );
+         work_dir = temp_dir->path();
+      }
+
+      fc::variants phase_reports;
+
+      phase_timer generate_timer;
+      const generated_chain chain = generate_chain( spec, work_dir );
+      for( const signed_block& block : chain.blocks )
+         generate_timer.count( block );
+      for( size_t round = 0; round < chain.fork_rounds.size(); round += 2 )
+         for( const signed_block& block : chain.fork_rounds[round] )
+            generate_timer.count( block );
+      phase_reports.push_back( generate_timer.report( "generate" ) );
+      std::cerr << "generated " << chain.blocks.size() << " blocks in " << work_dir.string() << "\n";
+
+      // open the state saved halfway, replaying the rest of the blocks like a restarted node does
+      if( run_phase( "replay" ) )
+      {
+         const fc::path replay_dir = work_dir / "replay";
+         copy_directory( work_dir / "replay_base", replay_dir );
+         fc::remove_all( replay_dir / "database" );
+         copy_directory( work_dir / "chain" / "database", replay_dir / "database" );
+         database db;
+         phase_timer timer;
+         db.open( replay_dir, [&chain]{ return chain.genesis; }, db_version );
+         for( uint32_t num = chain.replay_base_block_num + 1; num <= db.head_block_num(); ++num )
+            timer.count( chain.blocks[num - 1] );
+         phase_reports.push_back( timer.report( "replay" ) );
+         db.close();
+         fc::remove_all( replay_dir );
+      }
+
+      // rebuild the state from genesis out of the block log
+      if( run_phase( "reindex" ) )
+      {
+         database db;
+         phase_timer timer;
+         db.open( work_dir / "chain", [&chain]{ return chain.genesis; }, db_version + " reindex" );
+         for( uint32_t num = 1; num <= db.head_block_num(); ++num )
+            timer.count( chain.blocks[num - 1] );
+         phase_reports.push_back( timer.report( "reindex" ) );
+         db.close();
+      }
+
+      if( run_phase( "push_block" ) )
+         phase_reports.push_back( push_blocks( chain, work_dir / "push_block", database::skip_nothing, "push_block" ) );
+
+      if( run_phase( "push_block_no_signatures" ) )
+         phase_reports.push_back( push_blocks( chain, work_dir / "push_block_no_signatures",
+                                               database::skip_witness_signature | database::skip_transaction_signatures,
+                                               "push_block_no_signatures" ) );
+
+      // push both branches of the fork in turns, every round ends with a switch to the other branch
+      if( run_phase( "fork_switch" ) && !chain.fork_rounds.empty() )
+      {
+         const fc::path fork_dir = work_dir / "fork_switch";
+         fc::create_directories( fork_dir );
+         database db;
+         db.open( fork_dir, [&chain]{ return chain.genesis; }, db_version );
+         const uint32_t prefix_blocks = chain.fork_block_num + spec.fork_depth;
+         for( uint32_t num = 1; num <= prefix_blocks; ++num )
+            db.push_block( chain.blocks[num - 1], database::skip_witness_signature | database::skip_transaction_signatures );
+
+         phase_timer timer;
+         uint32_t switches = 0;
+         uint64_t blocks_popped = 0;
+         uint64_t blocks_applied = 0;
+         for( const auto& round : chain.fork_rounds )
+            for( const signed_block& block : round )
+            {
+               const uint32_t head_before = db.head_block_num();
+               if( db.push_block( block ) )
+               {
+                  ++switches;
+                  blocks_popped += head_before - chain.fork_block_num;
+                  blocks_applied += db.head_block_num() - chain.fork_block_num;
+               }
+               timer.count( block );
+            }
+         FC_ASSERT( switches == chain.fork_rounds.size(), "Expected ${n} fork switches, got ${s}",
+                    ("n", chain.fork_rounds.size())("s", switches) );
+         auto report = timer.report( "fork_switch" );
+         report( "switches", switches )( "blocks_popped", blocks_popped )( "blocks_applied", blocks_applied );
+         phase_reports.push_back( report );
+         db.close();
+         fc::remove_all( fork_dir );
+      }
+
+      fc::mutable_variant_object operations;
+      for( int type = 0; type < bench_operation_type_count; ++type )
+         if( chain.pushed[type] > 0 )
+            operations( bench_operation_names[type], fc::mutable_variant_object( "pushed", chain.pushed[type] )
+                                                                              ( "rejected", chain.rejected[type] ) );
+
+      fc::mutable_variant_object report;
+      report( "spec", fc::variant( spec, GRAPHENE_MAX_NESTED_OBJECTS ) )
+            ( "head_block_num", chain.blocks.back().block_num() )
+            ( "head_block_id", chain.blocks.back().id().str() )
+            ( "generated_operations", operations )
+            ( "phases", phase_reports )
+            ( "peak_rss_kb", peak_rss_kb() );
+      const string json = fc::json::to_pretty_string( report );
+      std::cout << json << "\n";
+      if( options.count("output") )
+      {
+         std::ofstream output( options["output"].as<boost::filesystem::path>().string() );
+         output << json << "\n";
+      }
+      return 0;
+   }
+   catch ( const fc::exception& e )
+   {
+      std::cerr << e.to_detail_string() << "\n";
+   }
+   return 1;
+}
@@ -26,16 +26,27 @@
 
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/protocol/protocol.hpp>
+#include <graphene/chain/protocol/utf8.hpp>
 
 #include <graphene/chain/account_object.hpp>
 #include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/content_blob.hpp>
+#include <graphene/chain/block_database.hpp>
 #include <graphene/chain/exceptions.hpp>
+#include <graphene/chain/fork_database.hpp>
+#include <graphene/chain/pending_transaction_pool.hpp>
+#include <graphene/chain/proposal_object.hpp>
 
 #include <graphene/db/simple_index.hpp>
 
+#include <fc/bitutil.hpp>
 #include <fc/crypto/digest.hpp>
 #include <fc/crypto/hex.hpp>
+#include <graphene/utilities/tempdir.hpp>
 #include "../common/database_fixture.hpp"
+#include "../../libraries/chain/utf8/checked.h"
+
+#include <boost/filesystem.hpp>
 
 #include <algorithm>
 #include <random>
@@ -107,6 +118,239 @@ BOOST_AUTO_TEST_CASE( valid_name_test )
    BOOST_CHECK( !is_valid_name( "none.of.these.labels.has.more.than-63.chars--but.still.not.valid" ) );
 }
 
+namespace {
+
+/// utf8::next(), which validated UTF-8 before utf8_decode_next() replaced it
+bool legacy_utf8_next( const char*& itr, const char* end, uint32_t& code_point )
+{
+   try
+   {
+      const char* next = itr;
+      code_point = utf8::next( next, end );
+      itr = next;
+      return true;
+   }
+   catch( const utf8::exception& )
+   {
+      return false;
+   }
+}
+
+/// the result of the exception-based platform string validation which validate_utf8() replaced
+utf8_validation_result legacy_validate_utf8( const string& str, uint32_t max_code_points )
+{
+   uint32_t len = 0;
+   auto itr = str.begin();
+   while( itr != str.end() )
+   {
+      try
+      {
+         utf8::next( itr, str.end() );
+      }
+      catch( const utf8::exception& )
+      {
+         return utf8_invalid;
+      }
+      if( ++len > max_code_points )
+         return utf8_too_long;
+   }
+   return utf8_valid;
+}
+
+bool decodes_to( const string& s, uint32_t expected )
+{
+   const char* itr = s.data();
+   uint32_t cp = 0;
+   return utf8_decode_next( itr, s.data() + s.size(), cp ) && itr == s.data() + s.size() && cp == expected;
+}
+
+bool is_rejected( const string& s )
+{
+   const char* itr = s.data();
+   uint32_t cp = 0;
+   return !utf8_decode_next( itr, s.data() + s.size(), cp ) && itr == s.data();
+}
+
+}
+
+BOOST_AUTO_TEST_CASE( utf8_decode_test )
+{
+   BOOST_CHECK( is_rejected( "" ) );
+   BOOST_CHECK( decodes_to( string( 1, '\0' ), 0 ) );
+   BOOST_CHECK( decodes_to( "a", 'a' ) );
+   BOOST_CHECK( decodes_to( "\x7f", 0x7f ) );
+   BOOST_CHECK( decodes_to( "\xc2\x80", 0x80 ) );
+   BOOST_CHECK( decodes_to( "\xdf\xbf", 0x7ff ) );
+   BOOST_CHECK( decodes_to( "\xe0\xa0\x80", 0x800 ) );
+   BOOST_CHECK( decodes_to( "\xe4\xb8\xad", 0x4e2d ) );
+   BOOST_CHECK( decodes_to( "\xef\xbc\x88", 0xff08 ) );
+   BOOST_CHECK( decodes_to( "\xef\xbf\xbf", 0xffff ) );
+   BOOST_CHECK( decodes_to( "\xf0\x90\x80\x80", 0x10000 ) );
+   BOOST_CHECK( decodes_to( "\xf4\x8f\xbf\xbf", 0x10ffff ) );
+
+   // overlong encodings
+   BOOST_CHECK( is_rejected( "\xc0\x80" ) );
+   BOOST_CHECK( is_rejected( "\xc1\xbf" ) );
+   BOOST_CHECK( is_rejected( "\xe0\x80\x80" ) );
+   BOOST_CHECK( is_rejected( "\xe0\x9f\xbf" ) );
+   BOOST_CHECK( is_rejected( "\xf0\x80\x80\x80" ) );
+   BOOST_CHECK( is_rejected( "\xf0\x8f\xbf\xbf" ) );
+
+   // surrogates, and the code points around them
+   BOOST_CHECK( decodes_to( "\xed\x9f\xbf", 0xd7ff ) );
+   BOOST_CHECK( is_rejected( "\xed\xa0\x80" ) );
+   BOOST_CHECK( is_rejected( "\xed\xbf\xbf" ) );
+   BOOST_CHECK( decodes_to( "\xee\x80\x80", 0xe000 ) );
+
+   // above U+10FFFF, and lead bytes of sequences longer than 4 bytes
+   BOOST_CHECK( is_rejected( "\xf4\x90\x80\x80" ) );
+   BOOST_CHECK( is_rejected( "\xf7\xbf\xbf\xbf" ) );
+   BOOST_CHECK( is_rejected( "\xf8\x88\x80\x80\x80" ) );
+   BOOST_CHECK( is_rejected( "\xfc\x84\x80\x80\x80\x80" ) );
+   BOOST_CHECK( is_rejected( "\xfe" ) );
+   BOOST_CHECK( is_rejected( "\xff" ) );
+
+   // truncated sequences, at the end of the input or followed by a non-continuation byte
+   BOOST_CHECK( is_rejected( "\xc3" ) );
+   BOOST_CHECK( is_rejected( "\xe4\xb8" ) );
+   BOOST_CHECK( is_rejected( "\xf0\x9f\x98" ) );
+   BOOST_CHECK( is_rejected( "\xc3" "a" ) );
+   BOOST_CHECK( is_rejected( "\xe4" "a\xad" ) );
+   BOOST_CHECK( is_rejected( "\xf0\x9f\x98\xc3\xa9" ) );
+   {
+      // the end of the input is respected even if more bytes follow in memory
+      const string s( "\xe4\xb8\xad" );
+      const char* itr = s.data();
+      uint32_t cp = 0;
+      BOOST_CHECK( !utf8_decode_next( itr, s.data() + 2, cp ) );
+      BOOST_CHECK( itr == s.data() );
+   }
+
+   // stray continuation bytes
+   BOOST_CHECK( is_rejected( "\x80" ) );
+   BOOST_CHECK( is_rejected( "\xbf" ) );
+   BOOST_CHECK( is_rejected( "\x80" "a" ) );
+
+   // the decoder accepts exactly what utf8::next() accepts, all 1 and 2 byte inputs
+   for( uint32_t i = 0; i < 0x10000; ++i )
+   {
+      const char bytes[2] = { char( i >> 8 ), char( i & 0xff ) };
+      for( size_t size = 1; size <= 2; ++size )
+      {
+         const char* itr = bytes;
+         const char* legacy_itr = bytes;
+         uint32_t cp = 0;
+         uint32_t legacy_cp = 0;
+         const bool ok = utf8_decode_next( itr, bytes + size, cp );
+         BOOST_REQUIRE_EQUAL( ok, legacy_utf8_next( legacy_itr, bytes + size, legacy_cp ) );
+         if( ok )
+         {
+            BOOST_REQUIRE( itr == legacy_itr );
+            BOOST_REQUIRE_EQUAL( cp, legacy_cp );
+         }
+      }
+   }
+   // and random 3 and 4 byte inputs, made mostly of lead and continuation bytes
+   std::mt19937 rng( 29 );
+   auto random_byte = [&rng]() -> char {
+      switch( rng() % 4 )
+      {
+         case 0:  return char( rng() % 0x100 );
+         case 1:  return char( 0xe0 + rng() % 0x20 );
+         default: return char( 0x80 + rng() % 0x40 );
+      }
+   };
+   for( uint32_t i = 0; i < 1000000; ++i )
+   {
+      char bytes[4];
+      for( char& c : bytes )
+         c = random_byte();
+      const size_t size = 3 + rng() % 2;
+      const char* itr = bytes;
+      const char* legacy_itr = bytes;
+      uint32_t cp = 0;
+      uint32_t legacy_cp = 0;
+      const bool ok = utf8_decode_next( itr, bytes + size, cp );
+      BOOST_REQUIRE_EQUAL( ok, legacy_utf8_next( legacy_itr, bytes + size, legacy_cp ) );
+      if( ok )
+      {
+         BOOST_REQUIRE( itr == legacy_itr );
+         BOOST_REQUIRE_EQUAL( cp, legacy_cp );
+      }
+   }
+}
+
+BOOST_AUTO_TEST_CASE( utf8_validation_test )
+{ try {
+   uint32_t code_points = 0;
+   BOOST_CHECK( validate_utf8( "", 0, code_points ) == utf8_valid );
+   BOOST_CHECK_EQUAL( code_points, 0u );
+   BOOST_CHECK( validate_utf8( "a\xe4\xb8\xad\xf0\x90\x80\x80", 3, code_points ) == utf8_valid );
+   BOOST_CHECK_EQUAL( code_points, 3u );
+   BOOST_CHECK( validate_utf8( "a\xe4\xb8\xad\xf0\x90\x80\x80", 2, code_points ) == utf8_too_long );
+   // invalid bytes after ASCII runs which are skipped in blocks
+   for( size_t ascii = 0; ascii < 40; ++ascii )
+   {
+      const string prefix( ascii, 'a' );
+      BOOST_CHECK( validate_utf8( prefix + "\xe4\xb8\xad", 100, code_points ) == utf8_valid );
+      BOOST_CHECK_EQUAL( code_points, ascii + 1 );
+      BOOST_CHECK( validate_utf8( prefix + "\xc0\x80" + prefix, 100, code_points ) == utf8_invalid );
+      BOOST_CHECK( validate_utf8( prefix + "\xed\xa0\x80", 100, code_points ) == utf8_invalid );
+      BOOST_CHECK( validate_utf8( prefix + "\xe4\xb8", 100, code_points ) == utf8_invalid );
+      BOOST_CHECK( validate_utf8( prefix + "\x80", 100, code_points ) == utf8_invalid );
+      BOOST_CHECK( validate_utf8( prefix, ascii, code_points ) == utf8_valid );
+      if( ascii > 0 )
+         BOOST_CHECK( validate_utf8( prefix, ascii - 1, code_points ) == utf8_too_long );
+   }
+
+   // the validators give the same results as the previous exception-based code
+   platform_update_operation platform_op;
+   platform_op.account = GRAPHENE_COMMITTEE_ACCOUNT_UID;
+   const string invalid_bytes( "\x80\xbf\xc0\xc1\xc2\xdf\xe0\xe4\xed\xef\xf0\xf4\xf5\xf8\xff" );
+   std::mt19937 rng( 29 );
+   for( uint32_t i = 0; i < 20000; ++i )
+   {
+      string str;
+      const size_t size = rng() % ( GRAPHENE_MAX_PLATFORM_NAME_LENGTH + 20 );
+      while( str.size() < size )
+      {
+         switch( rng() % 64 )
+         {
+            case 0:  str += invalid_bytes[ rng() % invalid_bytes.size() ]; break;
+            case 1:  str += "\xe4\xb8\xad"; break;
+            case 2:  str += "\xf0\x9f\x98\x80"; break;
+            case 3:  str += "\xc3\xa9"; break;
+            default: str += char( 'a' + rng() % 26 ); break;
+         }
+      }
+      const bool legacy_ok = legacy_validate_utf8( str, GRAPHENE_MAX_PLATFORM_NAME_LENGTH ) == utf8_valid;
+      BOOST_CHECK_EQUAL( validate_utf8( str, GRAPHENE_MAX_PLATFORM_NAME_LENGTH, code_points ) == utf8_valid,
+                         legacy_ok );
+      platform_op.new_name = str;
+      bool ok = true;
+      try
+      {
+         platform_op.validate();
+      }
+      catch( const fc::exception& )
+      {
+         ok = false;
+      }
+      BOOST_CHECK_EQUAL( ok, legacy_ok );
+   }
+
+   // account names are checked for UTF-8 before their characters
+   const public_key_type key = init_account_priv_key.get_public_key();
+   make_account_seed( 100, "abc\xe4\xb8\xad", key ).validate();
+   make_account_seed( 100, "abc\xef\xbc\x88" "d\xef\xbc\x89", key ).validate();
+   GRAPHENE_CHECK_THROW( make_account_seed( 100, "abc\xe4\xb8", key ).validate(), fc::assert_exception );
+   GRAPHENE_CHECK_THROW( make_account_seed( 100, "abc\xe0\x80\x80", key ).validate(), fc::assert_exception );
+   GRAPHENE_CHECK_THROW( make_account_seed( 100, "abc\xed\xa0\x80", key ).validate(), fc::assert_exception );
+   GRAPHENE_CHECK_THROW( make_account_seed( 100, "abc\x80", key ).validate(), fc::assert_exception );
+   // U+4E00 encoded with 4 bytes would be a valid character
+   GRAPHENE_CHECK_THROW( make_account_seed( 100, "abc\xf0\x84\xb8\x80", key ).validate(), fc::assert_exception );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE( valid_symbol_test )
 {
    BOOST_CHECK( !is_valid_symbol( "A" ) );
@@ -368,4 +612,809 @@ BOOST_AUTO_TEST_CASE( merkle_root )
    BOOST_CHECK( block.calculate_merkle_root() == c(dO) );
 }
 
+
+BOOST_AUTO_TEST_CASE( content_blob_test )
+{ try {
+   const std::string body( 4096, 'x' );
+
+   content_blob a( body );
+   content_blob b( body );
+   BOOST_CHECK( a == b );
+   BOOST_CHECK( a == body );
+   // identical content is stored once
+   BOOST_CHECK( &a.value() == &b.value() );
+
+   // copies share the content
+   content_blob c = a;
+   BOOST_CHECK( &c.value() == &a.value() );
+
+   content_blob d( std::string( "something else" ) );
+   BOOST_CHECK( a != d );
+
+   content_blob empty;
+   BOOST_CHECK( empty.empty() );
+   BOOST_CHECK( empty == std::string() );
+
+   // serializes exactly like std::string
+   BOOST_CHECK( fc::raw::pack( a ) == fc::raw::pack( body ) );
+   content_blob unpacked = fc::raw::unpack<content_blob>( fc::raw::pack( body ) );
+   BOOST_CHECK( &unpacked.value() == &a.value() );
+
+   fc::variant v;
+   fc::to_variant( a, v, 1 );
+   BOOST_CHECK( v.as_string() == body );
+   content_blob from_var;
+   fc::from_variant( v, from_var, 1 );
+   BOOST_CHECK( from_var == a );
+
+   const auto stats = content_blob_store::instance().get_stats();
+   BOOST_CHECK( stats.blob_count >= 2 );
+   BOOST_CHECK( stats.total_bytes >= body.size() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( pending_transaction_pool_test )
+{ try {
+   const time_point_sec now( 1500000000 );
+   auto make_trx = [&]( account_uid_type from, int64_t fee, uint32_t expiration_offset ) -> processed_transaction
+   {
+      transfer_operation op;
+      op.fee = fee_type( asset( fee ) );
+      op.from = from;
+      op.to = GRAPHENE_NULL_ACCOUNT_UID;
+      op.amount = asset( 1 );
+      processed_transaction trx;
+      trx.operations.push_back( op );
+      trx.expiration = now + expiration_offset;
+      return trx;
+   };
+
+   pending_transaction_pool pool;
+   const processed_transaction low = make_trx( 25638, 10, 10 );
+   const processed_transaction high = make_trx( 25997, 1000, 20 );
+   const processed_transaction mid = make_trx( 25638, 100, 30 );
+   BOOST_CHECK( pool.insert( low ) );
+   BOOST_CHECK( pool.insert( high ) );
+   BOOST_CHECK( pool.insert( mid ) );
+   BOOST_CHECK( !pool.insert( mid ) );
+   BOOST_CHECK_EQUAL( pool.size(), 3u );
+   BOOST_CHECK_EQUAL( pool.count_by_fee_payer( 25638 ), 2u );
+   BOOST_CHECK_EQUAL( pool.total_packed_size(),
+                      fc::raw::pack_size( signed_transaction( low ) ) + fc::raw::pack_size( signed_transaction( high ) )
+                      + fc::raw::pack_size( signed_transaction( mid ) ) );
+
+   // highest fee first, arrival order is kept
+   const auto& pri_idx = pool.indices().get<pending_transaction_pool::by_priority>();
+   vector<transaction_id_type> by_priority;
+   for( const pending_transaction& entry : pri_idx )
+      by_priority.push_back( entry.id );
+   BOOST_REQUIRE_EQUAL( by_priority.size(), 3u );
+   BOOST_CHECK( by_priority[0] == high.id() );
+   BOOST_CHECK( by_priority[1] == mid.id() );
+   BOOST_CHECK( by_priority[2] == low.id() );
+
+   const vector<processed_transaction> in_order = pool.get_transactions();
+   BOOST_REQUIRE_EQUAL( in_order.size(), 3u );
+   BOOST_CHECK( in_order[0].id() == low.id() );
+   BOOST_CHECK( in_order[2].id() == mid.id() );
+
+   // moving entries to another pool keeps the cached values
+   pending_transaction_pool other;
+   other.swap( pool );
+   BOOST_CHECK( pool.empty() );
+   BOOST_CHECK_EQUAL( other.size(), 3u );
+
+   BOOST_CHECK_EQUAL( other.remove_expired( now + 15 ), 1u );
+   BOOST_CHECK( !other.contains( low.id() ) );
+   other.remove( high.id() );
+   BOOST_CHECK_EQUAL( other.size(), 1u );
+   BOOST_CHECK_EQUAL( other.total_packed_size(), fc::raw::pack_size( signed_transaction( mid ) ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( generate_block_deadline_test )
+{ try {
+   ACTORS( (1000) );
+   generate_block();
+   const block_production_stats before = db.get_block_production_stats();
+   for( int64_t amount = 1; amount <= 5; ++amount )
+      transfer( committee_account, u_1000_id, asset( amount ) );
+
+   // inclusion stops at a deadline which has passed, the transactions stay pending
+   block_generation_stats stats;
+   signed_block block = db.generate_block( db.get_slot_time( 1 ), db.get_scheduled_witness( 1 ), init_account_priv_key,
+                                           ~0,
+                                           fc::time_point::now() - fc::seconds( 1 ), stats );
+   BOOST_CHECK( block.transactions.empty() );
+   BOOST_CHECK( stats.deadline_reached );
+   BOOST_CHECK_EQUAL( stats.included, 0u );
+   BOOST_CHECK_EQUAL( stats.deferred, 5u );
+   BOOST_CHECK_EQUAL( stats.failed, 0u );
+
+   block = db.generate_block( db.get_slot_time( 1 ), db.get_scheduled_witness( 1 ), init_account_priv_key,
+                              ~0, fc::time_point::maximum(), stats );
+   BOOST_CHECK_EQUAL( block.transactions.size(), 5u );
+   BOOST_CHECK( !stats.deadline_reached );
+   BOOST_CHECK_EQUAL( stats.included, 5u );
+   BOOST_CHECK_EQUAL( stats.deferred, 0u );
+
+   // the database keeps the totals of both blocks
+   const block_production_stats& totals = db.get_block_production_stats();
+   BOOST_CHECK_EQUAL( totals.blocks_produced, before.blocks_produced + 2 );
+   BOOST_CHECK_EQUAL( totals.deadline_hits, before.deadline_hits + 1 );
+   BOOST_CHECK_EQUAL( totals.transactions_included, before.transactions_included + 5 );
+   BOOST_CHECK_EQUAL( totals.transactions_deferred, before.transactions_deferred + 5 );
+   BOOST_CHECK_EQUAL( totals.last_block.included, 5u );
+   BOOST_CHECK( totals.max_production_time >= totals.last_production_time );
+   db.clear_pending();
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( state_hash_test )
+{ try {
+   db.enable_state_hash( true );
+   BOOST_CHECK( db.verify_state_hash() );
+
+   generate_blocks( 5 );
+   BOOST_CHECK( db.verify_state_hash() );
+   const uint32_t head_num = db.head_block_num();
+   optional<fc::uint128> head_hash = db.get_block_state_hash( head_num );
+   BOOST_REQUIRE( head_hash.valid() );
+   BOOST_CHECK( *head_hash == db.get_state_hash() );
+
+   // popping a block undoes its changes to the state hash
+   optional<fc::uint128> previous_hash = db.get_block_state_hash( head_num - 1 );
+   BOOST_REQUIRE( previous_hash.valid() );
+   db.pop_block();
+   BOOST_CHECK( *previous_hash == db.get_state_hash() );
+   BOOST_CHECK( !db.get_block_state_hash( head_num ).valid() );
+   BOOST_CHECK( db.verify_state_hash() );
+
+   db.enable_state_hash( false );
+   BOOST_CHECK( !db.get_block_state_hash( head_num - 1 ).valid() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( popped_block_redo_test )
+{ try {
+   db.enable_state_hash( true );
+   generate_blocks( 5 );
+   const uint32_t head_num = db.head_block_num();
+   const fc::uint128 head_hash = db.get_state_hash();
+   optional<signed_block> block1 = db.fetch_block_by_number( head_num - 1 );
+   optional<signed_block> block2 = db.fetch_block_by_number( head_num );
+   BOOST_REQUIRE( block1.valid() && block2.valid() );
+
+   db.pop_block();
+   const fc::uint128 block1_hash = db.get_state_hash();
+   BOOST_CHECK( block1_hash != head_hash );
+   db.pop_block();
+   const fc::uint128 block0_hash = db.get_state_hash();
+   BOOST_CHECK( block0_hash != block1_hash );
+   BOOST_CHECK_EQUAL( db.head_block_num(), head_num - 2 );
+   BOOST_CHECK( db.verify_state_hash() );
+
+   // pushing the popped blocks again restores them from the changes kept when they were popped
+   db.push_block( *block1 );
+   BOOST_CHECK( db.get_state_hash() == block1_hash );
+   db.push_block( *block2 );
+   BOOST_CHECK( db.head_block_id() == block2->id() );
+   BOOST_CHECK( db.get_state_hash() == head_hash );
+   BOOST_CHECK( db.verify_state_hash() );
+
+   // a restored block can be popped again, which rewinds its changes
+   db.pop_block();
+   BOOST_CHECK_EQUAL( db.head_block_num(), head_num - 1 );
+   BOOST_CHECK( db.head_block_id() == block1->id() );
+   BOOST_CHECK( db.get_state_hash() == block1_hash );
+   BOOST_CHECK( db.verify_state_hash() );
+
+   // restored from redo again, popped again, and the redo state kept by the second pop is complete
+   db.push_block( *block2 );
+   BOOST_CHECK( db.get_state_hash() == head_hash );
+   db.pop_block();
+   BOOST_CHECK( db.get_state_hash() == block1_hash );
+   BOOST_CHECK( db.verify_state_hash() );
+   db.pop_block();
+   BOOST_CHECK_EQUAL( db.head_block_num(), head_num - 2 );
+   BOOST_CHECK( db.get_state_hash() == block0_hash );
+   BOOST_CHECK( db.verify_state_hash() );
+
+   db.push_block( *block1 );
+   BOOST_CHECK( db.get_state_hash() == block1_hash );
+   db.push_block( *block2 );
+   BOOST_CHECK( db.head_block_id() == block2->id() );
+   BOOST_CHECK( db.get_state_hash() == head_hash );
+   BOOST_CHECK( db.verify_state_hash() );
+
+   generate_block();
+   BOOST_CHECK( db.verify_state_hash() );
+} FC_LOG_AND_RETHROW() }
+
+namespace {
+
+void copy_directory( const fc::path& from, const fc::path& to )
+{
+   namespace bfs = boost::filesystem;
+   const bfs::path source( from.string() );
+   const bfs::path target( to.string() );
+   bfs::create_directories( target );
+   for( bfs::recursive_directory_iterator itr( source ), end; itr != end; ++itr )
+   {
+      const bfs::path destination = target / itr->path().string().substr( source.string().size() );
+      if( bfs::is_directory( itr->status() ) )
+         bfs::create_directories( destination );
+      else
+         bfs::copy_file( itr->path(), destination );
+   }
+}
+
+}
+
+BOOST_AUTO_TEST_CASE( background_flush_restart_test )
+{ try {
+   generate_blocks( 20 );
+   db.set_flush_interval( 1 );
+   generate_block();
+   BOOST_REQUIRE( db.background_flush_in_progress() );
+   BOOST_REQUIRE( db.finish_background_flush( true ) );
+   db.set_flush_interval( 0 );
+   const uint32_t last_irreversible_block_num = db.get_dynamic_global_properties().last_irreversible_block_num;
+   BOOST_REQUIRE( last_irreversible_block_num > 0 && last_irreversible_block_num < db.head_block_num() );
+
+   // a crash right after the flush leaves the flushed state and the synced block log
+   fc::temp_directory crashed_dir( graphene::utilities::temp_directory_path() );
+   fc::copy( data_dir->path() / "db_version", crashed_dir.path() / "db_version" );
+   copy_directory( data_dir->path() / "object_database", crashed_dir.path() / "object_database" );
+   copy_directory( data_dir->path() / "database", crashed_dir.path() / "database" );
+
+   // the flushed state is of the last irreversible block, the reversible blocks are replayed with undo history
+   database restarted;
+   restarted.open( crashed_dir.path(), [this]{ return genesis_state; }, "test" );
+   BOOST_CHECK( restarted.head_block_id() == db.head_block_id() );
+   restarted.enable_state_hash( true );
+
+   // a longer fork starting at the last irreversible block
+   fc::temp_directory fork_dir( graphene::utilities::temp_directory_path() );
+   database forker;
+   forker.open( fork_dir.path(), [this]{ return genesis_state; }, "test" );
+   for( uint32_t num = 1; num <= last_irreversible_block_num; ++num )
+      forker.push_block( *db.fetch_block_by_number( num ) );
+   forker.enable_state_hash( true );
+   vector<signed_block> fork;
+   for( uint32_t num = last_irreversible_block_num; num <= db.head_block_num(); ++num )
+   {
+      // skip a slot first so that the fork differs from the chain of db
+      const uint32_t slot = fork.empty() ? 2 : 1;
+      fork.push_back( forker.generate_block( forker.get_slot_time( slot ), forker.get_scheduled_witness( slot ),
+                                             init_account_priv_key, ~0 | database::skip_undo_history_check ) );
+      forker.clear_pending();
+   }
+
+   // the restarted node pops its reversible blocks to switch to the fork
+   for( const signed_block& block : fork )
+      restarted.push_block( block );
+   BOOST_CHECK( restarted.head_block_id() == forker.head_block_id() );
+   BOOST_CHECK( restarted.get_state_hash() == forker.get_state_hash() );
+   BOOST_CHECK( restarted.verify_state_hash() );
+
+   restarted.close();
+   forker.close();
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( fork_database_unlinked_test )
+{ try {
+   const vector<signed_block> blocks = test::make_linked_blocks( 5 );
+
+   fork_database fork_db;
+   fork_db.start_block( blocks[1] );
+
+   // blocks arriving ahead of their predecessor are kept
+   GRAPHENE_CHECK_THROW( fork_db.push_block( blocks[4] ), unlinkable_block_buffered );
+   GRAPHENE_CHECK_THROW( fork_db.push_block( blocks[3] ), unlinkable_block_buffered );
+   BOOST_CHECK_EQUAL( fork_db.unlinked_size(), 2u );
+   BOOST_CHECK( fork_db.unlinked_bytes() > 0 );
+   BOOST_CHECK( fork_db.is_known_block( blocks[4].id() ) );
+   BOOST_CHECK( fork_db.head()->id == blocks[1].id() );
+
+   // and linked together with the missing one
+   BOOST_CHECK( fork_db.push_block( blocks[2] )->id == blocks[4].id() );
+   BOOST_CHECK_EQUAL( fork_db.unlinked_size(), 0u );
+   BOOST_CHECK_EQUAL( fork_db.unlinked_bytes(), 0u );
+   auto branches = fork_db.fetch_branch_from( blocks[4].id(), blocks[1].id() );
+   BOOST_CHECK_EQUAL( branches.first.size(), 3u );
+
+   // blocks too far ahead of the head are rejected
+   signed_block far_ahead;
+   far_ahead.previous = block_id_type();
+   far_ahead.previous._hash[0] = fc::endian_reverse_u32( blocks[4].block_num() + fork_database::MAX_BLOCK_REORDERING + 1 );
+   GRAPHENE_CHECK_THROW( fork_db.push_block( far_ahead ), unlinkable_block_exception );
+   BOOST_CHECK_EQUAL( fork_db.unlinked_size(), 0u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( proposal_authorization_cache_test )
+{ try {
+   ACTORS( (1000)(1001)(1002) );
+   transfer( committee_account, u_1000_id, asset( 10000 * GRAPHENE_BLOCKCHAIN_PRECISION ) );
+   transfer( committee_account, u_1002_id, asset( 10000 * GRAPHENE_BLOCKCHAIN_PRECISION ) );
+
+   auto update_active = [&]( account_uid_type uid, const public_key_type& key ) {
+      account_update_auth_operation op;
+      op.uid = uid;
+      op.active = authority( 1, key, 1 );
+      set_expiration( db, trx );
+      trx.operations.push_back( op );
+      for( auto& o : trx.operations ) db.current_fee_schedule().set_fee( o );
+      db.push_transaction( trx, ~0 );
+      trx.operations.clear();
+   };
+
+   // a transfer from u1000 approved with the key of u1001, which does not control u1000 yet
+   transfer_operation xfer;
+   xfer.from = u_1000_id;
+   xfer.to = u_1001_id;
+   xfer.amount = asset( 1 );
+   const proposal_object& proposal = db.create<proposal_object>( [&]( proposal_object& p ) {
+      p.expiration_time = db.head_block_time() + fc::days( 1 );
+      p.proposed_transaction.operations.push_back( xfer );
+      p.required_active_approvals.insert( u_1000_id );
+      p.available_key_approvals.insert( u_1001_public_key );
+   });
+   const proposal_id_type proposal_id = proposal.id;
+   const auto& approvals = dynamic_cast<const primary_index<proposal_index>&>( db.get_index_type<proposal_index>() )
+                              .get_secondary_index<required_approval_index>();
+
+   BOOST_CHECK( !proposal_id(db).is_authorized_to_execute( db ) );
+   BOOST_REQUIRE( approvals._authorizations.count( proposal_id ) == 1 );
+   BOOST_CHECK( approvals._authorizations.at( proposal_id ).authority_changes.count( u_1000_id ) == 1 );
+   BOOST_CHECK( approvals._authorizations.at( proposal_id ).authority_changes.count( u_1002_id ) == 0 );
+
+   // the cached result is returned: falsify it to tell it from a recomputed one
+   approvals._authorizations.at( proposal_id ).authorized = true;
+   BOOST_CHECK( proposal_id(db).is_authorized_to_execute( db ) );
+
+   // an authority change of an account which was not consulted keeps the cached result
+   update_active( u_1002_id, u_1001_public_key );
+   BOOST_CHECK( proposal_id(db).is_authorized_to_execute( db ) );
+
+   // an authority change of a consulted account drops it
+   approvals._authorizations.at( proposal_id ).authorized = false;
+   update_active( u_1000_id, u_1001_public_key );
+   BOOST_CHECK( proposal_id(db).is_authorized_to_execute( db ) );
+
+   // and so does a change of the proposal
+   db.modify( proposal_id(db), []( proposal_object& p ) {
+      p.available_key_approvals.clear();
+   });
+   BOOST_CHECK( approvals._authorizations.count( proposal_id ) == 0 );
+   BOOST_CHECK( !proposal_id(db).is_authorized_to_execute( db ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( block_database_journal_test )
+{ try {
+   fc::temp_directory dir( graphene::utilities::temp_directory_path() );
+   fc::temp_directory crashed_dir( graphene::utilities::temp_directory_path() );
+
+   const vector<signed_block> blocks = test::make_linked_blocks( 4 );
+
+   block_database db;
+   db.open( dir.path() );
+   for( size_t i = 1; i < blocks.size(); ++i )
+      db.store( blocks[i].id(), blocks[i] );
+   db.sync();
+
+   // a crash before the index reached the disk leaves the synced block log and journal
+   fc::copy( dir.path() / "blocks", crashed_dir.path() / "blocks" );
+   fc::copy( dir.path() / "journal", crashed_dir.path() / "journal" );
+   std::ofstream( ( crashed_dir.path() / "index" ).generic_string().c_str() );
+   {
+      // a torn record at the end of the journal is ignored
+      std::ofstream journal( ( crashed_dir.path() / "journal" ).generic_string().c_str(), std::ios::binary | std::ios::app );
+      journal.write( "torn", 4 );
+   }
+   db.close();
+
+   block_database recovered;
+   recovered.open( crashed_dir.path() );
+   for( size_t i = 1; i < blocks.size(); ++i )
+   {
+      auto b = recovered.fetch_by_number( i );
+      BOOST_REQUIRE( b.valid() );
+      BOOST_CHECK( b->id() == blocks[i].id() );
+   }
+   recovered.close();
+   BOOST_CHECK_EQUAL( fc::file_size( crashed_dir.path() / "journal" ), 0u );
+
+   auto result = block_database::verify( crashed_dir.path(), 2 );
+   BOOST_CHECK( result.ok() );
+   BOOST_CHECK_EQUAL( result.blocks_checked, 3u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( block_log_segments_test )
+{ try {
+   if( !block_log_segments::is_supported() )
+      return;
+   fc::temp_directory dir( graphene::utilities::temp_directory_path() );
+
+   const vector<signed_block> blocks = test::make_linked_blocks( 11 );
+
+   block_database db;
+   db.open( dir.path() );
+   for( size_t i = 1; i < blocks.size(); ++i )
+      db.store( blocks[i].id(), blocks[i] );
+
+   // two complete segments of 4 blocks, the reversible tail and block 9 stay in the block log
+   db.set_segment_size( 4, 2 );
+   db.compress_irreversible( 9 );
+   // pruning stops at the blocks being compressed in the background
+   db.prune( 3 );
+   BOOST_CHECK_EQUAL( db.first_available_block_num(), 1u );
+   // the blocks stay readable while the segments are written, and once they are added
+   for( int pass = 0; pass < 2; ++pass )
+   {
+      for( uint32_t i = 1; i < blocks.size(); ++i )
+      {
+         auto b = db.fetch_by_number( i );
+         BOOST_REQUIRE( b.valid() );
+         BOOST_CHECK( b->id() == blocks[i].id() );
+      }
+      db.wait_for_compression();
+   }
+   // the space of the compressed blocks is released only once the journal no longer refers to them
+   BOOST_CHECK_EQUAL( fc::file_size( dir.path() / "journal" ), 0u );
+   {
+      // a crash now recovers every block
+      fc::temp_directory crashed_dir( graphene::utilities::temp_directory_path() );
+      copy_directory( dir.path(), crashed_dir.path() );
+      block_database recovered;
+      recovered.open( crashed_dir.path() );
+      for( uint32_t i = 1; i < blocks.size(); ++i )
+      {
+         auto b = recovered.fetch_by_number( i );
+         BOOST_REQUIRE( b.valid() );
+         BOOST_CHECK( b->id() == blocks[i].id() );
+      }
+      recovered.close();
+   }
+   db.close();
+
+   block_database reopened;
+   reopened.open( dir.path() );
+   BOOST_CHECK( reopened.fetch_optional( blocks[3].id() ).valid() );
+   BOOST_CHECK( reopened.last()->id() == blocks[10].id() );
+   reopened.close();
+
+   block_log_segments segments;
+   segments.open( dir.path() / "segments" );
+   BOOST_CHECK_EQUAL( segments.begin_block_num(), 1u );
+   BOOST_CHECK_EQUAL( segments.end_block_num(), 9u );
+   BOOST_CHECK( block_database::verify( dir.path(), 2 ).ok() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( block_database_prune_test )
+{ try {
+   fc::temp_directory dir( graphene::utilities::temp_directory_path() );
+
+   const vector<signed_block> blocks = test::make_linked_blocks( 11 );
+
+   block_database db;
+   db.open( dir.path() );
+   for( size_t i = 1; i < blocks.size(); ++i )
+      db.store( blocks[i].id(), blocks[i] );
+   BOOST_CHECK_EQUAL( db.first_available_block_num(), 1u );
+
+   db.prune( 6 );
+   BOOST_CHECK_EQUAL( db.first_available_block_num(), 6u );
+   BOOST_CHECK( !db.fetch_by_number( 5 ).valid() );
+   BOOST_CHECK( !db.contains( blocks[5].id() ) );
+   // the ids of pruned blocks are kept
+   BOOST_CHECK( db.fetch_block_id( 5 ) == blocks[5].id() );
+   BOOST_CHECK( db.fetch_by_number( 6 )->id() == blocks[6].id() );
+   db.close();
+
+   db.open( dir.path() );
+   BOOST_CHECK_EQUAL( db.first_available_block_num(), 6u );
+   BOOST_CHECK( db.last()->id() == blocks[10].id() );
+   db.close();
+
+   // a crash after pruning recovers the blocks stored after it: the journal replay does not stop at the
+   // records storing the pruned blocks, whose space was released
+   fc::temp_directory live_dir( graphene::utilities::temp_directory_path() );
+   fc::temp_directory crashed_dir( graphene::utilities::temp_directory_path() );
+   block_database live;
+   live.open( live_dir.path() );
+   for( size_t i = 1; i <= 8; ++i )
+      live.store( blocks[i].id(), blocks[i] );
+   live.prune( 6 );
+   live.sync();
+   for( size_t i = 9; i < blocks.size(); ++i )
+      live.store( blocks[i].id(), blocks[i] );
+   live.sync();
+   for( const char* name : { "blocks", "journal", "index" } )
+      fc::copy( live_dir.path() / name, crashed_dir.path() / name );
+   live.close();
+
+   block_database recovered;
+   recovered.open( crashed_dir.path() );
+   BOOST_CHECK_EQUAL( recovered.first_available_block_num(), 6u );
+   BOOST_CHECK( recovered.last()->id() == blocks[10].id() );
+   BOOST_CHECK( recovered.fetch_by_number( 9 ).valid() );
+   recovered.close();
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( block_log_segments_prune_test )
+{ try {
+   if( !block_log_segments::is_supported() )
+      return;
+   fc::temp_directory dir( graphene::utilities::temp_directory_path() );
+
+   const vector<signed_block> blocks = test::make_linked_blocks( 13 );
+
+   block_database db;
+   db.open( dir.path() );
+   for( size_t i = 1; i < blocks.size(); ++i )
+      db.store( blocks[i].id(), blocks[i] );
+   db.set_segment_size( 4, 1 );
+
+   // compression starts at the first block which is not pruned
+   db.prune( 3 );
+   db.compress_irreversible( 12 );
+   db.wait_for_compression();
+
+   // pruning past the end of the segments leaves a gap before the next segment, even before the next
+   // sync removes the pruned segments
+   db.prune( 8 );
+   db.compress_irreversible( 12 );
+   db.wait_for_compression();
+   for( uint32_t i = 1; i < blocks.size(); ++i )
+      BOOST_CHECK_EQUAL( db.fetch_by_number( i ).valid(), i >= 8 );
+   db.close();
+
+   block_log_segments segments;
+   segments.open( dir.path() / "segments" );
+   BOOST_CHECK_EQUAL( segments.begin_block_num(), 8u );
+   BOOST_CHECK_EQUAL( segments.end_block_num(), 12u );
+   BOOST_CHECK( !segments.contains( 7 ) );
+   BOOST_CHECK( segments.contains( 11 ) );
+   segments.close();
+
+   db.open( dir.path() );
+   BOOST_CHECK_EQUAL( db.first_available_block_num(), 8u );
+   BOOST_CHECK( db.last()->id() == blocks[12].id() );
+   db.close();
+   BOOST_CHECK( block_database::verify( dir.path(), 2 ).ok() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( pruned_block_range_test )
+{ try {
+   const uint32_t window = 10;
+   db.set_block_prune_window( window );
+   generate_blocks( GRAPHENE_BLOCK_PRUNE_BATCH + 2 * window );
+   // nothing is pruned past the state the database was opened with
+   BOOST_CHECK_EQUAL( db.first_available_block_num(), 1u );
+
+   db.set_flush_interval( GRAPHENE_BLOCK_PRUNE_BATCH );
+   generate_blocks( GRAPHENE_BLOCK_PRUNE_BATCH );
+   BOOST_REQUIRE( db.finish_background_flush( true ) );
+   db.set_flush_interval( 0 );
+   // blocks are on disk as soon as they are stored, for the restart below
+   db.set_block_log_sync_interval( fc::microseconds( 0 ) );
+   generate_block();
+   const uint32_t first_available = db.first_available_block_num();
+   BOOST_REQUIRE_GT( first_available, 1u );
+   BOOST_CHECK_LE( first_available, db.get_dynamic_global_properties().last_irreversible_block_num );
+   BOOST_CHECK_LE( first_available, db.head_block_num() - window + 1 );
+
+   // pruned blocks are reported as such, their ids are still known
+   const block_id_type pruned_id = db.get_block_id_for_num( first_available - 1 );
+   BOOST_CHECK( !db.fetch_block_by_id( pruned_id ).valid() );
+   GRAPHENE_CHECK_THROW( db.get_block_by_id( pruned_id ), fc::key_not_found_exception );
+   const block_id_type available_id = db.get_block_id_for_num( first_available );
+   BOOST_CHECK( db.get_block_by_id( available_id ).id() == available_id );
+
+   // a peer which knows the last pruned block gets the available ones, a peer further behind gets nothing
+   BOOST_CHECK( db.get_block_ids_from( 1, 10 ).empty() );
+   BOOST_CHECK( db.get_block_ids_from( first_available - 2, 10 ).empty() );
+   const vector<block_id_type> ids = db.get_block_ids_from( first_available - 1, 10 );
+   BOOST_REQUIRE_EQUAL( ids.size(), 10u );
+   BOOST_CHECK( ids.front() == pruned_id );
+   BOOST_CHECK( ids.back() == db.get_block_id_for_num( first_available + 8 ) );
+   BOOST_CHECK_EQUAL( db.get_block_ids_from( db.head_block_num() - 1, 10 ).size(), 2u );
+
+   // a node restarted from the flushed state after a crash still has the blocks to replay
+   fc::temp_directory crashed_dir( graphene::utilities::temp_directory_path() );
+   fc::copy( data_dir->path() / "db_version", crashed_dir.path() / "db_version" );
+   copy_directory( data_dir->path() / "object_database", crashed_dir.path() / "object_database" );
+   copy_directory( data_dir->path() / "database", crashed_dir.path() / "database" );
+   database restarted;
+   restarted.open( crashed_dir.path(), [this]{ return genesis_state; }, "test" );
+   BOOST_CHECK( restarted.head_block_id() == db.head_block_id() );
+   restarted.close();
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( block_database_gap_test )
+{ try {
+   fc::temp_directory dir( graphene::utilities::temp_directory_path() );
+
+   const vector<signed_block> blocks = test::make_linked_blocks( 11 );
+
+   // a block log which starts above block 1 leaves the index entries below its first block unwritten
+   block_database db;
+   db.open( dir.path() );
+   for( size_t i = 6; i < blocks.size(); ++i )
+      db.store( blocks[i].id(), blocks[i] );
+   db.close();
+
+   db.open( dir.path() );
+   BOOST_CHECK_EQUAL( db.first_available_block_num(), 6u );
+   BOOST_CHECK( !db.fetch_by_number( 3 ).valid() );
+   BOOST_CHECK( db.fetch_by_number( 6 )->id() == blocks[6].id() );
+   BOOST_CHECK( db.last()->id() == blocks[10].id() );
+   db.close();
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( state_snapshot_test )
+{ try {
+   db.enable_state_hash( true );
+   generate_blocks( 20 );
+   const uint32_t last_irreversible_block_num = db.get_dynamic_global_properties().last_irreversible_block_num;
+   BOOST_REQUIRE( last_irreversible_block_num > 0 && last_irreversible_block_num < db.head_block_num() );
+   const block_id_type head_id = db.head_block_id();
+   const block_id_type irreversible_id = db.get_block_id_for_num( last_irreversible_block_num );
+   const fc::uint128 head_hash = db.get_state_hash();
+   BOOST_REQUIRE( db.get_block_state_hash( last_irreversible_block_num ).valid() );
+   const fc::uint128 irreversible_hash = *db.get_block_state_hash( last_irreversible_block_num );
+
+   fc::temp_directory snapshot_dir( graphene::utilities::temp_directory_path() );
+   db.export_snapshot( snapshot_dir.path() );
+   // the reversible blocks are restored after the export
+   BOOST_CHECK( db.head_block_id() == head_id );
+   BOOST_CHECK( db.get_state_hash() == head_hash );
+
+   fc::temp_directory imported_dir( graphene::utilities::temp_directory_path() );
+   {
+      database rejected;
+      GRAPHENE_CHECK_THROW( rejected.open_from_snapshot( snapshot_dir.path(), head_id, irreversible_hash,
+                                                         imported_dir.path(), [this]{ return genesis_state; }, "test" ),
+                            fc::exception );
+      // the hash in the snapshot is not trusted
+      GRAPHENE_CHECK_THROW( rejected.open_from_snapshot( snapshot_dir.path(), irreversible_id, head_hash,
+                                                         imported_dir.path(), [this]{ return genesis_state; }, "test" ),
+                            fc::exception );
+   }
+   {
+      // a snapshot whose header claims the trusted hash for a state which does not have it
+      auto header = fc::json::from_file( snapshot_dir.path() / "snapshot.json" )
+                       .as<state_snapshot_header>( GRAPHENE_MAX_NESTED_OBJECTS );
+      header.state_hash = head_hash;
+      fc::temp_directory tampered_dir( graphene::utilities::temp_directory_path() );
+      copy_directory( snapshot_dir.path() / "object_database", tampered_dir.path() / "object_database" );
+      fc::json::save_to_file( header, tampered_dir.path() / "snapshot.json", GRAPHENE_MAX_NESTED_OBJECTS );
+      database rejected;
+      GRAPHENE_CHECK_THROW( rejected.open_from_snapshot( tampered_dir.path(), irreversible_id, head_hash,
+                                                         imported_dir.path(), [this]{ return genesis_state; }, "test" ),
+                            fc::exception );
+      BOOST_CHECK( !fc::exists( imported_dir.path() / "object_database" ) );
+   }
+
+   database imported;
+   imported.open_from_snapshot( snapshot_dir.path(), irreversible_id, irreversible_hash, imported_dir.path(),
+                                [this]{ return genesis_state; }, "test" );
+   BOOST_CHECK( imported.head_block_id() == irreversible_id );
+   BOOST_CHECK_EQUAL( imported.first_available_block_num(), last_irreversible_block_num );
+
+   // the node continues with the blocks following the snapshot
+   for( uint32_t num = last_irreversible_block_num + 1; num <= db.head_block_num(); ++num )
+      imported.push_block( *db.fetch_block_by_number( num ) );
+   BOOST_CHECK( imported.head_block_id() == head_id );
+   imported.close();
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( index_memory_usage_test )
+{ try {
+   using graphene::db::heap_allocation_size;
+   using graphene::db::heap_size_of;
+
+   BOOST_CHECK_EQUAL( heap_allocation_size( 0 ), 0u );
+   BOOST_CHECK_EQUAL( heap_allocation_size( 1 ), 32u );
+   BOOST_CHECK_EQUAL( heap_allocation_size( 40 ), 48u );
+
+   const std::string empty;
+   const std::string long_string( 100, 'x' );
+   BOOST_CHECK_EQUAL( heap_size_of( empty ), 0u );
+   BOOST_CHECK_EQUAL( heap_size_of( long_string ), heap_allocation_size( long_string.capacity() + 1 ) );
+
+   std::vector<uint64_t> numbers;
+   BOOST_CHECK_EQUAL( heap_size_of( numbers ), 0u );
+   numbers.reserve( 10 );
+   numbers.push_back( 1 );
+   BOOST_CHECK_EQUAL( heap_size_of( numbers ), heap_allocation_size( numbers.capacity() * sizeof(uint64_t) ) );
+
+   std::map<uint64_t, std::string> names = { { 1, long_string }, { 2, empty } };
+   const uint64_t node_bytes = heap_allocation_size( sizeof( std::pair<const uint64_t, std::string> )
+                                                     + graphene::db::tree_node_overhead );
+   BOOST_CHECK_EQUAL( heap_size_of( names ), 2 * node_bytes + heap_size_of( long_string ) );
+
+   fc::optional<std::string> maybe;
+   BOOST_CHECK_EQUAL( heap_size_of( maybe ), 0u );
+   maybe = long_string;
+   BOOST_CHECK_EQUAL( heap_size_of( maybe ), heap_size_of( long_string ) );
+
+   const auto usage = db.get_index_memory_usage();
+   auto accounts = std::find_if( usage.begin(), usage.end(), []( const graphene::db::index_memory_usage& u ) {
+      return u.space_id == account_object::space_id && u.type_id == account_object::type_id;
+   });
+   BOOST_REQUIRE( accounts != usage.end() );
+   const auto& account_idx = db.get_index_type<account_index>().indices();
+   BOOST_CHECK_EQUAL( accounts->object_count, account_idx.size() );
+   BOOST_CHECK_EQUAL( accounts->object_bytes, account_idx.size() * sizeof( account_object ) );
+   uint64_t dynamic_bytes = 0;
+   for( const auto& a : account_idx )
+      dynamic_bytes += heap_size_of( a );
+   BOOST_CHECK_EQUAL( accounts->dynamic_bytes, dynamic_bytes );
+   BOOST_CHECK_GT( accounts->node_overhead_bytes, 0u );
+   BOOST_CHECK_GT( accounts->total_bytes(), accounts->object_bytes );
+   BOOST_CHECK( accounts->name.find( "account_object" ) != std::string::npos );
+
+   BOOST_REQUIRE_EQUAL( accounts->secondary_indexes.size(), 4u );
+   BOOST_CHECK( accounts->secondary_indexes[0].name.find( "account_member_index" ) != std::string::npos );
+   BOOST_CHECK( accounts->secondary_indexes[1].name.find( "account_referrer_index" ) != std::string::npos );
+   BOOST_CHECK( accounts->secondary_indexes[2].name.find( "account_authority_change_index" ) != std::string::npos );
+   BOOST_CHECK( accounts->secondary_indexes[3].name.find( "account_name_prefix_index" ) != std::string::npos );
+   BOOST_CHECK_EQUAL( accounts->secondary_indexes[3].entry_count, account_idx.size() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( account_name_trie_test )
+{ try {
+   account_name_trie trie;
+   const std::vector<std::string> names = { "alice", "alicia", "ali", "bob", "bobby", "b", "carol" };
+   for( size_t i = 0; i < names.size(); ++i )
+      BOOST_CHECK( trie.insert( names[i], 100 + i ) );
+   BOOST_CHECK( !trie.insert( "alice", 1 ) );
+   BOOST_CHECK_EQUAL( trie.size(), names.size() );
+   BOOST_CHECK_EQUAL( *trie.find( "alicia" ), 101u );
+   BOOST_CHECK( !trie.find( "alic" ).valid() );
+   BOOST_CHECK( !trie.find( "alicex" ).valid() );
+
+   BOOST_CHECK_EQUAL( trie.count_prefix( "" ), names.size() );
+   BOOST_CHECK_EQUAL( trie.count_prefix( "ali" ), 3u );
+   BOOST_CHECK_EQUAL( trie.count_prefix( "ALIC" ), 2u );
+   BOOST_CHECK_EQUAL( trie.count_prefix( "bo" ), 2u );
+   BOOST_CHECK_EQUAL( trie.count_prefix( "d" ), 0u );
+
+   typedef std::vector<std::pair<std::string,account_uid_type>> results;
+   BOOST_CHECK( trie.find_prefix( "Ali", "", 10 ) == results({ { "ali", 102 }, { "alice", 100 }, { "alicia", 101 } }) );
+   BOOST_CHECK( trie.find_prefix( "b", "", 2 ) == results({ { "b", 105 }, { "bob", 103 } }) );
+   BOOST_CHECK( trie.find_prefix( "b", "bob", 2 ) == results({ { "bobby", 104 } }) );
+   BOOST_CHECK( trie.find_prefix( "", "bobby", 10 ) == results({ { "carol", 106 } }) );
+   BOOST_CHECK( trie.find_prefix( "ali", "ab", 1 ) == results({ { "ali", 102 } }) );
+   BOOST_CHECK( trie.find_prefix( "ali", "b", 10 ).empty() );
+   BOOST_CHECK( trie.find_prefix( "x", "", 10 ).empty() );
+
+   // paging through all names returns each once, in order
+   std::vector<std::string> paged;
+   std::string cursor;
+   for( auto page = trie.find_prefix( "", cursor, 3 ); !page.empty(); page = trie.find_prefix( "", cursor, 3 ) )
+   {
+      for( const auto& item : page )
+         paged.push_back( item.first );
+      cursor = paged.back();
+   }
+   std::vector<std::string> sorted_names = names;
+   std::sort( sorted_names.begin(), sorted_names.end() );
+   BOOST_CHECK( paged == sorted_names );
+
+   BOOST_CHECK( trie.remove( "alice" ) );
+   BOOST_CHECK( !trie.remove( "alice" ) );
+   BOOST_CHECK( !trie.remove( "al" ) );
+   BOOST_CHECK_EQUAL( trie.count_prefix( "ali" ), 2u );
+   for( const auto& name : names )
+      trie.remove( name );
+   BOOST_CHECK_EQUAL( trie.size(), 0u );
+   BOOST_CHECK_EQUAL( trie.node_count(), 1u );
+
+   // the secondary index holds the names of all accounts
+   const auto& idx = dynamic_cast<const primary_index<account_index>&>( db.get_index_type<account_index>() );
+   const auto& prefix_index = idx.get_secondary_index<account_name_prefix_index>();
+   BOOST_CHECK_EQUAL( prefix_index.names.size(), idx.indices().size() );
+   const account_object& committee = db.get_account_by_uid( GRAPHENE_COMMITTEE_ACCOUNT_UID );
+   BOOST_CHECK_EQUAL( *prefix_index.names.find( committee.name ), committee.uid );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
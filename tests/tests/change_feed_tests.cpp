@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/change_feed/change_feed_reader.hpp>
+#include <graphene/utilities/tempdir.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+using namespace graphene::change_feed;
+
+namespace {
+
+change_feed_block make_block( uint32_t block_num )
+{
+   change_feed_block block;
+   block.block_num = block_num;
+   block.block_id._hash[0] = block_num;
+   block.timestamp = fc::time_point_sec( 1500000000 + 3 * block_num );
+   for( uint32_t i = 0; i < block_num % 4; ++i )
+   {
+      change_feed_object item;
+      item.id   = object_id_type( 1, 2, block_num * 10 + i );
+      item.kind = i % 3;
+      item.data = vector<char>( 20 * i, char( block_num ) );
+      block.objects.push_back( item );
+   }
+   return block;
+}
+
+bool same_block( const change_feed_block& a, const change_feed_block& b )
+{
+   return fc::raw::pack( a ) == fc::raw::pack( b );
+}
+
+/// Append the first @p size bytes of the record of @p block to feed file @p sequence, all of it by default
+void append_record( const fc::path& dir, uint32_t sequence, const change_feed_block& block,
+                    size_t size = size_t(-1) )
+{
+   std::ostringstream record;
+   write_change_feed_record( record, block );
+   const string bytes = record.str();
+   std::ofstream file( ( dir / change_feed_file_name( sequence ) ).generic_string().c_str(),
+                       std::ios::out | std::ios::binary | std::ios::app );
+   file.write( bytes.data(), std::min( size, bytes.size() ) );
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE( change_feed_tests )
+
+BOOST_AUTO_TEST_CASE( change_feed_round_trip_test )
+{ try {
+   fc::temp_directory dir( graphene::utilities::temp_directory_path() );
+   {
+      change_feed_reader reader( dir.path() );
+      BOOST_CHECK( !reader.read_next().valid() );
+   }
+
+   uint64_t size = 0;
+   {
+      std::ofstream file( ( dir.path() / change_feed_file_name( 1 ) ).generic_string().c_str(),
+                          std::ios::out | std::ios::binary );
+      for( uint32_t num = 1; num <= 5; ++num )
+         size += write_change_feed_record( file, make_block( num ) );
+   }
+   BOOST_CHECK_EQUAL( fc::file_size( dir.path() / change_feed_file_name( 1 ) ), size );
+
+   change_feed_reader reader( dir.path() );
+   change_feed_reader::position third;
+   for( uint32_t num = 1; num <= 5; ++num )
+   {
+      auto block = reader.read_next();
+      BOOST_REQUIRE( block.valid() );
+      BOOST_CHECK( same_block( *block, make_block( num ) ) );
+      if( num == 3 )
+         third = reader.current_position();
+   }
+   BOOST_CHECK( !reader.read_next().valid() );
+   BOOST_CHECK_EQUAL( reader.current_position().sequence, 1u );
+   BOOST_CHECK_EQUAL( reader.current_position().offset, size );
+
+   // records appended to the file and to the next one are picked up
+   append_record( dir.path(), 1, make_block( 6 ) );
+   append_record( dir.path(), 2, make_block( 7 ) );
+   for( uint32_t num = 6; num <= 7; ++num )
+   {
+      auto block = reader.read_next();
+      BOOST_REQUIRE( block.valid() );
+      BOOST_CHECK( same_block( *block, make_block( num ) ) );
+   }
+   BOOST_CHECK_EQUAL( reader.current_position().sequence, 2u );
+
+   // a reader resumes from a saved position
+   change_feed_reader resumed( dir.path(), third );
+   for( uint32_t num = 4; num <= 7; ++num )
+   {
+      auto block = resumed.read_next();
+      BOOST_REQUIRE( block.valid() );
+      BOOST_CHECK( same_block( *block, make_block( num ) ) );
+   }
+   BOOST_CHECK( !resumed.read_next().valid() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( change_feed_torn_record_test )
+{ try {
+   fc::temp_directory dir( graphene::utilities::temp_directory_path() );
+   append_record( dir.path(), 1, make_block( 1 ) );
+   append_record( dir.path(), 1, make_block( 2 ) );
+   // the writer stopped in the header of the next record
+   append_record( dir.path(), 1, make_block( 3 ), change_feed_frame_header_size / 2 );
+
+   change_feed_reader reader( dir.path() );
+   BOOST_REQUIRE( reader.read_next().valid() );
+   BOOST_REQUIRE( reader.read_next().valid() );
+   const change_feed_reader::position torn = reader.current_position();
+   BOOST_CHECK( !reader.read_next().valid() );
+   BOOST_CHECK_EQUAL( reader.current_position().offset, torn.offset );
+
+   // a torn final record is never returned, even with its header complete
+   {
+      std::ostringstream record;
+      write_change_feed_record( record, make_block( 3 ) );
+      const string bytes = record.str();
+      std::ofstream file( ( dir.path() / change_feed_file_name( 1 ) ).generic_string().c_str(),
+                          std::ios::out | std::ios::binary | std::ios::app );
+      file.write( bytes.data() + change_feed_frame_header_size / 2, bytes.size() / 2 );
+   }
+   BOOST_CHECK( !reader.read_next().valid() );
+   BOOST_CHECK_EQUAL( reader.current_position().offset, torn.offset );
+
+   // after a restart the writer continues in a new file, the torn record is skipped
+   append_record( dir.path(), 2, make_block( 3 ) );
+   append_record( dir.path(), 2, make_block( 4 ) );
+   for( uint32_t num = 3; num <= 4; ++num )
+   {
+      auto block = reader.read_next();
+      BOOST_REQUIRE( block.valid() );
+      BOOST_CHECK( same_block( *block, make_block( num ) ) );
+   }
+   BOOST_CHECK_EQUAL( reader.current_position().sequence, 2u );
+   BOOST_CHECK( !reader.read_next().valid() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( change_feed_corrupted_record_test )
+{ try {
+   fc::temp_directory dir( graphene::utilities::temp_directory_path() );
+   append_record( dir.path(), 1, make_block( 1 ) );
+   append_record( dir.path(), 1, make_block( 2 ) );
+   {
+      // flip the last byte of the second record
+      std::fstream file( ( dir.path() / change_feed_file_name( 1 ) ).generic_string().c_str(),
+                         std::ios::in | std::ios::out | std::ios::binary );
+      file.seekg( -1, std::ios::end );
+      const char last = file.get();
+      file.seekp( -1, std::ios::end );
+      file.put( char( last ^ 1 ) );
+   }
+
+   change_feed_reader reader( dir.path() );
+   BOOST_REQUIRE( reader.read_next().valid() );
+   BOOST_CHECK_THROW( reader.read_next(), fc::exception );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,376 @@
+/*
+ * Copyright (c) 2018, YOYOW Foundation PTE. LTD. and contributors.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/net/inventory_filter.hpp>
+#include <graphene/net/message_cache.hpp>
+#include <graphene/net/peer_database.hpp>
+#include <graphene/net/sync_scheduler.hpp>
+#include <graphene/utilities/tempdir.hpp>
+
+#include <fc/filesystem.hpp>
+
+#include <map>
+#include <set>
+
+namespace {
+
+/**
+ * Deterministic simulation of a node syncing blocks from peers with given bandwidth and latency.
+ * Each peer serves requests one at a time in the order it receives them, and blocks are applied
+ * in blockchain order as soon as they are on hand.
+ * @return simulated time in microseconds until every block was applied
+ */
+int64_t simulate_sync( bool adaptive, const std::vector<std::pair<uint64_t,int64_t>>& peer_profiles,
+                       uint32_t block_count, std::vector<graphene::net::sync_peer_stats>* stats = nullptr )
+{
+   using namespace graphene::net;
+
+   struct simulated_peer
+   {
+      uint64_t                              bytes_per_second;
+      int64_t                               latency_us;
+      int64_t                               busy_until_us = 0;
+      sync_peer_tracker                     tracker;
+      boost::container::deque<item_hash_t> ids_of_items_to_get;
+      std::set<item_hash_t>                 requested;
+   };
+
+   std::vector<item_hash_t> block_ids;
+   std::map<item_hash_t, uint32_t> block_sizes;
+   for( uint32_t i = 0; i < block_count; ++i )
+   {
+      block_ids.push_back( fc::ripemd160::hash( (const char*)&i, sizeof(i) ) );
+      block_sizes[block_ids.back()] = 2000 + ( i * 7919 ) % 16000;
+   }
+
+   std::vector<simulated_peer> peers( peer_profiles.size() );
+   for( size_t p = 0; p < peers.size(); ++p )
+   {
+      peers[p].bytes_per_second = peer_profiles[p].first;
+      peers[p].latency_us = peer_profiles[p].second;
+      peers[p].ids_of_items_to_get.assign( block_ids.begin(), block_ids.end() );
+   }
+
+   int64_t now = 0;
+   std::multimap<int64_t, std::pair<size_t, item_hash_t>> deliveries;
+   std::unordered_set<item_hash_t> active_requests;
+   std::unordered_set<item_hash_t> rerequested;
+   std::unordered_set<item_hash_t> received;
+   uint32_t blocks_applied = 0;
+
+   auto send_requests = [&]( size_t p, const std::vector<item_hash_t>& ids ) {
+      simulated_peer& peer = peers[p];
+      for( const item_hash_t& id : ids )
+      {
+         peer.requested.insert( id );
+         active_requests.insert( id );
+         peer.tracker.block_requested( id, fc::time_point( fc::microseconds( now ) ) );
+         peer.busy_until_us = std::max( now + peer.latency_us, peer.busy_until_us )
+                              + int64_t( block_sizes[id] ) * 1000000 / int64_t( peer.bytes_per_second );
+         deliveries.emplace( peer.busy_until_us + peer.latency_us, std::make_pair( p, id ) );
+      }
+   };
+   auto already_requested = [&]( const item_hash_t& id ) {
+      return active_requests.count( id ) || received.count( id );
+   };
+   auto schedule = [&]() {
+      if( adaptive )
+      {
+         std::vector<sync_peer_candidate> candidates;
+         for( simulated_peer& peer : peers )
+            candidates.push_back( sync_peer_candidate{ &peer.tracker, &peer.ids_of_items_to_get, true } );
+         auto requests = schedule_sync_requests( candidates, already_requested, rerequested,
+                                                 GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING,
+                                                 fc::time_point( fc::microseconds( now ) ) );
+         for( size_t p = 0; p < peers.size(); ++p )
+            send_requests( p, requests[p] );
+      }
+      else
+      {
+         // what fetch_sync_items_loop used to do: fill each idle peer up to the fixed cap, in connection order
+         std::unordered_set<item_hash_t> scheduled;
+         for( size_t p = 0; p < peers.size(); ++p )
+         {
+            if( !peers[p].requested.empty() )
+               continue;
+            std::vector<item_hash_t> requests;
+            for( const item_hash_t& id : peers[p].ids_of_items_to_get )
+            {
+               if( scheduled.count( id ) || already_requested( id ) )
+                  continue;
+               requests.push_back( id );
+               scheduled.insert( id );
+               if( requests.size() >= GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING )
+                  break;
+            }
+            send_requests( p, requests );
+         }
+      }
+   };
+
+   const int64_t tick_us = GRAPHENE_NET_SYNC_STRAGGLER_MIN_TIMEOUT_MS * 1000 / 2;
+   int64_t next_tick = tick_us;
+   schedule();
+   while( blocks_applied < block_count )
+   {
+      FC_ASSERT( !deliveries.empty(), "simulated sync stalled" );
+      if( deliveries.begin()->first > next_tick )
+      {
+         now = next_tick;
+         next_tick += tick_us;
+         schedule();
+         continue;
+      }
+      now = deliveries.begin()->first;
+      size_t p = deliveries.begin()->second.first;
+      item_hash_t id = deliveries.begin()->second.second;
+      deliveries.erase( deliveries.begin() );
+
+      peers[p].requested.erase( id );
+      peers[p].tracker.block_received( id, block_sizes[id], fc::time_point( fc::microseconds( now ) ) );
+      if( rerequested.count( id ) && !active_requests.count( id ) )
+         rerequested.erase( id ); // the other copy arrived first
+      else
+      {
+         active_requests.erase( id );
+         received.insert( id );
+      }
+      while( blocks_applied < block_count && received.count( block_ids[blocks_applied] ) )
+      {
+         for( simulated_peer& peer : peers )
+            peer.ids_of_items_to_get.pop_front();
+         ++blocks_applied;
+      }
+      schedule();
+   }
+
+   if( stats )
+      for( const simulated_peer& peer : peers )
+         stats->push_back( peer.tracker.get_stats() );
+   return now;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE( net_tests )
+
+BOOST_AUTO_TEST_CASE( inventory_filter_test )
+{ try {
+   using graphene::net::item_id;
+   using graphene::net::inventory_filter;
+
+   const uint32_t items_per_bucket = 1000;
+   inventory_filter filter( items_per_bucket, fc::minutes(2) );
+   auto make_item = []( uint32_t i ) {
+      return item_id( graphene::net::trx_message_type, fc::ripemd160::hash( (const char*)&i, sizeof(i) ) );
+   };
+
+   fc::time_point now = fc::time_point::now();
+   for( uint32_t i = 0; i < items_per_bucket; ++i )
+      filter.insert( make_item(i), now );
+   BOOST_CHECK_EQUAL( filter.size(), items_per_bucket );
+
+   // no false negatives
+   for( uint32_t i = 0; i < items_per_bucket; ++i )
+      BOOST_CHECK( filter.contains( make_item(i), now ) );
+   // the same hash with another type is another item
+   BOOST_CHECK( !filter.contains( item_id( graphene::net::block_message_type, make_item(0).item_hash ), now ) );
+
+   uint32_t false_positives = 0;
+   for( uint32_t i = items_per_bucket; i < items_per_bucket * 101; ++i )
+      if( filter.contains( make_item(i), now ) )
+         ++false_positives;
+   BOOST_CHECK_LT( false_positives, 100u * 5 );
+
+   // a full bucket is rotated early, its items are kept until it is recycled
+   filter.insert( make_item( items_per_bucket ), now );
+   BOOST_CHECK( filter.contains( make_item(0), now ) );
+   BOOST_CHECK( filter.contains( make_item( items_per_bucket ), now ) );
+
+   // items expire after the lifetime
+   BOOST_CHECK( filter.contains( make_item(0), now + fc::seconds(119) ) );
+   BOOST_CHECK( !filter.contains( make_item(0), now + fc::minutes(2) ) );
+   BOOST_CHECK_EQUAL( filter.size( now + fc::minutes(2) ), 0u );
+   filter.insert( make_item(1), now + fc::minutes(2) );
+   BOOST_CHECK_EQUAL( filter.size( now + fc::minutes(2) ), 1u );
+   BOOST_CHECK( filter.contains( make_item(1), now + fc::minutes(2) ) );
+   BOOST_CHECK( !filter.contains( make_item(2), now + fc::minutes(2) ) );
+
+   filter.clear();
+   BOOST_CHECK_EQUAL( filter.size(), 0u );
+   BOOST_CHECK( !filter.contains( make_item(1), now + fc::minutes(2) ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( message_cache_test )
+{ try {
+   using namespace graphene::net;
+
+   blockchain_tied_message_cache cache( 3 );
+   auto make_message = []( uint32_t i ) {
+      return std::make_shared<const message>( item_ids_inventory_message( i, std::vector<item_hash_t>() ) );
+   };
+   auto contents_hash = []( uint32_t i ) { return fc::ripemd160::hash( (const char*)&i, sizeof(i) ); };
+
+   std::vector<shared_message> messages;
+   for( uint32_t i = 0; i < 4; ++i )
+   {
+      messages.push_back( make_message( i ) );
+      message_propagation_data propagation_data{ fc::time_point::now(), fc::time_point::now(), node_id_t() };
+      cache.cache_message( messages.back(), messages.back()->id(), propagation_data, contents_hash( i ) );
+      // caching a message twice keeps the first copy
+      cache.cache_message( make_message( i ), messages.back()->id(), propagation_data, fc::uint160_t() );
+      if( i < 3 )
+         cache.block_accepted();
+   }
+   BOOST_CHECK_EQUAL( cache.size(), 4u );
+   BOOST_CHECK_EQUAL( cache.block_clock(), 3u );
+
+   // bodies are shared, not copied
+   for( uint32_t i = 0; i < 4; ++i )
+   {
+      BOOST_CHECK( cache.get_message( messages[i]->id() ) == messages[i] );
+      cache.get_message_propagation_data( contents_hash( i ) );
+   }
+   BOOST_CHECK_THROW( cache.get_message( make_message( 4 )->id() ), fc::key_not_found_exception );
+   BOOST_CHECK_THROW( cache.get_message_propagation_data( fc::uint160_t() ), fc::key_not_found_exception );
+
+   // each block expires the messages received one block earlier than the cache duration
+   for( uint32_t i = 0; i < 4; ++i )
+   {
+      cache.block_accepted();
+      BOOST_CHECK_EQUAL( cache.size(), 3u - i );
+      BOOST_CHECK_THROW( cache.get_message( messages[i]->id() ), fc::key_not_found_exception );
+      BOOST_CHECK_THROW( cache.get_message_propagation_data( contents_hash( i ) ), fc::key_not_found_exception );
+      for( uint32_t j = i + 1; j < 4; ++j )
+         BOOST_CHECK( cache.get_message( messages[j]->id() ) == messages[j] );
+   }
+   // the cache released its references
+   BOOST_CHECK_EQUAL( messages.front().use_count(), 1 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( peer_database_test )
+{ try {
+   using namespace graphene::net;
+
+   fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+   const fc::path filename = data_dir.path() / "peers.dat";
+   const fc::time_point_sec now( fc::time_point::now() );
+   auto make_endpoint = []( uint32_t i ) { return fc::ip::endpoint( fc::ip::address( 0x0a000000 + i ), 1776 ); };
+
+   {
+      peer_database db;
+      db.open( filename );
+      for( uint32_t i = 0; i < 10; ++i )
+         db.update_entry( potential_peer_record( make_endpoint(i), now - fc::minutes(i) ) );
+
+      // a slow peer, a peer which keeps failing and a peer we just failed to connect to
+      potential_peer_record record = db.lookup_or_create_entry_for_endpoint( make_endpoint(1) );
+      record.round_trip_delay_ms = 6000;
+      db.update_entry( record );
+      record = db.lookup_or_create_entry_for_endpoint( make_endpoint(2) );
+      record.number_of_failed_connection_attempts = 5;
+      db.update_entry( record );
+      record = db.lookup_or_create_entry_for_endpoint( make_endpoint(3) );
+      record.last_connection_disposition = last_connection_failed;
+      record.last_connection_attempt_time = now;
+      record.last_error = fc::exception( FC_LOG_MESSAGE( error, "connection refused" ) );
+      db.update_entry( record );
+      db.erase( make_endpoint(9) );
+
+      auto candidates = db.get_connection_candidates( 4, now, 30, []( const fc::ip::endpoint& endpoint ) {
+         return endpoint == fc::ip::endpoint( fc::ip::address( 0x0a000000 ), 1776 );
+      } );
+      BOOST_REQUIRE_EQUAL( candidates.size(), 4u );
+      BOOST_CHECK( candidates[0].endpoint == make_endpoint(4) );
+      BOOST_CHECK( candidates[1].endpoint == make_endpoint(5) );
+      BOOST_CHECK( candidates[2].endpoint == make_endpoint(6) );
+      BOOST_CHECK( candidates[3].endpoint == make_endpoint(7) );
+      // the failed peer is eligible again after its retry delay
+      candidates = db.get_connection_candidates( 100, now + fc::seconds(31), 30, nullptr );
+      BOOST_CHECK_EQUAL( candidates.size(), 9u );
+      BOOST_CHECK( candidates.back().endpoint == make_endpoint(2) );
+      // the changes are only in the log, not compacted yet
+   }
+   // simulate a crash while appending by tearing the last entry
+   fc::resize_file( filename, fc::file_size( filename ) - 3 );
+   {
+      peer_database db;
+      db.open( filename );
+      // the erase of peer 9 was lost with the torn entry
+      BOOST_CHECK_EQUAL( db.size(), 10u );
+      auto record = db.lookup_entry_for_endpoint( make_endpoint(3) );
+      BOOST_REQUIRE( record.valid() );
+      BOOST_CHECK( record->last_connection_disposition == last_connection_failed );
+      BOOST_REQUIRE( record->last_error.valid() );
+      BOOST_CHECK_EQUAL( db.lookup_entry_for_endpoint( make_endpoint(1) )->round_trip_delay_ms, 6000u );
+      db.erase( make_endpoint(9) );
+      db.close();
+   }
+   {
+      // the database is compacted on close, opening it with a smaller maximum keeps the best peers
+      peer_database db;
+      db.open( filename, 3 );
+      BOOST_CHECK_EQUAL( db.size(), 3u );
+      BOOST_CHECK( db.lookup_entry_for_endpoint( make_endpoint(0) ).valid() );
+      BOOST_CHECK( db.lookup_entry_for_endpoint( make_endpoint(3) ).valid() );
+      BOOST_CHECK( db.lookup_entry_for_endpoint( make_endpoint(4) ).valid() );
+   }
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( sync_scheduler_simulation_test )
+{ try {
+   using namespace graphene::net;
+
+   // bytes per second and one-way latency: two good peers, a mediocre one and one on a very slow link
+   const std::vector<std::pair<uint64_t,int64_t>> mixed_pool = {
+      { 20000, 800000 }, { 2000000, 50000 }, { 150000, 300000 }, { 1000000, 100000 } };
+   std::vector<sync_peer_stats> stats;
+   const int64_t fixed_cap_us = simulate_sync( false, mixed_pool, 5000 );
+   const int64_t adaptive_us = simulate_sync( true, mixed_pool, 5000, &stats );
+   BOOST_TEST_MESSAGE( "simulated sync of 5000 blocks: fixed cap " << fixed_cap_us / 1000 << " ms, adaptive "
+                       << adaptive_us / 1000 << " ms" );
+   BOOST_CHECK_LT( adaptive_us * 2, fixed_cap_us );
+
+   BOOST_REQUIRE_EQUAL( stats.size(), 4u );
+   // the fast peers got large windows and most of the blocks, the slow one a small window
+   BOOST_CHECK_GT( stats[1].bytes_per_second, stats[0].bytes_per_second * 10 );
+   BOOST_CHECK_GT( stats[1].window, stats[0].window );
+   BOOST_CHECK_GT( stats[1].blocks_received, stats[0].blocks_received * 10 );
+
+   // with equally good peers the adaptive scheduler is no slower than the fixed cap
+   const std::vector<std::pair<uint64_t,int64_t>> uniform_pool( 4, { 1000000, 100000 } );
+   BOOST_CHECK_LE( simulate_sync( true, uniform_pool, 5000 ), simulate_sync( false, uniform_pool, 5000 ) * 11 / 10 );
+
+   // requests a peer sits on are handed to a faster peer which has the blocks, once each
+   const fc::time_point start = fc::time_point::now();
+   const item_hash_t a = fc::ripemd160::hash( std::string("a") );
+   const item_hash_t b = fc::ripemd160::hash( std::string("b") );
+   const item_hash_t c = fc::ripemd160::hash( std::string("c") );
+   sync_peer_tracker slow, fast;
+   fast.block_requested( c, start - fc::seconds(2) );
+   BOOST_CHECK( fast.block_received( c, 10000, start - fc::milliseconds(1900) ) );
+   BOOST_CHECK( !fast.block_received( c, 10000, start ) );
+   BOOST_CHECK_EQUAL( fast.bytes_per_second(), 100000u );
+   slow.block_requested( a, start );
+   slow.block_requested( b, start );
+   BOOST_CHECK( slow.get_stragglers( start + fc::seconds(1) ).empty() );
+
+   boost::container::deque<item_hash_t> ids;
+   ids.push_back( a );
+   ids.push_back( b );
+   ids.push_back( c );
+   const std::vector<sync_peer_candidate> candidates = { { &slow, &ids, true }, { &fast, &ids, true } };
+   std::unordered_set<item_hash_t> rerequested;
+   auto requests = schedule_sync_requests( candidates, [&]( const item_hash_t& id ) { return id == a || id == b; },
+                                           rerequested, GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING, start + fc::seconds(3) );
+   BOOST_CHECK( requests[0].empty() );
+   BOOST_CHECK( requests[1] == std::vector<item_hash_t>({ a, b, c }) );
+   BOOST_CHECK_EQUAL( rerequested.size(), 2u );
+   BOOST_CHECK_EQUAL( slow.get_stats().blocks_rerequested, 2u );
+   BOOST_CHECK_LT( slow.window(), uint32_t(GRAPHENE_NET_INITIAL_BLOCKS_PER_PEER_DURING_SYNCING) );
+   BOOST_CHECK( slow.get_stragglers( start + fc::seconds(3) ).empty() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()